@@ -0,0 +1,194 @@
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+
+#include <libaes/cpu_features.hpp>
+#include <benchaes/benchRunner.hpp>
+
+#if defined(LIBAES_X86)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+static inline uint64_t readCycles()
+{
+#if defined(LIBAES_X86)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+BenchResult benchMeasure(const std::string& name, uint64_t bytes, double minTime,
+    const std::function<void(uint64_t n)>& body)
+{
+    typedef std::chrono::steady_clock clock;
+
+    BenchResult result;
+    result.name = name;
+    result.keyBits = 0;
+    result.threads = 1;
+    result.bytes = bytes;
+
+    body(1); // Warm up caches, tables and threads
+
+    uint64_t n = 1;
+    while (true)
+    {
+        clock::time_point start = clock::now();
+        uint64_t startCycles = readCycles();
+        body(n);
+        uint64_t cycles = readCycles() - startCycles;
+        double seconds = std::chrono::duration<double>(clock::now() - start).count();
+
+        if (seconds >= minTime) {
+            result.iterations = n;
+            result.seconds = seconds;
+            result.cycles = cycles;
+            return result;
+        }
+
+        // Aim a bit past minTime from the last run, without jumping too far on tiny timings
+        double factor = seconds > 0 ? minTime / seconds * 1.2 : 100;
+        if (factor < 2)
+            factor = 2;
+        if (factor > 100)
+            factor = 100;
+        n = (uint64_t)(n * factor);
+    }
+}
+
+static std::string formatSize(uint64_t size)
+{
+    static const char* UNITS[] = { "B", "KB", "MB", "GB" };
+    int unit = 0;
+    while (unit < 3 && size >= 1024 && size % 1024 == 0) {
+        size /= 1024;
+        ++unit;
+    }
+    return std::to_string(size) + UNITS[unit];
+}
+
+void BenchReport::add(const BenchResult& result)
+{
+    double total = (double)result.bytes * result.iterations;
+    double gbps = total / result.seconds / 1e9;
+
+    std::cout << std::left << std::setw(22) << result.name
+        << std::setw(10) << (result.engine.empty() ? "-" : result.engine)
+        << std::setw(9) << (result.ghash.empty() ? "-" : result.ghash)
+        << std::setw(5) << (result.keyBits ? std::to_string(result.keyBits) : "-")
+        << std::right << std::setw(7) << formatSize(result.bytes)
+        << std::setw(4) << result.threads << "T"
+        << std::fixed << std::setprecision(3) << std::setw(10) << gbps << " GB/s";
+    if (result.cycles > 0)
+        std::cout << std::setprecision(2) << std::setw(10) << result.cycles / total << " c/B";
+    std::cout << std::endl;
+
+    this->results.push_back(result);
+}
+
+static std::string jsonString(const std::string& str)
+{
+    std::string out = "\"";
+    for (char c : str) {
+        if (c == '"' || c == '\\')
+            out += '\\';
+        out += c;
+    }
+    return out + "\"";
+}
+
+bool BenchReport::writeJson(const std::string& path) const
+{
+    const AES::CpuFeatures& cpu = AES::getCpuFeatures();
+    std::ostringstream json;
+
+    json << std::setprecision(6);
+    json << "{\n";
+    json << "  \"cpu\": { \"aesni\": " << (cpu.aesni ? "true" : "false")
+        << ", \"pclmul\": " << (cpu.pclmul ? "true" : "false")
+        << ", \"ssse3\": " << (cpu.ssse3 ? "true" : "false")
+        << ", \"avx2\": " << (cpu.avx2 ? "true" : "false")
+        << ", \"avx512\": " << (cpu.avx512 ? "true" : "false")
+        << ", \"vaes\": " << (cpu.vaes ? "true" : "false")
+        << ", \"vpclmul\": " << (cpu.vpclmul ? "true" : "false")
+        << ", \"hardware_threads\": " << std::thread::hardware_concurrency() << " },\n";
+    json << "  \"results\": [";
+    for (size_t i = 0; i < this->results.size(); ++i)
+    {
+        const BenchResult& r = this->results[i];
+        double total = (double)r.bytes * r.iterations;
+
+        json << (i == 0 ? "\n" : ",\n");
+        json << "    { \"name\": " << jsonString(r.name);
+        if (!r.engine.empty())
+            json << ", \"engine\": " << jsonString(r.engine);
+        if (!r.ghash.empty())
+            json << ", \"ghash\": " << jsonString(r.ghash);
+        if (r.keyBits > 0)
+            json << ", \"key_bits\": " << r.keyBits;
+        json << ", \"threads\": " << r.threads
+            << ", \"bytes\": " << r.bytes
+            << ", \"iterations\": " << r.iterations
+            << ", \"seconds\": " << r.seconds
+            << ", \"ns_per_op\": " << r.seconds * 1e9 / r.iterations
+            << ", \"gb_per_s\": " << total / r.seconds / 1e9;
+        if (r.cycles > 0)
+            json << ", \"cycles_per_byte\": " << r.cycles / total;
+        else
+            json << ", \"cycles_per_byte\": null";
+        json << " }";
+    }
+    json << "\n  ]\n}\n";
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+        return false;
+    file << json.str();
+    return file.good();
+}
+
+std::string engineName(AES::ENGINE engine)
+{
+    switch (engine)
+    {
+    case AES::ENGINE::AUTO:
+        return "auto";
+    case AES::ENGINE::REFERENCE:
+        return "ref";
+    case AES::ENGINE::TTABLE:
+        return "ttable";
+    case AES::ENGINE::BITSLICE:
+        return "bitslice";
+    case AES::ENGINE::AESNI:
+        return "aesni";
+    case AES::ENGINE::VAES:
+        return "vaes";
+    }
+    return "";
+}
+
+std::string ghashName(AES::GHASH ghash)
+{
+    switch (ghash)
+    {
+    case AES::GHASH::AUTO:
+        return "auto";
+    case AES::GHASH::REFERENCE:
+        return "ref";
+    case AES::GHASH::TABLE:
+        return "table";
+    case AES::GHASH::CLMUL:
+        return "clmul";
+    case AES::GHASH::VPCLMUL:
+        return "vpclmul";
+    }
+    return "";
+}
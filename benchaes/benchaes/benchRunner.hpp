@@ -0,0 +1,66 @@
+#ifndef BENCHAES_BENCH_RUNNER_HPP
+#define BENCHAES_BENCH_RUNNER_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <functional>
+
+#include <libaes/libaes.hpp>
+
+/**
+ * What to measure, filled from the command line
+ * Every list is swept, a result is produced for each combination that makes sense
+**/
+struct BenchConfig
+{
+    std::vector<size_t> sizes; // Message sizes, powers of 2 from min to max
+    std::vector<unsigned int> threads;
+    std::vector<AES::ENGINE> engines;
+    std::vector<AES::GHASH> ghashes;
+    std::vector<AES::KEY_SIZE> keySizes;
+    double minTime; // Seconds spent on each measure
+    std::string filter; // Only run the benchmarks whose name contains it
+};
+
+/**
+ * One measure, bytes is the amount of data processed by one iteration
+ * cycles is read from the CPU timestamp counter, 0 when there is none
+ * The timestamp counter runs at the nominal frequency, not the current one
+**/
+struct BenchResult
+{
+    std::string name;
+    std::string engine; // Empty when the benchmark doesn't depend on it
+    std::string ghash;
+    int keyBits;        // 0 when the benchmark doesn't depend on it
+    unsigned int threads;
+    uint64_t bytes;
+    uint64_t iterations;
+    double seconds;
+    uint64_t cycles;
+};
+
+/*
+    Runs body(n) with n growing until it takes at least minTime seconds
+    body must do n iterations of the measured code
+*/
+BenchResult benchMeasure(const std::string& name, uint64_t bytes, double minTime,
+    const std::function<void(uint64_t n)>& body);
+
+class BenchReport
+{
+public:
+    // Prints the result on stdout and keeps it for the JSON file
+    void add(const BenchResult& result);
+
+    bool writeJson(const std::string& path) const;
+
+private:
+    std::vector<BenchResult> results;
+};
+
+std::string engineName(AES::ENGINE engine);
+std::string ghashName(AES::GHASH ghash);
+
+#endif
@@ -0,0 +1,513 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <libaes/libaes.hpp>
+#include <libaes/aes_cipher.hpp>
+#include <libaes/aes_engine.hpp>
+#include <libaes/aes_ghash.hpp>
+#include <benchaes/benchSuites.hpp>
+
+typedef void (*keyExpansionFunc_t)(const byte_t* key, word_t* ksch);
+
+static const byte_t KEY[AES::AES::MAX_KEY_SIZE] = {
+    0x60, 0x3d, 0xeb, 0x10, 0x15, 0xca, 0x71, 0xbe, 0x2b, 0x73, 0xae, 0xf0, 0x85, 0x7d, 0x77, 0x81,
+    0x1f, 0x35, 0x2c, 0x07, 0x3b, 0x61, 0x08, 0xd7, 0x2d, 0x98, 0x10, 0xa3, 0x09, 0x14, 0xdf, 0xf4
+};
+static const byte_t IV[AES::AES::BLOCKSIZE] = {
+    0xca, 0xfe, 0xba, 0xbe, 0xfa, 0xce, 0xdb, 0xad, 0xde, 0xca, 0xf8, 0x88, 0x00, 0x00, 0x00, 0x01
+};
+static const byte_t AAD[20] = {
+    0xfe, 0xed, 0xfa, 0xce, 0xde, 0xad, 0xbe, 0xef, 0xfe, 0xed, 0xfa, 0xce, 0xde, 0xad, 0xbe, 0xef,
+    0xab, 0xad, 0xda, 0xd2
+};
+static const int GCM_IV_SIZE = 12;
+static const int OCB_NONCE_SIZE = 12;
+
+static bool isSelected(const BenchConfig& config, const std::string& name)
+{
+    return config.filter.empty() || name.find(config.filter) != std::string::npos;
+}
+
+static int getNr(AES::KEY_SIZE keySize)
+{
+    switch (keySize)
+    {
+    case AES::KEY_SIZE::S128:
+        return 10;
+    case AES::KEY_SIZE::S192:
+        return 12;
+    case AES::KEY_SIZE::S256:
+        return 14;
+    }
+    return 0;
+}
+
+static keyExpansionFunc_t getKeyExpansion(AES::KEY_SIZE keySize)
+{
+    switch (keySize)
+    {
+    case AES::KEY_SIZE::S128:
+        return AES::keyExpansion<4>;
+    case AES::KEY_SIZE::S192:
+        return AES::keyExpansion<6>;
+    case AES::KEY_SIZE::S256:
+        return AES::keyExpansion<8>;
+    }
+    return nullptr;
+}
+
+// Settings of one context of the modes benchmarks
+struct BenchContext
+{
+    AES::ENGINE engine;
+    AES::GHASH ghash;
+    AES::KEY_SIZE keySize;
+    unsigned int threads;
+};
+
+// Every combination of engine, ghash (GCM only), key size and threads
+static std::vector<BenchContext> getContexts(const BenchConfig& config, bool gcm)
+{
+    const std::vector<AES::GHASH> noGhash(1, AES::GHASH::AUTO);
+    std::vector<BenchContext> contexts;
+
+    for (AES::ENGINE engine : config.engines) {
+        for (AES::GHASH ghash : gcm ? config.ghashes : noGhash) {
+            for (AES::KEY_SIZE keySize : config.keySizes) {
+                for (unsigned int threads : config.threads)
+                    contexts.push_back({ engine, ghash, keySize, threads });
+            }
+        }
+    }
+    return contexts;
+}
+
+// Context ready to cipher, false if an engine is not supported by this CPU
+// XTS takes two keys, the second one is KEY reversed
+static bool initContext(AES::AES& aes, const BenchContext& context, AES::MODE mode)
+{
+    if (!aes.setEngine(context.engine) || !aes.setGhash(context.ghash))
+        return false;
+    aes.setThreads(context.threads);
+
+    byte_t key[2 * AES::AES::MAX_KEY_SIZE];
+    const int keyBytes = (int)context.keySize / 8;
+    memcpy(key, KEY, keyBytes);
+    for (int i = 0; i < keyBytes; ++i)
+        key[keyBytes + i] = KEY[keyBytes - 1 - i];
+    return aes.initialize(context.keySize, mode, false, key);
+}
+
+static void addContextResult(BenchReport& report, BenchResult& result,
+    const BenchContext& context, bool gcm)
+{
+    result.engine = engineName(context.engine);
+    if (gcm)
+        result.ghash = ghashName(context.ghash);
+    result.keyBits = (int)context.keySize;
+    result.threads = context.threads;
+    report.add(result);
+}
+
+// Largest message of the sweep plus room for a tag, filled with a pattern
+static std::vector<byte_t> makeBuffer(const BenchConfig& config)
+{
+    std::vector<byte_t> buffer(config.sizes.back() + AES::AES::STREAM_FINAL_SIZE);
+    for (size_t i = 0; i < buffer.size(); ++i)
+        buffer[i] = (byte_t)(i * 7 + 1);
+    return buffer;
+}
+
+void benchKeyExpansion(const BenchConfig& config, BenchReport& report)
+{
+    if (!isSelected(config, "keyExpansion"))
+        return;
+
+    for (AES::KEY_SIZE keySize : config.keySizes)
+    {
+        keyExpansionFunc_t expand = getKeyExpansion(keySize);
+        const int lastWord = 4 * getNr(keySize) + 3;
+        byte_t key[AES::AES::MAX_KEY_SIZE];
+        alignas(16) word_t ksch[60];
+
+        memcpy(key, KEY, sizeof(key));
+        BenchResult result = benchMeasure("keyExpansion", (int)keySize / 8, config.minTime,
+            [&](uint64_t n) {
+                for (uint64_t i = 0; i < n; ++i) {
+                    expand(key, ksch);
+                    key[0] ^= (byte_t)ksch[lastWord]; // Each key depends on the previous schedule
+                }
+            });
+        result.keyBits = (int)keySize;
+        report.add(result);
+    }
+}
+
+void benchBlocks(const BenchConfig& config, BenchReport& report)
+{
+    const unsigned int batch = AES::ENGINE_BATCH_BLOCKS;
+
+    for (AES::ENGINE engineId : config.engines)
+    {
+        for (AES::KEY_SIZE keySize : config.keySizes)
+        {
+            const AES::Engine* engine = AES::getEngine(engineId, getNr(keySize));
+            if (engine == nullptr)
+                continue;
+
+            alignas(16) word_t ksch[60];
+            alignas(16) word_t encKeys[60];
+            alignas(16) word_t decKeys[60];
+            alignas(16) byte_t blocks[AES::ENGINE_BATCH_BLOCKS * AES::AES::BLOCKSIZE];
+            getKeyExpansion(keySize)(KEY, ksch);
+            engine->prepareKeys(ksch, encKeys, decKeys);
+            memset(blocks, 0x5a, sizeof(blocks));
+
+            // Single block calls are chained on the same state, so they measure the latency
+            std::vector<BenchResult> results;
+            if (isSelected(config, "cipherBlock")) {
+                results.push_back(benchMeasure("cipherBlock", AES::AES::BLOCKSIZE,
+                    config.minTime, [&](uint64_t n) {
+                        for (uint64_t i = 0; i < n; ++i)
+                            engine->cipherBlock(blocks, encKeys);
+                    }));
+            }
+            if (isSelected(config, "decipherBlock")) {
+                results.push_back(benchMeasure("decipherBlock", AES::AES::BLOCKSIZE,
+                    config.minTime, [&](uint64_t n) {
+                        for (uint64_t i = 0; i < n; ++i)
+                            engine->decipherBlock(blocks, decKeys);
+                    }));
+            }
+            if (isSelected(config, "cipherBlocks")) {
+                results.push_back(benchMeasure("cipherBlocks", batch * AES::AES::BLOCKSIZE,
+                    config.minTime, [&](uint64_t n) {
+                        for (uint64_t i = 0; i < n; ++i)
+                            engine->cipherBlocks(blocks, batch, encKeys);
+                    }));
+            }
+            if (isSelected(config, "decipherBlocks")) {
+                results.push_back(benchMeasure("decipherBlocks", batch * AES::AES::BLOCKSIZE,
+                    config.minTime, [&](uint64_t n) {
+                        for (uint64_t i = 0; i < n; ++i)
+                            engine->decipherBlocks(blocks, batch, decKeys);
+                    }));
+            }
+
+            for (BenchResult& result : results) {
+                result.engine = engineName(engineId);
+                result.keyBits = (int)keySize;
+                report.add(result);
+            }
+        }
+    }
+}
+
+void benchGhash(const BenchConfig& config, BenchReport& report)
+{
+    qword_t H;
+    memcpy(QWTOBUF(H), KEY, AES::AES::BLOCKSIZE);
+
+    if (isSelected(config, "gmul")) {
+        qword_t Y;
+        memcpy(QWTOBUF(Y), IV, AES::AES::BLOCKSIZE);
+        report.add(benchMeasure("gmul", AES::AES::BLOCKSIZE, config.minTime, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i)
+                AES::gmul(H, Y);
+        }));
+    }
+
+    if (!isSelected(config, "ghash"))
+        return;
+
+    std::vector<byte_t> data = makeBuffer(config);
+    for (AES::GHASH ghashId : config.ghashes)
+    {
+        const AES::GhashEngine* engine = AES::getGhashEngine(ghashId);
+        if (engine == nullptr)
+            continue;
+
+        AES::GhashKey key;
+        engine->init(key, H);
+        for (size_t size : config.sizes)
+        {
+            qword_t Y = QWORD_STATIC_ZERO;
+            BenchResult result = benchMeasure("ghash", size, config.minTime, [&](uint64_t n) {
+                for (uint64_t i = 0; i < n; ++i)
+                    engine->update(key, Y, data.data(), size / AES::AES::BLOCKSIZE);
+            });
+            result.ghash = ghashName(ghashId);
+            report.add(result);
+        }
+    }
+}
+
+/*
+    Deciphering reads a message ciphered once beforehand, the buffers are never in place
+*/
+void benchModes(const BenchConfig& config, BenchReport& report)
+{
+    static const struct { const char* name; AES::MODE mode; } MODES[] = {
+        { "ecb", AES::MODE::ECB },
+        { "cbc", AES::MODE::CBC },
+        { "ctr", AES::MODE::CTR },
+        { "gcm", AES::MODE::GCM },
+        { "xts", AES::MODE::XTS },
+        { "ocb", AES::MODE::OCB },
+        { "gcm-siv", AES::MODE::GCM_SIV }
+    };
+    std::vector<byte_t> plain;
+    std::vector<byte_t> cipher;
+    for (const auto& mode : MODES)
+    {
+        const bool gcm = mode.mode == AES::MODE::GCM;
+        const bool ocb = mode.mode == AES::MODE::OCB;
+        const bool siv = mode.mode == AES::MODE::GCM_SIV; // POLYVAL runs on the ghash engines
+        const std::string encryptName = std::string(mode.name) + "/encrypt";
+        const std::string decryptName = std::string(mode.name) + "/decrypt";
+        const bool doEncrypt = isSelected(config, encryptName);
+        const bool doDecrypt = isSelected(config, decryptName);
+        if (!doEncrypt && !doDecrypt)
+            continue;
+        if (plain.empty()) {
+            plain = makeBuffer(config);
+            cipher = makeBuffer(config);
+        }
+
+        for (const BenchContext& context : getContexts(config, gcm || siv))
+        {
+            AES::AES aes;
+            if (!initContext(aes, context, mode.mode)) // No 192 bits XTS or GCM-SIV
+                continue;
+            aes.setIv(IV, gcm ? GCM_IV_SIZE : ocb ? OCB_NONCE_SIZE
+                : siv ? AES::AES::SIV_NONCE_SIZE : AES::AES::BLOCKSIZE);
+            aes.setAad(nullptr, 0);
+
+            for (size_t size : config.sizes)
+            {
+                const size_t tagSize = gcm || ocb || siv ? AES::AES::BLOCKSIZE : 0;
+                std::vector<BenchResult> results;
+                bool ok = true;
+
+                if (doEncrypt) {
+                    results.push_back(benchMeasure(encryptName, size, config.minTime,
+                        [&](uint64_t n) {
+                            for (uint64_t i = 0; i < n; ++i)
+                                ok &= aes.cipher(plain.data(), cipher.data(), size);
+                        }));
+                }
+                if (doDecrypt) {
+                    ok &= aes.cipher(plain.data(), cipher.data(), size);
+                    results.push_back(benchMeasure(decryptName, size, config.minTime,
+                        [&](uint64_t n) {
+                            for (uint64_t i = 0; i < n; ++i)
+                                ok &= aes.decipher(cipher.data(), plain.data(), size + tagSize);
+                        }));
+                }
+                if (!ok) {
+                    std::cout << mode.name << " failed, engine " << engineName(context.engine)
+                        << ", size " << size << std::endl;
+                    continue;
+                }
+
+                for (BenchResult& result : results)
+                    addContextResult(report, result, context, gcm || siv);
+            }
+        }
+    }
+}
+
+void benchGcm(const BenchConfig& config, BenchReport& report)
+{
+    if (!isSelected(config, "gcm/roundtrip"))
+        return;
+
+    std::vector<byte_t> plain = makeBuffer(config);
+    std::vector<byte_t> cipher = makeBuffer(config);
+
+    for (const BenchContext& context : getContexts(config, true))
+    {
+        AES::AES aes;
+        if (!initContext(aes, context, AES::MODE::GCM))
+            continue;
+
+        for (size_t size : config.sizes)
+        {
+            bool ok = true;
+            BenchResult result = benchMeasure("gcm/roundtrip", size, config.minTime,
+                [&](uint64_t n) {
+                    for (uint64_t i = 0; i < n; ++i) {
+                        ok &= aes.setIv(IV, GCM_IV_SIZE);
+                        ok &= aes.setAad(AAD, sizeof(AAD));
+                        ok &= aes.cipher(plain.data(), cipher.data(), size);
+                        ok &= aes.decipher(cipher.data(), plain.data(), size + AES::AES::BLOCKSIZE);
+                    }
+                });
+            if (!ok) {
+                std::cout << "gcm roundtrip failed, engine " << engineName(context.engine)
+                    << ", size " << size << std::endl;
+                continue;
+            }
+
+            addContextResult(report, result, context, true);
+        }
+    }
+}
+
+/*
+    Many short messages, each with its own iv: setIv and cipher per message against a single
+    cipherBatch call, for a few lane counts. The batch runs on the calling thread, so only
+    the 1 thread contexts are measured
+*/
+void benchBatch(const BenchConfig& config, BenchReport& report)
+{
+    static const struct { const char* name; AES::MODE mode; } MODES[] = {
+        { "cbc", AES::MODE::CBC },
+        { "gcm", AES::MODE::GCM },
+        { "gcm-siv", AES::MODE::GCM_SIV }
+    };
+    static const unsigned int LANES[] = { 4, 8, 16 };
+    static const size_t MESSAGES = 64;
+    static const size_t MAX_SIZE = 64 << 10;
+
+    for (const auto& mode : MODES)
+    {
+        const bool gcm = mode.mode == AES::MODE::GCM;
+        const bool siv = mode.mode == AES::MODE::GCM_SIV;
+        const bool tagged = gcm || siv;
+        const std::string messagesName = std::string(mode.name) + "/messages";
+        const std::string batchName = std::string(mode.name) + "/batch";
+        if (!isSelected(config, messagesName) && !isSelected(config, batchName + "16"))
+            continue;
+
+        for (const BenchContext& context : getContexts(config, tagged))
+        {
+            AES::AES aes;
+            if (context.threads != 1 || !initContext(aes, context, mode.mode))
+                continue;
+
+            for (size_t size : config.sizes)
+            {
+                if (size > MAX_SIZE)
+                    break;
+                const size_t stride = size + AES::AES::BLOCKSIZE; // Room for the tag
+                std::vector<byte_t> plain(MESSAGES * stride, 0x5a);
+                std::vector<byte_t> cipher(MESSAGES * stride);
+                std::vector<AES::BatchJob> jobs(MESSAGES);
+                for (size_t i = 0; i < MESSAGES; ++i) {
+                    jobs[i] = {};
+                    jobs[i].key = &aes;
+                    jobs[i].iv = IV;
+                    jobs[i].ivSize = gcm ? GCM_IV_SIZE
+                        : siv ? AES::AES::SIV_NONCE_SIZE : AES::AES::BLOCKSIZE;
+                    jobs[i].aad = tagged ? AAD : nullptr;
+                    jobs[i].aadSize = tagged ? sizeof(AAD) : 0;
+                    jobs[i].dataIn = plain.data() + i * stride;
+                    jobs[i].dataOut = cipher.data() + i * stride;
+                    jobs[i].dataSize = size;
+                }
+
+                std::vector<BenchResult> results;
+                bool ok = true;
+                if (isSelected(config, messagesName)) {
+                    results.push_back(benchMeasure(messagesName, MESSAGES * size, config.minTime,
+                        [&](uint64_t n) {
+                            for (uint64_t i = 0; i < n; ++i) {
+                                for (const AES::BatchJob& job : jobs) {
+                                    ok &= aes.setIv(job.iv, (int)job.ivSize);
+                                    if (tagged)
+                                        ok &= aes.setAad(job.aad, (int)job.aadSize);
+                                    ok &= aes.cipher((byte_t*)job.dataIn, job.dataOut, size);
+                                }
+                            }
+                        }));
+                }
+                for (unsigned int lanes : LANES)
+                {
+                    const std::string name = batchName + std::to_string(lanes);
+                    if (!isSelected(config, name))
+                        continue;
+                    results.push_back(benchMeasure(name, MESSAGES * size, config.minTime,
+                        [&](uint64_t n) {
+                            for (uint64_t i = 0; i < n; ++i)
+                                ok &= AES::AES::cipherBatch(jobs.data(), jobs.size(), lanes);
+                        }));
+                }
+                if (!ok) {
+                    std::cout << mode.name << " batch failed, engine "
+                        << engineName(context.engine) << ", size " << size << std::endl;
+                    continue;
+                }
+
+                for (BenchResult& result : results)
+                    addContextResult(report, result, context, tagged);
+            }
+        }
+    }
+}
+
+/*
+    Disk style XTS: the largest message size of the sweep as consecutive sectors of 512, 4096
+    and 16384 bytes, numbered from 0, in one cipherSectors/decipherSectors call
+*/
+void benchXts(const BenchConfig& config, BenchReport& report)
+{
+    static const size_t SECTOR_SIZES[] = { 512, 4096, 16384 };
+
+    for (size_t sectorSize : SECTOR_SIZES)
+    {
+        const std::string name = "xts" + std::to_string(sectorSize);
+        const std::string encryptName = name + "/encrypt";
+        const std::string decryptName = name + "/decrypt";
+        const bool doEncrypt = isSelected(config, encryptName);
+        const bool doDecrypt = isSelected(config, decryptName);
+        if (!doEncrypt && !doDecrypt)
+            continue;
+
+        const size_t count = std::max<size_t>(1, config.sizes.back() / sectorSize);
+        const size_t size = count * sectorSize;
+        std::vector<byte_t> plain(size, 0x5a);
+        std::vector<byte_t> cipher(size);
+        std::vector<uint64_t> sectors(count);
+        for (size_t i = 0; i < count; ++i)
+            sectors[i] = i;
+
+        for (const BenchContext& context : getContexts(config, false))
+        {
+            AES::AES aes;
+            if (!initContext(aes, context, AES::MODE::XTS))
+                continue;
+
+            std::vector<BenchResult> results;
+            bool ok = true;
+            if (doEncrypt) {
+                results.push_back(benchMeasure(encryptName, size, config.minTime,
+                    [&](uint64_t n) {
+                        for (uint64_t i = 0; i < n; ++i) {
+                            ok &= aes.cipherSectors(plain.data(), cipher.data(), sectorSize,
+                                sectors.data(), count);
+                        }
+                    }));
+            }
+            if (doDecrypt) {
+                results.push_back(benchMeasure(decryptName, size, config.minTime,
+                    [&](uint64_t n) {
+                        for (uint64_t i = 0; i < n; ++i) {
+                            ok &= aes.decipherSectors(cipher.data(), plain.data(), sectorSize,
+                                sectors.data(), count);
+                        }
+                    }));
+            }
+            if (!ok) {
+                std::cout << name << " failed, engine " << engineName(context.engine)
+                    << std::endl;
+                continue;
+            }
+
+            for (BenchResult& result : results)
+                addContextResult(report, result, context, false);
+        }
+    }
+}
@@ -0,0 +1,27 @@
+#ifndef BENCHAES_BENCH_SUITES_HPP
+#define BENCHAES_BENCH_SUITES_HPP
+
+#include <benchaes/benchRunner.hpp>
+
+// Key schedule, one result per key size
+void benchKeyExpansion(const BenchConfig& config, BenchReport& report);
+
+// Single block (latency) and batch (throughput) primitives of each engine
+void benchBlocks(const BenchConfig& config, BenchReport& report);
+
+// gmul and the GHASH engines over the message sizes
+void benchGhash(const BenchConfig& config, BenchReport& report);
+
+// One shot cipher/decipher of every mode over the message sizes and thread counts
+void benchModes(const BenchConfig& config, BenchReport& report);
+
+// GCM as an application uses it: iv, aad, cipher then decipher with the tag check
+void benchGcm(const BenchConfig& config, BenchReport& report);
+
+// 64 messages of each size up to 64 KB, one call per message against cipherBatch
+void benchBatch(const BenchConfig& config, BenchReport& report);
+
+// XTS sectors of 512, 4096 and 16384 bytes filling the largest message size
+void benchXts(const BenchConfig& config, BenchReport& report);
+
+#endif
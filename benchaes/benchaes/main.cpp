@@ -0,0 +1,289 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <exception>
+#include <thread>
+
+#include <boost/program_options.hpp>
+
+#include <libaes/libaes.hpp>
+#include <libaes/aes_engine.hpp>
+#include <libaes/aes_ghash.hpp>
+#include <benchaes/benchRunner.hpp>
+#include <benchaes/benchSuites.hpp>
+
+struct Args
+{
+    BenchConfig config;
+    std::string json;
+};
+
+bool getArgs(int argc, char** argv, Args& args);
+
+int main(int argc, char** argv)
+{
+    Args args;
+    if (!getArgs(argc, argv, args))
+        return -1;
+
+    BenchReport report;
+    benchKeyExpansion(args.config, report);
+    benchBlocks(args.config, report);
+    benchGhash(args.config, report);
+    benchModes(args.config, report);
+    benchGcm(args.config, report);
+    benchBatch(args.config, report);
+    benchXts(args.config, report);
+
+    if (args.json.size() > 0 && !report.writeJson(args.json)) {
+        std::cout << "Can't write file " << args.json << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
+
+static std::vector<std::string> splitList(const std::string& list)
+{
+    std::vector<std::string> items;
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t end = list.find(',', start);
+        if (end == std::string::npos)
+            end = list.size();
+        if (end > start)
+            items.push_back(list.substr(start, end - start));
+        start = end + 1;
+    }
+    return items;
+}
+
+// Number of bytes with an optional K, M or G suffix, 0 if invalid
+static size_t parseSize(const std::string& str)
+{
+    size_t size;
+    size_t end;
+    try {
+        size = std::stoull(str, &end);
+    }
+    catch (const std::exception& e) {
+        (void)e;
+        return 0;
+    }
+
+    std::string suffix = str.substr(end);
+    if (suffix == "K" || suffix == "KB")
+        size <<= 10;
+    else if (suffix == "M" || suffix == "MB")
+        size <<= 20;
+    else if (suffix == "G" || suffix == "GB")
+        size <<= 30;
+    else if (suffix != "" && suffix != "B")
+        return 0;
+    return size;
+}
+
+// AUTO is replaced by the engine it picks, results are always tied to a real engine
+static bool parseEngines(const std::string& list, std::vector<AES::ENGINE>& engines)
+{
+    static const AES::ENGINE ALL[] = { AES::ENGINE::REFERENCE, AES::ENGINE::TTABLE,
+        AES::ENGINE::BITSLICE, AES::ENGINE::AESNI, AES::ENGINE::VAES };
+
+    for (const std::string& name : splitList(list))
+    {
+        if (name == "all") {
+            for (AES::ENGINE engine : ALL) {
+                if (AES::AES::isEngineSupported(engine))
+                    engines.push_back(engine);
+            }
+        }
+        else if (name == "auto")
+            engines.push_back(AES::getEngine(AES::ENGINE::AUTO, 10)->id);
+        else if (name == "ref")
+            engines.push_back(AES::ENGINE::REFERENCE);
+        else if (name == "ttable")
+            engines.push_back(AES::ENGINE::TTABLE);
+        else if (name == "bitslice")
+            engines.push_back(AES::ENGINE::BITSLICE);
+        else if (name == "aesni")
+            engines.push_back(AES::ENGINE::AESNI);
+        else if (name == "vaes")
+            engines.push_back(AES::ENGINE::VAES);
+        else
+            return false;
+    }
+    return !engines.empty();
+}
+
+static bool parseGhashes(const std::string& list, std::vector<AES::GHASH>& ghashes)
+{
+    static const AES::GHASH ALL[] = { AES::GHASH::REFERENCE, AES::GHASH::TABLE,
+        AES::GHASH::CLMUL, AES::GHASH::VPCLMUL };
+
+    for (const std::string& name : splitList(list))
+    {
+        if (name == "all") {
+            for (AES::GHASH ghash : ALL) {
+                if (AES::AES::isGhashSupported(ghash))
+                    ghashes.push_back(ghash);
+            }
+        }
+        else if (name == "auto")
+            ghashes.push_back(AES::getGhashEngine(AES::GHASH::AUTO)->id);
+        else if (name == "ref")
+            ghashes.push_back(AES::GHASH::REFERENCE);
+        else if (name == "table")
+            ghashes.push_back(AES::GHASH::TABLE);
+        else if (name == "clmul")
+            ghashes.push_back(AES::GHASH::CLMUL);
+        else if (name == "vpclmul")
+            ghashes.push_back(AES::GHASH::VPCLMUL);
+        else
+            return false;
+    }
+    return !ghashes.empty();
+}
+
+static bool parseKeySizes(const std::string& list, std::vector<AES::KEY_SIZE>& keySizes)
+{
+    for (const std::string& name : splitList(list))
+    {
+        if (name == "all") {
+            keySizes.push_back(AES::KEY_SIZE::S128);
+            keySizes.push_back(AES::KEY_SIZE::S192);
+            keySizes.push_back(AES::KEY_SIZE::S256);
+        }
+        else if (name == "128")
+            keySizes.push_back(AES::KEY_SIZE::S128);
+        else if (name == "192")
+            keySizes.push_back(AES::KEY_SIZE::S192);
+        else if (name == "256")
+            keySizes.push_back(AES::KEY_SIZE::S256);
+        else
+            return false;
+    }
+    return !keySizes.empty();
+}
+
+static bool parseThreads(const std::string& list, std::vector<unsigned int>& threads)
+{
+    for (const std::string& name : splitList(list))
+    {
+        int n;
+        try {
+            n = std::stoi(name);
+        }
+        catch (const std::exception& e) {
+            (void)e;
+            return false;
+        }
+        if (n < 0 || n > 256)
+            return false;
+        if (n == 0)
+            n = (int)std::thread::hardware_concurrency();
+        threads.push_back(n > 0 ? (unsigned int)n : 1);
+    }
+    return !threads.empty();
+}
+
+static bool checkArgs(boost::program_options::variables_map& vm, Args& args)
+{
+    BenchConfig& config = args.config;
+    bool gotError = false;
+
+    if (vm.count("help")) {
+        return false;
+    }
+
+    args.json = vm.count("json") ? vm["json"].as<std::string>() : "";
+    config.filter = vm.count("filter") ? vm["filter"].as<std::string>() : "";
+
+    if (!parseEngines(vm["engine"].as<std::string>(), config.engines)) {
+        std::cout << "Engine is invalid" << std::endl;
+        gotError = true;
+    }
+    if (!parseGhashes(vm["ghash"].as<std::string>(), config.ghashes)) {
+        std::cout << "Ghash is invalid" << std::endl;
+        gotError = true;
+    }
+    if (!parseKeySizes(vm["size"].as<std::string>(), config.keySizes)) {
+        std::cout << "Key size is invalid" << std::endl;
+        gotError = true;
+    }
+
+    std::string threads = "1";
+    if (std::thread::hardware_concurrency() > 1)
+        threads += "," + std::to_string(std::thread::hardware_concurrency());
+    if (vm.count("threads"))
+        threads = vm["threads"].as<std::string>();
+    if (!parseThreads(threads, config.threads)) {
+        std::cout << "Number of threads must be in range [0;256]" << std::endl;
+        gotError = true;
+    }
+
+    // Sizes are multiples of 16 bytes, so every mode runs without padding
+    size_t minSize = parseSize(vm["min-size"].as<std::string>());
+    size_t maxSize = parseSize(vm["max-size"].as<std::string>());
+    if (minSize == 0 || maxSize < minSize || minSize % AES::AES::BLOCKSIZE != 0) {
+        std::cout << "Message sizes must be multiples of 16 bytes, min <= max" << std::endl;
+        gotError = true;
+    }
+    else {
+        for (size_t size = minSize; size <= maxSize && size != 0; size *= 4)
+            config.sizes.push_back(size);
+    }
+
+    config.minTime = vm["min-time"].as<double>();
+    if (config.minTime <= 0) {
+        std::cout << "Minimal time must be positive" << std::endl;
+        gotError = true;
+    }
+
+    return !gotError;
+}
+
+bool getArgs(int argc, char** argv, Args& args)
+{
+    namespace po = boost::program_options;
+
+    po::options_description desc("Command line options");
+    desc.add_options()
+        ("help,h", "produce help message then exit")
+        ("json,j", po::value<std::string>(), "write the results in this JSON file")
+        ("filter,f", po::value<std::string>(),
+            "only run the benchmarks whose name contains this string")
+        ("engine", po::value<std::string>()->default_value("auto"),
+            "cipher engines, comma separated (all, auto, ref, ttable, bitslice, aesni, vaes)")
+        ("ghash", po::value<std::string>()->default_value("auto"),
+            "gcm, gcm-siv ghash engines, comma separated (all, auto, ref, table, clmul, vpclmul)")
+        ("size,s", po::value<std::string>()->default_value("128"),
+            "key sizes, comma separated (all, 128, 192, 256)")
+        ("threads", po::value<std::string>(),
+            "thread counts, comma separated, 0 = all cores, default = 1 and all cores")
+        ("min-size", po::value<std::string>()->default_value("16"),
+            "smallest message, K/M/G suffixes allowed")
+        ("max-size", po::value<std::string>()->default_value("1G"),
+            "largest message, sizes go from min to max by a factor of 4")
+        ("min-time", po::value<double>()->default_value(0.2, "0.2"),
+            "seconds spent on each measure");
+
+    po::variables_map vm;
+    try
+    {
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        po::notify(vm);
+    }
+    catch (std::exception& e)
+    {
+        std::cout << e.what() << std::endl;
+        return false;
+    }
+
+    if (!checkArgs(vm, args))
+    {
+        std::cout << desc << std::endl;
+        return false;
+    }
+
+    return true;
+}
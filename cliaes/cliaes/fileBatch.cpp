@@ -0,0 +1,262 @@
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include <libaes/types.hpp>
+#include <libaes/libaes.hpp>
+#include <cliaes/fileBatch.hpp>
+
+static bool parseHex(const std::string& str, std::vector<byte_t>& bytes)
+{
+    static const std::string DIGITS = "0123456789abcdef";
+
+    if (str.size() % 2 != 0)
+        return false;
+    bytes.resize(str.size() / 2);
+    for (size_t i = 0; i < str.size(); i += 2)
+    {
+        size_t hi = DIGITS.find((char)tolower(str[i]));
+        size_t lo = DIGITS.find((char)tolower(str[i + 1]));
+        if (hi == std::string::npos || lo == std::string::npos)
+            return false;
+        bytes[i / 2] = (byte_t)((hi << 4) | lo);
+    }
+    return true;
+}
+
+static bool isIvSizeValid(AES::MODE mode, size_t ivSize)
+{
+    if (mode == AES::MODE::GCM)
+        return AES::AES::isGcmIvSizeValid((unsigned int)ivSize);
+    if (mode == AES::MODE::OCB)
+        return AES::AES::isOcbIvSizeValid((unsigned int)ivSize);
+    return ivSize == AES::AES::BLOCKSIZE;
+}
+
+bool loadBatchManifest(const std::string& path, const BatchConfig& config,
+    std::vector<BatchEntry>& entries)
+{
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cout << "Can't load manifest " << path << std::endl;
+        return false;
+    }
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line))
+    {
+        ++lineNumber;
+        std::istringstream fields(line);
+        BatchEntry entry;
+        std::string iv;
+        if (!(fields >> entry.in) || entry.in[0] == '#')
+            continue;
+        if (!(fields >> entry.out))
+            entry.out = entry.in + (config.encrypt ? ".encrypted" : ".decrypted");
+        if (fields >> iv) {
+            if (!parseHex(iv, entry.iv) || !isIvSizeValid(config.mode, entry.iv.size())) {
+                std::cout << "Invalid iv line " << lineNumber << " of " << path << std::endl;
+                return false;
+            }
+        }
+        entries.push_back(entry);
+    }
+    return true;
+}
+
+bool listBatchDirectory(const std::string& dirIn, const std::string& dirOut,
+    std::vector<BatchEntry>& entries)
+{
+    namespace fs = boost::filesystem;
+
+    boost::system::error_code error;
+    if (!fs::is_directory(dirIn, error)) {
+        std::cout << "Can't read directory " << dirIn << std::endl;
+        return false;
+    }
+    fs::create_directories(dirOut, error);
+    if (!fs::is_directory(dirOut, error) || fs::equivalent(dirIn, dirOut, error)) {
+        std::cout << "Output directory must be a new or another directory" << std::endl;
+        return false;
+    }
+
+    // Sorted, so the index of each file (and its derived iv) does not depend on the system
+    std::vector<std::string> names;
+    for (fs::directory_iterator it(dirIn, error), end; !error && it != end; it.increment(error))
+    {
+        if (fs::is_regular_file(it->status()))
+            names.push_back(it->path().filename().string());
+    }
+    if (error) {
+        std::cout << "Can't read directory " << dirIn << std::endl;
+        return false;
+    }
+    std::sort(names.begin(), names.end());
+
+    for (const std::string& name : names)
+    {
+        BatchEntry entry;
+        entry.in = (fs::path(dirIn) / name).string();
+        entry.out = (fs::path(dirOut) / name).string();
+        entries.push_back(entry);
+    }
+    return true;
+}
+
+bool deriveBatchIvs(const BatchConfig& config, std::vector<BatchEntry>& entries)
+{
+    const size_t ivSize = config.iv.size();
+    if (config.mode == AES::MODE::ECB) {
+        for (BatchEntry& entry : entries) {
+            if (entry.iv.empty())
+                entry.iv = config.iv;
+        }
+        return true;
+    }
+
+    // GCM and OCB ivs can be shorter than the index
+    const bool nonce = config.mode == AES::MODE::GCM || config.mode == AES::MODE::OCB;
+    const size_t indexSize = ivSize < 8 ? ivSize : 8;
+    const size_t indexOffset = nonce ? ivSize - indexSize : 0;
+    if (indexSize < 8 && entries.size() > ((uint64_t)1 << (8 * indexSize))) {
+        std::cout << "iv is too short to derive an iv per file" << std::endl;
+        return false;
+    }
+
+    AES::AES ecb;
+    if (config.mode == AES::MODE::CBC) {
+        ecb.setEngine(config.engine);
+        if (!ecb.initialize(config.size, AES::MODE::ECB, false, config.key.data()))
+            return false;
+    }
+
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        BatchEntry& entry = entries[i];
+        if (!entry.iv.empty())
+            continue;
+
+        entry.iv = config.iv;
+        uint64_t index = i;
+        for (size_t b = indexSize; b > 0; --b) {
+            entry.iv[indexOffset + b - 1] ^= (byte_t)index;
+            index >>= 8;
+        }
+        if (config.mode == AES::MODE::CTR)
+            memset(entry.iv.data() + 8, 0, AES::AES::BLOCKSIZE - 8);
+        if (config.mode == AES::MODE::CBC)
+            ecb.cipher(entry.iv.data(), entry.iv.data(), AES::AES::BLOCKSIZE);
+    }
+    return true;
+}
+
+// Same as cryptFile, without the pipeline threads: the workers already overlap reads and writes
+static PIPELINE_STATUS cryptEntry(AES::AES& aes, bool encrypt, const BatchEntry& entry,
+    std::vector<byte_t>& bufferIn, std::vector<byte_t>& bufferOut)
+{
+    if (entry.in == entry.out)
+        return PIPELINE_STATUS::WRITE_ERROR;
+
+    std::ifstream fileIn(entry.in, std::ios::in | std::ios::binary);
+    if (!fileIn.is_open())
+        return PIPELINE_STATUS::READ_ERROR;
+    std::ofstream fileOut(entry.out, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!fileOut.is_open())
+        return PIPELINE_STATUS::WRITE_ERROR;
+
+    bool readError = false;
+    bool writeError = false;
+    bool cryptError = !aes.init(encrypt);
+    bool last = false;
+    while (!last && !readError && !writeError && !cryptError)
+    {
+        IoTimer readTimer(AES::STAGE::READ);
+        fileIn.read((char*)bufferIn.data(), BATCH_BUFFER_SIZE);
+        size_t inSize = (size_t)fileIn.gcount();
+        readTimer.done(inSize);
+        readError = fileIn.bad();
+        last = fileIn.eof() || fileIn.fail();
+
+        size_t outSize = 0;
+        cryptError = !aes.update(bufferIn.data(), inSize, bufferOut.data(), outSize);
+        if (!cryptError && last) {
+            size_t finalSize = 0;
+            cryptError = !aes.final(bufferOut.data() + outSize, finalSize);
+            outSize += finalSize;
+        }
+        if (!cryptError && outSize > 0) {
+            IoTimer writeTimer(AES::STAGE::WRITE);
+            fileOut.write((const char*)bufferOut.data(), outSize);
+            writeError = !fileOut.good();
+            writeTimer.done(outSize);
+        }
+    }
+
+    fileOut.close();
+    writeError = writeError || fileOut.fail();
+    if (readError || writeError || cryptError)
+    {
+        std::remove(entry.out.c_str());
+        if (readError)
+            return PIPELINE_STATUS::READ_ERROR;
+        if (writeError)
+            return PIPELINE_STATUS::WRITE_ERROR;
+        return PIPELINE_STATUS::CRYPT_ERROR;
+    }
+    return PIPELINE_STATUS::OK;
+}
+
+void cryptBatch(const BatchConfig& config, const std::vector<BatchEntry>& entries,
+    std::vector<PIPELINE_STATUS>& status)
+{
+    status.assign(entries.size(), PIPELINE_STATUS::CRYPT_ERROR);
+
+    unsigned int workers = config.workers;
+    if (workers == 0)
+        workers = std::thread::hardware_concurrency();
+    if (workers > entries.size())
+        workers = (unsigned int)entries.size();
+    if (workers == 0)
+        return;
+
+    std::atomic<size_t> nextEntry(0);
+    auto worker = [&]() {
+        AES::AES aes;
+        bool ready = aes.setEngine(config.engine) && aes.setGhash(config.ghash)
+            && aes.initialize(config.size, config.mode, config.padding, config.key.data())
+            && aes.setAad(config.aad.data(), (int)config.aad.size());
+
+        // update may give BLOCKSIZE more bytes, then final
+        std::vector<byte_t> bufferIn(BATCH_BUFFER_SIZE);
+        std::vector<byte_t> bufferOut(BATCH_BUFFER_SIZE + AES::AES::BLOCKSIZE
+            + AES::AES::STREAM_FINAL_SIZE);
+
+        size_t i;
+        while ((i = nextEntry++) < entries.size())
+        {
+            const BatchEntry& entry = entries[i];
+            if (!ready || !aes.setIv(entry.iv.data(), (int)entry.iv.size()))
+                continue; // Stays CRYPT_ERROR
+            status[i] = cryptEntry(aes, config.encrypt, entry, bufferIn, bufferOut);
+        }
+    };
+
+    // The caller is a worker too
+    std::vector<std::thread> threads;
+    for (unsigned int w = 1; w < workers; ++w)
+        threads.emplace_back(worker);
+    worker();
+    for (std::thread& t : threads)
+        t.join();
+}
@@ -0,0 +1,68 @@
+#ifndef CLIAES_FILE_BATCH_HPP
+#define CLIAES_FILE_BATCH_HPP
+
+#include <string>
+#include <vector>
+
+#include <libaes/types.hpp>
+#include <libaes/libaes.hpp>
+#include <cliaes/filePipeline.hpp>
+
+// Size of each read of a batch worker, files are streamed through it
+static const unsigned int BATCH_BUFFER_SIZE = 1024 * 1024;
+
+// One file of a batch, iv is empty until given by the manifest or derived
+struct BatchEntry
+{
+    std::string in;
+    std::string out;
+    std::vector<byte_t> iv;
+};
+
+// Same settings for every file of the batch
+struct BatchConfig
+{
+    AES::KEY_SIZE size;
+    AES::MODE mode;
+    bool padding;
+    bool encrypt;
+    AES::ENGINE engine;
+    AES::GHASH ghash;
+    std::vector<byte_t> key;
+    std::vector<byte_t> iv; // Base iv, see deriveBatchIvs
+    std::vector<byte_t> aad;
+    unsigned int workers; // 0 = all cores
+};
+
+/**
+ * Manifest, one file per line: in [out [iv]]
+ * out defaults to in.[en|de]crypted, iv is in hexadecimal
+ * Fields are separated by blanks, empty lines and lines starting with # are skipped
+**/
+bool loadBatchManifest(const std::string& path, const BatchConfig& config,
+    std::vector<BatchEntry>& entries);
+
+// Every regular file of dirIn (not recursive), written with the same name in dirOut
+bool listBatchDirectory(const std::string& dirIn, const std::string& dirOut,
+    std::vector<BatchEntry>& entries);
+
+/**
+ * Files without an iv get the base iv with their index in the batch xored in, big endian
+ * GCM, OCB: on the last 8 bytes, the fixed part of the iv is kept (same as TLS 1.3 nonces)
+ * CTR: on the first 8 bytes, the last 8 bytes start at 0: the first half is a nonce per file and
+ * the counter only runs on the second half. A file (less than 2^64 bytes) never reaches 2^64
+ * blocks, so the counter never carries into the nonce and 2 files never share a counter block
+ * CBC: on the first 8 bytes, then ciphered with the key so ivs can't be predicted
+ * (NIST SP 800-38A appendix C)
+**/
+bool deriveBatchIvs(const BatchConfig& config, std::vector<BatchEntry>& entries);
+
+/**
+ * Cipher or decipher every file on a pool of workers, status receives one result per entry
+ * Each worker initializes its aes context once, then only sets the iv of each file
+ * Files are streamed, workers read and write their own files at the same time
+**/
+void cryptBatch(const BatchConfig& config, const std::vector<BatchEntry>& entries,
+    std::vector<PIPELINE_STATUS>& status);
+
+#endif
@@ -0,0 +1,216 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <libaes/types.hpp>
+#include <libaes/libaes.hpp>
+#include <cliaes/fileMapping.hpp>
+
+// Data given to each update call, mapped pages are read in order
+static const size_t MAPPING_CHUNK_SIZE = 64 * 1024 * 1024;
+
+struct MappedFile
+{
+    byte_t* data;
+    uint64_t size;
+#if defined(_WIN32)
+    HANDLE file;
+    HANDLE mapping;
+#else
+    int fd;
+#endif
+};
+
+#if defined(_WIN32)
+static bool mapInput(const std::string& path, MappedFile& map)
+{
+    LARGE_INTEGER size;
+
+    map.data = nullptr;
+    map.mapping = nullptr;
+    map.file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (map.file == INVALID_HANDLE_VALUE)
+        return false;
+    if (GetFileType(map.file) != FILE_TYPE_DISK || !GetFileSizeEx(map.file, &size)
+        || size.QuadPart == 0) {
+        CloseHandle(map.file);
+        return false;
+    }
+    map.size = (uint64_t)size.QuadPart;
+
+    map.mapping = CreateFileMappingA(map.file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (map.mapping != nullptr)
+        map.data = (byte_t*)MapViewOfFile(map.mapping, FILE_MAP_READ, 0, 0, 0);
+    if (map.data == nullptr) {
+        if (map.mapping != nullptr)
+            CloseHandle(map.mapping);
+        CloseHandle(map.file);
+        return false;
+    }
+    return true;
+}
+
+// The mapping grows the file to size
+static bool mapOutput(const std::string& path, uint64_t size, MappedFile& map)
+{
+    map.data = nullptr;
+    map.size = size;
+    map.file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (map.file == INVALID_HANDLE_VALUE)
+        return false;
+
+    map.mapping = CreateFileMappingA(map.file, nullptr, PAGE_READWRITE, (DWORD)(size >> 32),
+        (DWORD)size, nullptr);
+    if (map.mapping != nullptr)
+        map.data = (byte_t*)MapViewOfFile(map.mapping, FILE_MAP_WRITE, 0, 0, 0);
+    if (map.data == nullptr) {
+        if (map.mapping != nullptr)
+            CloseHandle(map.mapping);
+        CloseHandle(map.file);
+        return false;
+    }
+    return true;
+}
+
+// Output file is cut to finalSize once unmapped
+static bool unmapFile(MappedFile& map, bool output, uint64_t finalSize)
+{
+    bool ok = UnmapViewOfFile(map.data) != 0;
+    CloseHandle(map.mapping);
+    if (output) {
+        LARGE_INTEGER end;
+        end.QuadPart = (LONGLONG)finalSize;
+        ok = ok && SetFilePointerEx(map.file, end, nullptr, FILE_BEGIN) && SetEndOfFile(map.file);
+    }
+    CloseHandle(map.file);
+    return ok;
+}
+#else
+static bool mapInput(const std::string& path, MappedFile& map)
+{
+    struct stat st;
+
+    map.data = nullptr;
+    map.fd = open(path.c_str(), O_RDONLY);
+    if (map.fd < 0)
+        return false;
+    // The whole file is mapped at once, it must fit in the address space
+    if (fstat(map.fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0
+        || (uint64_t)st.st_size > SIZE_MAX - AES::AES::STREAM_FINAL_SIZE) {
+        close(map.fd);
+        return false;
+    }
+    map.size = (uint64_t)st.st_size;
+
+    void* data = mmap(nullptr, map.size, PROT_READ, MAP_SHARED, map.fd, 0);
+    if (data == MAP_FAILED) {
+        close(map.fd);
+        return false;
+    }
+    map.data = (byte_t*)data;
+    madvise(data, map.size, MADV_SEQUENTIAL);
+    return true;
+}
+
+// File is sized with ftruncate before being mapped
+static bool mapOutput(const std::string& path, uint64_t size, MappedFile& map)
+{
+    map.data = nullptr;
+    map.size = size;
+    map.fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (map.fd < 0)
+        return false;
+    if (ftruncate(map.fd, (off_t)size) != 0) {
+        close(map.fd);
+        return false;
+    }
+
+    void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, map.fd, 0);
+    if (data == MAP_FAILED) {
+        close(map.fd);
+        return false;
+    }
+    map.data = (byte_t*)data;
+    madvise(data, size, MADV_SEQUENTIAL);
+    return true;
+}
+
+// Output file is cut to finalSize once unmapped
+static bool unmapFile(MappedFile& map, bool output, uint64_t finalSize)
+{
+    bool ok = munmap(map.data, map.size) == 0;
+    if (output)
+        ok = ok && ftruncate(map.fd, (off_t)finalSize) == 0;
+    return close(map.fd) == 0 && ok;
+}
+#endif
+
+PIPELINE_STATUS cryptFileMapped(AES::AES& aes, bool encrypt, const std::string& pathIn,
+    const std::string& pathOut, byte_t* tag)
+{
+    if (pathIn == pathOut)
+        return PIPELINE_STATUS::WRITE_ERROR;
+
+    MappedFile mapIn;
+    MappedFile mapOut;
+    if (!mapInput(pathIn, mapIn))
+        return PIPELINE_STATUS::UNSUPPORTED;
+
+    // Upper bound of the output, padding and tag included
+    uint64_t outSize = mapIn.size;
+    if (encrypt)
+        outSize += AES::AES::STREAM_FINAL_SIZE;
+    if (!mapOutput(pathOut, outSize, mapOut)) {
+        unmapFile(mapIn, false, 0);
+        return PIPELINE_STATUS::WRITE_ERROR;
+    }
+
+    bool cryptError = !aes.init(encrypt);
+    uint64_t offsetIn = 0;
+    uint64_t offsetOut = 0;
+    while (!cryptError && offsetIn < mapIn.size)
+    {
+        size_t size = MAPPING_CHUNK_SIZE;
+        if (mapIn.size - offsetIn < size)
+            size = (size_t)(mapIn.size - offsetIn);
+
+        size_t written;
+        cryptError = !aes.update(mapIn.data + offsetIn, size, mapOut.data + offsetOut, written);
+        offsetIn += size;
+        offsetOut += written;
+    }
+    if (!cryptError) {
+        size_t written;
+        cryptError = !aes.final(mapOut.data + offsetOut, written);
+        offsetOut += written;
+    }
+
+    // The tag is the last 16 bytes of the cipher text
+    memset(tag, 0, AES::AES::BLOCKSIZE);
+    const MappedFile& cipherText = encrypt ? mapOut : mapIn;
+    uint64_t cipherSize = encrypt ? offsetOut : mapIn.size;
+    if (!cryptError && cipherSize >= AES::AES::BLOCKSIZE)
+        memcpy(tag, cipherText.data + cipherSize - AES::AES::BLOCKSIZE, AES::AES::BLOCKSIZE);
+
+    unmapFile(mapIn, false, 0);
+    bool writeError = !unmapFile(mapOut, true, offsetOut);
+
+    if (cryptError || writeError) {
+        std::remove(pathOut.c_str());
+        return cryptError ? PIPELINE_STATUS::CRYPT_ERROR : PIPELINE_STATUS::WRITE_ERROR;
+    }
+    return PIPELINE_STATUS::OK;
+}
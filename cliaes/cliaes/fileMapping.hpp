@@ -0,0 +1,18 @@
+#ifndef CLIAES_FILE_MAPPING_HPP
+#define CLIAES_FILE_MAPPING_HPP
+
+#include <string>
+
+#include <libaes/types.hpp>
+#include <libaes/libaes.hpp>
+#include <cliaes/filePipeline.hpp>
+
+/**
+ * Same as cryptFile, but both files are mapped in memory:
+ * aes reads from and writes to the page cache directly, without intermediate buffers
+ * Returns UNSUPPORTED when the input is not a regular file, cryptFile must be used instead
+**/
+PIPELINE_STATUS cryptFileMapped(AES::AES& aes, bool encrypt, const std::string& pathIn,
+    const std::string& pathOut, byte_t* tag);
+
+#endif
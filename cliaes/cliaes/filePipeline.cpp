@@ -0,0 +1,165 @@
+#include <cstdio>
+#include <cstring>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <libaes/types.hpp>
+#include <libaes/libaes.hpp>
+#include <cliaes/filePipeline.hpp>
+
+// One slot per stage, so reading, crypting and writing never wait on each other
+static const int PIPELINE_SLOTS = 3;
+
+struct Slot
+{
+    std::vector<byte_t> in;
+    std::vector<byte_t> out; // update may give BLOCKSIZE more bytes, then final
+    size_t inSize;
+    size_t outSize;
+    bool last; // End of file, or read error
+};
+
+// Hands slots from one stage to the next
+class SlotQueue
+{
+public:
+    void push(Slot* slot)
+    {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->slots.push(slot);
+        }
+        this->ready.notify_one();
+    }
+
+    Slot* pop()
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->ready.wait(lock, [this] { return !this->slots.empty(); });
+        Slot* slot = this->slots.front();
+        this->slots.pop();
+        return slot;
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::queue<Slot*> slots;
+};
+
+// Keep the last 16 bytes seen in tail
+static void keepTail(byte_t* tail, const byte_t* data, size_t size)
+{
+    if (size >= AES::AES::BLOCKSIZE) {
+        memcpy(tail, data + size - AES::AES::BLOCKSIZE, AES::AES::BLOCKSIZE);
+    }
+    else if (size > 0) {
+        memmove(tail, tail + size, AES::AES::BLOCKSIZE - size);
+        memcpy(tail + AES::AES::BLOCKSIZE - size, data, size);
+    }
+}
+
+PIPELINE_STATUS cryptFile(AES::AES& aes, bool encrypt, const std::string& pathIn,
+    const std::string& pathOut, byte_t* tag)
+{
+    if (pathIn == pathOut) // Output is truncated before input is read
+        return PIPELINE_STATUS::WRITE_ERROR;
+
+    std::ifstream fileIn(pathIn, std::ios::in | std::ios::binary);
+    if (!fileIn.is_open())
+        return PIPELINE_STATUS::READ_ERROR;
+    std::ofstream fileOut(pathOut, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!fileOut.is_open())
+        return PIPELINE_STATUS::WRITE_ERROR;
+
+    Slot slots[PIPELINE_SLOTS];
+    SlotQueue freeSlots;
+    SlotQueue toCrypt;
+    SlotQueue toWrite;
+    for (Slot& slot : slots) {
+        slot.in.resize(PIPELINE_BUFFER_SIZE);
+        slot.out.resize(PIPELINE_BUFFER_SIZE + AES::AES::BLOCKSIZE + AES::AES::STREAM_FINAL_SIZE);
+        freeSlots.push(&slot);
+    }
+
+    bool readError = false;
+    bool writeError = false;
+    bool cryptError = !aes.init(encrypt);
+
+    std::thread reader([&] {
+        bool last = false;
+        while (!last)
+        {
+            Slot* slot = freeSlots.pop();
+            IoTimer timer(AES::STAGE::READ);
+            fileIn.read((char*)slot->in.data(), PIPELINE_BUFFER_SIZE);
+            slot->inSize = (size_t)fileIn.gcount();
+            timer.done(slot->inSize);
+            if (fileIn.bad())
+                readError = true;
+            last = slot->last = fileIn.eof() || fileIn.fail();
+            toCrypt.push(slot);
+        }
+    });
+
+    std::thread writer([&] {
+        bool last = false;
+        while (!last)
+        {
+            Slot* slot = toWrite.pop();
+            if (!writeError && slot->outSize > 0) {
+                IoTimer timer(AES::STAGE::WRITE);
+                fileOut.write((const char*)slot->out.data(), slot->outSize);
+                writeError = !fileOut;
+                timer.done(slot->outSize);
+            }
+            last = slot->last;
+            freeSlots.push(slot);
+        }
+    });
+
+    // Crypt stage, slots go on even after an error so the other stages can end
+    memset(tag, 0, AES::AES::BLOCKSIZE);
+    bool last = false;
+    while (!last)
+    {
+        Slot* slot = toCrypt.pop();
+        last = slot->last;
+        slot->outSize = 0;
+        if (!cryptError && !readError) {
+            size_t finalSize = 0;
+            cryptError = !aes.update(slot->in.data(), slot->inSize, slot->out.data(),
+                slot->outSize);
+            if (last && !cryptError)
+                cryptError = !aes.final(slot->out.data() + slot->outSize, finalSize);
+            slot->outSize += finalSize;
+
+            if (encrypt)
+                keepTail(tag, slot->out.data(), slot->outSize);
+            else
+                keepTail(tag, slot->in.data(), slot->inSize);
+        }
+        toWrite.push(slot);
+    }
+
+    reader.join();
+    writer.join();
+    fileOut.close();
+
+    PIPELINE_STATUS status = PIPELINE_STATUS::OK;
+    if (readError)
+        status = PIPELINE_STATUS::READ_ERROR;
+    else if (cryptError)
+        status = PIPELINE_STATUS::CRYPT_ERROR;
+    else if (writeError || !fileOut)
+        status = PIPELINE_STATUS::WRITE_ERROR;
+
+    if (status != PIPELINE_STATUS::OK)
+        std::remove(pathOut.c_str());
+    return status;
+}
@@ -0,0 +1,55 @@
+#ifndef CLIAES_FILE_PIPELINE_HPP
+#define CLIAES_FILE_PIPELINE_HPP
+
+#include <chrono>
+#include <string>
+
+#include <libaes/types.hpp>
+#include <libaes/libaes.hpp>
+
+// Size of each read, memory use stays around 6 times this size whatever the file size
+static const unsigned int PIPELINE_BUFFER_SIZE = 4 * 1024 * 1024;
+
+enum class PIPELINE_STATUS {
+    OK,
+    READ_ERROR,
+    WRITE_ERROR,
+    CRYPT_ERROR,
+    UNSUPPORTED // Files can't be mapped (pipe, empty file...), nothing was done
+};
+
+// Times one READ or WRITE for --stats, nothing is measured while stats are off
+class IoTimer
+{
+public:
+    explicit IoTimer(AES::STAGE pStage) : stage(pStage), active(AES::AES::isStatsEnabled())
+    {
+        if (this->active)
+            this->start = std::chrono::steady_clock::now();
+    }
+
+    void done(uint64_t bytes)
+    {
+        if (!this->active)
+            return;
+        AES::AES::addStats(this->stage, bytes, (uint64_t)std::chrono::duration_cast<
+            std::chrono::nanoseconds>(std::chrono::steady_clock::now() - this->start).count());
+        this->active = false;
+    }
+
+private:
+    AES::STAGE stage;
+    bool active;
+    std::chrono::steady_clock::time_point start;
+};
+
+/**
+ * Cipher or decipher pathIn into pathOut with the streaming API of aes (already initialized)
+ * Read, crypt and write run at the same time on their own buffers (triple buffering)
+ * tag receives the last 16 bytes of the cipher text, the GCM/OCB tag
+ * On error the output file is removed
+**/
+PIPELINE_STATUS cryptFile(AES::AES& aes, bool encrypt, const std::string& pathIn,
+    const std::string& pathOut, byte_t* tag);
+
+#endif
@@ -5,8 +5,6 @@
 
 #include <libaes/types.hpp>
 
-unsigned int getFileSize(std::string path);
-byte_t* loadDataFromFile(std::string path, unsigned int bufferSize);
-bool writeEncryptedDataToFile(std::string path, byte_t* data, unsigned int size);
+uint64_t getFileSize(std::string path);
 
 #endif
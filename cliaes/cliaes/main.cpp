@@ -3,10 +3,14 @@
 #include <vector>
 #include <exception>
 
+#include <boost/filesystem.hpp>
 #include <boost/program_options.hpp>
 
 #include <utility/logs.hpp>
 #include <cliaes/loadData.hpp>
+#include <cliaes/filePipeline.hpp>
+#include <cliaes/fileMapping.hpp>
+#include <cliaes/fileBatch.hpp>
 #include <cliaes/random_generator.hpp>
 #include <libaes/libaes.hpp>
 #include <libaes/types_helper.hpp>
@@ -26,10 +30,24 @@ struct Args
     bool encrypt;
     AES::KEY_SIZE size;
     AES::MODE mode;
+    AES::ENGINE engine;
+    AES::GHASH ghash;
+    int threads;
+    bool mmap;
+    bool stats;
+    std::string batch;
 };
 
 bool getArgs(int argc, char** argv, Args& args);
 byte_t* hexStrToBytes(const std::string& str);
+int batchMain(const Args& args);
+
+// Time is summed over threads, mapped files (--mmap) are read and written inside the crypto stages
+static void printStats(const Args& args)
+{
+    if (args.stats)
+        std::cout << AES::AES::getStatsReport() << std::endl;
+}
 
 int main(int argc, char** argv)
 {
@@ -59,7 +77,13 @@ int main(int argc, char** argv)
         return 0;
     }
 
-    unsigned int dataInSize = getFileSize(args.in);
+    if (args.stats)
+        AES::AES::enableStats(true);
+
+    if (args.batch.size() > 0)
+        return batchMain(args);
+
+    uint64_t dataInSize = getFileSize(args.in);
     if (!args.padding && (args.mode == AES::MODE::ECB || args.mode == AES::MODE::CBC)
         && dataInSize % AES::AES::BLOCKSIZE != 0) {
         std::cout << "Padding is disabled, input data must be a multiple of 16 bytes " << std::endl;
@@ -80,6 +104,17 @@ int main(int argc, char** argv)
     }
 
     AES::AES aes;
+    if (!aes.setEngine(args.engine))
+    {
+        std::cout << "Engine is not supported by this CPU" << std::endl;
+        return -1;
+    }
+    if (!aes.setGhash(args.ghash))
+    {
+        std::cout << "Ghash is not supported by this CPU" << std::endl;
+        return -1;
+    }
+    aes.setThreads((unsigned int)args.threads);
     if (!aes.initialize(args.size, args.mode, args.padding, key))
     {
         std::cout << "Can't init aes " << std::endl;
@@ -102,69 +137,46 @@ int main(int argc, char** argv)
     TRACE_INFO("Input file in: ", args.in);
     TRACE_INFO("Output file in: ", args.out);
 
-    AES::PADDING pad = args.padding ? AES::PADDING::PKCS7 : AES::PADDING::NONE;
-    byte_t* dataIn = nullptr;
-    byte_t* dataOut = nullptr;
-    unsigned int inBufSize;
-    unsigned int outBufSize;
-
-    if (args.encrypt) {
-        inBufSize = AES::AES::getPlainInBufferSize(dataInSize, pad, args.mode);
-    }
-    else {
-        inBufSize = AES::AES::getCipherInBufferSize(dataInSize, pad, args.mode);
-    }
-
-    // Read input file
-    if ((dataIn = loadDataFromFile(args.in, inBufSize)) == nullptr)
+    // Input goes through fixed size buffers, memory use does not depend on the file size
+    // Mapped files skip the buffers, pipes and empty files can't be mapped and use them anyway
+    byte_t tagOut[AES::AES::BLOCKSIZE];
+    PIPELINE_STATUS status = PIPELINE_STATUS::UNSUPPORTED;
+    if (args.mmap)
+        status = cryptFileMapped(aes, args.encrypt, args.in, args.out, tagOut);
+    if (status == PIPELINE_STATUS::UNSUPPORTED)
+        status = cryptFile(aes, args.encrypt, args.in, args.out, tagOut);
+    if (status == PIPELINE_STATUS::READ_ERROR)
     {
         std::cout << "Can't load file " << args.in << std::endl;
         return -1;
     }
-
-    if (args.encrypt) {
-        outBufSize = AES::AES::getCipherOutBufferSize(dataInSize, pad, args.mode);
-    }
-    else {
-        outBufSize = AES::AES::getPlainOutBufferSize(dataInSize, pad, args.mode);
-    }
-
-    dataOut = new byte_t[outBufSize];
-    if (args.encrypt) {
-        aes.cipher(dataIn, dataOut, dataInSize);
-    }
-    else {
-        aes.decipher(dataIn, dataOut, dataInSize);
-        // Remove padding
-
-        outBufSize -= AES::AES::getRevPaddingSize(dataOut, dataInSize, pad, args.mode);
-    }
-
-    if (!writeEncryptedDataToFile(args.out, dataOut, outBufSize))
+    if (status == PIPELINE_STATUS::WRITE_ERROR)
     {
         std::cout << "Can't write file " << args.out << std::endl;
         return -1;
     }
+    if (status == PIPELINE_STATUS::CRYPT_ERROR)
+    {
+        if (args.encrypt)
+            std::cout << "Can't encrypt file " << args.in << std::endl;
+        else
+            std::cout << "Can't decrypt file " << args.in << std::endl;
+        return -1;
+    }
 
     // Print error if asked for a specific tag check
-    if (args.mode == AES::MODE::GCM && args.tag.size() > 0) {
+    if ((args.mode == AES::MODE::GCM || args.mode == AES::MODE::OCB) && args.tag.size() > 0) {
         byte_t* tag = nullptr;
         if ((tag = hexStrToBytes(args.tag)) == nullptr)
             return -1;
-        const byte_t* bufferToTest;
-        if (args.encrypt)
-            bufferToTest = dataOut + outBufSize - 16;
-        else
-            bufferToTest = dataIn + dataInSize - 16;
-        if (memcmp(tag, bufferToTest, 16) != 0) {
+        if (memcmp(tag, tagOut, 16) != 0) {
             TRACE_ERROR("Expected tag: ", args.tag);
         }
 
         delete[] tag;
     }
 
-    delete[] dataIn;
-    delete[] dataOut;
+    printStats(args);
 
     TRACE_STOP();
 
@@ -235,6 +247,8 @@ static bool checkArgs(boost::program_options::variables_map& vm, Args& args)
             args.mode = AES::MODE::CTR;
         else if (mode == "gcm")
             args.mode = AES::MODE::GCM;
+        else if (mode == "ocb")
+            args.mode = AES::MODE::OCB;
         else {
             std::cout << "Mode is invalid" << std::endl;
             gotError = true;
@@ -245,9 +259,71 @@ static bool checkArgs(boost::program_options::variables_map& vm, Args& args)
         gotError = true;
     }
 
+    args.engine = AES::ENGINE::AUTO;
+    if (vm.count("engine"))
+    {
+        auto engine = vm["engine"].as<std::string>();
+        if (engine == "auto")
+            args.engine = AES::ENGINE::AUTO;
+        else if (engine == "ref")
+            args.engine = AES::ENGINE::REFERENCE;
+        else if (engine == "ttable")
+            args.engine = AES::ENGINE::TTABLE;
+        else if (engine == "bitslice")
+            args.engine = AES::ENGINE::BITSLICE;
+        else if (engine == "aesni")
+            args.engine = AES::ENGINE::AESNI;
+        else if (engine == "vaes")
+            args.engine = AES::ENGINE::VAES;
+        else {
+            std::cout << "Engine is invalid" << std::endl;
+            gotError = true;
+        }
+    }
+
+    args.ghash = AES::GHASH::AUTO;
+    if (vm.count("ghash"))
+    {
+        auto ghash = vm["ghash"].as<std::string>();
+        if (ghash == "auto")
+            args.ghash = AES::GHASH::AUTO;
+        else if (ghash == "ref")
+            args.ghash = AES::GHASH::REFERENCE;
+        else if (ghash == "table")
+            args.ghash = AES::GHASH::TABLE;
+        else if (ghash == "clmul")
+            args.ghash = AES::GHASH::CLMUL;
+        else if (ghash == "vpclmul")
+            args.ghash = AES::GHASH::VPCLMUL;
+        else {
+            std::cout << "Ghash is invalid" << std::endl;
+            gotError = true;
+        }
+    }
+
+    args.threads = 1;
+    if (vm.count("threads"))
+    {
+        std::string n = vm["threads"].as<std::string>();
+        try {
+            args.threads = std::stoi(n);
+        }
+        catch (const std::exception& e) {
+            (void)e;
+            args.threads = -1;
+        }
+        if (args.threads < 0 || args.threads > 256) {
+            std::cout << "Number of threads must be in range [0;256]" << std::endl;
+            gotError = true;
+        }
+    }
+
+    args.mmap = vm.count("mmap") > 0;
+    args.stats = vm.count("stats") > 0;
+
     args.aad = ""; // Can be 0 size long
-    args.tag = ""; // Only for gcm testing purpose
-    if (args.mode == AES::MODE::GCM) {
+    args.tag = ""; // Only for gcm/ocb testing purpose
+    if (args.mode == AES::MODE::GCM || args.mode == AES::MODE::OCB) {
         if (vm.count("aad"))
             args.aad = vm["aad"].as<std::string>();
         if (vm.count("tag")) {
@@ -265,7 +341,11 @@ static bool checkArgs(boost::program_options::variables_map& vm, Args& args)
     }
     args.encrypt = vm.count("decrypt") == 0;
 
-    if (vm.count("in")) {
+    args.batch = "";
+    if (vm.count("batch")) {
+        args.batch = vm["batch"].as<std::string>();
+    }
+    else if (vm.count("in")) {
         args.in = vm["in"].as<std::string>();
     }
     else {
@@ -276,6 +356,9 @@ static bool checkArgs(boost::program_options::variables_map& vm, Args& args)
     if (vm.count("out")) {
         args.out = vm["out"].as<std::string>();
     }
+    else if (args.batch.size() > 0) {
+        args.out = ""; // Only needed by directories
+    }
     else {
         if (args.encrypt)
             args.out = args.in + ".encrypted";
@@ -321,7 +404,7 @@ static bool checkArgs(boost::program_options::variables_map& vm, Args& args)
 
     if (vm.count("iv")) {
         args.iv = vm["iv"].as<std::string>();
-        if (args.mode != AES::MODE::GCM && args.iv.size() != 32) {
+        if (args.mode != AES::MODE::GCM && args.mode != AES::MODE::OCB && args.iv.size() != 32) {
             std::cout << "iv should be 32 chars long (16 bytes/128 bits)" << std::endl;
             gotError = true;
         }
@@ -332,6 +415,12 @@ static bool checkArgs(boost::program_options::variables_map& vm, Args& args)
                 gotError = true;
             }
         }
+        if (args.mode == AES::MODE::OCB) {
+            if (!AES::AES::isOcbIvSizeValid((unsigned int)args.iv.size() / 2)) {
+                std::cout << "Supported nonce length in ocb: 1 to 15 bytes" << std::endl;
+                gotError = true;
+            }
+        }
     }
     else {
         std::cout << "iv is missing" << std::endl;
@@ -350,14 +439,20 @@ bool getArgs(int argc, char** argv, Args& args)
         ("help,h", "produce help message then exit")
         ("key,k", po::value<std::string>(), "secret key in hexadecimal")
         ("iv,n", po::value<std::string>(), "iv/counter in hexadecimal")
-        ("aad,a", po::value<std::string>(), "aad for gcm only in hexadecimal")
+        ("aad,a", po::value<std::string>(), "aad for gcm and ocb only in hexadecimal")
         ("list,l", "list supported algorithms then exit")
         ("encrypt,e", "encrypt input file (default)")
         ("decrypt,d", "decrypt input file")
         ("in,i", po::value<std::string>(), "input file")
         ("out,o", po::value<std::string>(), "output file (default = X.[de|en]crypted)")
-        ("mode,m", po::value<std::string>(), "operation mode (ecb, cbc, ctr)")
+        ("mode,m", po::value<std::string>(), "operation mode (ecb, cbc, ctr, gcm, ocb)")
         ("size,s", po::value<std::string>(), "key size (128, 192, 256)")
+        ("engine", po::value<std::string>(), "cipher engine (auto, ref, ttable, bitslice, aesni, vaes), default = auto")
+        ("ghash", po::value<std::string>(), "gcm ghash engine (auto, ref, table, clmul, vpclmul), default = auto")
+        ("threads", po::value<std::string>(), "number of threads, 0 = all cores, default = 1")
+        ("mmap", "map files in memory instead of reading them by blocks")
+        ("stats", "print the calls, bytes and time of each stage (crypto, read, write) at the end")
+        ("batch,b", po::value<std::string>(), "manifest or directory of input files, replaces --in (--out is the output directory)")
         ("generate,g", po::value<std::string>(), "generate X random bytes in hexadecimal then exit")
         ("nopad", "disable block padding (default is pkcs7). Input size must be a multiple of 16 bytes")
         ("verbose,v", "verbose mode (default = false)")
@@ -384,6 +479,71 @@ bool getArgs(int argc, char** argv, Args& args)
     return true;
 }
 
+/*
+    Every file of the batch with the same key, the iv of each file is in the manifest
+    or derived from --iv, see deriveBatchIvs
+*/
+int batchMain(const Args& args)
+{
+    BatchConfig config;
+    config.size = args.size;
+    config.mode = args.mode;
+    config.padding = args.padding;
+    config.encrypt = args.encrypt;
+    config.engine = args.engine;
+    config.ghash = args.ghash;
+    config.workers = (unsigned int)args.threads;
+
+    byte_t* key = hexStrToBytes(args.key);
+    byte_t* iv = hexStrToBytes(args.iv);
+    byte_t* aad = hexStrToBytes(args.aad);
+    config.key.assign(key, key + args.key.size() / 2);
+    config.iv.assign(iv, iv + args.iv.size() / 2);
+    config.aad.assign(aad, aad + args.aad.size() / 2);
+    delete[] aad;
+    delete[] iv;
+    delete[] key;
+
+    std::vector<BatchEntry> entries;
+    if (boost::filesystem::is_directory(args.batch)) {
+        if (args.out.size() == 0) {
+            std::cout << "Output directory is missing" << std::endl;
+            return -1;
+        }
+        if (!listBatchDirectory(args.batch, args.out, entries))
+            return -1;
+    }
+    else if (!loadBatchManifest(args.batch, config, entries)) {
+        return -1;
+    }
+    if (!deriveBatchIvs(config, entries))
+        return -1;
+
+    std::vector<PIPELINE_STATUS> status;
+    cryptBatch(config, entries, status);
+
+    int failed = 0;
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        if (status[i] == PIPELINE_STATUS::READ_ERROR)
+            std::cout << "Can't load file " << entries[i].in << std::endl;
+        else if (status[i] == PIPELINE_STATUS::WRITE_ERROR)
+            std::cout << "Can't write file " << entries[i].out << std::endl;
+        else if (status[i] == PIPELINE_STATUS::CRYPT_ERROR && args.encrypt)
+            std::cout << "Can't encrypt file " << entries[i].in << std::endl;
+        else if (status[i] == PIPELINE_STATUS::CRYPT_ERROR)
+            std::cout << "Can't decrypt file " << entries[i].in << std::endl;
+        if (status[i] != PIPELINE_STATUS::OK)
+            ++failed;
+    }
+    TRACE_INFO("Batch: ", entries.size() - failed, "/", entries.size(), " files done");
+    printStats(args);
+
+    TRACE_STOP();
+
+    return failed == 0 ? 0 : -1;
+}
+
 byte_t* hexStrToBytes(const std::string& str)
 {
     byte_t* buffer = new byte_t[str.size() / 2];
@@ -0,0 +1,49 @@
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+#include <libaes/libaes.hpp>
+
+#include "fuzzInput.hpp"
+
+/**
+ * AES::decipher on any input, buffers have the exact size given by the helpers so the
+ * sanitizers see any access past them
+ * The picked engine must agree with the REFERENCE engine and ghash, status and output
+**/
+
+static bool decipher(const FuzzInput& input, AES::ENGINE engine, AES::GHASH ghash,
+    byte_t* out)
+{
+    size_t dataSize = input.data.size();
+    std::unique_ptr<byte_t[]> in(new byte_t[dataSize]);
+    if (dataSize > 0)
+        memcpy(in.get(), input.data.data(), dataSize);
+
+    AES::AES aes;
+    fuzzCheck(input.setup(aes, engine, ghash));
+    return aes.decipher(in.get(), out, dataSize);
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    FuzzInput input(data, size);
+    AES::PADDING padding = input.padding ? AES::PADDING::PKCS7 : AES::PADDING::NONE;
+    size_t dataSize = input.data.size();
+    size_t plainSize = AES::AES::getPlainOutBufferSize(dataSize, padding, input.mode);
+    fuzzCheck(plainSize <= dataSize);
+
+    std::unique_ptr<byte_t[]> out(new byte_t[plainSize]());
+    std::unique_ptr<byte_t[]> expected(new byte_t[plainSize]());
+    bool ok = decipher(input, input.engine, input.ghash, out.get());
+    bool expectedOk = decipher(input, AES::ENGINE::REFERENCE, AES::GHASH::REFERENCE,
+        expected.get());
+
+    fuzzCheck(ok == expectedOk);
+    if (!ok)
+        return 0;
+    fuzzCheck(plainSize == 0 || memcmp(out.get(), expected.get(), plainSize) == 0);
+    fuzzCheck(AES::AES::getRevPaddingSize(out.get(), dataSize, padding, input.mode)
+        <= plainSize);
+    return 0;
+}
@@ -0,0 +1,117 @@
+#ifndef FUZZ_FUZZ_INPUT_HPP
+#define FUZZ_FUZZ_INPUT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#include <libaes/libaes.hpp>
+
+/**
+ * Splits a fuzzer input into the parameters of a context and the data to decipher
+ * byte 0: mode (bit 5 picks OCB, bit 6 GCM-SIV, bit 7 XTS), key size and padding,
+ * byte 1: engine and ghash, byte 2: iv size, byte 3: aad size, then key, iv, aad and the rest
+ * is the ciphertext
+ * GCM-SIV and XTS have no 192 bits keys, they become 256 bits ones
+ * XTS reads a double length key, has no padding and deciphers at least one block
+ * Missing bytes read as 0, so every input is valid
+ * Single threaded so one input stays in the microseconds
+**/
+struct FuzzInput
+{
+    AES::MODE mode;
+    AES::KEY_SIZE keySize;
+    bool padding;
+    AES::ENGINE engine;
+    AES::GHASH ghash;
+    byte_t key[2 * AES::AES::MAX_KEY_SIZE]; // XTS takes both keys
+    std::vector<byte_t> iv;
+    std::vector<byte_t> aad;
+    std::vector<byte_t> data;
+
+    FuzzInput(const uint8_t* input, size_t size) : in(input), left(size)
+    {
+        static const AES::MODE MODES[] = { AES::MODE::ECB, AES::MODE::CBC, AES::MODE::CTR,
+            AES::MODE::GCM };
+        static const AES::KEY_SIZE KEY_SIZES[] = { AES::KEY_SIZE::S128, AES::KEY_SIZE::S192,
+            AES::KEY_SIZE::S256, AES::KEY_SIZE::S128 };
+        static const AES::ENGINE ENGINES[] = { AES::ENGINE::REFERENCE, AES::ENGINE::TTABLE,
+            AES::ENGINE::BITSLICE, AES::ENGINE::AESNI, AES::ENGINE::VAES };
+        static const AES::GHASH GHASHES[] = { AES::GHASH::REFERENCE, AES::GHASH::TABLE,
+            AES::GHASH::CLMUL, AES::GHASH::VPCLMUL, AES::GHASH::AUTO };
+
+        byte_t params = this->take();
+        this->mode = (params & 0x20) != 0 ? AES::MODE::OCB : MODES[params & 3];
+        if ((params & 0x40) != 0)
+            this->mode = AES::MODE::GCM_SIV;
+        if ((params & 0x80) != 0)
+            this->mode = AES::MODE::XTS;
+        const bool xts = this->mode == AES::MODE::XTS;
+        this->keySize = KEY_SIZES[(params >> 2) & 3];
+        if ((xts || this->mode == AES::MODE::GCM_SIV) && this->keySize == AES::KEY_SIZE::S192)
+            this->keySize = AES::KEY_SIZE::S256;
+        this->padding = !xts && (params & 0x10) != 0;
+        byte_t backend = this->take();
+        this->engine = ENGINES[backend % 5];
+        this->ghash = GHASHES[backend / 5 % 5];
+        if (!AES::AES::isEngineSupported(this->engine))
+            this->engine = AES::ENGINE::REFERENCE;
+        if (!AES::AES::isGhashSupported(this->ghash))
+            this->ghash = AES::GHASH::REFERENCE;
+
+        size_t ivSize = AES::AES::BLOCKSIZE;
+        const bool tagged = this->mode == AES::MODE::GCM || this->mode == AES::MODE::OCB
+            || this->mode == AES::MODE::GCM_SIV;
+        if (this->mode == AES::MODE::GCM)
+            ivSize = 1 + this->take() % (AES::AES::MAX_IV_SIZE - 1);
+        else if (this->mode == AES::MODE::OCB)
+            ivSize = 1 + this->take() % (AES::AES::BLOCKSIZE - 1);
+        else if (this->mode == AES::MODE::GCM_SIV)
+            ivSize = (this->take(), AES::AES::SIV_NONCE_SIZE);
+        else
+            this->take();
+        size_t aadSize = tagged ? this->take() : (this->take(), 0);
+
+        const size_t keyBytes = (xts ? 2 : 1) * (size_t)AES::AES::MAX_KEY_SIZE;
+        for (size_t i = 0; i < sizeof(this->key); ++i)
+            this->key[i] = i < keyBytes ? this->take() : 0;
+        for (size_t i = 0; i < ivSize; ++i)
+            this->iv.push_back(this->take());
+        for (size_t i = 0; i < aadSize; ++i)
+            this->aad.push_back(this->take());
+        this->data.assign(this->in, this->in + this->left);
+        if (xts && this->data.size() < AES::AES::BLOCKSIZE)
+            this->data.resize(AES::AES::BLOCKSIZE);
+    }
+
+    bool setup(AES::AES& aes, AES::ENGINE pEngine, AES::GHASH pGhash) const
+    {
+        return aes.setEngine(pEngine)
+            && aes.setGhash(pGhash)
+            && aes.initialize(this->keySize, this->mode, this->padding, this->key)
+            && aes.setIv(this->iv.data(), (int)this->iv.size())
+            && aes.setAad(this->aad.empty() ? nullptr : this->aad.data(), (int)this->aad.size());
+    }
+
+private:
+    byte_t take()
+    {
+        if (this->left == 0)
+            return 0;
+        --this->left;
+        return *this->in++;
+    }
+
+    const uint8_t* in;
+    size_t left;
+};
+
+// A mismatch is a bug, the fuzzer reports the crash and keeps the input
+inline void fuzzCheck(bool condition)
+{
+    if (!condition)
+        std::abort();
+}
+
+#endif
@@ -0,0 +1,112 @@
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+/**
+ * Driver for compilers without libFuzzer (GCC, MSVC), takes the same options:
+ * files given on the command line are replayed (not directories), then random inputs are run until
+ * -runs=N or -max_total_time=S, up to -max_len=N bytes, from -seed=N
+ * The input that aborts is written to crash-input (ASAN_OPTIONS=abort_on_error=1 for the
+ * sanitizer reports)
+**/
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+static std::vector<uint8_t> current;
+
+static void saveCurrent()
+{
+    std::ofstream file("crash-input", std::ios::binary | std::ios::trunc);
+    file.write((const char*)current.data(), current.size());
+}
+
+static void runOne(const std::vector<uint8_t>& input)
+{
+    current = input;
+    LLVMFuzzerTestOneInput(input.data(), input.size());
+}
+
+static bool getOption(const char* arg, const char* name, uint64_t& value)
+{
+    size_t len = strlen(name);
+    if (strncmp(arg, name, len) != 0 || arg[len] != '=')
+        return false;
+    value = std::strtoull(arg + len + 1, nullptr, 0);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    typedef std::chrono::steady_clock clock;
+
+    uint64_t runs = 0;
+    uint64_t maxTime = 0;
+    uint64_t maxLen = 1024;
+    uint64_t seed = 1;
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (argv[i][0] != '-')
+            files.push_back(argv[i]);
+        else if (!getOption(argv[i], "-runs", runs) && !getOption(argv[i], "-max_total_time", maxTime)
+            && !getOption(argv[i], "-max_len", maxLen) && !getOption(argv[i], "-seed", seed))
+            std::cout << "Ignored option " << argv[i] << std::endl;
+    }
+    std::signal(SIGABRT, [](int) { saveCurrent(); std::_Exit(1); });
+
+    for (const std::string& path : files)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            std::cout << "Can't open " << path << std::endl;
+            return 1;
+        }
+        std::vector<uint8_t> input;
+        try {
+            input.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        }
+        catch (const std::exception& e) {
+            (void)e;
+            std::cout << "Skipped " << path << ", corpus directories need libFuzzer" << std::endl;
+            continue;
+        }
+        runOne(input);
+    }
+
+    // Short inputs are the interesting ones, sizes are skewed toward them
+    std::mt19937_64 rng(seed);
+    clock::time_point start = clock::now();
+    uint64_t n = 0;
+    while ((runs > 0 && n < runs) || (runs == 0 && maxTime > 0))
+    {
+        double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+        if (maxTime > 0 && elapsed >= (double)maxTime)
+            break;
+
+        size_t size = (size_t)(rng() % (maxLen + 1));
+        if (rng() % 2 == 0)
+            size %= 128;
+        std::vector<uint8_t> input(size);
+        for (uint8_t& b : input)
+            b = (uint8_t)rng();
+        runOne(input);
+        ++n;
+    }
+
+    double seconds = std::chrono::duration<double>(clock::now() - start).count();
+    std::cout << "Done " << n << " runs in " << seconds << " second(s)";
+    if (seconds > 0)
+        std::cout << ", " << (uint64_t)(n / seconds) << " exec/s";
+    std::cout << std::endl;
+    return 0;
+}
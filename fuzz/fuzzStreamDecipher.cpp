@@ -0,0 +1,76 @@
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+#include <libaes/libaes.hpp>
+
+#include "fuzzInput.hpp"
+
+/**
+ * Streaming decipher, update in pieces sized from the key bytes then final
+ * Output must stay within the documented bounds and match the one shot decipher
+ * without its padding whenever final accepts the message
+ * GCM-SIV and XTS have no stream, init must refuse them
+**/
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    FuzzInput input(data, size);
+    AES::PADDING padding = input.padding ? AES::PADDING::PKCS7 : AES::PADDING::NONE;
+    size_t dataSize = input.data.size();
+    size_t outCapacity = dataSize + AES::AES::BLOCKSIZE + AES::AES::STREAM_FINAL_SIZE;
+
+    // Each piece is read from its own exact size buffer
+    std::unique_ptr<byte_t[]> out(new byte_t[outCapacity]);
+    size_t total = 0;
+    size_t outSize;
+    AES::AES aes;
+    fuzzCheck(input.setup(aes, input.engine, input.ghash));
+    const bool noStream = input.mode == AES::MODE::GCM_SIV || input.mode == AES::MODE::XTS;
+    fuzzCheck(aes.init(false) == !noStream);
+    if (noStream)
+        return 0;
+
+    bool streamOk = true;
+    for (size_t offset = 0, i = 0; offset < dataSize && streamOk; ++i)
+    {
+        size_t pieceSize = input.key[i % AES::AES::MAX_KEY_SIZE] % 64;
+        if (pieceSize > dataSize - offset)
+            pieceSize = dataSize - offset;
+        std::unique_ptr<byte_t[]> piece(new byte_t[pieceSize]);
+        if (pieceSize > 0)
+            memcpy(piece.get(), input.data.data() + offset, pieceSize);
+
+        streamOk = aes.update(piece.get(), pieceSize, out.get() + total, outSize);
+        fuzzCheck(outSize <= pieceSize + AES::AES::BLOCKSIZE);
+        total += outSize;
+        offset += pieceSize;
+    }
+    if (streamOk) {
+        streamOk = aes.final(out.get() + total, outSize);
+        fuzzCheck(outSize <= AES::AES::STREAM_FINAL_SIZE);
+        total += outSize;
+    }
+    fuzzCheck(total <= outCapacity);
+
+    size_t plainSize = AES::AES::getPlainOutBufferSize(dataSize, padding, input.mode);
+    std::unique_ptr<byte_t[]> in(new byte_t[dataSize]);
+    if (dataSize > 0)
+        memcpy(in.get(), input.data.data(), dataSize);
+    std::unique_ptr<byte_t[]> plain(new byte_t[plainSize]());
+    AES::AES oneShot;
+    fuzzCheck(input.setup(oneShot, input.engine, input.ghash));
+    bool oneShotOk = oneShot.decipher(in.get(), plain.get(), dataSize);
+
+    // Without padding, GCM, OCB and CTR accept the same messages both ways
+    if (!input.padding && (input.mode == AES::MODE::GCM || input.mode == AES::MODE::OCB
+        || input.mode == AES::MODE::CTR))
+        fuzzCheck(streamOk == oneShotOk);
+    if (streamOk) {
+        fuzzCheck(oneShotOk);
+        plainSize -= AES::AES::getRevPaddingSize(plain.get(), dataSize, padding, input.mode);
+        fuzzCheck(total == plainSize);
+        fuzzCheck(total == 0 || memcmp(out.get(), plain.get(), total) == 0);
+    }
+    return 0;
+}
@@ -0,0 +1,410 @@
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <libaes/libaes.hpp>
+#include <libaes/types_helper.hpp>
+#include <libaes/aes_engine.hpp>
+#include <libaes/aes_ghash.hpp>
+#include <libaes/aes_mode.hpp>
+#include <libaes/aes_stats.hpp>
+
+/*
+    Multi-buffer calls, many short messages that each have their own iv and maybe key
+    The messages only read their AES object, nothing is stored between calls
+*/
+
+namespace AES
+{
+
+static_assert(AES::MAX_BATCH_LANES <= MAX_LANES, "Lanes are sized for the engines");
+
+/**
+ * What a job needs from its AES object, read once by getBatchMessage
+ * fullSize bytes of dataIn are whole blocks given to the modes directly,
+ * on cipher the tail is the rest of dataIn followed by the padding
+**/
+struct BatchMessage
+{
+    BatchJob* job;
+    MODE mode;
+    const Engine* engine;
+    const word_t* encKeys;
+    const word_t* decKeys;
+    const GhashEngine* ghashEngine;
+    const GhashKey* ghashKey;
+    const OcbKey* ocbKey;
+    int Nk; // GCM-SIV message key size
+    size_t fullSize;
+    byte_t tail[2 * AES::BLOCKSIZE];
+    unsigned int tailSize;
+};
+
+// false if the job can't be run, same rules as initialize/setIv/setAad
+bool AES::getBatchMessage(BatchJob& job, bool encrypt, BatchMessage& message)
+{
+    const AES* key = job.key;
+    if (key == nullptr || !key->hasInit)
+        return false;
+    if (key->mode == MODE::XTS) // cipherSectors
+        return false;
+    if (job.dataSize > 0 && (job.dataIn == nullptr || job.dataOut == nullptr))
+        return false;
+    if (AES::hasTag(key->mode)) {
+        bool ivSizeValid = job.ivSize == AES::SIV_NONCE_SIZE;
+        if (key->mode == MODE::GCM)
+            ivSizeValid = AES::isGcmIvSizeValid(job.ivSize);
+        else if (key->mode == MODE::OCB)
+            ivSizeValid = AES::isOcbIvSizeValid(job.ivSize);
+        if (job.iv == nullptr || !ivSizeValid)
+            return false;
+        if (job.aad == nullptr && job.aadSize > 0)
+            return false;
+    }
+    else if (key->mode != MODE::ECB) {
+        if (job.iv == nullptr || job.ivSize != AES::BLOCKSIZE)
+            return false;
+    }
+
+    message.job = &job;
+    message.mode = key->mode;
+    message.engine = key->engine;
+    message.encKeys = key->keySchedule.encKeys;
+    message.decKeys = key->keySchedule.decKeys;
+    message.ghashEngine = key->ghashEngine;
+    message.ghashKey = key->ghashKey;
+    message.ocbKey = key->ocbKey;
+    message.Nk = key->Nk;
+    message.fullSize = job.dataSize;
+    message.tailSize = 0;
+
+    // Same padding as cipher, without writing in dataIn
+    if (encrypt) {
+        message.fullSize = job.dataSize - job.dataSize % AES::BLOCKSIZE;
+        unsigned int restSize = (unsigned int)(job.dataSize - message.fullSize);
+        unsigned int paddingSize = AES::getPaddingSize(job.dataSize, key->padding);
+        if (restSize > 0)
+            memcpy(message.tail, job.dataIn + message.fullSize, restSize);
+        memset(message.tail + restSize, paddingSize, paddingSize);
+        message.tailSize = restSize + paddingSize;
+    }
+
+    if (message.mode == MODE::GCM && message.fullSize + message.tailSize > GCM_MAX_DATA_SIZE)
+        return false;
+    if (message.mode == MODE::GCM_SIV && (message.fullSize + message.tailSize > SIV_MAX_DATA_SIZE
+        || job.aadSize > SIV_MAX_DATA_SIZE))
+        return false;
+    return true;
+}
+
+/*****************************
+ * CBC
+ ****************************/
+struct CbcLane
+{
+    BatchMessage* message;
+    size_t block;   // Next block to cipher
+    size_t nBlocks; // Whole blocks of dataIn, then of the tail
+};
+
+/*
+    Each lane ciphers one message, the lanes run together until one of them ends
+    or goes from dataIn to its tail. An ended lane takes the next message, or the last lane
+    is moved in its place so the active lanes stay at the front
+*/
+static void cbcEncryptLanes(const Engine* engine, BatchMessage* const* messages, size_t count,
+    unsigned int lanes)
+{
+    uint64_t totalSize = 0;
+    for (size_t i = 0; i < count; ++i)
+        totalSize += messages[i]->fullSize + messages[i]->tailSize;
+    StatsScope stats(STAGE::CBC, totalSize, totalSize / AES::BLOCKSIZE);
+
+    CbcLane lane[MAX_LANES];
+    qword_t chains[MAX_LANES];
+    const word_t* keys[MAX_LANES];
+    const byte_t* dataIn[MAX_LANES];
+    byte_t* dataOut[MAX_LANES];
+    unsigned int active = 0;
+    size_t next = 0;
+
+    while (true)
+    {
+        for (; active < lanes && next < count; ++next)
+        {
+            BatchMessage* message = messages[next];
+            size_t nBlocks = (message->fullSize + message->tailSize) / AES::BLOCKSIZE;
+            if (nBlocks == 0)
+                continue;
+            lane[active] = { message, 0, nBlocks };
+            qwordCopy(message->job->iv, chains[active]);
+            keys[active] = message->encKeys;
+            ++active;
+        }
+        if (active == 0)
+            break;
+
+        size_t run = SIZE_MAX;
+        for (unsigned int i = 0; i < active; ++i)
+        {
+            const BatchMessage& message = *lane[i].message;
+            size_t fullBlocks = message.fullSize / AES::BLOCKSIZE;
+            size_t offset = lane[i].block * AES::BLOCKSIZE;
+            size_t end = lane[i].block < fullBlocks ? fullBlocks : lane[i].nBlocks;
+            if (end - lane[i].block < run)
+                run = end - lane[i].block;
+            dataIn[i] = offset < message.fullSize ?
+                message.job->dataIn + offset : message.tail + (offset - message.fullSize);
+            dataOut[i] = message.job->dataOut + offset;
+        }
+
+        engine->cbcLanes(active, dataIn, dataOut, chains, run, keys);
+
+        for (unsigned int i = active; i-- > 0;)
+        {
+            lane[i].block += run;
+            if (lane[i].block == lane[i].nBlocks) {
+                --active;
+                lane[i] = lane[active];
+                qwordCopy(chains[active], chains[i]);
+                keys[i] = keys[active];
+            }
+        }
+    }
+}
+
+/*****************************
+ * ECB, CBC decrypt, CTR
+ ****************************/
+// Parallel within the message, the mode kernels already keep the engine busy
+static void cryptMessage(BatchMessage& message, bool encrypt)
+{
+    BatchJob& job = *message.job;
+    byte_t* tailOut = job.dataOut + message.fullSize;
+
+    if (message.mode == MODE::ECB) {
+        const blocksFunc_t blocksFunc = encrypt ?
+            message.engine->cipherBlocks : message.engine->decipherBlocks;
+        const word_t* keys = encrypt ? message.encKeys : message.decKeys;
+        ecbCryptChunks(nullptr, blocksFunc, keys, job.dataIn, job.dataOut, message.fullSize);
+        if (message.tailSize > 0)
+            ecbCryptChunks(nullptr, blocksFunc, keys, message.tail, tailOut, message.tailSize);
+    }
+    else if (message.mode == MODE::CBC) {
+        qword_t nonce;
+        qwordCopy(job.iv, nonce);
+        cbcDecryptChunks(nullptr, message.engine, message.decKeys, nonce, job.dataIn,
+            job.dataOut, message.fullSize);
+    }
+    else if (message.mode == MODE::CTR) {
+        qword_t counter;
+        qwordCopy(job.iv, counter);
+        ctrCryptChunks(nullptr, message.engine, message.encKeys, counter, 16, job.dataIn,
+            job.dataOut, message.fullSize);
+        if (message.tailSize > 0) {
+            ctrCryptChunks(nullptr, message.engine, message.encKeys, counter, 16, message.tail,
+                tailOut, message.tailSize);
+        }
+    }
+}
+
+// Wrong tag: the plain text is not released, dataOut is wiped
+static void rejectMessage(BatchJob& job)
+{
+    job.status = false;
+    if (job.dataSize > 0)
+        memset(job.dataOut, 0, job.dataSize);
+}
+
+/*****************************
+ * GCM
+ ****************************/
+// The aad is hashed here, every message has its own
+static void gcmMessage(BatchMessage& message, bool encrypt)
+{
+    BatchJob& job = *message.job;
+    const GhashKey& hashKey = *message.ghashKey;
+
+    qword_t J0;
+    gcmJ0(message.ghashEngine, hashKey, job.iv, job.ivSize, J0);
+
+    qword_t Y = QWORD_STATIC_ZERO;
+    {
+        StatsScope stats(STAGE::GHASH, job.aadSize,
+            AES::getBlockRoundedSize(job.aadSize) / AES::BLOCKSIZE);
+        ghashPadded(message.ghashEngine, hashKey, Y, job.aad, job.aadSize);
+    }
+
+    qword_t counter;
+    qwordCopy(J0, counter);
+    ctrAdd(counter, 4, 1);
+    gcmCryptHashChunks(nullptr, message.engine, message.encKeys, message.ghashEngine,
+        hashKey, counter, Y, job.dataIn, job.dataOut, message.fullSize, !encrypt);
+    if (message.tailSize > 0) {
+        gcmCryptHashChunks(nullptr, message.engine, message.encKeys, message.ghashEngine,
+            hashKey, counter, Y, message.tail, job.dataOut + message.fullSize,
+            message.tailSize, false);
+    }
+
+    // T = E(K, J0) ^ GHASH(aad || C || sizes)
+    StatsScope stats(STAGE::GCM_TAG, AES::BLOCKSIZE, 1);
+    gcmHashSizes(message.ghashEngine, hashKey, Y, job.aadSize,
+        message.fullSize + message.tailSize);
+    message.engine->cipherBlock(QWTOBUF(J0), message.encKeys);
+    qwordXor(J0, Y);
+    if (encrypt)
+        memcpy(job.tag, QWTOCBUF(Y), AES::BLOCKSIZE);
+    else if (!bufferEqual(job.tag, QWTOCBUF(Y), AES::BLOCKSIZE))
+        rejectMessage(job);
+}
+
+/*****************************
+ * OCB
+ ****************************/
+// HASH(K, A) is computed here too, the partial last block is in dataIn or in the tail
+static void ocbMessage(BatchMessage& message, bool encrypt)
+{
+    BatchJob& job = *message.job;
+    const OcbKey& key = *message.ocbKey;
+    const word_t* keys = encrypt ? message.encKeys : message.decKeys;
+
+    qword_t aadHash;
+    qword_t offset;
+    qword_t checksum = QWORD_STATIC_ZERO;
+    ocbHash(message.engine, message.encKeys, key, job.aad, job.aadSize, aadHash);
+    ocbOffset0(message.engine, message.encKeys, job.iv, job.ivSize, offset);
+
+    size_t fullSize = message.fullSize - message.fullSize % AES::BLOCKSIZE;
+    ocbCryptChunks(nullptr, message.engine, keys, key, offset, checksum, 0, job.dataIn,
+        job.dataOut, fullSize, !encrypt);
+    const byte_t* lastIn = job.dataIn + fullSize;
+    byte_t* lastOut = job.dataOut + fullSize;
+    size_t lastSize = message.fullSize - fullSize;
+    if (message.tailSize > 0) {
+        size_t tailFull = message.tailSize - message.tailSize % AES::BLOCKSIZE;
+        ocbCryptChunks(nullptr, message.engine, keys, key, offset, checksum,
+            fullSize / AES::BLOCKSIZE, message.tail, lastOut, tailFull, false);
+        lastIn = message.tail + tailFull;
+        lastOut += tailFull;
+        lastSize = message.tailSize - tailFull;
+    }
+
+    qword_t T;
+    ocbTag(message.engine, message.encKeys, key, offset, checksum, aadHash, lastIn, lastOut,
+        (unsigned int)lastSize, !encrypt, T);
+    if (encrypt)
+        memcpy(job.tag, QWTOCBUF(T), AES::BLOCKSIZE);
+    else if (!bufferEqual(job.tag, QWTOCBUF(T), AES::BLOCKSIZE))
+        rejectMessage(job);
+}
+
+/*****************************
+ * GCM-SIV
+ ****************************/
+// The message keys are derived here from the nonce, the aad is hashed with them
+static void sivMessage(BatchMessage& message, bool encrypt)
+{
+    BatchJob& job = *message.job;
+    SivKeys keys;
+    sivDeriveKeys(message.engine, message.ghashEngine, message.encKeys, message.Nk, job.iv,
+        keys);
+
+    qword_t Y = QWORD_STATIC_ZERO;
+    qword_t counter;
+    sivHashChunks(nullptr, message.ghashEngine, keys.hashKey, Y, job.aad, job.aadSize);
+    if (encrypt) {
+        sivHashChunks(nullptr, message.ghashEngine, keys.hashKey, Y, job.dataIn,
+            message.fullSize);
+        sivHashChunks(nullptr, message.ghashEngine, keys.hashKey, Y, message.tail,
+            message.tailSize);
+    }
+    else {
+        sivCounter(job.tag, counter);
+        ctrCryptChunks(nullptr, message.engine, keys.encKeys, counter, SIV_INC_BYTES,
+            job.dataIn, job.dataOut, message.fullSize);
+        sivHashChunks(nullptr, message.ghashEngine, keys.hashKey, Y, job.dataOut,
+            message.fullSize);
+    }
+
+    qword_t T;
+    sivTag(message.engine, message.ghashEngine, keys, Y, job.iv, job.aadSize,
+        message.fullSize + message.tailSize, T);
+    if (!encrypt) {
+        if (!bufferEqual(job.tag, QWTOCBUF(T), AES::BLOCKSIZE))
+            rejectMessage(job);
+        return;
+    }
+
+    sivCounter(QWTOCBUF(T), counter);
+    ctrCryptChunks(nullptr, message.engine, keys.encKeys, counter, SIV_INC_BYTES, job.dataIn,
+        job.dataOut, message.fullSize);
+    ctrCryptChunks(nullptr, message.engine, keys.encKeys, counter, SIV_INC_BYTES, message.tail,
+        job.dataOut + message.fullSize, message.tailSize);
+    memcpy(job.tag, QWTOCBUF(T), AES::BLOCKSIZE);
+}
+
+/*****************************
+ * API
+ ****************************/
+bool AES::runBatch(BatchJob* jobs, size_t count, unsigned int lanes, bool encrypt)
+{
+    if (jobs == nullptr)
+        return count == 0;
+    const bool lanesValid = lanes >= 1 && lanes <= MAX_BATCH_LANES;
+
+    std::vector<BatchMessage> messages;
+    messages.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        BatchMessage message;
+        jobs[i].status = lanesValid && AES::getBatchMessage(jobs[i], encrypt, message);
+        if (jobs[i].status)
+            messages.push_back(message);
+    }
+
+    // CBC encryption by lanes, one group per engine, which is a single one in the usual case
+    std::vector<BatchMessage*> cbc;
+    for (BatchMessage& message : messages) {
+        if (encrypt && message.mode == MODE::CBC)
+            cbc.push_back(&message);
+        else if (message.mode == MODE::GCM)
+            gcmMessage(message, encrypt);
+        else if (message.mode == MODE::OCB)
+            ocbMessage(message, encrypt);
+        else if (message.mode == MODE::GCM_SIV)
+            sivMessage(message, encrypt);
+        else
+            cryptMessage(message, encrypt);
+    }
+    while (!cbc.empty())
+    {
+        const Engine* engine = cbc[0]->engine;
+        std::vector<BatchMessage*> others;
+        size_t laneCount = 0;
+        for (BatchMessage* message : cbc) {
+            if (message->engine == engine)
+                cbc[laneCount++] = message;
+            else
+                others.push_back(message);
+        }
+        cbcEncryptLanes(engine, cbc.data(), laneCount, lanes);
+        cbc.swap(others);
+    }
+
+    bool success = true;
+    for (size_t i = 0; i < count; ++i)
+        success &= jobs[i].status;
+    return success;
+}
+
+bool AES::cipherBatch(BatchJob* pJobs, size_t pCount, unsigned int pLanes)
+{
+    return AES::runBatch(pJobs, pCount, pLanes, true);
+}
+
+bool AES::decipherBatch(BatchJob* pJobs, size_t pCount, unsigned int pLanes)
+{
+    return AES::runBatch(pJobs, pCount, pLanes, false);
+}
+
+} // namespace AES
@@ -1,6 +1,9 @@
+#include <cstring>
+
 #include <libaes/types_helper.hpp>
 #include <libaes/libaes.hpp>
 #include <libaes/aes_cipher.hpp>
+#include <libaes/aes_engine.hpp>
 
 #define CELL(r, c) (r + c * 4)
 
@@ -173,32 +176,17 @@ static void addRoundKey(byte_t* state, const word_t* keySchedule, int round)
     }
 }
 
-void keyExpansion(const byte_t* key, word_t* ksch, int kschSize, int Nk)
+template <int Nk>
+void keyExpansion(const byte_t* key, word_t* ksch)
 {
-#define ROTWORD(x) (((x) << 8) | ((x) >> 24))
-
-    int i;
-    for (i = 0; i < Nk; ++i) {
-        ksch[i] = bytesToWord(key[4 * i], key[4 * i + 1], key[4 * i + 2], key[4 * i + 3]);
-    }
-
-    for (i = Nk; i < kschSize; ++i) {
-        word_t tmp = ksch[i - 1];
-        if (i % Nk == 0) {
-            tmp = subWord(ROTWORD(tmp)) ^ LOOKUPS::RCON[i / Nk - 1];
-        }
-        else if (Nk > 6 && i % Nk == 4) {
-            tmp = subWord(tmp);
-        }
-        ksch[i] = ksch[(i + kschSize - Nk) % kschSize] ^ tmp;
-    }
-
-#undef ROTWORD
+    expandKeySchedule<Nk, subWord>(key, ksch);
 }
 
-void cipherBlock(byte_t* state, const word_t* keySchedule, int Nr)
+template <int Nr>
+void cipherBlock(byte_t* state, const word_t* keySchedule)
 {
     addRoundKey(state, keySchedule, 0);
+    LIBAES_UNROLL
     for (int round = 1; round < Nr; ++round) {
         subBytes(state);
         shiftRows(state);
@@ -210,9 +198,11 @@ void cipherBlock(byte_t* state, const word_t* keySchedule, int Nr)
     addRoundKey(state, keySchedule, Nr);
 }
 
-void decipherBlock(byte_t* state, const word_t* keySchedule, int Nr)
+template <int Nr>
+void decipherBlock(byte_t* state, const word_t* keySchedule)
 {
     addRoundKey(state, keySchedule, Nr);
+    LIBAES_UNROLL
     for (int round = Nr - 1; round > 0; --round) {
         invShiftRows(state);
         invSubBytes(state);
@@ -224,6 +214,22 @@ void decipherBlock(byte_t* state, const word_t* keySchedule, int Nr)
     addRoundKey(state, keySchedule, 0);
 }
 
+// The reference round functions work directly on the key schedule
+template <int Nr>
+void prepareKeysRef(const word_t* ksch, word_t* encKeys, word_t* decKeys)
+{
+    const int len = 4 * (Nr + 1);
+    memcpy(encKeys, ksch, len * sizeof(word_t));
+    memcpy(decKeys, ksch, len * sizeof(word_t));
+}
+
+template void keyExpansion<4>(const byte_t* key, word_t* ksch);
+template void keyExpansion<6>(const byte_t* key, word_t* ksch);
+template void keyExpansion<8>(const byte_t* key, word_t* ksch);
+INSTANTIATE_ENGINE_PREPARE_KEYS(prepareKeysRef)
+INSTANTIATE_ENGINE_BLOCK(cipherBlock)
+INSTANTIATE_ENGINE_BLOCK(decipherBlock)
+
 } // namespace AES
 
 #undef CELL
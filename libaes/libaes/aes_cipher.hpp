@@ -2,6 +2,7 @@
 #define LIBAES_AES_CIPHER_HPP
 
 #include <libaes/types.hpp>
+#include <libaes/types_helper.hpp>
 
 namespace AES
 {
@@ -14,6 +15,14 @@ public:
     static const byte_t INV_SBOX[];
     static const byte_t MIX_COLUMNS_MATRIX[];
     static const byte_t INV_MIX_COLUMNS_MATRIX[];
+    static const word_t TE0[];
+    static const word_t TE1[];
+    static const word_t TE2[];
+    static const word_t TE3[];
+    static const word_t TD0[];
+    static const word_t TD1[];
+    static const word_t TD2[];
+    static const word_t TD3[];
 
     LOOKUPS() = delete;
     ~LOOKUPS() = delete;
@@ -22,9 +31,40 @@ public:
     LOOKUPS& operator=(LOOKUPS&& other) = delete;
 };
 
-void keyExpansion(const byte_t* key, word_t* ksch, int kschSize, int Nk);
-void cipherBlock(byte_t* state, const word_t* keySchedule, int Nr);
-void decipherBlock(byte_t* state, const word_t* keySchedule, int Nr);
+/*
+    Key schedule of FIPS-197, SubWord is given by the engine so the constant time ones don't
+    index the S-box table with key bytes. Only the public round number picks RCON
+    Nk is known at compile time, the i % Nk tests of the loop are resolved by the compiler
+    Schedule is Nb * (Nr + 1) = 4 * (Nk + 7) words
+*/
+template <int Nk, word_t (*SubWord)(word_t)>
+inline void expandKeySchedule(const byte_t* key, word_t* ksch)
+{
+    const int kschSize = 4 * (Nk + 7);
+    int i;
+    for (i = 0; i < Nk; ++i) {
+        ksch[i] = bytesToWord(key[4 * i], key[4 * i + 1], key[4 * i + 2], key[4 * i + 3]);
+    }
+
+    for (i = Nk; i < kschSize; ++i) {
+        word_t tmp = ksch[i - 1];
+        if (i % Nk == 0) {
+            tmp = SubWord((tmp << 8) | (tmp >> 24)) ^ LOOKUPS::RCON[i / Nk - 1];
+        }
+        else if (Nk > 6 && i % Nk == 4) {
+            tmp = SubWord(tmp);
+        }
+        ksch[i] = ksch[i - Nk] ^ tmp;
+    }
+}
+
+// Instantiated for Nk = 4, 6, 8 and Nr = 10, 12, 14, SubWord reads the S-box table
+template <int Nk>
+void keyExpansion(const byte_t* key, word_t* ksch);
+template <int Nr>
+void cipherBlock(byte_t* state, const word_t* keySchedule);
+template <int Nr>
+void decipherBlock(byte_t* state, const word_t* keySchedule);
 
 } // namespace AES
 
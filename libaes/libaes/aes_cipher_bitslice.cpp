@@ -0,0 +1,589 @@
+#include <cstdint>
+#include <cstring>
+
+#include <libaes/types.hpp>
+#include <libaes/aes_cipher.hpp>
+#include <libaes/aes_engine.hpp>
+
+/*
+    Bitsliced engine, constant time: no table lookup and no branch depends on data or key,
+    the key expansion included, its SubWord goes through the bitsliced S-box
+    Based on the "ct64" representation of BearSSL (https://bearssl.org/constanttime.html)
+    One group = 4 blocks spread over 8 64 bits words, word i holds the bit i of every byte
+    of the 4 blocks. Two groups are processed side by side, so 8 blocks per pass
+
+    Round keys are stored compressed, 2 x 64 bits per round (it fits the 4 words per round
+    of the other engines), and expanded at the start of each call
+*/
+
+namespace AES
+{
+
+static const int BS_GROUP_BLOCKS = 4;
+static const int BS_PASS_BLOCKS = 2 * BS_GROUP_BLOCKS;
+
+/*
+    Boyar-Peralta S-box circuit, 113 gates
+    https://eprint.iacr.org/2011/332.pdf
+*/
+static void bitsliceSbox(uint64_t* q)
+{
+    uint64_t x0, x1, x2, x3, x4, x5, x6, x7;
+    uint64_t y1, y2, y3, y4, y5, y6, y7, y8, y9;
+    uint64_t y10, y11, y12, y13, y14, y15, y16, y17, y18, y19;
+    uint64_t y20, y21;
+    uint64_t z0, z1, z2, z3, z4, z5, z6, z7, z8, z9;
+    uint64_t z10, z11, z12, z13, z14, z15, z16, z17;
+    uint64_t t0, t1, t2, t3, t4, t5, t6, t7, t8, t9;
+    uint64_t t10, t11, t12, t13, t14, t15, t16, t17, t18, t19;
+    uint64_t t20, t21, t22, t23, t24, t25, t26, t27, t28, t29;
+    uint64_t t30, t31, t32, t33, t34, t35, t36, t37, t38, t39;
+    uint64_t t40, t41, t42, t43, t44, t45, t46, t47, t48, t49;
+    uint64_t t50, t51, t52, t53, t54, t55, t56, t57, t58, t59;
+    uint64_t t60, t61, t62, t63, t64, t65, t66, t67;
+    uint64_t s0, s1, s2, s3, s4, s5, s6, s7;
+
+    x0 = q[7];
+    x1 = q[6];
+    x2 = q[5];
+    x3 = q[4];
+    x4 = q[3];
+    x5 = q[2];
+    x6 = q[1];
+    x7 = q[0];
+
+    // Top linear transformation
+    y14 = x3 ^ x5;
+    y13 = x0 ^ x6;
+    y9 = x0 ^ x3;
+    y8 = x0 ^ x5;
+    t0 = x1 ^ x2;
+    y1 = t0 ^ x7;
+    y4 = y1 ^ x3;
+    y12 = y13 ^ y14;
+    y2 = y1 ^ x0;
+    y5 = y1 ^ x6;
+    y3 = y5 ^ y8;
+    t1 = x4 ^ y12;
+    y15 = t1 ^ x5;
+    y20 = t1 ^ x1;
+    y6 = y15 ^ x7;
+    y10 = y15 ^ t0;
+    y11 = y20 ^ y9;
+    y7 = x7 ^ y11;
+    y17 = y10 ^ y11;
+    y19 = y10 ^ y8;
+    y16 = t0 ^ y11;
+    y21 = y13 ^ y16;
+    y18 = x0 ^ y16;
+
+    // Non linear section, inversion in GF(2^8)
+    t2 = y12 & y15;
+    t3 = y3 & y6;
+    t4 = t3 ^ t2;
+    t5 = y4 & x7;
+    t6 = t5 ^ t2;
+    t7 = y13 & y16;
+    t8 = y5 & y1;
+    t9 = t8 ^ t7;
+    t10 = y2 & y7;
+    t11 = t10 ^ t7;
+    t12 = y9 & y11;
+    t13 = y14 & y17;
+    t14 = t13 ^ t12;
+    t15 = y8 & y10;
+    t16 = t15 ^ t12;
+    t17 = t4 ^ t14;
+    t18 = t6 ^ t16;
+    t19 = t9 ^ t14;
+    t20 = t11 ^ t16;
+    t21 = t17 ^ y20;
+    t22 = t18 ^ y19;
+    t23 = t19 ^ y21;
+    t24 = t20 ^ y18;
+
+    t25 = t21 ^ t22;
+    t26 = t21 & t23;
+    t27 = t24 ^ t26;
+    t28 = t25 & t27;
+    t29 = t28 ^ t22;
+    t30 = t23 ^ t24;
+    t31 = t22 ^ t26;
+    t32 = t31 & t30;
+    t33 = t32 ^ t24;
+    t34 = t23 ^ t33;
+    t35 = t27 ^ t33;
+    t36 = t24 & t35;
+    t37 = t36 ^ t34;
+    t38 = t27 ^ t36;
+    t39 = t29 & t38;
+    t40 = t25 ^ t39;
+
+    t41 = t40 ^ t37;
+    t42 = t29 ^ t33;
+    t43 = t29 ^ t40;
+    t44 = t33 ^ t37;
+    t45 = t42 ^ t41;
+    z0 = t44 & y15;
+    z1 = t37 & y6;
+    z2 = t33 & x7;
+    z3 = t43 & y16;
+    z4 = t40 & y1;
+    z5 = t29 & y7;
+    z6 = t42 & y11;
+    z7 = t45 & y17;
+    z8 = t41 & y10;
+    z9 = t44 & y12;
+    z10 = t37 & y3;
+    z11 = t33 & y4;
+    z12 = t43 & y13;
+    z13 = t40 & y5;
+    z14 = t29 & y2;
+    z15 = t42 & y9;
+    z16 = t45 & y14;
+    z17 = t41 & y8;
+
+    // Bottom linear transformation
+    t46 = z15 ^ z16;
+    t47 = z10 ^ z11;
+    t48 = z5 ^ z13;
+    t49 = z9 ^ z10;
+    t50 = z2 ^ z12;
+    t51 = z2 ^ z5;
+    t52 = z7 ^ z8;
+    t53 = z0 ^ z3;
+    t54 = z6 ^ z7;
+    t55 = z16 ^ z17;
+    t56 = z12 ^ t48;
+    t57 = t50 ^ t53;
+    t58 = z4 ^ t46;
+    t59 = z3 ^ t54;
+    t60 = t46 ^ t57;
+    t61 = z14 ^ t57;
+    t62 = t52 ^ t58;
+    t63 = t49 ^ t58;
+    t64 = z4 ^ t59;
+    t65 = t61 ^ t62;
+    t66 = z1 ^ t63;
+    s0 = t59 ^ t63;
+    s6 = t56 ^ ~t62;
+    s7 = t48 ^ ~t60;
+    t67 = t64 ^ t65;
+    s3 = t53 ^ t66;
+    s4 = t51 ^ t66;
+    s5 = t47 ^ t65;
+    s1 = t64 ^ ~s3;
+    s2 = t55 ^ ~t67;
+
+    q[7] = s0;
+    q[6] = s1;
+    q[5] = s2;
+    q[4] = s3;
+    q[3] = s4;
+    q[2] = s5;
+    q[1] = s6;
+    q[0] = s7;
+}
+
+// S-box^-1(x) = A^-1(Inv(x)), Inv(x) is obtained with the forward S-box framed by A^-1
+static void bitsliceInvSbox(uint64_t* q)
+{
+    for (int pass = 0; pass < 2; ++pass) {
+        uint64_t q0 = ~q[0];
+        uint64_t q1 = ~q[1];
+        uint64_t q2 = q[2];
+        uint64_t q3 = q[3];
+        uint64_t q4 = q[4];
+        uint64_t q5 = ~q[5];
+        uint64_t q6 = ~q[6];
+        uint64_t q7 = q[7];
+        q[7] = q1 ^ q4 ^ q6;
+        q[6] = q0 ^ q3 ^ q5;
+        q[5] = q7 ^ q2 ^ q4;
+        q[4] = q6 ^ q1 ^ q3;
+        q[3] = q5 ^ q0 ^ q2;
+        q[2] = q4 ^ q7 ^ q1;
+        q[1] = q3 ^ q6 ^ q0;
+        q[0] = q2 ^ q5 ^ q7;
+
+        if (pass == 0)
+            bitsliceSbox(q);
+    }
+}
+
+// Transpose 8 words so that word i gets bit i of every byte
+static void ortho(uint64_t* q)
+{
+#define SWAPN(cl, ch, s, x, y)                              \
+    {                                                       \
+        uint64_t a = (x);                                   \
+        uint64_t b = (y);                                   \
+        (x) = (a & (uint64_t)(cl)) | ((b & (uint64_t)(cl)) << (s)); \
+        (y) = ((a & (uint64_t)(ch)) >> (s)) | (b & (uint64_t)(ch)); \
+    }
+#define SWAP2(x, y) SWAPN(0x5555555555555555, 0xAAAAAAAAAAAAAAAA, 1, x, y)
+#define SWAP4(x, y) SWAPN(0x3333333333333333, 0xCCCCCCCCCCCCCCCC, 2, x, y)
+#define SWAP8(x, y) SWAPN(0x0F0F0F0F0F0F0F0F, 0xF0F0F0F0F0F0F0F0, 4, x, y)
+
+    SWAP2(q[0], q[1]);
+    SWAP2(q[2], q[3]);
+    SWAP2(q[4], q[5]);
+    SWAP2(q[6], q[7]);
+
+    SWAP4(q[0], q[2]);
+    SWAP4(q[1], q[3]);
+    SWAP4(q[4], q[6]);
+    SWAP4(q[5], q[7]);
+
+    SWAP8(q[0], q[4]);
+    SWAP8(q[1], q[5]);
+    SWAP8(q[2], q[6]);
+    SWAP8(q[3], q[7]);
+
+#undef SWAP8
+#undef SWAP4
+#undef SWAP2
+#undef SWAPN
+}
+
+static inline word_t loadWordLe(const byte_t* b)
+{
+    return (word_t)b[0] | ((word_t)b[1] << 8) | ((word_t)b[2] << 16) | ((word_t)b[3] << 24);
+}
+
+static inline void storeWordLe(word_t w, byte_t* b)
+{
+    b[0] = (byte_t)w;
+    b[1] = (byte_t)(w >> 8);
+    b[2] = (byte_t)(w >> 16);
+    b[3] = (byte_t)(w >> 24);
+}
+
+static void interleaveIn(uint64_t* q0, uint64_t* q1, const word_t* w)
+{
+    uint64_t x0 = w[0];
+    uint64_t x1 = w[1];
+    uint64_t x2 = w[2];
+    uint64_t x3 = w[3];
+    x0 |= (x0 << 16);
+    x1 |= (x1 << 16);
+    x2 |= (x2 << 16);
+    x3 |= (x3 << 16);
+    x0 &= (uint64_t)0x0000FFFF0000FFFF;
+    x1 &= (uint64_t)0x0000FFFF0000FFFF;
+    x2 &= (uint64_t)0x0000FFFF0000FFFF;
+    x3 &= (uint64_t)0x0000FFFF0000FFFF;
+    x0 |= (x0 << 8);
+    x1 |= (x1 << 8);
+    x2 |= (x2 << 8);
+    x3 |= (x3 << 8);
+    x0 &= (uint64_t)0x00FF00FF00FF00FF;
+    x1 &= (uint64_t)0x00FF00FF00FF00FF;
+    x2 &= (uint64_t)0x00FF00FF00FF00FF;
+    x3 &= (uint64_t)0x00FF00FF00FF00FF;
+    *q0 = x0 | (x2 << 8);
+    *q1 = x1 | (x3 << 8);
+}
+
+static void interleaveOut(word_t* w, uint64_t q0, uint64_t q1)
+{
+    uint64_t x0 = q0 & (uint64_t)0x00FF00FF00FF00FF;
+    uint64_t x1 = q1 & (uint64_t)0x00FF00FF00FF00FF;
+    uint64_t x2 = (q0 >> 8) & (uint64_t)0x00FF00FF00FF00FF;
+    uint64_t x3 = (q1 >> 8) & (uint64_t)0x00FF00FF00FF00FF;
+    x0 |= (x0 >> 8);
+    x1 |= (x1 >> 8);
+    x2 |= (x2 >> 8);
+    x3 |= (x3 >> 8);
+    x0 &= (uint64_t)0x0000FFFF0000FFFF;
+    x1 &= (uint64_t)0x0000FFFF0000FFFF;
+    x2 &= (uint64_t)0x0000FFFF0000FFFF;
+    x3 &= (uint64_t)0x0000FFFF0000FFFF;
+    w[0] = (word_t)x0 | (word_t)(x0 >> 16);
+    w[1] = (word_t)x1 | (word_t)(x1 >> 16);
+    w[2] = (word_t)x2 | (word_t)(x2 >> 16);
+    w[3] = (word_t)x3 | (word_t)(x3 >> 16);
+}
+
+static inline void addRoundKey(uint64_t* q, const uint64_t* sk)
+{
+    for (int i = 0; i < 8; ++i)
+        q[i] ^= sk[i];
+}
+
+static inline void shiftRows(uint64_t* q)
+{
+    for (int i = 0; i < 8; ++i) {
+        uint64_t x = q[i];
+        q[i] = (x & (uint64_t)0x000000000000FFFF)
+            | ((x & (uint64_t)0x00000000FFF00000) >> 4)
+            | ((x & (uint64_t)0x00000000000F0000) << 12)
+            | ((x & (uint64_t)0x0000FF0000000000) >> 8)
+            | ((x & (uint64_t)0x000000FF00000000) << 8)
+            | ((x & (uint64_t)0xF000000000000000) >> 12)
+            | ((x & (uint64_t)0x0FFF000000000000) << 4);
+    }
+}
+
+static inline void invShiftRows(uint64_t* q)
+{
+    for (int i = 0; i < 8; ++i) {
+        uint64_t x = q[i];
+        q[i] = (x & (uint64_t)0x000000000000FFFF)
+            | ((x & (uint64_t)0x000000000FFF0000) << 4)
+            | ((x & (uint64_t)0x00000000F0000000) >> 12)
+            | ((x & (uint64_t)0x000000FF00000000) << 8)
+            | ((x & (uint64_t)0x0000FF0000000000) >> 8)
+            | ((x & (uint64_t)0x000F000000000000) << 12)
+            | ((x & (uint64_t)0xFFF0000000000000) >> 4);
+    }
+}
+
+static inline uint64_t rotr16(uint64_t x)
+{
+    return (x << 48) | (x >> 16);
+}
+
+static inline uint64_t rotr32(uint64_t x)
+{
+    return (x << 32) | (x >> 32);
+}
+
+// rotr16 gives the next row of the same column, rotr32 the row after
+static inline void mixColumns(uint64_t* q)
+{
+    uint64_t q0 = q[0], q1 = q[1], q2 = q[2], q3 = q[3];
+    uint64_t q4 = q[4], q5 = q[5], q6 = q[6], q7 = q[7];
+    uint64_t r0 = rotr16(q0), r1 = rotr16(q1), r2 = rotr16(q2), r3 = rotr16(q3);
+    uint64_t r4 = rotr16(q4), r5 = rotr16(q5), r6 = rotr16(q6), r7 = rotr16(q7);
+
+    q[0] = q7 ^ r7 ^ r0 ^ rotr32(q0 ^ r0);
+    q[1] = q0 ^ r0 ^ q7 ^ r7 ^ r1 ^ rotr32(q1 ^ r1);
+    q[2] = q1 ^ r1 ^ r2 ^ rotr32(q2 ^ r2);
+    q[3] = q2 ^ r2 ^ q7 ^ r7 ^ r3 ^ rotr32(q3 ^ r3);
+    q[4] = q3 ^ r3 ^ q7 ^ r7 ^ r4 ^ rotr32(q4 ^ r4);
+    q[5] = q4 ^ r4 ^ r5 ^ rotr32(q5 ^ r5);
+    q[6] = q5 ^ r5 ^ r6 ^ rotr32(q6 ^ r6);
+    q[7] = q6 ^ r6 ^ r7 ^ rotr32(q7 ^ r7);
+}
+
+static inline void invMixColumns(uint64_t* q)
+{
+    uint64_t q0 = q[0], q1 = q[1], q2 = q[2], q3 = q[3];
+    uint64_t q4 = q[4], q5 = q[5], q6 = q[6], q7 = q[7];
+    uint64_t r0 = rotr16(q0), r1 = rotr16(q1), r2 = rotr16(q2), r3 = rotr16(q3);
+    uint64_t r4 = rotr16(q4), r5 = rotr16(q5), r6 = rotr16(q6), r7 = rotr16(q7);
+
+    q[0] = q5 ^ q6 ^ q7 ^ r0 ^ r5 ^ r7 ^ rotr32(q0 ^ q5 ^ q6 ^ r0 ^ r5);
+    q[1] = q0 ^ q5 ^ r0 ^ r1 ^ r5 ^ r6 ^ r7 ^ rotr32(q1 ^ q5 ^ q7 ^ r1 ^ r5 ^ r6);
+    q[2] = q0 ^ q1 ^ q6 ^ r1 ^ r2 ^ r6 ^ r7 ^ rotr32(q0 ^ q2 ^ q6 ^ r2 ^ r6 ^ r7);
+    q[3] = q0 ^ q1 ^ q2 ^ q5 ^ q6 ^ r0 ^ r2 ^ r3 ^ r5
+        ^ rotr32(q0 ^ q1 ^ q3 ^ q5 ^ q6 ^ q7 ^ r0 ^ r3 ^ r5 ^ r7);
+    q[4] = q1 ^ q2 ^ q3 ^ q5 ^ r1 ^ r3 ^ r4 ^ r5 ^ r6 ^ r7
+        ^ rotr32(q1 ^ q2 ^ q4 ^ q5 ^ q7 ^ r1 ^ r4 ^ r5 ^ r6);
+    q[5] = q2 ^ q3 ^ q4 ^ q6 ^ r2 ^ r4 ^ r5 ^ r6 ^ r7
+        ^ rotr32(q2 ^ q3 ^ q5 ^ q6 ^ r2 ^ r5 ^ r6 ^ r7);
+    q[6] = q3 ^ q4 ^ q5 ^ q7 ^ r3 ^ r5 ^ r6 ^ r7 ^ rotr32(q3 ^ q4 ^ q6 ^ q7 ^ r3 ^ r6 ^ r7);
+    q[7] = q4 ^ q5 ^ q6 ^ r4 ^ r6 ^ r7 ^ rotr32(q4 ^ q5 ^ q7 ^ r4 ^ r7);
+}
+
+// The 4 bytes of n are 4 lanes of a group, the other ones are S-box(0) and dropped
+static word_t subWordBitslice(word_t n)
+{
+    uint64_t q[8] = { n, 0, 0, 0, 0, 0, 0, 0 };
+    ortho(q);
+    bitsliceSbox(q);
+    ortho(q);
+    return (word_t)q[0];
+}
+
+template <int Nr>
+void keyExpansionBitslice(const byte_t* key, word_t* ksch)
+{
+    expandKeySchedule<Nr - 6, subWordBitslice>(key, ksch);
+}
+
+/*
+    Compressed round key: every lane holds the same key, so lane i of word j
+    only needs to keep the bits of word 4 * k + i
+*/
+template <int Nr>
+void prepareKeysBitslice(const word_t* ksch, word_t* encKeys, word_t* decKeys)
+{
+    for (int round = 0; round <= Nr; ++round) {
+        word_t w[4];
+        uint64_t q[8];
+        uint64_t comp[2];
+
+        for (int i = 0; i < 4; ++i) {
+            byte_t b[4] = { (byte_t)(ksch[4 * round + i] >> 24), (byte_t)(ksch[4 * round + i] >> 16),
+                (byte_t)(ksch[4 * round + i] >> 8), (byte_t)ksch[4 * round + i] };
+            w[i] = loadWordLe(b);
+        }
+        interleaveIn(&q[0], &q[4], w);
+        q[1] = q[2] = q[3] = q[0];
+        q[5] = q[6] = q[7] = q[4];
+        ortho(q);
+
+        comp[0] = (q[0] & (uint64_t)0x1111111111111111) | (q[1] & (uint64_t)0x2222222222222222)
+            | (q[2] & (uint64_t)0x4444444444444444) | (q[3] & (uint64_t)0x8888888888888888);
+        comp[1] = (q[4] & (uint64_t)0x1111111111111111) | (q[5] & (uint64_t)0x2222222222222222)
+            | (q[6] & (uint64_t)0x4444444444444444) | (q[7] & (uint64_t)0x8888888888888888);
+        memcpy(encKeys + 4 * round, comp, sizeof(comp));
+    }
+    memcpy(decKeys, encKeys, 4 * (Nr + 1) * sizeof(word_t));
+}
+
+template <int Nr>
+static void expandKeys(const word_t* keys, uint64_t* sk)
+{
+    for (int i = 0; i < 2 * (Nr + 1); ++i) {
+        uint64_t comp;
+        memcpy(&comp, keys + 2 * i, sizeof(comp));
+        for (int lane = 0; lane < 4; ++lane) {
+            uint64_t x = (comp >> lane) & (uint64_t)0x1111111111111111;
+            sk[4 * i + lane] = (x << 4) - x; // Spread the bit over the 4 lanes
+        }
+    }
+}
+
+static void loadGroup(const byte_t* blocks, int nBlocks, uint64_t* q)
+{
+    for (int i = 0; i < BS_GROUP_BLOCKS; ++i) {
+        word_t w[4] = { 0, 0, 0, 0 };
+        if (i < nBlocks) {
+            for (int j = 0; j < 4; ++j)
+                w[j] = loadWordLe(blocks + 16 * i + 4 * j);
+        }
+        interleaveIn(&q[i], &q[i + 4], w);
+    }
+    ortho(q);
+}
+
+static void storeGroup(uint64_t* q, byte_t* blocks, int nBlocks)
+{
+    ortho(q);
+    for (int i = 0; i < BS_GROUP_BLOCKS && i < nBlocks; ++i) {
+        word_t w[4];
+        interleaveOut(w, q[i], q[i + 4]);
+        for (int j = 0; j < 4; ++j)
+            storeWordLe(w[j], blocks + 16 * i + 4 * j);
+    }
+}
+
+// Up to 8 blocks, both groups go through each step together
+template <int Nr>
+static void cipherPass(byte_t* blocks, int nBlocks, const uint64_t* sk)
+{
+    uint64_t qa[8];
+    uint64_t qb[8];
+    int nb = nBlocks > BS_GROUP_BLOCKS ? nBlocks - BS_GROUP_BLOCKS : 0;
+
+    loadGroup(blocks, nBlocks, qa);
+    loadGroup(blocks + 16 * BS_GROUP_BLOCKS, nb, qb);
+
+    addRoundKey(qa, sk);
+    addRoundKey(qb, sk);
+    for (int round = 1; round < Nr; ++round) {
+        bitsliceSbox(qa);
+        bitsliceSbox(qb);
+        shiftRows(qa);
+        shiftRows(qb);
+        mixColumns(qa);
+        mixColumns(qb);
+        addRoundKey(qa, sk + 8 * round);
+        addRoundKey(qb, sk + 8 * round);
+    }
+    bitsliceSbox(qa);
+    bitsliceSbox(qb);
+    shiftRows(qa);
+    shiftRows(qb);
+    addRoundKey(qa, sk + 8 * Nr);
+    addRoundKey(qb, sk + 8 * Nr);
+
+    storeGroup(qa, blocks, nBlocks);
+    storeGroup(qb, blocks + 16 * BS_GROUP_BLOCKS, nb);
+}
+
+template <int Nr>
+static void decipherPass(byte_t* blocks, int nBlocks, const uint64_t* sk)
+{
+    uint64_t qa[8];
+    uint64_t qb[8];
+    int nb = nBlocks > BS_GROUP_BLOCKS ? nBlocks - BS_GROUP_BLOCKS : 0;
+
+    loadGroup(blocks, nBlocks, qa);
+    loadGroup(blocks + 16 * BS_GROUP_BLOCKS, nb, qb);
+
+    addRoundKey(qa, sk + 8 * Nr);
+    addRoundKey(qb, sk + 8 * Nr);
+    for (int round = Nr - 1; round > 0; --round) {
+        invShiftRows(qa);
+        invShiftRows(qb);
+        bitsliceInvSbox(qa);
+        bitsliceInvSbox(qb);
+        addRoundKey(qa, sk + 8 * round);
+        addRoundKey(qb, sk + 8 * round);
+        invMixColumns(qa);
+        invMixColumns(qb);
+    }
+    invShiftRows(qa);
+    invShiftRows(qb);
+    bitsliceInvSbox(qa);
+    bitsliceInvSbox(qb);
+    addRoundKey(qa, sk);
+    addRoundKey(qb, sk);
+
+    storeGroup(qa, blocks, nBlocks);
+    storeGroup(qb, blocks + 16 * BS_GROUP_BLOCKS, nb);
+}
+
+template <int Nr>
+void cipherBlocksBitslice(byte_t* blocks, unsigned int nBlocks, const word_t* keys)
+{
+    uint64_t sk[8 * (Nr + 1)];
+    expandKeys<Nr>(keys, sk);
+
+    while (nBlocks > 0) {
+        int n = nBlocks < (unsigned int)BS_PASS_BLOCKS ? (int)nBlocks : BS_PASS_BLOCKS;
+        cipherPass<Nr>(blocks, n, sk);
+        blocks += 16 * n;
+        nBlocks -= n;
+    }
+}
+
+template <int Nr>
+void decipherBlocksBitslice(byte_t* blocks, unsigned int nBlocks, const word_t* keys)
+{
+    uint64_t sk[8 * (Nr + 1)];
+    expandKeys<Nr>(keys, sk);
+
+    while (nBlocks > 0) {
+        int n = nBlocks < (unsigned int)BS_PASS_BLOCKS ? (int)nBlocks : BS_PASS_BLOCKS;
+        decipherPass<Nr>(blocks, n, sk);
+        blocks += 16 * n;
+        nBlocks -= n;
+    }
+}
+
+// A single block still pays for a full pass, use cipherBlocks whenever possible
+template <int Nr>
+void cipherBlockBitslice(byte_t* state, const word_t* keys)
+{
+    cipherBlocksBitslice<Nr>(state, 1, keys);
+}
+
+template <int Nr>
+void decipherBlockBitslice(byte_t* state, const word_t* keys)
+{
+    decipherBlocksBitslice<Nr>(state, 1, keys);
+}
+
+INSTANTIATE_ENGINE_EXPAND_KEY(keyExpansionBitslice)
+INSTANTIATE_ENGINE_PREPARE_KEYS(prepareKeysBitslice)
+INSTANTIATE_ENGINE_BLOCK(cipherBlockBitslice)
+INSTANTIATE_ENGINE_BLOCK(decipherBlockBitslice)
+INSTANTIATE_ENGINE_BLOCKS(cipherBlocksBitslice)
+INSTANTIATE_ENGINE_BLOCKS(decipherBlocksBitslice)
+
+} // namespace AES
@@ -0,0 +1,428 @@
+#include <libaes/types.hpp>
+#include <libaes/aes_cipher.hpp>
+#include <libaes/aes_engine.hpp>
+#include <libaes/cpu_features.hpp>
+
+#if defined(LIBAES_X86)
+
+#include <wmmintrin.h>
+
+/*
+    AES-NI engine
+    Round keys are stored as 16 bytes blocks, in the same byte order as the state,
+    so they can be loaded directly in a register
+    The key expansion gets SubWord from aeskeygenassist, not from the S-box table
+*/
+
+namespace AES
+{
+
+// aeskeygenassist gives SubWord(X1) in its low 32 bits, SubWord works on each byte alone
+LIBAES_TARGET("aes,sse2")
+static word_t subWordNi(word_t n)
+{
+    __m128i x = _mm_set_epi32(0, 0, (int)n, 0);
+    return (word_t)_mm_cvtsi128_si32(_mm_aeskeygenassist_si128(x, 0));
+}
+
+template <int Nr>
+LIBAES_TARGET("aes,sse2")
+void keyExpansionNi(const byte_t* key, word_t* ksch)
+{
+    expandKeySchedule<Nr - 6, subWordNi>(key, ksch);
+}
+
+template <int Nr>
+LIBAES_TARGET("aes,sse2")
+void prepareKeysNi(const word_t* ksch, word_t* encKeys, word_t* decKeys)
+{
+    byte_t* rk = (byte_t*)encKeys;
+    for (int i = 0; i < 4 * (Nr + 1); ++i) {
+        rk[4 * i] = (byte_t)(ksch[i] >> 24);
+        rk[4 * i + 1] = (byte_t)(ksch[i] >> 16);
+        rk[4 * i + 2] = (byte_t)(ksch[i] >> 8);
+        rk[4 * i + 3] = (byte_t)ksch[i];
+    }
+
+    // Equivalent inverse cipher, InvMixColumns applied on the middle round keys
+    const __m128i* enc = (const __m128i*)encKeys;
+    __m128i* dec = (__m128i*)decKeys;
+    _mm_storeu_si128(dec, _mm_loadu_si128(enc + Nr));
+    for (int round = 1; round < Nr; ++round) {
+        _mm_storeu_si128(dec + round, _mm_aesimc_si128(_mm_loadu_si128(enc + Nr - round)));
+    }
+    _mm_storeu_si128(dec + Nr, _mm_loadu_si128(enc));
+}
+
+template <int Nr>
+LIBAES_TARGET("aes,sse2")
+void cipherBlockNi(byte_t* state, const word_t* keys)
+{
+    const __m128i* rk = (const __m128i*)keys;
+    __m128i s = _mm_loadu_si128((const __m128i*)state);
+
+    s = _mm_xor_si128(s, _mm_loadu_si128(rk));
+    LIBAES_UNROLL
+    for (int round = 1; round < Nr; ++round) {
+        s = _mm_aesenc_si128(s, _mm_loadu_si128(rk + round));
+    }
+    s = _mm_aesenclast_si128(s, _mm_loadu_si128(rk + Nr));
+
+    _mm_storeu_si128((__m128i*)state, s);
+}
+
+template <int Nr>
+LIBAES_TARGET("aes,sse2")
+void decipherBlockNi(byte_t* state, const word_t* keys)
+{
+    const __m128i* rk = (const __m128i*)keys;
+    __m128i s = _mm_loadu_si128((const __m128i*)state);
+
+    s = _mm_xor_si128(s, _mm_loadu_si128(rk));
+    LIBAES_UNROLL
+    for (int round = 1; round < Nr; ++round) {
+        s = _mm_aesdec_si128(s, _mm_loadu_si128(rk + round));
+    }
+    s = _mm_aesdeclast_si128(s, _mm_loadu_si128(rk + Nr));
+
+    _mm_storeu_si128((__m128i*)state, s);
+}
+
+/*
+    aesenc has a latency of several cycles but can start a new one every cycle,
+    so N independent blocks are kept in flight to fill the pipeline
+*/
+template <int N, int Nr>
+LIBAES_TARGET("aes,sse2")
+static inline void cipherInterleavedNi(byte_t* blocks, const __m128i* rk)
+{
+    __m128i* b = (__m128i*)blocks;
+    __m128i s[N];
+
+    __m128i k = _mm_loadu_si128(rk);
+    for (int i = 0; i < N; ++i)
+        s[i] = _mm_xor_si128(_mm_loadu_si128(b + i), k);
+    LIBAES_UNROLL
+    for (int round = 1; round < Nr; ++round) {
+        k = _mm_loadu_si128(rk + round);
+        for (int i = 0; i < N; ++i)
+            s[i] = _mm_aesenc_si128(s[i], k);
+    }
+    k = _mm_loadu_si128(rk + Nr);
+    for (int i = 0; i < N; ++i)
+        _mm_storeu_si128(b + i, _mm_aesenclast_si128(s[i], k));
+}
+
+template <int Nr>
+LIBAES_TARGET("aes,sse2")
+void cipherBlocksNi(byte_t* blocks, unsigned int nBlocks, const word_t* keys)
+{
+    const __m128i* rk = (const __m128i*)keys;
+
+    for (; nBlocks >= 8; nBlocks -= 8, blocks += 8 * 16)
+        cipherInterleavedNi<8, Nr>(blocks, rk);
+    if (nBlocks >= 4) {
+        cipherInterleavedNi<4, Nr>(blocks, rk);
+        nBlocks -= 4;
+        blocks += 4 * 16;
+    }
+    for (; nBlocks > 0; --nBlocks, blocks += 16)
+        cipherInterleavedNi<1, Nr>(blocks, rk);
+}
+
+template <int N, int Nr>
+LIBAES_TARGET("aes,sse2")
+static inline void decipherInterleavedNi(byte_t* blocks, const __m128i* rk)
+{
+    __m128i* b = (__m128i*)blocks;
+    __m128i s[N];
+
+    __m128i k = _mm_loadu_si128(rk);
+    for (int i = 0; i < N; ++i)
+        s[i] = _mm_xor_si128(_mm_loadu_si128(b + i), k);
+    LIBAES_UNROLL
+    for (int round = 1; round < Nr; ++round) {
+        k = _mm_loadu_si128(rk + round);
+        for (int i = 0; i < N; ++i)
+            s[i] = _mm_aesdec_si128(s[i], k);
+    }
+    k = _mm_loadu_si128(rk + Nr);
+    for (int i = 0; i < N; ++i)
+        _mm_storeu_si128(b + i, _mm_aesdeclast_si128(s[i], k));
+}
+
+template <int Nr>
+LIBAES_TARGET("aes,sse2")
+void decipherBlocksNi(byte_t* blocks, unsigned int nBlocks, const word_t* keys)
+{
+    const __m128i* rk = (const __m128i*)keys;
+
+    for (; nBlocks >= 8; nBlocks -= 8, blocks += 8 * 16)
+        decipherInterleavedNi<8, Nr>(blocks, rk);
+    if (nBlocks >= 4) {
+        decipherInterleavedNi<4, Nr>(blocks, rk);
+        nBlocks -= 4;
+        blocks += 4 * 16;
+    }
+    for (; nBlocks > 0; --nBlocks, blocks += 16)
+        decipherInterleavedNi<1, Nr>(blocks, rk);
+}
+
+/*
+    CBC encryption is serial within a message, N messages are interleaved instead
+    Each lane has its own round keys, aesenc reads them straight from memory
+*/
+template <int N, int Nr>
+LIBAES_TARGET("aes,sse2")
+static inline void cbcLanesInterleavedNi(const byte_t* const* dataIn, byte_t* const* dataOut,
+    qword_t* chains, size_t nBlocks, const word_t* const* keys)
+{
+    const __m128i* rk[N];
+    __m128i c[N];
+    for (int i = 0; i < N; ++i) {
+        rk[i] = (const __m128i*)keys[i];
+        c[i] = _mm_loadu_si128((const __m128i*)&chains[i]);
+    }
+
+    for (size_t block = 0; block < nBlocks; ++block)
+    {
+        for (int i = 0; i < N; ++i) {
+            __m128i p = _mm_loadu_si128((const __m128i*)(dataIn[i] + 16 * block));
+            c[i] = _mm_xor_si128(_mm_xor_si128(c[i], p), _mm_loadu_si128(rk[i]));
+        }
+        LIBAES_UNROLL
+        for (int round = 1; round < Nr; ++round) {
+            for (int i = 0; i < N; ++i)
+                c[i] = _mm_aesenc_si128(c[i], _mm_loadu_si128(rk[i] + round));
+        }
+        for (int i = 0; i < N; ++i) {
+            c[i] = _mm_aesenclast_si128(c[i], _mm_loadu_si128(rk[i] + Nr));
+            _mm_storeu_si128((__m128i*)(dataOut[i] + 16 * block), c[i]);
+        }
+    }
+
+    for (int i = 0; i < N; ++i)
+        _mm_storeu_si128((__m128i*)&chains[i], c[i]);
+}
+
+// 8 lanes keep the pipeline full, the rest goes in one smaller group
+template <int Nr>
+LIBAES_TARGET("aes,sse2")
+void cbcLanesNi(unsigned int nLanes, const byte_t* const* dataIn, byte_t* const* dataOut,
+    qword_t* chains, size_t nBlocks, const word_t* const* keys)
+{
+    for (; nLanes >= 8; nLanes -= 8, dataIn += 8, dataOut += 8, chains += 8, keys += 8)
+        cbcLanesInterleavedNi<8, Nr>(dataIn, dataOut, chains, nBlocks, keys);
+
+    switch (nLanes)
+    {
+    case 7:
+        cbcLanesInterleavedNi<7, Nr>(dataIn, dataOut, chains, nBlocks, keys);
+        break;
+    case 6:
+        cbcLanesInterleavedNi<6, Nr>(dataIn, dataOut, chains, nBlocks, keys);
+        break;
+    case 5:
+        cbcLanesInterleavedNi<5, Nr>(dataIn, dataOut, chains, nBlocks, keys);
+        break;
+    case 4:
+        cbcLanesInterleavedNi<4, Nr>(dataIn, dataOut, chains, nBlocks, keys);
+        break;
+    case 3:
+        cbcLanesInterleavedNi<3, Nr>(dataIn, dataOut, chains, nBlocks, keys);
+        break;
+    case 2:
+        cbcLanesInterleavedNi<2, Nr>(dataIn, dataOut, chains, nBlocks, keys);
+        break;
+    case 1:
+        cbcLanesInterleavedNi<1, Nr>(dataIn, dataOut, chains, nBlocks, keys);
+        break;
+    default:
+        break;
+    }
+}
+
+/*
+    XTS, the tweak stays in a register. T.alpha shifts each 64 bits half left by one bit,
+    the bit out of the low half goes in the high one and the bit out of the top
+    is reduced in the low byte (x^128 = x^7 + x^2 + x + 1)
+*/
+LIBAES_TARGET("sse2")
+static inline __m128i xtsDoubleNi(__m128i t)
+{
+    const __m128i poly = _mm_set_epi32(0, 1, 0, 0x87);
+    __m128i carry = _mm_shuffle_epi32(_mm_srai_epi32(t, 31), 0x13); // Top bits of each half
+    return _mm_xor_si128(_mm_add_epi64(t, t), _mm_and_si128(carry, poly));
+}
+
+template <int N, int Nr, bool Decrypt>
+LIBAES_TARGET("aes,sse2")
+static inline void xtsInterleavedNi(__m128i& t, const byte_t* dataIn, byte_t* dataOut,
+    const __m128i* rk)
+{
+    __m128i tweaks[N];
+    __m128i s[N];
+
+    __m128i k = _mm_loadu_si128(rk);
+    for (int i = 0; i < N; ++i) {
+        tweaks[i] = t;
+        t = xtsDoubleNi(t);
+        __m128i in = _mm_loadu_si128((const __m128i*)dataIn + i);
+        s[i] = _mm_xor_si128(_mm_xor_si128(in, tweaks[i]), k);
+    }
+    LIBAES_UNROLL
+    for (int round = 1; round < Nr; ++round) {
+        k = _mm_loadu_si128(rk + round);
+        for (int i = 0; i < N; ++i)
+            s[i] = Decrypt ? _mm_aesdec_si128(s[i], k) : _mm_aesenc_si128(s[i], k);
+    }
+    k = _mm_loadu_si128(rk + Nr);
+    for (int i = 0; i < N; ++i) {
+        s[i] = Decrypt ? _mm_aesdeclast_si128(s[i], k) : _mm_aesenclast_si128(s[i], k);
+        _mm_storeu_si128((__m128i*)dataOut + i, _mm_xor_si128(s[i], tweaks[i]));
+    }
+}
+
+template <int Nr, bool Decrypt>
+LIBAES_TARGET("aes,sse2")
+static inline void xtsBlocksNi(qword_t& tweak, const byte_t* dataIn, byte_t* dataOut,
+    size_t nBlocks, const word_t* keys)
+{
+    const __m128i* rk = (const __m128i*)keys;
+    __m128i t = _mm_loadu_si128((const __m128i*)QWTOCBUF(tweak));
+
+    for (; nBlocks >= 8; nBlocks -= 8, dataIn += 8 * 16, dataOut += 8 * 16)
+        xtsInterleavedNi<8, Nr, Decrypt>(t, dataIn, dataOut, rk);
+    for (; nBlocks > 0; --nBlocks, dataIn += 16, dataOut += 16)
+        xtsInterleavedNi<1, Nr, Decrypt>(t, dataIn, dataOut, rk);
+
+    _mm_storeu_si128((__m128i*)QWTOBUF(tweak), t);
+}
+
+template <int Nr>
+LIBAES_TARGET("aes,sse2")
+void xtsCipherBlocksNi(qword_t& tweak, const byte_t* dataIn, byte_t* dataOut, size_t nBlocks,
+    const word_t* keys)
+{
+    xtsBlocksNi<Nr, false>(tweak, dataIn, dataOut, nBlocks, keys);
+}
+
+template <int Nr>
+LIBAES_TARGET("aes,sse2")
+void xtsDecipherBlocksNi(qword_t& tweak, const byte_t* dataIn, byte_t* dataOut, size_t nBlocks,
+    const word_t* keys)
+{
+    xtsBlocksNi<Nr, true>(tweak, dataIn, dataOut, nBlocks, keys);
+}
+
+/*
+    OCB, the offset and the checksum stay in registers
+    A group of 8 blocks starts on a block number that is 1 mod 8, the ntz of its first 7 blocks
+    are always 0, 1, 0, 2, 0, 1, 0 so only the last block looks up its L_i
+*/
+template <int N, int Nr, bool Decrypt>
+LIBAES_TARGET("aes,sse2")
+static inline void ocbInterleavedNi(const __m128i* offsets, __m128i& checksum,
+    const byte_t* dataIn, byte_t* dataOut, const __m128i* rk)
+{
+    __m128i s[N];
+
+    __m128i k = _mm_loadu_si128(rk);
+    for (int i = 0; i < N; ++i) {
+        __m128i in = _mm_loadu_si128((const __m128i*)dataIn + i);
+        if (!Decrypt)
+            checksum = _mm_xor_si128(checksum, in);
+        s[i] = _mm_xor_si128(_mm_xor_si128(in, offsets[i]), k);
+    }
+    LIBAES_UNROLL
+    for (int round = 1; round < Nr; ++round) {
+        k = _mm_loadu_si128(rk + round);
+        for (int i = 0; i < N; ++i)
+            s[i] = Decrypt ? _mm_aesdec_si128(s[i], k) : _mm_aesenc_si128(s[i], k);
+    }
+    k = _mm_loadu_si128(rk + Nr);
+    for (int i = 0; i < N; ++i) {
+        s[i] = Decrypt ? _mm_aesdeclast_si128(s[i], k) : _mm_aesenclast_si128(s[i], k);
+        __m128i out = _mm_xor_si128(s[i], offsets[i]);
+        if (Decrypt)
+            checksum = _mm_xor_si128(checksum, out);
+        _mm_storeu_si128((__m128i*)dataOut + i, out);
+    }
+}
+
+template <int Nr, bool Decrypt>
+LIBAES_TARGET("aes,sse2")
+static inline void ocbBlocksNi(qword_t& offset, qword_t& checksum, uint64_t blockIndex,
+    const qword_t* L, const byte_t* dataIn, byte_t* dataOut, size_t nBlocks, const word_t* keys)
+{
+    const __m128i* rk = (const __m128i*)keys;
+    __m128i o = _mm_loadu_si128((const __m128i*)QWTOCBUF(offset));
+    __m128i sum = _mm_loadu_si128((const __m128i*)QWTOCBUF(checksum));
+    __m128i offsets[8];
+
+    // One block at a time up to the start of a group
+    for (; nBlocks > 0 && blockIndex % 8 != 0; --nBlocks, dataIn += 16, dataOut += 16) {
+        o = _mm_xor_si128(o, _mm_loadu_si128((const __m128i*)QWTOCBUF(L[ocbNtz(++blockIndex)])));
+        offsets[0] = o;
+        ocbInterleavedNi<1, Nr, Decrypt>(offsets, sum, dataIn, dataOut, rk);
+    }
+
+    const __m128i l0 = _mm_loadu_si128((const __m128i*)QWTOCBUF(L[0]));
+    const __m128i l1 = _mm_loadu_si128((const __m128i*)QWTOCBUF(L[1]));
+    const __m128i l2 = _mm_loadu_si128((const __m128i*)QWTOCBUF(L[2]));
+    for (; nBlocks >= 8; nBlocks -= 8, dataIn += 8 * 16, dataOut += 8 * 16) {
+        offsets[0] = _mm_xor_si128(o, l0);
+        offsets[1] = _mm_xor_si128(offsets[0], l1);
+        offsets[2] = _mm_xor_si128(offsets[1], l0);
+        offsets[3] = _mm_xor_si128(offsets[2], l2);
+        offsets[4] = _mm_xor_si128(offsets[3], l0);
+        offsets[5] = _mm_xor_si128(offsets[4], l1);
+        offsets[6] = _mm_xor_si128(offsets[5], l0);
+        blockIndex += 8;
+        o = _mm_xor_si128(offsets[6],
+            _mm_loadu_si128((const __m128i*)QWTOCBUF(L[ocbNtz(blockIndex)])));
+        offsets[7] = o;
+        ocbInterleavedNi<8, Nr, Decrypt>(offsets, sum, dataIn, dataOut, rk);
+    }
+
+    for (; nBlocks > 0; --nBlocks, dataIn += 16, dataOut += 16) {
+        o = _mm_xor_si128(o, _mm_loadu_si128((const __m128i*)QWTOCBUF(L[ocbNtz(++blockIndex)])));
+        offsets[0] = o;
+        ocbInterleavedNi<1, Nr, Decrypt>(offsets, sum, dataIn, dataOut, rk);
+    }
+
+    _mm_storeu_si128((__m128i*)QWTOBUF(offset), o);
+    _mm_storeu_si128((__m128i*)QWTOBUF(checksum), sum);
+}
+
+template <int Nr>
+LIBAES_TARGET("aes,sse2")
+void ocbCipherBlocksNi(qword_t& offset, qword_t& checksum, uint64_t blockIndex, const qword_t* L,
+    const byte_t* dataIn, byte_t* dataOut, size_t nBlocks, const word_t* keys)
+{
+    ocbBlocksNi<Nr, false>(offset, checksum, blockIndex, L, dataIn, dataOut, nBlocks, keys);
+}
+
+template <int Nr>
+LIBAES_TARGET("aes,sse2")
+void ocbDecipherBlocksNi(qword_t& offset, qword_t& checksum, uint64_t blockIndex, const qword_t* L,
+    const byte_t* dataIn, byte_t* dataOut, size_t nBlocks, const word_t* keys)
+{
+    ocbBlocksNi<Nr, true>(offset, checksum, blockIndex, L, dataIn, dataOut, nBlocks, keys);
+}
+
+INSTANTIATE_ENGINE_EXPAND_KEY(keyExpansionNi)
+INSTANTIATE_ENGINE_PREPARE_KEYS(prepareKeysNi)
+INSTANTIATE_ENGINE_BLOCK(cipherBlockNi)
+INSTANTIATE_ENGINE_BLOCK(decipherBlockNi)
+INSTANTIATE_ENGINE_BLOCKS(cipherBlocksNi)
+INSTANTIATE_ENGINE_BLOCKS(decipherBlocksNi)
+INSTANTIATE_ENGINE_CBC_LANES(cbcLanesNi)
+INSTANTIATE_ENGINE_XTS_BLOCKS(xtsCipherBlocksNi)
+INSTANTIATE_ENGINE_XTS_BLOCKS(xtsDecipherBlocksNi)
+INSTANTIATE_ENGINE_OCB_BLOCKS(ocbCipherBlocksNi)
+INSTANTIATE_ENGINE_OCB_BLOCKS(ocbDecipherBlocksNi)
+
+} // namespace AES
+
+#endif
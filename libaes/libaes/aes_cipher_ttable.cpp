@@ -0,0 +1,159 @@
+#include <cstring>
+
+#include <libaes/types.hpp>
+#include <libaes/aes_cipher.hpp>
+#include <libaes/aes_engine.hpp>
+
+/*
+    T-table engine
+    The state is kept as 4 column words, in the same big endian form as the key schedule,
+    each round is 16 table lookups and the round key xor
+    https://csrc.nist.gov/csrc/media/projects/cryptographic-standards-and-guidelines/documents/aes-development/rijndael-ammended.pdf (5.2.1)
+*/
+
+#define BYTE(w, n) (((w) >> (24 - 8 * (n))) & 0xff)
+
+namespace AES
+{
+
+static inline word_t loadWord(const byte_t* b)
+{
+    return ((word_t)b[0] << 24) | ((word_t)b[1] << 16) | ((word_t)b[2] << 8) | (word_t)b[3];
+}
+
+static inline void storeWord(word_t w, byte_t* b)
+{
+    b[0] = (byte_t)(w >> 24);
+    b[1] = (byte_t)(w >> 16);
+    b[2] = (byte_t)(w >> 8);
+    b[3] = (byte_t)w;
+}
+
+// MixColumns^-1 of a key word, Td tables include InvSubBytes so cancel it with SubBytes first
+static inline word_t invMixColumnWord(word_t w)
+{
+    const byte_t* S = LOOKUPS::SBOX;
+    return LOOKUPS::TD0[S[BYTE(w, 0)]] ^ LOOKUPS::TD1[S[BYTE(w, 1)]]
+        ^ LOOKUPS::TD2[S[BYTE(w, 2)]] ^ LOOKUPS::TD3[S[BYTE(w, 3)]];
+}
+
+/*
+    Encryption uses the key schedule as is
+    Decryption uses the equivalent inverse cipher: round keys in reverse order,
+    with InvMixColumns applied on the middle ones
+*/
+template <int Nr>
+void prepareKeysTTable(const word_t* ksch, word_t* encKeys, word_t* decKeys)
+{
+    memcpy(encKeys, ksch, 4 * (Nr + 1) * sizeof(word_t));
+
+    for (int i = 0; i < 4; ++i) {
+        decKeys[i] = ksch[4 * Nr + i];
+        decKeys[4 * Nr + i] = ksch[i];
+    }
+    for (int round = 1; round < Nr; ++round) {
+        for (int i = 0; i < 4; ++i) {
+            decKeys[4 * round + i] = invMixColumnWord(ksch[4 * (Nr - round) + i]);
+        }
+    }
+}
+
+template <int Nr>
+void cipherBlockTTable(byte_t* state, const word_t* keys)
+{
+    const word_t* TE0 = LOOKUPS::TE0;
+    const word_t* TE1 = LOOKUPS::TE1;
+    const word_t* TE2 = LOOKUPS::TE2;
+    const word_t* TE3 = LOOKUPS::TE3;
+    const byte_t* S = LOOKUPS::SBOX;
+    const word_t* rk = keys;
+
+    word_t s0 = loadWord(state) ^ rk[0];
+    word_t s1 = loadWord(state + 4) ^ rk[1];
+    word_t s2 = loadWord(state + 8) ^ rk[2];
+    word_t s3 = loadWord(state + 12) ^ rk[3];
+    word_t t0, t1, t2, t3;
+
+    LIBAES_UNROLL
+    for (int round = 1; round < Nr; ++round) {
+        rk += 4;
+        t0 = TE0[BYTE(s0, 0)] ^ TE1[BYTE(s1, 1)] ^ TE2[BYTE(s2, 2)] ^ TE3[BYTE(s3, 3)] ^ rk[0];
+        t1 = TE0[BYTE(s1, 0)] ^ TE1[BYTE(s2, 1)] ^ TE2[BYTE(s3, 2)] ^ TE3[BYTE(s0, 3)] ^ rk[1];
+        t2 = TE0[BYTE(s2, 0)] ^ TE1[BYTE(s3, 1)] ^ TE2[BYTE(s0, 2)] ^ TE3[BYTE(s1, 3)] ^ rk[2];
+        t3 = TE0[BYTE(s3, 0)] ^ TE1[BYTE(s0, 1)] ^ TE2[BYTE(s1, 2)] ^ TE3[BYTE(s2, 3)] ^ rk[3];
+        s0 = t0;
+        s1 = t1;
+        s2 = t2;
+        s3 = t3;
+    }
+
+    // Last round, no MixColumns
+    rk += 4;
+    t0 = ((word_t)S[BYTE(s0, 0)] << 24) | ((word_t)S[BYTE(s1, 1)] << 16)
+        | ((word_t)S[BYTE(s2, 2)] << 8) | (word_t)S[BYTE(s3, 3)];
+    t1 = ((word_t)S[BYTE(s1, 0)] << 24) | ((word_t)S[BYTE(s2, 1)] << 16)
+        | ((word_t)S[BYTE(s3, 2)] << 8) | (word_t)S[BYTE(s0, 3)];
+    t2 = ((word_t)S[BYTE(s2, 0)] << 24) | ((word_t)S[BYTE(s3, 1)] << 16)
+        | ((word_t)S[BYTE(s0, 2)] << 8) | (word_t)S[BYTE(s1, 3)];
+    t3 = ((word_t)S[BYTE(s3, 0)] << 24) | ((word_t)S[BYTE(s0, 1)] << 16)
+        | ((word_t)S[BYTE(s1, 2)] << 8) | (word_t)S[BYTE(s2, 3)];
+
+    storeWord(t0 ^ rk[0], state);
+    storeWord(t1 ^ rk[1], state + 4);
+    storeWord(t2 ^ rk[2], state + 8);
+    storeWord(t3 ^ rk[3], state + 12);
+}
+
+template <int Nr>
+void decipherBlockTTable(byte_t* state, const word_t* keys)
+{
+    const word_t* TD0 = LOOKUPS::TD0;
+    const word_t* TD1 = LOOKUPS::TD1;
+    const word_t* TD2 = LOOKUPS::TD2;
+    const word_t* TD3 = LOOKUPS::TD3;
+    const byte_t* IS = LOOKUPS::INV_SBOX;
+    const word_t* rk = keys;
+
+    word_t s0 = loadWord(state) ^ rk[0];
+    word_t s1 = loadWord(state + 4) ^ rk[1];
+    word_t s2 = loadWord(state + 8) ^ rk[2];
+    word_t s3 = loadWord(state + 12) ^ rk[3];
+    word_t t0, t1, t2, t3;
+
+    LIBAES_UNROLL
+    for (int round = 1; round < Nr; ++round) {
+        rk += 4;
+        t0 = TD0[BYTE(s0, 0)] ^ TD1[BYTE(s3, 1)] ^ TD2[BYTE(s2, 2)] ^ TD3[BYTE(s1, 3)] ^ rk[0];
+        t1 = TD0[BYTE(s1, 0)] ^ TD1[BYTE(s0, 1)] ^ TD2[BYTE(s3, 2)] ^ TD3[BYTE(s2, 3)] ^ rk[1];
+        t2 = TD0[BYTE(s2, 0)] ^ TD1[BYTE(s1, 1)] ^ TD2[BYTE(s0, 2)] ^ TD3[BYTE(s3, 3)] ^ rk[2];
+        t3 = TD0[BYTE(s3, 0)] ^ TD1[BYTE(s2, 1)] ^ TD2[BYTE(s1, 2)] ^ TD3[BYTE(s0, 3)] ^ rk[3];
+        s0 = t0;
+        s1 = t1;
+        s2 = t2;
+        s3 = t3;
+    }
+
+    // Last round, no InvMixColumns
+    rk += 4;
+    t0 = ((word_t)IS[BYTE(s0, 0)] << 24) | ((word_t)IS[BYTE(s3, 1)] << 16)
+        | ((word_t)IS[BYTE(s2, 2)] << 8) | (word_t)IS[BYTE(s1, 3)];
+    t1 = ((word_t)IS[BYTE(s1, 0)] << 24) | ((word_t)IS[BYTE(s0, 1)] << 16)
+        | ((word_t)IS[BYTE(s3, 2)] << 8) | (word_t)IS[BYTE(s2, 3)];
+    t2 = ((word_t)IS[BYTE(s2, 0)] << 24) | ((word_t)IS[BYTE(s1, 1)] << 16)
+        | ((word_t)IS[BYTE(s0, 2)] << 8) | (word_t)IS[BYTE(s3, 3)];
+    t3 = ((word_t)IS[BYTE(s3, 0)] << 24) | ((word_t)IS[BYTE(s2, 1)] << 16)
+        | ((word_t)IS[BYTE(s1, 2)] << 8) | (word_t)IS[BYTE(s0, 3)];
+
+    storeWord(t0 ^ rk[0], state);
+    storeWord(t1 ^ rk[1], state + 4);
+    storeWord(t2 ^ rk[2], state + 8);
+    storeWord(t3 ^ rk[3], state + 12);
+}
+
+INSTANTIATE_ENGINE_PREPARE_KEYS(prepareKeysTTable)
+INSTANTIATE_ENGINE_BLOCK(cipherBlockTTable)
+INSTANTIATE_ENGINE_BLOCK(decipherBlockTTable)
+
+} // namespace AES
+
+#undef BYTE
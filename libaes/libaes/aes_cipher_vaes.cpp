@@ -0,0 +1,275 @@
+#include <libaes/types.hpp>
+#include <libaes/aes_engine.hpp>
+#include <libaes/aes_mode.hpp>
+#include <libaes/cpu_features.hpp>
+
+#if defined(LIBAES_X86)
+
+// GCC 12 warns on the undefined source operand inside the AVX-512 intrinsics (GCC bug 105593)
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+#include <immintrin.h>
+
+/*
+    VAES engine, counter mode on 512 bits (4 blocks) or 256 bits (2 blocks) vectors
+    Round keys are the AES-NI ones, broadcast to every 128 bits lane
+
+    Counter blocks are kept byte reversed, one little endian 128 bits integer per lane,
+    so the next ones are a single vector add: 32 bits adds wrap like inc32 in GCM,
+    64 bits adds give CTR as long as the low 64 bits don't wrap, see ctrBlocksVaes
+    The GCM-SIV counter already is little endian: 32 bits adds, blocks are not reversed back
+*/
+
+namespace AES
+{
+
+#define VAES512_TARGET LIBAES_TARGET("vaes,avx512f,avx512bw,avx2,avx,aes,sse4.1,ssse3,sse2")
+#define VAES256_TARGET LIBAES_TARGET("vaes,avx2,avx,aes,sse4.1,ssse3,sse2")
+
+static const unsigned int VAES_STATES = 8; // Vectors in flight, 32 or 16 blocks
+
+/*****************************
+ * 512 bits
+ ****************************/
+template <bool Inc32>
+VAES512_TARGET
+static inline __m512i add512(__m512i a, __m512i b)
+{
+    return Inc32 ? _mm512_add_epi32(a, b) : _mm512_add_epi64(a, b);
+}
+
+template <int N, int Nr>
+VAES512_TARGET
+static inline void cipherWide512(__m512i* s, const __m512i* rk)
+{
+    for (int i = 0; i < N; ++i)
+        s[i] = _mm512_xor_si512(s[i], rk[0]);
+    LIBAES_UNROLL
+    for (int round = 1; round < Nr; ++round) {
+        for (int i = 0; i < N; ++i)
+            s[i] = _mm512_aesenc_epi128(s[i], rk[round]);
+    }
+    for (int i = 0; i < N; ++i)
+        s[i] = _mm512_aesenclast_epi128(s[i], rk[Nr]);
+}
+
+template <bool Reversed>
+VAES512_TARGET
+static inline __m512i toBlocks512(__m512i ctr, __m512i reverse)
+{
+    return Reversed ? _mm512_shuffle_epi8(ctr, reverse) : ctr;
+}
+
+// counter is byte reversed (or GCM-SIV), nBlocks from it without carry out of the added lane
+template <bool Inc32, bool Reversed, int Nr>
+VAES512_TARGET
+static void ctrRun512(__m128i counter, const byte_t* dataIn, byte_t* dataOut, size_t nBlocks,
+    const word_t* keys)
+{
+    const __m512i reverse = _mm512_broadcast_i32x4(
+        _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+    const __m512i four = _mm512_set_epi64(0, 4, 0, 4, 0, 4, 0, 4);
+
+    __m512i rk[Nr + 1];
+    for (int i = 0; i <= Nr; ++i)
+        rk[i] = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i*)keys + i));
+
+    __m512i ctr = add512<Inc32>(_mm512_broadcast_i32x4(counter),
+        _mm512_set_epi64(0, 3, 0, 2, 0, 1, 0, 0));
+
+    for (; nBlocks >= 4 * VAES_STATES; nBlocks -= 4 * VAES_STATES) {
+        __m512i s[VAES_STATES];
+        for (unsigned int i = 0; i < VAES_STATES; ++i) {
+            s[i] = toBlocks512<Reversed>(ctr, reverse);
+            ctr = add512<Inc32>(ctr, four);
+        }
+        cipherWide512<VAES_STATES, Nr>(s, rk);
+        for (unsigned int i = 0; i < VAES_STATES; ++i) {
+            __m512i in = _mm512_loadu_si512((const void*)(dataIn + 64 * i));
+            _mm512_storeu_si512((void*)(dataOut + 64 * i), _mm512_xor_si512(in, s[i]));
+        }
+        dataIn += 64 * VAES_STATES;
+        dataOut += 64 * VAES_STATES;
+    }
+
+    for (; nBlocks >= 4; nBlocks -= 4) {
+        __m512i s = toBlocks512<Reversed>(ctr, reverse);
+        ctr = add512<Inc32>(ctr, four);
+        cipherWide512<1, Nr>(&s, rk);
+        __m512i in = _mm512_loadu_si512((const void*)dataIn);
+        _mm512_storeu_si512((void*)dataOut, _mm512_xor_si512(in, s));
+        dataIn += 64;
+        dataOut += 64;
+    }
+
+    // 1 to 3 blocks, masked bytes are neither read nor written
+    if (nBlocks > 0) {
+        __mmask64 mask = ((__mmask64)1 << (16 * nBlocks)) - 1;
+        __m512i s = toBlocks512<Reversed>(ctr, reverse);
+        cipherWide512<1, Nr>(&s, rk);
+        __m512i in = _mm512_maskz_loadu_epi8(mask, dataIn);
+        _mm512_mask_storeu_epi8(dataOut, mask, _mm512_xor_si512(in, s));
+    }
+}
+
+/*****************************
+ * 256 bits
+ ****************************/
+template <bool Inc32>
+VAES256_TARGET
+static inline __m256i add256(__m256i a, __m256i b)
+{
+    return Inc32 ? _mm256_add_epi32(a, b) : _mm256_add_epi64(a, b);
+}
+
+template <int N, int Nr>
+VAES256_TARGET
+static inline void cipherWide256(__m256i* s, const __m256i* rk)
+{
+    for (int i = 0; i < N; ++i)
+        s[i] = _mm256_xor_si256(s[i], rk[0]);
+    LIBAES_UNROLL
+    for (int round = 1; round < Nr; ++round) {
+        for (int i = 0; i < N; ++i)
+            s[i] = _mm256_aesenc_epi128(s[i], rk[round]);
+    }
+    for (int i = 0; i < N; ++i)
+        s[i] = _mm256_aesenclast_epi128(s[i], rk[Nr]);
+}
+
+template <bool Reversed>
+VAES256_TARGET
+static inline __m256i toBlocks256(__m256i ctr, __m256i reverse)
+{
+    return Reversed ? _mm256_shuffle_epi8(ctr, reverse) : ctr;
+}
+
+template <bool Inc32, bool Reversed, int Nr>
+VAES256_TARGET
+static void ctrRun256(__m128i counter, const byte_t* dataIn, byte_t* dataOut, size_t nBlocks,
+    const word_t* keys)
+{
+    const __m256i reverse = _mm256_broadcastsi128_si256(
+        _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+    const __m256i two = _mm256_set_epi64x(0, 2, 0, 2);
+
+    __m256i rk[Nr + 1];
+    for (int i = 0; i <= Nr; ++i)
+        rk[i] = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)keys + i));
+
+    __m256i ctr = add256<Inc32>(_mm256_broadcastsi128_si256(counter),
+        _mm256_set_epi64x(0, 1, 0, 0));
+
+    for (; nBlocks >= 2 * VAES_STATES; nBlocks -= 2 * VAES_STATES) {
+        __m256i s[VAES_STATES];
+        for (unsigned int i = 0; i < VAES_STATES; ++i) {
+            s[i] = toBlocks256<Reversed>(ctr, reverse);
+            ctr = add256<Inc32>(ctr, two);
+        }
+        cipherWide256<VAES_STATES, Nr>(s, rk);
+        for (unsigned int i = 0; i < VAES_STATES; ++i) {
+            __m256i in = _mm256_loadu_si256((const __m256i*)(dataIn + 32 * i));
+            _mm256_storeu_si256((__m256i*)(dataOut + 32 * i), _mm256_xor_si256(in, s[i]));
+        }
+        dataIn += 32 * VAES_STATES;
+        dataOut += 32 * VAES_STATES;
+    }
+
+    for (; nBlocks >= 2; nBlocks -= 2) {
+        __m256i s = toBlocks256<Reversed>(ctr, reverse);
+        ctr = add256<Inc32>(ctr, two);
+        cipherWide256<1, Nr>(&s, rk);
+        __m256i in = _mm256_loadu_si256((const __m256i*)dataIn);
+        _mm256_storeu_si256((__m256i*)dataOut, _mm256_xor_si256(in, s));
+        dataIn += 32;
+        dataOut += 32;
+    }
+
+    // Last block, only the low lane is used
+    if (nBlocks > 0) {
+        __m256i s = toBlocks256<Reversed>(ctr, reverse);
+        cipherWide256<1, Nr>(&s, rk);
+        __m128i in = _mm_loadu_si128((const __m128i*)dataIn);
+        _mm_storeu_si128((__m128i*)dataOut, _mm_xor_si128(in, _mm256_castsi256_si128(s)));
+    }
+}
+
+/*****************************
+ * Counter mode
+ ****************************/
+typedef void (*ctrRunFunc_t)(__m128i counter, const byte_t* dataIn, byte_t* dataOut,
+    size_t nBlocks, const word_t* keys);
+
+LIBAES_TARGET("ssse3,sse2")
+static inline __m128i loadReversed(const qword_t& counter)
+{
+    const __m128i reverse = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    return _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)QWTOCBUF(counter)), reverse);
+}
+
+/*
+    CTR lanes only add on the low 64 bits: the blocks are split where they wrap,
+    ctrAdd carries into the high 64 bits between the runs
+*/
+static void ctrBlocksVaes(ctrRunFunc_t runInc32, ctrRunFunc_t runInc64, ctrRunFunc_t runSiv,
+    qword_t& counter, int incBytes, const byte_t* dataIn, byte_t* dataOut, size_t nBlocks,
+    const word_t* keys)
+{
+    if (incBytes == SIV_INC_BYTES) {
+        runSiv(_mm_loadu_si128((const __m128i*)QWTOCBUF(counter)), dataIn, dataOut, nBlocks,
+            keys);
+        ctrAdd(counter, incBytes, nBlocks);
+        return;
+    }
+
+    while (nBlocks > 0)
+    {
+        size_t n = nBlocks;
+        if (incBytes != 4) {
+            uint64_t lo = 0;
+            for (int i = 8; i < 16; ++i)
+                lo = (lo << 8) | counter.b[i];
+            uint64_t beforeWrap = (uint64_t)0 - lo; // 2^64 - lo, 0 means lo = 0, no wrap
+            if (beforeWrap != 0 && beforeWrap < n)
+                n = (size_t)beforeWrap;
+        }
+
+        if (incBytes == 4)
+            runInc32(loadReversed(counter), dataIn, dataOut, n, keys);
+        else
+            runInc64(loadReversed(counter), dataIn, dataOut, n, keys);
+        ctrAdd(counter, incBytes, n);
+
+        dataIn += 16 * n;
+        dataOut += 16 * n;
+        nBlocks -= n;
+    }
+}
+
+template <int Nr>
+void ctrBlocksVaes512(qword_t& counter, int incBytes, const byte_t* dataIn, byte_t* dataOut,
+    size_t nBlocks, const word_t* keys)
+{
+    ctrBlocksVaes(ctrRun512<true, true, Nr>, ctrRun512<false, true, Nr>,
+        ctrRun512<true, false, Nr>, counter, incBytes, dataIn, dataOut, nBlocks, keys);
+}
+
+template <int Nr>
+void ctrBlocksVaes256(qword_t& counter, int incBytes, const byte_t* dataIn, byte_t* dataOut,
+    size_t nBlocks, const word_t* keys)
+{
+    ctrBlocksVaes(ctrRun256<true, true, Nr>, ctrRun256<false, true, Nr>,
+        ctrRun256<true, false, Nr>, counter, incBytes, dataIn, dataOut, nBlocks, keys);
+}
+
+INSTANTIATE_ENGINE_CTR_BLOCKS(ctrBlocksVaes512)
+INSTANTIATE_ENGINE_CTR_BLOCKS(ctrBlocksVaes256)
+
+#undef VAES512_TARGET
+#undef VAES256_TARGET
+
+} // namespace AES
+
+#endif
@@ -1,20 +1,44 @@
+#include <cstring>
 #include <string>
 #include <memory>
+#include <thread>
 
 #include <libaes/types_helper.hpp>
 #include <libaes/libaes.hpp>
-#include <libaes/aes_cipher.hpp>
+#include <libaes/aes_engine.hpp>
+#include <libaes/aes_ghash.hpp>
+#include <libaes/aes_mode.hpp>
+#include <libaes/thread_pool.hpp>
+#include <libaes/aes_stats.hpp>
 
 #include <utility/logs.hpp>
 
 namespace AES
 {
 
+AES::~AES()
+{
+    delete ghashKey;
+    delete ocbKey;
+    delete sivKeys;
+    delete threadPool;
+}
+
 bool AES::initialize(KEY_SIZE pKeySize, MODE pMode, bool pPadding, const byte_t* pKey)
 {
+    this->hasInit = false;
+    this->stream.started = false;
     if (pKey == nullptr)
         return false;
 
+    this->ghashEngine = getGhashEngine(this->ghashId);
+    if (this->ghashEngine == nullptr)
+        return false;
+    this->modeKernels = AES::getModeKernels(pMode);
+    if (this->modeKernels == nullptr)
+        return false;
+
+    // The key size picks the specialized key expansion and round functions once here
     this->mode = pMode;
     switch (pKeySize)
     {
@@ -36,90 +60,231 @@ bool AES::initialize(KEY_SIZE pKeySize, MODE pMode, bool pPadding, const byte_t*
         break;
     }
 
-    if (!pPadding) {
+    this->engine = getEngine(this->engineId, this->Nr);
+    if (this->engine == nullptr)
+        return false;
+    if (pMode == MODE::XTS && pKeySize == KEY_SIZE::S192) // Not defined by IEEE 1619
+        return false;
+    if (pMode == MODE::GCM_SIV && pKeySize == KEY_SIZE::S192) // Nor by RFC 8452
+        return false;
+
+    // XTS keeps the data size, there is no room for padding
+    if (!pPadding || pMode == MODE::XTS) {
         this->padding = PADDING::NONE;
     }
     else {
         this->padding = PADDING::PKCS7;
     }
 
-    this->key = new byte_t[this->keySize];
-    if (this->key == nullptr)
-        return false;
-    memcpy(this->key, pKey, this->keySize);
+    const int nKeys = this->mode == MODE::XTS ? 2 : 1;
+    memcpy(this->key, pKey, nKeys * this->keySize);
 
+    {
+        StatsScope stats(STAGE::KEY_EXPANSION, nKeys * this->keySize, nKeys * (this->Nr + 1));
+        this->keySchedule.len = this->Nb * (this->Nr + 1);
+        this->engine->expandKey(this->key, this->keySchedule.keys);
+        this->engine->prepareKeys(this->keySchedule.keys, this->keySchedule.encKeys,
+            this->keySchedule.decKeys);
+        if (this->mode == MODE::XTS) {
+            this->tweakSchedule.len = this->keySchedule.len;
+            this->engine->expandKey(this->key + this->keySize, this->tweakSchedule.keys);
+            this->engine->prepareKeys(this->tweakSchedule.keys, this->tweakSchedule.encKeys,
+                this->tweakSchedule.decKeys);
+        }
+    }
 
-    this->keySchedule.len = this->Nb * (this->Nr + 1);
-    this->keySchedule.keys = new word_t[this->keySchedule.len];
-    if (this->keySchedule.keys == nullptr)
-        return false;
+    // Only allocated by the first GCM key
+    if (this->mode == MODE::GCM) {
+        if (this->ghashKey == nullptr)
+            this->ghashKey = new GhashKey;
+        this->prepareGhash();
+    }
 
-    keyExpansion(this->key, this->keySchedule.keys, this->keySchedule.len, this->Nk);
+    // Same for the OCB L table, L_* = E(0^128) and its doublings
+    if (this->mode == MODE::OCB) {
+        if (this->ocbKey == nullptr)
+            this->ocbKey = new OcbKey;
+        ocbInitKey(this->engine, this->keySchedule.encKeys, *this->ocbKey);
+    }
+
+    // GCM-SIV message keys depend on the nonce, they are derived by setIv
+    if (this->mode == MODE::GCM_SIV && this->sivKeys == nullptr)
+        this->sivKeys = new SivKeys;
 
+    // iv and aad belong to the previous key
     this->ivSize = 0;
     this->aadSize = 0;
-    this->iv = nullptr;
-    this->aad = nullptr;
+    qwordZero(this->aadHash);
 
     this->hasInit = true;
 
     return true;
 }
 
+/*
+    Can be called before or after initialize, the engine keys are rebuilt if needed
+*/
+bool AES::setEngine(ENGINE pEngine)
+{
+    if (!AES::isEngineSupported(pEngine))
+        return false;
+
+    this->engineId = pEngine;
+    if (this->hasInit) {
+        this->engine = getEngine(pEngine, this->Nr);
+        this->engine->prepareKeys(this->keySchedule.keys, this->keySchedule.encKeys,
+            this->keySchedule.decKeys);
+        if (this->mode == MODE::XTS) {
+            this->engine->prepareKeys(this->tweakSchedule.keys, this->tweakSchedule.encKeys,
+                this->tweakSchedule.decKeys);
+        }
+        if (this->mode == MODE::GCM_SIV && this->ivSize != 0)
+            this->prepareSiv();
+    }
+    return true;
+}
+
+bool AES::setGhash(GHASH pGhash)
+{
+    const GhashEngine* newEngine = getGhashEngine(pGhash);
+    if (newEngine == nullptr)
+        return false;
+
+    this->ghashId = pGhash;
+    if (this->hasInit) {
+        this->ghashEngine = newEngine;
+        if (this->mode == MODE::GCM)
+            this->prepareGhash();
+        if (this->mode == MODE::GCM_SIV && this->ivSize != 0)
+            this->prepareSiv();
+    }
+    return true;
+}
+
+/*
+    Number of threads used by the parallel modes (ECB, CBC decrypt, CTR, GCM, XTS sectors, OCB,
+    GCM-SIV), 0 = all cores
+    Can be called before or after initialize, threads are started here and reused by every call
+*/
+bool AES::setThreads(unsigned int pThreads)
+{
+    if (pThreads == 0)
+        pThreads = std::thread::hardware_concurrency();
+    if (pThreads == 0) // Unknown
+        pThreads = 1;
+
+    if (pThreads != this->threads) {
+        delete this->threadPool;
+        this->threadPool = nullptr;
+        if (pThreads > 1)
+            this->threadPool = new ThreadPool(pThreads);
+        this->threads = pThreads;
+    }
+    return true;
+}
+
+/*
+    H = CIPH(0^128) only depends on the key, GHASH engine tables are built once here
+    so each GCM message under the same key starts hashing right away
+*/
+void AES::prepareGhash()
+{
+    StatsScope stats(STAGE::GHASH_KEY, AES::BLOCKSIZE, 1);
+    qword_t H = QWORD_STATIC_ZERO;
+
+    this->engine->cipherBlock(QWTOBUF(H), this->keySchedule.encKeys);
+    this->ghashEngine->init(*this->ghashKey, H);
+}
+
+/*
+    GCM-SIV message keys of the nonce in iv, derived again when the engines change
+    The POLYVAL of the aad doesn't depend on the engines, it is kept
+*/
+void AES::prepareSiv()
+{
+    sivDeriveKeys(this->engine, this->ghashEngine, this->keySchedule.encKeys, this->Nk,
+        this->iv, *this->sivKeys);
+}
+
 /*
     Round block size to be 128 x m so we already have the full buffer for gcm
-    Other mode will stay unchanged, and ivSize has the REAL size of the iv, not the full buffer
+    OCB takes its nonce as is, other modes need a full block,
+    and ivSize has the REAL size of the iv, not the full buffer
+    GCM-SIV derives the keys of the nonce here, the aad hashed with the previous ones is dropped
 */
 bool AES::setIv(const byte_t* pIv, int pIvSize)
 {
-    if (!this->hasInit)
+    if (!this->hasInit || pIv == nullptr)
         return false;
     if (this->mode == MODE::GCM && !this->isGcmIvSizeValid(pIvSize))
         return false;
-
-    this->iv = new byte_t[this->getBlockRoundedSize(pIvSize)];
-    if (this->iv == nullptr)
+    if (this->mode == MODE::OCB && !this->isOcbIvSizeValid(pIvSize))
+        return false;
+    if (this->mode == MODE::GCM_SIV && pIvSize != AES::SIV_NONCE_SIZE)
+        return false;
+    if (this->mode != MODE::GCM && this->mode != MODE::OCB && this->mode != MODE::GCM_SIV
+        && pIvSize != AES::BLOCKSIZE)
         return false;
+
     this->ivSize = pIvSize;
     memcpy(this->iv, pIv, pIvSize);
 
     if (this->mode == MODE::GCM) {
-        unsigned int roundedSize = this->getBlockRoundedSize(this->ivSize);
+        size_t roundedSize = this->getBlockRoundedSize(this->ivSize);
         if (roundedSize != this->ivSize)
             memset(this->iv + this->ivSize, 0, roundedSize - this->ivSize);
     }
+    else if (this->mode == MODE::GCM_SIV) {
+        this->prepareSiv();
+        this->aadSize = 0;
+        qwordZero(this->aadHash);
+    }
 
     return true;
 }
 
 /*
-    Round block size to be 128 x m so we already have the full buffer for gcm
+    The aad is hashed here, zero padded to a multiple of 128 bits, and not kept
+    Every GCM message under this aad starts hashing from the result
+    OCB keeps HASH(K, A) instead, it only depends on the key and the aad
+    GCM-SIV hashes it with the POLYVAL key of the nonce, so the iv must be set first
 */
 bool AES::setAad(const byte_t* pAad, int pAadSize)
 {
-    if (!this->hasInit)
+    if (!this->hasInit || pAadSize < 0)
         return false;
 
     if (this->mode == MODE::GCM) {
-        if (pAad == nullptr || pAadSize == 0) { // Empty aad
-            this->aadSize = 0;
-            this->aad = nullptr;
-        }
-        else {
-            this->aadSize = pAadSize;
-            unsigned int roundedSize = this->getBlockRoundedSize(this->aadSize);
-            this->aad = new byte_t[roundedSize];
-            if (this->aad == nullptr)
-                return false;
-            memcpy(this->aad, pAad, this->aadSize);
-            if (roundedSize != this->aadSize)
-                memset(this->aad + this->aadSize, 0, roundedSize - this->aadSize);
-        }
+        if (pAad == nullptr) // Empty aad
+            pAadSize = 0;
+        this->aadSize = pAadSize;
+        qwordZero(this->aadHash);
+        StatsScope stats(STAGE::GHASH, this->aadSize,
+            getBlockRoundedSize(this->aadSize) / AES::BLOCKSIZE);
+
+        ghashPadded(this->ghashEngine, *this->ghashKey, this->aadHash, pAad, this->aadSize);
+    }
+    else if (this->mode == MODE::OCB) {
+        if (pAad == nullptr)
+            pAadSize = 0;
+        this->aadSize = pAadSize;
+        ocbHash(this->engine, this->keySchedule.encKeys, *this->ocbKey, pAad, this->aadSize,
+            this->aadHash);
+    }
+    else if (this->mode == MODE::GCM_SIV) {
+        if (this->ivSize == 0)
+            return false;
+        if (pAad == nullptr)
+            pAadSize = 0;
+        this->aadSize = pAadSize;
+        qwordZero(this->aadHash);
+        sivHashChunks(this->threadPool, this->ghashEngine, this->sivKeys->hashKey,
+            this->aadHash, pAad, this->aadSize);
     }
     return true;
 }
 
-void AES::applyPadding(byte_t* data, unsigned int& dataSize)
+void AES::applyPadding(byte_t* data, size_t& dataSize)
 {
     if (this->padding == PADDING::NONE)
         return;
@@ -130,7 +295,7 @@ void AES::applyPadding(byte_t* data, unsigned int& dataSize)
     dataSize += paddingSize;
 }
 
-bool AES::cipher(byte_t* dataIn, byte_t* dataOut, unsigned int dataSize)
+bool AES::cipher(byte_t* dataIn, byte_t* dataOut, size_t dataSize)
 {
     if (!hasInit)
         return false;
@@ -138,61 +303,17 @@ bool AES::cipher(byte_t* dataIn, byte_t* dataOut, unsigned int dataSize)
         return false;
     this->applyPadding((byte_t*)dataIn, dataSize);
 
-    bool result;
-    if (this->mode == MODE::ECB)
-    {
-        result = this->ecb_encrypt(dataIn, dataOut, dataSize);
-    }
-    else if (this->mode == MODE::CBC)
-    {
-        result = this->cbc_encrypt(dataIn, dataOut, dataSize);
-    }
-    else if (this->mode == MODE::CTR)
-    {
-        result = this->ctr_encrypt(dataIn, dataOut, dataSize);
-    }
-    else if (this->mode == MODE::GCM)
-    {
-        result = this->gcm_encrypt(dataIn, dataOut, dataSize);
-    }
-    else // Should never happen
-    {
-        result = false;
-    }
-
-    return result;
+    return (this->*this->modeKernels->encrypt)(dataIn, dataOut, dataSize);
 }
 
-bool AES::decipher(const byte_t* dataIn, byte_t* dataOut, unsigned int dataSize)
+bool AES::decipher(const byte_t* dataIn, byte_t* dataOut, size_t dataSize)
 {
     if (!hasInit)
         return false;
     if (dataIn == nullptr || dataOut == nullptr)
         return false;
 
-    bool result;
-    if (this->mode == MODE::ECB)
-    {
-        result = this->ecb_decrypt(dataIn, dataOut, dataSize);
-    }
-    else if (this->mode == MODE::CBC)
-    {
-        result = this->cbc_decrypt(dataIn, dataOut, dataSize);
-    }
-    else if (this->mode == MODE::CTR)
-    {
-        result = this->ctr_decrypt(dataIn, dataOut, dataSize);
-    }
-    else if (this->mode == MODE::GCM)
-    {
-        result = this->gcm_decrypt(dataIn, dataOut, dataSize);
-    }
-    else // Should never happen
-    {
-        result = false;
-    }
-
-    return result;
+    return (this->*this->modeKernels->decrypt)(dataIn, dataOut, dataSize);
 }
 
 bool AES::isGcmIvSizeValid(unsigned int pIvSize)
@@ -209,12 +330,36 @@ bool AES::isGcmIvSizeValid(unsigned int pIvSize)
         return true;
     return false;
 }
+
+// RFC 7253 nonces are at most 120 bits, 96 bits is the recommended size
+bool AES::isOcbIvSizeValid(unsigned int pIvSize)
+{
+    return pIvSize > 0 && pIvSize < AES::BLOCKSIZE;
+}
+
+// GCM, OCB and GCM-SIV append a 16 bytes tag to the ciphertext
+bool AES::hasTag(MODE pMode)
+{
+    return pMode == MODE::GCM || pMode == MODE::OCB || pMode == MODE::GCM_SIV;
+}
+
+// What cliaes takes, XTS and GCM-SIV are library only
 std::string AES::getSupportedList()
 {
     std::string buffer;
     buffer += "Supported algorithms : ";
-    buffer += "aes-[128|192|256]-[ecb|cbc|ctr|gcm]";
+    buffer += "aes-[128|192|256]-[ecb|cbc|ctr|gcm|ocb]";
     buffer += "\nPadding = PKCS7";
+    buffer += "\nEngines : auto|ref|ttable|bitslice";
+    if (AES::isEngineSupported(ENGINE::AESNI))
+        buffer += "|aesni";
+    if (AES::isEngineSupported(ENGINE::VAES))
+        buffer += "|vaes";
+    buffer += "\nGhash : auto|ref|table";
+    if (AES::isGhashSupported(GHASH::CLMUL))
+        buffer += "|clmul";
+    if (AES::isGhashSupported(GHASH::VPCLMUL))
+        buffer += "|vpclmul";
     return buffer;
 }
 
@@ -244,6 +389,12 @@ std::string AES::getModeFromEnum(MODE value)
         return "CTR";
     case MODE::GCM:
         return "GCM";
+    case MODE::XTS:
+        return "XTS";
+    case MODE::OCB:
+        return "OCB";
+    case MODE::GCM_SIV:
+        return "GCM-SIV";
     }
     return "ERROR";
 }
@@ -260,6 +411,88 @@ std::string AES::getPaddingFromEnum(PADDING value)
     return "ERROR";
 }
 
+std::string AES::getEngineFromEnum(ENGINE value)
+{
+    switch (value)
+    {
+    case ENGINE::AUTO:
+        return "Auto";
+    case ENGINE::REFERENCE:
+        return "Reference";
+    case ENGINE::TTABLE:
+        return "T-table";
+    case ENGINE::BITSLICE:
+        return "Bitslice";
+    case ENGINE::AESNI:
+        return "AES-NI";
+    case ENGINE::VAES:
+        return "VAES";
+    }
+    return "ERROR";
+}
+
+bool AES::isEngineSupported(ENGINE value)
+{
+    return getEngine(value, 10) != nullptr; // Same for every key size
+}
+
+std::string AES::getGhashFromEnum(GHASH value)
+{
+    switch (value)
+    {
+    case GHASH::AUTO:
+        return "Auto";
+    case GHASH::REFERENCE:
+        return "Reference";
+    case GHASH::TABLE:
+        return "Table";
+    case GHASH::CLMUL:
+        return "CLMUL";
+    case GHASH::VPCLMUL:
+        return "VPCLMUL";
+    }
+    return "ERROR";
+}
+
+bool AES::isGhashSupported(GHASH value)
+{
+    return getGhashEngine(value) != nullptr;
+}
+
+std::string AES::getStageFromEnum(STAGE value)
+{
+    switch (value)
+    {
+    case STAGE::KEY_EXPANSION:
+        return "Key expansion";
+    case STAGE::GHASH_KEY:
+        return "GHASH key";
+    case STAGE::GCM_J0:
+        return "GCM J0";
+    case STAGE::ECB:
+        return "ECB";
+    case STAGE::CBC:
+        return "CBC";
+    case STAGE::CTR:
+        return "CTR";
+    case STAGE::GCTR:
+        return "GCTR";
+    case STAGE::GHASH:
+        return "GHASH";
+    case STAGE::GCM_TAG:
+        return "GCM tag";
+    case STAGE::XTS:
+        return "XTS";
+    case STAGE::OCB:
+        return "OCB";
+    case STAGE::READ:
+        return "Read";
+    case STAGE::WRITE:
+        return "Write";
+    }
+    return "ERROR";
+}
+
 std::string AES::getInfos()
 {
     if (!this->hasInit)
@@ -270,13 +503,18 @@ std::string AES::getInfos()
     std::string buffer = "";
     buffer += "AES-" + std::to_string(this->keySize * 8) + "-"
         + AES::getModeFromEnum(this->mode);
-    buffer += "\nKey: " + bytesToHexString(this->key, this->keySize);
+    buffer += "\nKey: " + bytesToHexString(this->key,
+        this->mode == MODE::XTS ? 2 * this->keySize : this->keySize);
     buffer += "\niv/counter (size = " + std::to_string(this->ivSize) + "): "
         + bytesToHexString(this->iv, this->ivSize);
-    buffer += "\naad (size = " + std::to_string(this->aadSize) + "): "
-        + bytesToHexString(this->aad, this->aadSize);
+    buffer += "\naad (size = " + std::to_string(this->aadSize) + "), hash: "
+        + bytesToHexString(QWTOCBUF(this->aadHash), AES::BLOCKSIZE);
     buffer += "\nPadding: " + getPaddingFromEnum(this->padding);
-    buffer += "\nGCM Tag: fixed length of 16 bytes";
+    buffer += "\nEngine: " + getEngineFromEnum(this->engine->id);
+    if (this->mode == MODE::GCM || this->mode == MODE::GCM_SIV)
+        buffer += "\nGhash: " + getGhashFromEnum(this->ghashEngine->id);
+    buffer += "\nThreads: " + std::to_string(this->threads);
+    buffer += "\nGCM/OCB/GCM-SIV Tag: fixed length of 16 bytes";
 
     return buffer;
 }
@@ -287,27 +525,36 @@ std::string AES::getInfos()
     since it does not add a lot of memory :)
     +1 block if padding is asked
 */
-unsigned int AES::getPaddingSize(unsigned int pDataSize, PADDING pPadding)
+unsigned int AES::getPaddingSize(uint64_t pDataSize, PADDING pPadding)
 {
     if (pPadding == PADDING::NONE || pDataSize == 0)
         return 0;
     if (pDataSize % AES::BLOCKSIZE == 0)
         return AES::BLOCKSIZE;
-    return AES::BLOCKSIZE + (AES::BLOCKSIZE - pDataSize % AES::BLOCKSIZE);
+    return AES::BLOCKSIZE + (AES::BLOCKSIZE - (unsigned int)(pDataSize % AES::BLOCKSIZE));
 }
 
-// Only use on ciphered text
-unsigned int AES::getRevPaddingSize(const byte_t* pDataIn, unsigned int pDataSize,
+// Only use on deciphered text, pDataSize is the size of the ciphered text
+// 0 when there is no room for padding or the last byte can't be a padding size
+unsigned int AES::getRevPaddingSize(const byte_t* pDataIn, size_t pDataSize,
     PADDING pPadding, MODE pMode)
 {
-    if (pPadding == PADDING::NONE || pDataSize == 0)
+    if (pPadding == PADDING::NONE)
+        return 0;
+    if (AES::hasTag(pMode)) {
+        if (pDataSize <= AES::BLOCKSIZE)
+            return 0;
+        pDataSize -= AES::BLOCKSIZE; // Remove tag
+    }
+    if (pDataSize == 0)
         return 0;
-    if (pMode == MODE::GCM)
-        pDataSize -= 16; // Remove tag
-    return pDataIn[pDataSize - 1];
+    unsigned int paddingSize = pDataIn[pDataSize - 1];
+    if (paddingSize > pDataSize || paddingSize > 2 * AES::BLOCKSIZE)
+        return 0;
+    return paddingSize;
 }
 
-unsigned int AES::getBlockRoundedSize(unsigned int pDataSize)
+size_t AES::getBlockRoundedSize(size_t pDataSize)
 {
     if (pDataSize == 0)
         return 0;
@@ -316,18 +563,18 @@ unsigned int AES::getBlockRoundedSize(unsigned int pDataSize)
     return pDataSize + (AES::BLOCKSIZE - pDataSize % AES::BLOCKSIZE);
 }
 
-unsigned int AES::getPlainInBufferSize(unsigned int pDataSize, PADDING pPadding, MODE pMode)
+size_t AES::getPlainInBufferSize(size_t pDataSize, PADDING pPadding, MODE pMode)
 {
     (void)pMode;
     return pDataSize + getPaddingSize(pDataSize, pPadding);
 }
 
-// In gcm, cipher output must be a multiple of 16 bytes for last ghash step
+// In gcm, ocb and gcm-siv, the tag follows the cipher text
 // Else it must be equal to the Input, data + padding
-unsigned int AES::getCipherOutBufferSize(unsigned int pDataSize, PADDING pPadding, MODE pMode)
+size_t AES::getCipherOutBufferSize(size_t pDataSize, PADDING pPadding, MODE pMode)
 {
-    unsigned int n = getPaddingSize(pDataSize, pPadding); // Padding link the input
-    if (pMode == MODE::GCM)
+    size_t n = getPaddingSize(pDataSize, pPadding); // Padding link the input
+    if (AES::hasTag(pMode))
     {
         pDataSize += AES::BLOCKSIZE; // Tag at the end
     }
@@ -335,18 +582,21 @@ unsigned int AES::getCipherOutBufferSize(unsigned int pDataSize, PADDING pPaddin
 }
 
 // Dont need more space, Tag space can be used to round Cipher txt in gcm
-unsigned int AES::getCipherInBufferSize(unsigned int pDataSize, PADDING pPadding, MODE pMode)
+size_t AES::getCipherInBufferSize(size_t pDataSize, PADDING pPadding, MODE pMode)
 {
     (void)pPadding;
     (void)pMode;
     return pDataSize;
 }
 
-unsigned int AES::getPlainOutBufferSize(unsigned int pDataSize, PADDING pPadding, MODE pMode)
+size_t AES::getPlainOutBufferSize(size_t pDataSize, PADDING pPadding, MODE pMode)
 {
     (void)pPadding; // Padding is removed AFTER the decryption
-    if (pMode == MODE::GCM)
+    if (AES::hasTag(pMode)) {
+        if (pDataSize < AES::BLOCKSIZE)
+            return 0; // No room for the tag, decipher fails
         pDataSize -= AES::BLOCKSIZE; // Remove Tag
+    }
     return pDataSize;
 }
 
@@ -0,0 +1,158 @@
+#include <cstring>
+
+#include <libaes/libaes.hpp>
+#include <libaes/aes_cipher.hpp>
+#include <libaes/aes_engine.hpp>
+#include <libaes/cpu_features.hpp>
+
+namespace AES
+{
+
+// Engines without a multi block primitive just loop over their single block one
+template <blockFunc_t F>
+static void blocksLoop(byte_t* blocks, unsigned int nBlocks, const word_t* keys)
+{
+    for (unsigned int i = 0; i < nBlocks; ++i)
+        F(blocks + 16 * i, keys);
+}
+
+// And CBC lanes one after the other
+template <blockFunc_t F>
+static void cbcLanesLoop(unsigned int nLanes, const byte_t* const* dataIn,
+    byte_t* const* dataOut, qword_t* chains, size_t nBlocks, const word_t* const* keys)
+{
+    for (unsigned int lane = 0; lane < nLanes; ++lane) {
+        for (size_t i = 0; i < nBlocks; ++i) {
+            byte_t* chain = QWTOBUF(chains[lane]);
+            for (int j = 0; j < 16; ++j)
+                chain[j] ^= dataIn[lane][16 * i + j];
+            F(chain, keys[lane]);
+            memcpy(dataOut[lane] + 16 * i, chain, 16);
+        }
+    }
+}
+
+// One entry per key size, AES-128, AES-192, AES-256
+template <int Nr>
+static constexpr Engine referenceEngine()
+{
+    return { ENGINE::REFERENCE, Nr, keyExpansion<Nr - 6>, prepareKeysRef<Nr>, cipherBlock<Nr>,
+        decipherBlock<Nr>, blocksLoop<cipherBlock<Nr>>, blocksLoop<decipherBlock<Nr>>, nullptr,
+        cbcLanesLoop<cipherBlock<Nr>>, nullptr, nullptr, nullptr, nullptr };
+}
+
+template <int Nr>
+static constexpr Engine ttableEngine()
+{
+    return { ENGINE::TTABLE, Nr, keyExpansion<Nr - 6>, prepareKeysTTable<Nr>,
+        cipherBlockTTable<Nr>, decipherBlockTTable<Nr>, blocksLoop<cipherBlockTTable<Nr>>,
+        blocksLoop<decipherBlockTTable<Nr>>, nullptr, cbcLanesLoop<cipherBlockTTable<Nr>>,
+        nullptr, nullptr, nullptr, nullptr };
+}
+
+template <int Nr>
+static constexpr Engine bitsliceEngine()
+{
+    return { ENGINE::BITSLICE, Nr, keyExpansionBitslice<Nr>, prepareKeysBitslice<Nr>,
+        cipherBlockBitslice<Nr>, decipherBlockBitslice<Nr>, cipherBlocksBitslice<Nr>,
+        decipherBlocksBitslice<Nr>, nullptr, cbcLanesLoop<cipherBlockBitslice<Nr>>, nullptr,
+        nullptr, nullptr, nullptr };
+}
+
+static const Engine ENGINE_REFERENCE[] = {
+    referenceEngine<10>(), referenceEngine<12>(), referenceEngine<14>()
+};
+
+static const Engine ENGINE_TTABLE[] = {
+    ttableEngine<10>(), ttableEngine<12>(), ttableEngine<14>()
+};
+
+static const Engine ENGINE_BITSLICE[] = {
+    bitsliceEngine<10>(), bitsliceEngine<12>(), bitsliceEngine<14>()
+};
+
+#if defined(LIBAES_X86)
+template <int Nr>
+static constexpr Engine aesniEngine()
+{
+    return { ENGINE::AESNI, Nr, keyExpansionNi<Nr>, prepareKeysNi<Nr>, cipherBlockNi<Nr>,
+        decipherBlockNi<Nr>, cipherBlocksNi<Nr>, decipherBlocksNi<Nr>, nullptr, cbcLanesNi<Nr>,
+        xtsCipherBlocksNi<Nr>, xtsDecipherBlocksNi<Nr>, ocbCipherBlocksNi<Nr>,
+        ocbDecipherBlocksNi<Nr> };
+}
+
+static const Engine ENGINE_AESNI[] = {
+    aesniEngine<10>(), aesniEngine<12>(), aesniEngine<14>()
+};
+
+// Same keys, block primitives, XTS and OCB as AES-NI, only the counter mode is wide
+template <int Nr>
+static constexpr Engine vaesEngine(ctrBlocksFunc_t ctrBlocks)
+{
+    return { ENGINE::VAES, Nr, keyExpansionNi<Nr>, prepareKeysNi<Nr>, cipherBlockNi<Nr>,
+        decipherBlockNi<Nr>, cipherBlocksNi<Nr>, decipherBlocksNi<Nr>, ctrBlocks, cbcLanesNi<Nr>,
+        xtsCipherBlocksNi<Nr>, xtsDecipherBlocksNi<Nr>, ocbCipherBlocksNi<Nr>,
+        ocbDecipherBlocksNi<Nr> };
+}
+
+static const Engine ENGINE_VAES512[] = {
+    vaesEngine<10>(ctrBlocksVaes512<10>), vaesEngine<12>(ctrBlocksVaes512<12>),
+    vaesEngine<14>(ctrBlocksVaes512<14>)
+};
+
+static const Engine ENGINE_VAES256[] = {
+    vaesEngine<10>(ctrBlocksVaes256<10>), vaesEngine<12>(ctrBlocksVaes256<12>),
+    vaesEngine<14>(ctrBlocksVaes256<14>)
+};
+
+// 512 bits vectors when the CPU has AVX-512, 256 bits with AVX2, nullptr without VAES
+static const Engine* getVaesEngine(const CpuFeatures& cpu, int k)
+{
+    if (!cpu.aesni || !cpu.vaes || !cpu.avx2)
+        return nullptr;
+    return cpu.avx512 ? &ENGINE_VAES512[k] : &ENGINE_VAES256[k];
+}
+#endif
+
+const Engine* getEngine(ENGINE id, int Nr)
+{
+    const CpuFeatures& cpu = getCpuFeatures();
+    (void)cpu;
+
+    if (Nr != 10 && Nr != 12 && Nr != 14)
+        return nullptr;
+    const int k = (Nr - 10) / 2;
+
+    switch (id)
+    {
+    case ENGINE::AUTO:
+#if defined(LIBAES_X86)
+        if (getVaesEngine(cpu, k) != nullptr)
+            return getVaesEngine(cpu, k);
+        if (cpu.aesni)
+            return &ENGINE_AESNI[k];
+#endif
+        return &ENGINE_REFERENCE[k];
+    case ENGINE::REFERENCE:
+        return &ENGINE_REFERENCE[k];
+    case ENGINE::TTABLE:
+        return &ENGINE_TTABLE[k];
+    case ENGINE::BITSLICE:
+        return &ENGINE_BITSLICE[k];
+    case ENGINE::AESNI:
+#if defined(LIBAES_X86)
+        if (cpu.aesni)
+            return &ENGINE_AESNI[k];
+#endif
+        return nullptr;
+    case ENGINE::VAES:
+#if defined(LIBAES_X86)
+        return getVaesEngine(cpu, k);
+#else
+        return nullptr;
+#endif
+    }
+    return nullptr;
+}
+
+} // namespace AES
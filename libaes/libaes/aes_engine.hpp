@@ -0,0 +1,221 @@
+#ifndef LIBAES_AES_ENGINE_HPP
+#define LIBAES_AES_ENGINE_HPP
+
+#include <libaes/types.hpp>
+#include <libaes/libaes.hpp>
+#include <libaes/cpu_features.hpp>
+
+namespace AES
+{
+
+// Key to the FIPS-197 schedule of 4 * (Nr + 1) words, the same schedule for every engine
+typedef void (*expandKeyFunc_t)(const byte_t* key, word_t* ksch);
+// Keys given to the block functions are the ones built by prepareKeys, not the raw key schedule
+typedef void (*prepareKeysFunc_t)(const word_t* ksch, word_t* encKeys, word_t* decKeys);
+typedef void (*blockFunc_t)(byte_t* state, const word_t* keys);
+typedef void (*blocksFunc_t)(byte_t* blocks, unsigned int nBlocks, const word_t* keys);
+// CBC encryption of nLanes independent messages, nBlocks full blocks of each, lane i uses keys[i]
+// chains[i] is the previous ciphertext block of lane i (the iv at first), left on its last one
+typedef void (*cbcLanesFunc_t)(unsigned int nLanes, const byte_t* const* dataIn,
+    byte_t* const* dataOut, qword_t* chains, size_t nBlocks, const word_t* const* keys);
+// dataOut = dataIn ^ E(counter), E(counter + 1)... on nBlocks full blocks, counter is left on
+// the next unused value. incBytes low bytes are incremented: 16 for CTR, 4 for GCM (inc32)
+// or SIV_INC_BYTES for the little endian counter of GCM-SIV
+typedef void (*ctrBlocksFunc_t)(qword_t& counter, int incBytes, const byte_t* dataIn,
+    byte_t* dataOut, size_t nBlocks, const word_t* keys);
+// XTS on nBlocks full blocks of a data unit, tweak is the ciphered tweak of the first block,
+// left on the one of the next block. dataIn and dataOut can be the same buffer
+typedef void (*xtsBlocksFunc_t)(qword_t& tweak, const byte_t* dataIn, byte_t* dataOut,
+    size_t nBlocks, const word_t* keys);
+// OCB on nBlocks full blocks numbered from blockIndex + 1, offset is the one of block blockIndex,
+// left on the last one, L is the L_i table of the key. checksum ^= every plaintext block
+typedef void (*ocbBlocksFunc_t)(qword_t& offset, qword_t& checksum, uint64_t blockIndex,
+    const qword_t* L, const byte_t* dataIn, byte_t* dataOut, size_t nBlocks, const word_t* keys);
+
+/**
+ * Set of block primitives, one per implementation of the cipher and per key size
+ * The number of rounds is a template parameter of the primitives, so their round loops
+ * have a constant trip count and are unrolled by the compiler
+ * Every engine produces the exact same output, only speed differs
+**/
+struct Engine
+{
+    ENGINE id;
+    int Nr;
+    expandKeyFunc_t expandKey; // Constant time SubWord on the constant time engines
+    prepareKeysFunc_t prepareKeys;
+    blockFunc_t cipherBlock;
+    blockFunc_t decipherBlock;
+    blocksFunc_t cipherBlocks; // nBlocks contiguous and independent blocks, in place
+    blocksFunc_t decipherBlocks;
+    ctrBlocksFunc_t ctrBlocks; // nullptr: the modes build the counter blocks for cipherBlocks
+    cbcLanesFunc_t cbcLanes;   // Up to MAX_LANES messages, for the multi-buffer calls
+    xtsBlocksFunc_t xtsCipherBlocks; // nullptr: the modes xor the tweaks around cipherBlocks
+    xtsBlocksFunc_t xtsDecipherBlocks;
+    ocbBlocksFunc_t ocbCipherBlocks; // nullptr: the modes xor the offsets around cipherBlocks
+    ocbBlocksFunc_t ocbDecipherBlocks;
+};
+
+// Fully unroll the next loop, for the round loops whose trip count depends only on Nr
+// MSVC has no such pragma but unrolls these short constant loops on its own
+#if defined(__clang__)
+#define LIBAES_UNROLL _Pragma("unroll")
+#elif defined(__GNUC__)
+#define LIBAES_UNROLL _Pragma("GCC unroll 16")
+#else
+#define LIBAES_UNROLL
+#endif
+
+// Number of independent blocks the modes try to give to cipherBlocks/decipherBlocks at once
+static const unsigned int ENGINE_BATCH_BLOCKS = 8;
+
+// Most messages given to cbcLanes at once
+static const unsigned int MAX_LANES = 16;
+
+// Trailing zero bits of a block number, OCB block i uses L[ntz(i)], i is never 0
+static inline unsigned int ocbNtz(uint64_t i)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return (unsigned int)__builtin_ctzll(i);
+#else
+    unsigned int n = 0;
+    for (; (i & 1) == 0; i >>= 1)
+        ++n;
+    return n;
+#endif
+}
+
+// nullptr if the engine can't run on this CPU or Nr is not 10, 12 or 14
+// AUTO picks the fastest hardware engine, the reference one without AES-NI
+const Engine* getEngine(ENGINE id, int Nr);
+
+// Each engine instantiates its primitives for AES-128, AES-192 and AES-256
+#define INSTANTIATE_ENGINE_EXPAND_KEY(F) \
+    template void F<10>(const byte_t* key, word_t* ksch); \
+    template void F<12>(const byte_t* key, word_t* ksch); \
+    template void F<14>(const byte_t* key, word_t* ksch);
+#define INSTANTIATE_ENGINE_PREPARE_KEYS(F) \
+    template void F<10>(const word_t* ksch, word_t* encKeys, word_t* decKeys); \
+    template void F<12>(const word_t* ksch, word_t* encKeys, word_t* decKeys); \
+    template void F<14>(const word_t* ksch, word_t* encKeys, word_t* decKeys);
+#define INSTANTIATE_ENGINE_BLOCK(F) \
+    template void F<10>(byte_t* state, const word_t* keys); \
+    template void F<12>(byte_t* state, const word_t* keys); \
+    template void F<14>(byte_t* state, const word_t* keys);
+#define INSTANTIATE_ENGINE_BLOCKS(F) \
+    template void F<10>(byte_t* blocks, unsigned int nBlocks, const word_t* keys); \
+    template void F<12>(byte_t* blocks, unsigned int nBlocks, const word_t* keys); \
+    template void F<14>(byte_t* blocks, unsigned int nBlocks, const word_t* keys);
+#define INSTANTIATE_ENGINE_CBC_LANES(F) \
+    template void F<10>(unsigned int nLanes, const byte_t* const* dataIn, byte_t* const* dataOut, \
+        qword_t* chains, size_t nBlocks, const word_t* const* keys); \
+    template void F<12>(unsigned int nLanes, const byte_t* const* dataIn, byte_t* const* dataOut, \
+        qword_t* chains, size_t nBlocks, const word_t* const* keys); \
+    template void F<14>(unsigned int nLanes, const byte_t* const* dataIn, byte_t* const* dataOut, \
+        qword_t* chains, size_t nBlocks, const word_t* const* keys);
+#define INSTANTIATE_ENGINE_CTR_BLOCKS(F) \
+    template void F<10>(qword_t& counter, int incBytes, const byte_t* dataIn, byte_t* dataOut, \
+        size_t nBlocks, const word_t* keys); \
+    template void F<12>(qword_t& counter, int incBytes, const byte_t* dataIn, byte_t* dataOut, \
+        size_t nBlocks, const word_t* keys); \
+    template void F<14>(qword_t& counter, int incBytes, const byte_t* dataIn, byte_t* dataOut, \
+        size_t nBlocks, const word_t* keys);
+#define INSTANTIATE_ENGINE_XTS_BLOCKS(F) \
+    template void F<10>(qword_t& tweak, const byte_t* dataIn, byte_t* dataOut, size_t nBlocks, \
+        const word_t* keys); \
+    template void F<12>(qword_t& tweak, const byte_t* dataIn, byte_t* dataOut, size_t nBlocks, \
+        const word_t* keys); \
+    template void F<14>(qword_t& tweak, const byte_t* dataIn, byte_t* dataOut, size_t nBlocks, \
+        const word_t* keys);
+#define INSTANTIATE_ENGINE_OCB_BLOCKS(F) \
+    template void F<10>(qword_t& offset, qword_t& checksum, uint64_t blockIndex, \
+        const qword_t* L, const byte_t* dataIn, byte_t* dataOut, size_t nBlocks, \
+        const word_t* keys); \
+    template void F<12>(qword_t& offset, qword_t& checksum, uint64_t blockIndex, \
+        const qword_t* L, const byte_t* dataIn, byte_t* dataOut, size_t nBlocks, \
+        const word_t* keys); \
+    template void F<14>(qword_t& offset, qword_t& checksum, uint64_t blockIndex, \
+        const qword_t* L, const byte_t* dataIn, byte_t* dataOut, size_t nBlocks, \
+        const word_t* keys);
+
+// Reference engine, aes_cipher.cpp
+template <int Nr>
+void prepareKeysRef(const word_t* ksch, word_t* encKeys, word_t* decKeys);
+
+// T-table engine, aes_cipher_ttable.cpp
+template <int Nr>
+void prepareKeysTTable(const word_t* ksch, word_t* encKeys, word_t* decKeys);
+template <int Nr>
+void cipherBlockTTable(byte_t* state, const word_t* keys);
+template <int Nr>
+void decipherBlockTTable(byte_t* state, const word_t* keys);
+
+// Bitsliced engine, aes_cipher_bitslice.cpp
+template <int Nr>
+void keyExpansionBitslice(const byte_t* key, word_t* ksch);
+template <int Nr>
+void prepareKeysBitslice(const word_t* ksch, word_t* encKeys, word_t* decKeys);
+template <int Nr>
+void cipherBlockBitslice(byte_t* state, const word_t* keys);
+template <int Nr>
+void decipherBlockBitslice(byte_t* state, const word_t* keys);
+template <int Nr>
+void cipherBlocksBitslice(byte_t* blocks, unsigned int nBlocks, const word_t* keys);
+template <int Nr>
+void decipherBlocksBitslice(byte_t* blocks, unsigned int nBlocks, const word_t* keys);
+
+#if defined(LIBAES_X86)
+// AES-NI engine, aes_cipher_ni.cpp
+// The target is part of the template declaration, or the instantiations are built without it
+template <int Nr>
+LIBAES_TARGET("aes,sse2")
+void keyExpansionNi(const byte_t* key, word_t* ksch);
+template <int Nr>
+LIBAES_TARGET("aes,sse2")
+void prepareKeysNi(const word_t* ksch, word_t* encKeys, word_t* decKeys);
+template <int Nr>
+LIBAES_TARGET("aes,sse2")
+void cipherBlockNi(byte_t* state, const word_t* keys);
+template <int Nr>
+LIBAES_TARGET("aes,sse2")
+void decipherBlockNi(byte_t* state, const word_t* keys);
+template <int Nr>
+LIBAES_TARGET("aes,sse2")
+void cipherBlocksNi(byte_t* blocks, unsigned int nBlocks, const word_t* keys);
+template <int Nr>
+LIBAES_TARGET("aes,sse2")
+void decipherBlocksNi(byte_t* blocks, unsigned int nBlocks, const word_t* keys);
+template <int Nr>
+LIBAES_TARGET("aes,sse2")
+void cbcLanesNi(unsigned int nLanes, const byte_t* const* dataIn, byte_t* const* dataOut,
+    qword_t* chains, size_t nBlocks, const word_t* const* keys);
+template <int Nr>
+LIBAES_TARGET("aes,sse2")
+void xtsCipherBlocksNi(qword_t& tweak, const byte_t* dataIn, byte_t* dataOut, size_t nBlocks,
+    const word_t* keys);
+template <int Nr>
+LIBAES_TARGET("aes,sse2")
+void xtsDecipherBlocksNi(qword_t& tweak, const byte_t* dataIn, byte_t* dataOut, size_t nBlocks,
+    const word_t* keys);
+template <int Nr>
+LIBAES_TARGET("aes,sse2")
+void ocbCipherBlocksNi(qword_t& offset, qword_t& checksum, uint64_t blockIndex, const qword_t* L,
+    const byte_t* dataIn, byte_t* dataOut, size_t nBlocks, const word_t* keys);
+template <int Nr>
+LIBAES_TARGET("aes,sse2")
+void ocbDecipherBlocksNi(qword_t& offset, qword_t& checksum, uint64_t blockIndex, const qword_t* L,
+    const byte_t* dataIn, byte_t* dataOut, size_t nBlocks, const word_t* keys);
+
+// VAES engine, aes_cipher_vaes.cpp, the AES-NI primitives with a wide counter mode
+// 512 bits vectors need AVX-512, 256 bits ones AVX2
+template <int Nr>
+void ctrBlocksVaes512(qword_t& counter, int incBytes, const byte_t* dataIn, byte_t* dataOut,
+    size_t nBlocks, const word_t* keys);
+template <int Nr>
+void ctrBlocksVaes256(qword_t& counter, int incBytes, const byte_t* dataIn, byte_t* dataOut,
+    size_t nBlocks, const word_t* keys);
+#endif
+
+} // namespace AES
+
+#endif
@@ -0,0 +1,286 @@
+#include <libaes/libaes.hpp>
+#include <libaes/types_helper.hpp>
+#include <libaes/aes_ghash.hpp>
+#include <libaes/cpu_features.hpp>
+
+namespace AES
+{
+
+// R = 0x10000111
+// https://nvlpubs.nist.gov/nistpubs/legacy/sp/nistspecialpublication800-38d.pdf
+void gmul(const qword_t& x, qword_t& y)
+{
+#define BITON(x, b) ((x) & (0x01 << (b)))
+
+    int carry;
+    qword_t v;
+    qword_t r = QWORD_STATIC_ZERO;
+
+    r.b[0] = 0b11100001; // x128 + x7 + x2 + x + 1
+    qwordCopy(y, v);
+    qwordZero(y);
+
+    for (int byte = 0; byte < 16; ++byte) {
+        byte_t xi = x.b[byte];
+        for (int bit = 7; bit >= 0; --bit) {
+            if (BITON(xi, bit)) {
+                qwordXor(v, y);
+            }
+            carry = BITON(v.b[15], 0);
+            qwordShiftRight(v);
+            if (carry) {
+                qwordXor(r, v);
+            }
+        }
+    }
+
+#undef BITON
+}
+
+/*
+    Hn = H^n by square and multiply
+    GHASH of a chunk started from 0 is merged into the running value with Y = Y.H^n ^ chunk
+*/
+void ghashPower(const GhashKey& key, unsigned int n, qword_t& Hn)
+{
+    qword_t square;
+    qword_t tmp;
+
+    qwordCopy(key.H, square);
+    qwordZero(Hn);
+    Hn.b[0] = 0x80; // 1, bits are reflected in GCM
+    while (n > 0)
+    {
+        if (n & 1)
+            gmul(square, Hn);
+        n >>= 1;
+        if (n > 0) {
+            qwordCopy(square, tmp);
+            gmul(tmp, square);
+        }
+    }
+}
+
+/*****************************
+ * Reference engine, bit by bit gmul
+ ****************************/
+static void ghashInitRef(GhashKey& key, const qword_t& H)
+{
+    qwordCopy(H, key.H);
+}
+
+static void ghashUpdateRef(const GhashKey& key, qword_t& Y, const byte_t* data,
+    size_t nBlocks)
+{
+    qword_t tmp;
+    for (size_t i = 0; i < nBlocks; ++i)
+    {
+        qwordCopy(data + i * AES::BLOCKSIZE, tmp);
+        qwordXor(tmp, Y);
+        gmul(key.H, Y);
+    }
+}
+
+/*****************************
+ * Table engine, Shoup's method with 4 bits tables
+ * The product is built 4 bits of Y at a time: a 16 entries table of multiples of H,
+ * and a fixed table for the bits shifted out at each step
+ * https://luca-giuzzi.unibs.it/corsi/Support/papers-cryptography/gcm-spec.pdf (4.1)
+ * Lookups depend on data, prefer CLMUL when the CPU has it
+ ****************************/
+#define PACK(x) ((uint64_t)(x) << 48)
+static const uint64_t REM_4BIT[16] = {
+    PACK(0x0000), PACK(0x1C20), PACK(0x3840), PACK(0x2460),
+    PACK(0x7080), PACK(0x6CA0), PACK(0x48C0), PACK(0x54E0),
+    PACK(0xE100), PACK(0xFD20), PACK(0xD940), PACK(0xC560),
+    PACK(0x9180), PACK(0x8DA0), PACK(0xA9C0), PACK(0xB5E0)
+};
+#undef PACK
+
+static inline uint64_t loadU64Be(const byte_t* b)
+{
+    uint64_t v = 0;
+    for (int i = 0; i < 8; ++i)
+        v = (v << 8) | b[i];
+    return v;
+}
+
+static inline void storeU64Be(uint64_t v, byte_t* b)
+{
+    for (int i = 7; i >= 0; --i) {
+        b[i] = (byte_t)v;
+        v >>= 8;
+    }
+}
+
+static void ghashInitTable(GhashKey& key, const qword_t& H)
+{
+    uint64_t (*T)[2] = key.table;
+    uint64_t hi = loadU64Be(QWTOCBUF(H));
+    uint64_t lo = loadU64Be(QWTOCBUF(H) + 8);
+
+    qwordCopy(H, key.H);
+
+    // T[8] = H, T[4] = H.x, T[2] = H.x^2, T[1] = H.x^3 (x is a right shift in GCM bit order)
+    T[0][0] = 0;
+    T[0][1] = 0;
+    for (int i = 8; i > 0; i >>= 1) {
+        T[i][0] = hi;
+        T[i][1] = lo;
+        uint64_t reduce = (uint64_t)0xe100000000000000 & (0 - (lo & 1));
+        lo = (hi << 63) | (lo >> 1);
+        hi = (hi >> 1) ^ reduce;
+    }
+    // Other entries are sums of the powers of two ones
+    for (int i = 2; i < 16; i <<= 1) {
+        for (int j = 1; j < i; ++j) {
+            T[i + j][0] = T[i][0] ^ T[j][0];
+            T[i + j][1] = T[i][1] ^ T[j][1];
+        }
+    }
+}
+
+// y = y * H, nibbles are read from the last byte to the first one, low nibble first
+static void gmulTable(const GhashKey& key, qword_t& y)
+{
+    const uint64_t (*T)[2] = key.table;
+    uint64_t zhi = 0;
+    uint64_t zlo = 0;
+
+    for (int byte = 15; byte >= 0; --byte) {
+        int nibbles[2] = { y.b[byte] & 0xf, y.b[byte] >> 4 };
+        for (int n = 0; n < 2; ++n) {
+            if (byte != 15 || n != 0) {
+                int rem = (int)(zlo & 0xf);
+                zlo = (zhi << 60) | (zlo >> 4);
+                zhi = (zhi >> 4) ^ REM_4BIT[rem];
+            }
+            zhi ^= T[nibbles[n]][0];
+            zlo ^= T[nibbles[n]][1];
+        }
+    }
+
+    storeU64Be(zhi, QWTOBUF(y));
+    storeU64Be(zlo, QWTOBUF(y) + 8);
+}
+
+static void ghashUpdateTable(const GhashKey& key, qword_t& Y, const byte_t* data,
+    size_t nBlocks)
+{
+    qword_t tmp;
+    for (size_t i = 0; i < nBlocks; ++i)
+    {
+        qwordCopy(data + i * AES::BLOCKSIZE, tmp);
+        qwordXor(tmp, Y);
+        gmulTable(key, Y);
+    }
+}
+
+/*****************************
+ * POLYVAL
+ ****************************/
+// H = mulX_GHASH(ByteReverse(K)), x is the second bit of the first byte in GCM order
+void polyvalKey(const byte_t* authKey, qword_t& H)
+{
+    qword_t x = QWORD_STATIC_ZERO;
+    x.b[0] = 0x40;
+    for (int i = 0; i < AES::BLOCKSIZE; ++i)
+        H.b[i] = authKey[AES::BLOCKSIZE - 1 - i];
+    gmul(x, H);
+}
+
+// Engines without a POLYVAL path hash a byte reversed copy, one block at a time
+template <ghashUpdateFunc_t Update>
+static void polyvalUpdateReversed(const GhashKey& key, qword_t& Y, const byte_t* data,
+    size_t nBlocks)
+{
+    qword_t block;
+    for (size_t i = 0; i < nBlocks; ++i)
+    {
+        for (int j = 0; j < AES::BLOCKSIZE; ++j)
+            block.b[j] = data[i * AES::BLOCKSIZE + AES::BLOCKSIZE - 1 - j];
+        Update(key, Y, QWTOCBUF(block), 1);
+    }
+}
+
+static const GhashEngine GHASH_REFERENCE = {
+    GHASH::REFERENCE,
+    ghashInitRef,
+    ghashUpdateRef,
+    polyvalUpdateReversed<ghashUpdateRef>
+};
+
+static const GhashEngine GHASH_TABLE = {
+    GHASH::TABLE,
+    ghashInitTable,
+    ghashUpdateTable,
+    polyvalUpdateReversed<ghashUpdateTable>
+};
+
+#if defined(LIBAES_X86)
+static const GhashEngine GHASH_CLMUL = {
+    GHASH::CLMUL,
+    ghashInitClmul,
+    ghashUpdateClmul,
+    polyvalUpdateClmul
+};
+
+static const GhashEngine GHASH_VPCLMUL512 = {
+    GHASH::VPCLMUL,
+    ghashInitClmul,
+    ghashUpdateVpclmul512,
+    polyvalUpdateVpclmul512
+};
+
+static const GhashEngine GHASH_VPCLMUL256 = {
+    GHASH::VPCLMUL,
+    ghashInitClmul,
+    ghashUpdateVpclmul256,
+    polyvalUpdateVpclmul256
+};
+
+// 512 bits vectors when the CPU has AVX-512, 256 bits with AVX2, nullptr without VPCLMULQDQ
+static const GhashEngine* getVpclmulEngine(const CpuFeatures& cpu)
+{
+    if (!cpu.pclmul || !cpu.ssse3 || !cpu.vpclmul || !cpu.avx2)
+        return nullptr;
+    return cpu.avx512 ? &GHASH_VPCLMUL512 : &GHASH_VPCLMUL256;
+}
+#endif
+
+const GhashEngine* getGhashEngine(GHASH id)
+{
+    const CpuFeatures& cpu = getCpuFeatures();
+    (void)cpu;
+
+    switch (id)
+    {
+    case GHASH::AUTO:
+#if defined(LIBAES_X86)
+        if (getVpclmulEngine(cpu) != nullptr)
+            return getVpclmulEngine(cpu);
+        if (cpu.pclmul && cpu.ssse3)
+            return &GHASH_CLMUL;
+#endif
+        return &GHASH_TABLE;
+    case GHASH::REFERENCE:
+        return &GHASH_REFERENCE;
+    case GHASH::TABLE:
+        return &GHASH_TABLE;
+    case GHASH::CLMUL:
+#if defined(LIBAES_X86)
+        if (cpu.pclmul && cpu.ssse3)
+            return &GHASH_CLMUL;
+#endif
+        return nullptr;
+    case GHASH::VPCLMUL:
+#if defined(LIBAES_X86)
+        return getVpclmulEngine(cpu);
+#else
+        return nullptr;
+#endif
+    }
+    return nullptr;
+}
+
+} // namespace AES
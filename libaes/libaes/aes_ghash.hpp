@@ -0,0 +1,70 @@
+#ifndef LIBAES_AES_GHASH_HPP
+#define LIBAES_AES_GHASH_HPP
+
+#include <libaes/types.hpp>
+#include <libaes/libaes.hpp>
+#include <libaes/cpu_features.hpp>
+
+namespace AES
+{
+
+static const int GHASH_POWERS = 16; // Blocks aggregated per reduction, by the widest engine
+
+/**
+ * Everything GHASH needs for one hash key H, built once per key by GhashEngine::init
+ * The layout of powers depends on the engine
+**/
+struct GhashKey
+{
+    qword_t H;
+    qword_t powers[GHASH_POWERS]; // H^1..H^16
+    uint64_t table[16][2]; // Shoup 4 bits table, i.H as {high, low} 64 bits halves
+};
+
+typedef void (*ghashInitFunc_t)(GhashKey& key, const qword_t& H);
+// Y = (...((Y ^ X1) * H ^ X2) * H ...) * H, data is nBlocks full blocks
+typedef void (*ghashUpdateFunc_t)(const GhashKey& key, qword_t& Y, const byte_t* data,
+    size_t nBlocks);
+
+/**
+ * POLYVAL (RFC 8452 appendix A) is GHASH of the byte reversed blocks under
+ * H = mulX_GHASH(ByteReverse(K)), see polyvalKey
+ * polyval takes the POLYVAL blocks as they are, Y stays in GHASH order: the result
+ * is ByteReverse(Y), and ghashPower/gmul merge partial values like for GHASH
+**/
+struct GhashEngine
+{
+    GHASH id;
+    ghashInitFunc_t init;
+    ghashUpdateFunc_t update;
+    ghashUpdateFunc_t polyval;
+};
+
+// nullptr if the engine can't run on this CPU, AUTO picks the fastest one available
+const GhashEngine* getGhashEngine(GHASH id);
+
+void gmul(const qword_t& x, qword_t& y);
+void ghashPower(const GhashKey& key, unsigned int n, qword_t& Hn);
+void polyvalKey(const byte_t* authKey, qword_t& H);
+
+#if defined(LIBAES_X86)
+// Carry-less multiply engine, aes_ghash_clmul.cpp
+void ghashInitClmul(GhashKey& key, const qword_t& H);
+void ghashUpdateClmul(const GhashKey& key, qword_t& Y, const byte_t* data, size_t nBlocks);
+void polyvalUpdateClmul(const GhashKey& key, qword_t& Y, const byte_t* data, size_t nBlocks);
+
+// Wide carry-less multiply engine, aes_ghash_vpclmul.cpp, keys built by ghashInitClmul
+// 512 bits vectors need AVX-512, 256 bits ones AVX2
+void ghashUpdateVpclmul512(const GhashKey& key, qword_t& Y, const byte_t* data,
+    size_t nBlocks);
+void ghashUpdateVpclmul256(const GhashKey& key, qword_t& Y, const byte_t* data,
+    size_t nBlocks);
+void polyvalUpdateVpclmul512(const GhashKey& key, qword_t& Y, const byte_t* data,
+    size_t nBlocks);
+void polyvalUpdateVpclmul256(const GhashKey& key, qword_t& Y, const byte_t* data,
+    size_t nBlocks);
+#endif
+
+} // namespace AES
+
+#endif
@@ -0,0 +1,97 @@
+#include <libaes/types.hpp>
+#include <libaes/aes_ghash.hpp>
+#include <libaes/aes_ghash_clmul.hpp>
+#include <libaes/cpu_features.hpp>
+
+#if defined(LIBAES_X86)
+
+/*
+    GHASH with carry-less multiply
+    Blocks are byte reversed so that the bit reflected GCM field elements become plain
+    polynomials, products are then shifted by one bit and reduced
+    https://www.intel.com/content/dam/develop/external/us/en/documents/clmul-wp-rev-2-02-2014-04-20.pdf
+
+    8 blocks are aggregated per reduction: (Y ^ X1).H^8 ^ X2.H^7 ^ ... ^ X8.H
+    Each product is done with Karatsuba (3 multiplies) and accumulated unreduced
+    The multiply and the reduction are shared with VPCLMUL, aes_ghash_clmul.hpp
+
+    POLYVAL blocks are the byte reversed GHASH blocks, they are loaded without the swap
+*/
+
+namespace AES
+{
+
+static const int CLMUL_BLOCKS = 8;
+
+// Powers are stored byte reversed, ready for the multiply
+CLMUL_TARGET
+void ghashInitClmul(GhashKey& key, const qword_t& H)
+{
+    __m128i h = byteSwap(_mm_loadu_si128((const __m128i*)QWTOCBUF(H)));
+    __m128i p = h;
+
+    _mm_storeu_si128((__m128i*)QWTOBUF(key.H), _mm_loadu_si128((const __m128i*)QWTOCBUF(H)));
+    _mm_storeu_si128((__m128i*)QWTOBUF(key.powers[0]), p);
+    for (int i = 1; i < GHASH_POWERS; ++i) {
+        p = gfmul(p, h);
+        _mm_storeu_si128((__m128i*)QWTOBUF(key.powers[i]), p);
+    }
+}
+
+template <bool Polyval>
+CLMUL_TARGET
+static inline __m128i loadBlock(const byte_t* data)
+{
+    __m128i x = _mm_loadu_si128((const __m128i*)data);
+    return Polyval ? x : byteSwap(x);
+}
+
+template <bool Polyval>
+CLMUL_TARGET
+static void updateClmul(const GhashKey& key, qword_t& Y, const byte_t* data, size_t nBlocks)
+{
+    __m128i h[CLMUL_BLOCKS];
+    for (int i = 0; i < CLMUL_BLOCKS; ++i)
+        h[i] = _mm_loadu_si128((const __m128i*)QWTOCBUF(key.powers[i]));
+
+    __m128i y = byteSwap(_mm_loadu_si128((const __m128i*)QWTOCBUF(Y)));
+
+    for (; nBlocks >= (size_t)CLMUL_BLOCKS; nBlocks -= CLMUL_BLOCKS) {
+        __m128i lo = _mm_setzero_si128();
+        __m128i mid = _mm_setzero_si128();
+        __m128i hi = _mm_setzero_si128();
+
+        for (int i = 0; i < CLMUL_BLOCKS; ++i) {
+            __m128i x = loadBlock<Polyval>(data + 16 * i);
+            if (i == 0)
+                x = _mm_xor_si128(x, y);
+            mulAcc(x, h[CLMUL_BLOCKS - 1 - i], lo, mid, hi);
+        }
+        y = reduce(lo, mid, hi);
+        data += CLMUL_BLOCKS * 16;
+    }
+
+    for (; nBlocks > 0; --nBlocks) {
+        __m128i x = loadBlock<Polyval>(data);
+        y = gfmul(_mm_xor_si128(x, y), h[0]);
+        data += 16;
+    }
+
+    _mm_storeu_si128((__m128i*)QWTOBUF(Y), byteSwap(y));
+}
+
+CLMUL_TARGET
+void ghashUpdateClmul(const GhashKey& key, qword_t& Y, const byte_t* data, size_t nBlocks)
+{
+    updateClmul<false>(key, Y, data, nBlocks);
+}
+
+CLMUL_TARGET
+void polyvalUpdateClmul(const GhashKey& key, qword_t& Y, const byte_t* data, size_t nBlocks)
+{
+    updateClmul<true>(key, Y, data, nBlocks);
+}
+
+} // namespace AES
+
+#endif
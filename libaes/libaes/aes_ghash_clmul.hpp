@@ -0,0 +1,98 @@
+#ifndef LIBAES_AES_GHASH_CLMUL_HPP
+#define LIBAES_AES_GHASH_CLMUL_HPP
+
+#include <libaes/cpu_features.hpp>
+
+#if defined(LIBAES_X86)
+
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#include <wmmintrin.h>
+
+/*
+    128 bits carry-less multiply and reduction, used by the CLMUL engine and by VPCLMUL
+    to reduce the products accumulated in its wide vectors
+*/
+
+namespace AES
+{
+
+#define CLMUL_TARGET LIBAES_TARGET("pclmul,ssse3,sse2")
+
+CLMUL_TARGET
+static inline __m128i byteSwap(__m128i x)
+{
+    const __m128i mask = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    return _mm_shuffle_epi8(x, mask);
+}
+
+// lo/mid/hi += a * b, mid is the Karatsuba middle term, not yet corrected
+CLMUL_TARGET
+static inline void mulAcc(__m128i a, __m128i b, __m128i& lo, __m128i& mid, __m128i& hi)
+{
+    __m128i a01 = _mm_xor_si128(a, _mm_srli_si128(a, 8));
+    __m128i b01 = _mm_xor_si128(b, _mm_srli_si128(b, 8));
+    lo = _mm_xor_si128(lo, _mm_clmulepi64_si128(a, b, 0x00));
+    hi = _mm_xor_si128(hi, _mm_clmulepi64_si128(a, b, 0x11));
+    mid = _mm_xor_si128(mid, _mm_clmulepi64_si128(a01, b01, 0x00));
+}
+
+// 256 bits product to field element, mod x^128 + x^7 + x^2 + x + 1
+CLMUL_TARGET
+static inline __m128i reduce(__m128i lo, __m128i mid, __m128i hi)
+{
+    __m128i t7, t8, t9;
+
+    mid = _mm_xor_si128(mid, _mm_xor_si128(lo, hi));
+    lo = _mm_xor_si128(lo, _mm_slli_si128(mid, 8));
+    hi = _mm_xor_si128(hi, _mm_srli_si128(mid, 8));
+
+    // Shift left by one, the product of two reflected values is off by one bit
+    t7 = _mm_srli_epi32(lo, 31);
+    t8 = _mm_srli_epi32(hi, 31);
+    lo = _mm_slli_epi32(lo, 1);
+    hi = _mm_slli_epi32(hi, 1);
+    t9 = _mm_srli_si128(t7, 12);
+    t8 = _mm_slli_si128(t8, 4);
+    t7 = _mm_slli_si128(t7, 4);
+    lo = _mm_or_si128(lo, t7);
+    hi = _mm_or_si128(hi, t8);
+    hi = _mm_or_si128(hi, t9);
+
+    // First phase of the reduction
+    t7 = _mm_slli_epi32(lo, 31);
+    t8 = _mm_slli_epi32(lo, 30);
+    t9 = _mm_slli_epi32(lo, 25);
+    t7 = _mm_xor_si128(t7, t8);
+    t7 = _mm_xor_si128(t7, t9);
+    t8 = _mm_srli_si128(t7, 4);
+    t7 = _mm_slli_si128(t7, 12);
+    lo = _mm_xor_si128(lo, t7);
+
+    // Second phase
+    __m128i t2 = _mm_srli_epi32(lo, 1);
+    __m128i t4 = _mm_srli_epi32(lo, 2);
+    __m128i t5 = _mm_srli_epi32(lo, 7);
+    t2 = _mm_xor_si128(t2, t4);
+    t2 = _mm_xor_si128(t2, t5);
+    t2 = _mm_xor_si128(t2, t8);
+    lo = _mm_xor_si128(lo, t2);
+
+    return _mm_xor_si128(hi, lo);
+}
+
+CLMUL_TARGET
+static inline __m128i gfmul(__m128i a, __m128i b)
+{
+    __m128i lo = _mm_setzero_si128();
+    __m128i mid = _mm_setzero_si128();
+    __m128i hi = _mm_setzero_si128();
+    mulAcc(a, b, lo, mid, hi);
+    return reduce(lo, mid, hi);
+}
+
+} // namespace AES
+
+#endif
+
+#endif
@@ -0,0 +1,201 @@
+#include <libaes/types.hpp>
+#include <libaes/aes_ghash.hpp>
+#include <libaes/aes_ghash_clmul.hpp>
+#include <libaes/cpu_features.hpp>
+
+#if defined(LIBAES_X86)
+
+// GCC 12 warns on the undefined source operand inside the AVX-512 intrinsics (GCC bug 105593)
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+#include <immintrin.h>
+
+/*
+    GHASH with VPCLMULQDQ, 4 (512 bits) or 2 (256 bits) blocks per multiply
+    16 blocks are aggregated per reduction: (Y ^ X1).H^16 ^ X2.H^15 ^ ... ^ X16.H
+    Products are accumulated in the wide vectors, their lanes are added together
+    then reduced once with the CLMUL reduction. Less than 16 blocks go to CLMUL
+
+    Powers are the CLMUL ones, byte reversed, in increasing order: lanes are swapped
+    on load so that each block meets its power
+    POLYVAL blocks skip the byte reversal of the data, like CLMUL
+*/
+
+namespace AES
+{
+
+#define VPCLMUL512_TARGET LIBAES_TARGET("vpclmulqdq,avx512f,avx512bw,avx2,avx,pclmul,ssse3,sse2")
+#define VPCLMUL256_TARGET LIBAES_TARGET("vpclmulqdq,avx2,avx,pclmul,ssse3,sse2")
+
+static const int VPCLMUL_BLOCKS = GHASH_POWERS;
+
+/*****************************
+ * 512 bits
+ ****************************/
+// lo/mid/hi += a * b on each lane, mid is the full middle term (2 multiplies, no Karatsuba)
+VPCLMUL512_TARGET
+static inline void mulAcc512(__m512i a, __m512i b, __m512i& lo, __m512i& mid, __m512i& hi)
+{
+    lo = _mm512_xor_si512(lo, _mm512_clmulepi64_epi128(a, b, 0x00));
+    hi = _mm512_xor_si512(hi, _mm512_clmulepi64_epi128(a, b, 0x11));
+    mid = _mm512_xor_si512(mid, _mm512_clmulepi64_epi128(a, b, 0x01));
+    mid = _mm512_xor_si512(mid, _mm512_clmulepi64_epi128(a, b, 0x10));
+}
+
+VPCLMUL512_TARGET
+static inline __m128i sumLanes512(__m512i x)
+{
+    __m256i y = _mm256_xor_si256(_mm512_castsi512_si256(x), _mm512_extracti64x4_epi64(x, 1));
+    return _mm_xor_si128(_mm256_castsi256_si128(y), _mm256_extracti128_si256(y, 1));
+}
+
+template <bool Polyval>
+VPCLMUL512_TARGET
+static void updateVpclmul512(const GhashKey& key, qword_t& Y, const byte_t* data, size_t nBlocks)
+{
+    if (nBlocks >= (size_t)VPCLMUL_BLOCKS) {
+        const __m512i reverse = _mm512_broadcast_i32x4(
+            _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+
+        // h[0] = H^16..H^13, h[3] = H^4..H^1
+        __m512i h[VPCLMUL_BLOCKS / 4];
+        for (int i = 0; i < VPCLMUL_BLOCKS / 4; ++i) {
+            __m512i p = _mm512_loadu_si512((const void*)QWTOCBUF(
+                key.powers[VPCLMUL_BLOCKS - 4 * (i + 1)]));
+            h[i] = _mm512_shuffle_i64x2(p, p, 0x1B); // Lanes 3, 2, 1, 0
+        }
+
+        __m128i y = byteSwap(_mm_loadu_si128((const __m128i*)QWTOCBUF(Y)));
+
+        for (; nBlocks >= (size_t)VPCLMUL_BLOCKS; nBlocks -= VPCLMUL_BLOCKS) {
+            __m512i lo = _mm512_setzero_si512();
+            __m512i mid = _mm512_setzero_si512();
+            __m512i hi = _mm512_setzero_si512();
+
+            for (int i = 0; i < VPCLMUL_BLOCKS / 4; ++i) {
+                __m512i x = _mm512_loadu_si512((const void*)(data + 64 * i));
+                if (!Polyval)
+                    x = _mm512_shuffle_epi8(x, reverse);
+                if (i == 0)
+                    x = _mm512_xor_si512(x, _mm512_inserti32x4(_mm512_setzero_si512(), y, 0));
+                mulAcc512(x, h[i], lo, mid, hi);
+            }
+
+            __m128i loSum = sumLanes512(lo);
+            __m128i hiSum = sumLanes512(hi);
+            __m128i midSum = _mm_xor_si128(sumLanes512(mid), _mm_xor_si128(loSum, hiSum));
+            y = reduce(loSum, midSum, hiSum); // Expects the Karatsuba middle term
+            data += VPCLMUL_BLOCKS * 16;
+        }
+
+        _mm_storeu_si128((__m128i*)QWTOBUF(Y), byteSwap(y));
+    }
+
+    if (nBlocks > 0 && Polyval)
+        polyvalUpdateClmul(key, Y, data, nBlocks);
+    else if (nBlocks > 0)
+        ghashUpdateClmul(key, Y, data, nBlocks);
+}
+
+/*****************************
+ * 256 bits
+ ****************************/
+VPCLMUL256_TARGET
+static inline void mulAcc256(__m256i a, __m256i b, __m256i& lo, __m256i& mid, __m256i& hi)
+{
+    lo = _mm256_xor_si256(lo, _mm256_clmulepi64_epi128(a, b, 0x00));
+    hi = _mm256_xor_si256(hi, _mm256_clmulepi64_epi128(a, b, 0x11));
+    mid = _mm256_xor_si256(mid, _mm256_clmulepi64_epi128(a, b, 0x01));
+    mid = _mm256_xor_si256(mid, _mm256_clmulepi64_epi128(a, b, 0x10));
+}
+
+VPCLMUL256_TARGET
+static inline __m128i sumLanes256(__m256i x)
+{
+    return _mm_xor_si128(_mm256_castsi256_si128(x), _mm256_extracti128_si256(x, 1));
+}
+
+template <bool Polyval>
+VPCLMUL256_TARGET
+static void updateVpclmul256(const GhashKey& key, qword_t& Y, const byte_t* data, size_t nBlocks)
+{
+    if (nBlocks >= (size_t)VPCLMUL_BLOCKS) {
+        const __m256i reverse = _mm256_broadcastsi128_si256(
+            _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+
+        // h[0] = H^16, H^15, h[7] = H^2, H^1
+        __m256i h[VPCLMUL_BLOCKS / 2];
+        for (int i = 0; i < VPCLMUL_BLOCKS / 2; ++i) {
+            __m256i p = _mm256_loadu_si256((const __m256i*)QWTOCBUF(
+                key.powers[VPCLMUL_BLOCKS - 2 * (i + 1)]));
+            h[i] = _mm256_permute4x64_epi64(p, 0x4E); // Lanes 1, 0
+        }
+
+        __m128i y = byteSwap(_mm_loadu_si128((const __m128i*)QWTOCBUF(Y)));
+
+        for (; nBlocks >= (size_t)VPCLMUL_BLOCKS; nBlocks -= VPCLMUL_BLOCKS) {
+            __m256i lo = _mm256_setzero_si256();
+            __m256i mid = _mm256_setzero_si256();
+            __m256i hi = _mm256_setzero_si256();
+
+            for (int i = 0; i < VPCLMUL_BLOCKS / 2; ++i) {
+                __m256i x = _mm256_loadu_si256((const __m256i*)(data + 32 * i));
+                if (!Polyval)
+                    x = _mm256_shuffle_epi8(x, reverse);
+                if (i == 0) {
+                    x = _mm256_xor_si256(x,
+                        _mm256_inserti128_si256(_mm256_setzero_si256(), y, 0));
+                }
+                mulAcc256(x, h[i], lo, mid, hi);
+            }
+
+            __m128i loSum = sumLanes256(lo);
+            __m128i hiSum = sumLanes256(hi);
+            __m128i midSum = _mm_xor_si128(sumLanes256(mid), _mm_xor_si128(loSum, hiSum));
+            y = reduce(loSum, midSum, hiSum);
+            data += VPCLMUL_BLOCKS * 16;
+        }
+
+        _mm_storeu_si128((__m128i*)QWTOBUF(Y), byteSwap(y));
+    }
+
+    if (nBlocks > 0 && Polyval)
+        polyvalUpdateClmul(key, Y, data, nBlocks);
+    else if (nBlocks > 0)
+        ghashUpdateClmul(key, Y, data, nBlocks);
+}
+
+VPCLMUL512_TARGET
+void ghashUpdateVpclmul512(const GhashKey& key, qword_t& Y, const byte_t* data, size_t nBlocks)
+{
+    updateVpclmul512<false>(key, Y, data, nBlocks);
+}
+
+VPCLMUL512_TARGET
+void polyvalUpdateVpclmul512(const GhashKey& key, qword_t& Y, const byte_t* data,
+    size_t nBlocks)
+{
+    updateVpclmul512<true>(key, Y, data, nBlocks);
+}
+
+VPCLMUL256_TARGET
+void ghashUpdateVpclmul256(const GhashKey& key, qword_t& Y, const byte_t* data, size_t nBlocks)
+{
+    updateVpclmul256<false>(key, Y, data, nBlocks);
+}
+
+VPCLMUL256_TARGET
+void polyvalUpdateVpclmul256(const GhashKey& key, qword_t& Y, const byte_t* data,
+    size_t nBlocks)
+{
+    updateVpclmul256<true>(key, Y, data, nBlocks);
+}
+
+#undef VPCLMUL512_TARGET
+#undef VPCLMUL256_TARGET
+
+} // namespace AES
+
+#endif
@@ -1,69 +1,223 @@
+#include <cstring>
+#include <vector>
+
 #include <libaes/libaes.hpp>
 #include <libaes/types_helper.hpp>
 #include <libaes/aes_cipher.hpp>
+#include <libaes/aes_engine.hpp>
+#include <libaes/aes_ghash.hpp>
+#include <libaes/thread_pool.hpp>
+#include <libaes/aes_mode.hpp>
+#include <libaes/aes_stats.hpp>
 
 #include <utility/logs.hpp>
 
 namespace AES
 {
 
+static inline uint64_t loadU64Be(const byte_t* b)
+{
+    return ((uint64_t)bytesToWord(b[0], b[1], b[2], b[3]) << 32)
+        | bytesToWord(b[4], b[5], b[6], b[7]);
+}
+
+static inline void storeU64Be(uint64_t v, byte_t* b)
+{
+    copyUIntToBuf((unsigned int)(v >> 32), b);
+    copyUIntToBuf((unsigned int)v, b + 4);
+}
+
+static inline word_t loadU32Le(const byte_t* b)
+{
+    return bytesToWord(b[3], b[2], b[1], b[0]);
+}
+
+static inline void storeU32Le(word_t v, byte_t* b)
+{
+    for (int i = 0; i < 4; ++i)
+        b[i] = (byte_t)(v >> (8 * i));
+}
+
 /**
- * Increment counter function, used for CTR and GCM only
+ * Write nBlocks consecutive counter blocks in keystream, then cipher them in a single call
+ * so the engine can keep all of them in flight
+ * The incBytes low bytes of the counter are incremented: 16 for CTR, 4 for GCM (inc32),
+ * SIV_INC_BYTES for the little endian 32 bits counter of GCM-SIV in the first 4 bytes
+ * Counter is left on the next unused value
 **/
-static inline void incCounter(qword_t& counter)
+static void ctrKeystream(const Engine* engine, const word_t* ksch, qword_t& counter,
+    int incBytes, byte_t* keystream, unsigned int nBlocks)
 {
-    qwordInc(counter, 16);
+    if (incBytes == 4) {
+        word_t ctr = bytesToWord(counter.b[12], counter.b[13], counter.b[14], counter.b[15]);
+        for (unsigned int i = 0; i < nBlocks; ++i) {
+            memcpy(keystream + 16 * i, QWTOCBUF(counter), 12);
+            copyUIntToBuf(ctr + i, keystream + 16 * i + 12); // mod 2^32
+        }
+        copyUIntToBuf(ctr + nBlocks, QWTOBUF(counter) + 12);
+    }
+    else if (incBytes == SIV_INC_BYTES) {
+        word_t ctr = loadU32Le(QWTOCBUF(counter));
+        for (unsigned int i = 0; i < nBlocks; ++i) {
+            storeU32Le(ctr + i, keystream + 16 * i); // mod 2^32
+            memcpy(keystream + 16 * i + 4, QWTOCBUF(counter) + 4, 12);
+        }
+        storeU32Le(ctr + nBlocks, QWTOBUF(counter));
+    }
+    else if (incBytes == 16) {
+        uint64_t hi = loadU64Be(QWTOCBUF(counter));
+        uint64_t lo = loadU64Be(QWTOCBUF(counter) + 8);
+        for (unsigned int i = 0; i < nBlocks; ++i) {
+            storeU64Be(hi, keystream + 16 * i);
+            storeU64Be(lo, keystream + 16 * i + 8);
+            if (++lo == 0)
+                ++hi;
+        }
+        storeU64Be(hi, QWTOBUF(counter));
+        storeU64Be(lo, QWTOBUF(counter) + 8);
+    }
+    else {
+        for (unsigned int i = 0; i < nBlocks; ++i) {
+            qwordCopy(counter, keystream + 16 * i);
+            qwordInc(counter, incBytes);
+        }
+    }
+
+    engine->cipherBlocks(keystream, nBlocks, ksch);
 }
 
-/*****************************
- * ECB
- ****************************/
-bool AES::ecb_encrypt(const byte_t* dataIn, byte_t* dataOut, unsigned int dataSize)
+/**
+ * Counter mode core, used for CTR, GCM (gctr) and GCM-SIV
+ * Keystream is produced ENGINE_BATCH_BLOCKS blocks at a time and xored on the whole batch
+ * Engines with their own counter mode (ctrBlocks) do the full blocks in one call
+ * The last block can be partial
+**/
+static void ctrCrypt(const Engine* engine, const word_t* ksch, qword_t& counter,
+    int incBytes, const byte_t* dataIn, byte_t* dataOut, size_t dataSize)
 {
-    const word_t* ksch = this->keySchedule.keys;
-    qword_t state;
-
-    unsigned int offsetData = 0;
-    unsigned int i = 0;
-    const unsigned int nBlocks = dataSize / 16;
-    while (i < nBlocks)
+    const unsigned int batchSize = ENGINE_BATCH_BLOCKS * AES::BLOCKSIZE;
+    byte_t keystream[ENGINE_BATCH_BLOCKS * AES::BLOCKSIZE];
+
+    size_t offsetData = 0;
+    if (engine->ctrBlocks != nullptr) {
+        size_t nBlocks = dataSize / AES::BLOCKSIZE;
+        engine->ctrBlocks(counter, incBytes, dataIn, dataOut, nBlocks, ksch);
+        offsetData = nBlocks * AES::BLOCKSIZE;
+    }
+    while (dataSize - offsetData >= batchSize)
     {
-        // Init the state (AES input)
-        memcpy(QWTOBUF(state), dataIn + offsetData, AES::BLOCKSIZE);
+        ctrKeystream(engine, ksch, counter, incBytes, keystream, ENGINE_BATCH_BLOCKS);
+        bufferXor(dataIn + offsetData, keystream, dataOut + offsetData, batchSize);
+        offsetData += batchSize;
+    }
 
-        // Cipher state
-        cipherBlock(QWTOBUF(state), ksch, this->Nr);
+    size_t remaining = dataSize - offsetData;
+    if (remaining > 0)
+    {
+        unsigned int n = (unsigned int)((remaining + AES::BLOCKSIZE - 1) / AES::BLOCKSIZE);
+        ctrKeystream(engine, ksch, counter, incBytes, keystream, n);
+        bufferXor(dataIn + offsetData, keystream, dataOut + offsetData, remaining);
+    }
+}
 
-        memcpy(dataOut + offsetData, QWTOCBUF(state), AES::BLOCKSIZE);
+/*****************************
+ * Threads
+ ****************************/
+// 1 when single threaded or when there is not enough data to split
+static unsigned int getChunkCount(const ThreadPool* pool, size_t dataSize)
+{
+    if (pool == nullptr || dataSize <= THREAD_CHUNK_SIZE)
+        return 1;
+    return (unsigned int)((dataSize - 1) / THREAD_CHUNK_SIZE + 1);
+}
 
-        ++i;
-        offsetData += AES::BLOCKSIZE;
+/*
+    Call chunkFunc(index, offset, size) on each chunk, in parallel when there is more than one
+    Template so a single chunk is a direct call, without building a std::function
+*/
+template <typename ChunkFunc>
+static void runChunks(ThreadPool* pool, size_t dataSize, const ChunkFunc& chunkFunc)
+{
+    unsigned int nChunks = getChunkCount(pool, dataSize);
+    if (nChunks == 1) {
+        chunkFunc(0, 0, dataSize);
+        return;
     }
 
-    return true;
+    pool->run(nChunks, [&](unsigned int index) {
+        size_t offset = (size_t)index * THREAD_CHUNK_SIZE;
+        size_t size = dataSize - offset;
+        if (size > THREAD_CHUNK_SIZE)
+            size = THREAD_CHUNK_SIZE;
+        chunkFunc(index, offset, size);
+    });
+}
+
+// counter += n on the incBytes low bytes, same rules as ctrKeystream (4, 16 or SIV_INC_BYTES)
+void ctrAdd(qword_t& counter, int incBytes, uint64_t n)
+{
+    if (incBytes == 4) {
+        word_t ctr = bytesToWord(counter.b[12], counter.b[13], counter.b[14], counter.b[15]);
+        copyUIntToBuf(ctr + (word_t)n, QWTOBUF(counter) + 12); // mod 2^32
+    }
+    else if (incBytes == SIV_INC_BYTES) {
+        storeU32Le(loadU32Le(QWTOCBUF(counter)) + (word_t)n, QWTOBUF(counter));
+    }
+    else {
+        uint64_t hi = loadU64Be(QWTOCBUF(counter));
+        uint64_t lo = loadU64Be(QWTOCBUF(counter) + 8);
+        lo += n;
+        if (lo < n)
+            ++hi;
+        storeU64Be(hi, QWTOBUF(counter));
+        storeU64Be(lo, QWTOBUF(counter) + 8);
+    }
 }
 
-bool AES::ecb_decrypt(const byte_t* dataIn, byte_t* dataOut, unsigned int dataSize)
+/*****************************
+ * ECB
+ ****************************/
+static void ecbCrypt(blocksFunc_t blocksFunc, const word_t* ksch,
+    const byte_t* dataIn, byte_t* dataOut, size_t dataSize)
 {
-    const word_t* ksch = this->keySchedule.keys;
-    qword_t state;
+    StatsScope stats(STAGE::ECB, dataSize, dataSize / AES::BLOCKSIZE);
 
-    unsigned int offsetData = 0;
-    unsigned int i = 0;
-    const unsigned int nBlocks = dataSize / 16;
-    while (i < nBlocks)
+    // Blocks are independent, cipher them by batch directly in the output buffer
+    size_t offsetData = 0;
+    size_t nBlocks = dataSize / 16;
+    while (nBlocks > 0)
     {
-        // Init the state (AES input)
-        memcpy(QWTOBUF(state), dataIn + offsetData, AES::BLOCKSIZE);
-
-        // Cipher state
-        decipherBlock(QWTOBUF(state), ksch, this->Nr);
+        unsigned int n = nBlocks < ENGINE_BATCH_BLOCKS ?
+            (unsigned int)nBlocks : ENGINE_BATCH_BLOCKS;
+        memmove(dataOut + offsetData, dataIn + offsetData, n * AES::BLOCKSIZE);
 
-        memcpy(dataOut + offsetData, QWTOCBUF(state), AES::BLOCKSIZE);
+        blocksFunc(dataOut + offsetData, n, ksch);
 
-        ++i;
-        offsetData += AES::BLOCKSIZE;
+        nBlocks -= n;
+        offsetData += n * AES::BLOCKSIZE;
     }
+}
+
+void ecbCryptChunks(ThreadPool* pool, blocksFunc_t blocksFunc, const word_t* ksch,
+    const byte_t* dataIn, byte_t* dataOut, size_t dataSize)
+{
+    runChunks(pool, dataSize, [&](unsigned int, size_t offset, size_t size) {
+        ecbCrypt(blocksFunc, ksch, dataIn + offset, dataOut + offset, size);
+    });
+}
+
+bool AES::ecb_encrypt(const byte_t* dataIn, byte_t* dataOut, size_t dataSize)
+{
+    ecbCryptChunks(this->threadPool, this->engine->cipherBlocks, this->keySchedule.encKeys,
+        dataIn, dataOut, dataSize);
+
+    return true;
+}
+
+bool AES::ecb_decrypt(const byte_t* dataIn, byte_t* dataOut, size_t dataSize)
+{
+    ecbCryptChunks(this->threadPool, this->engine->decipherBlocks, this->keySchedule.decKeys,
+        dataIn, dataOut, dataSize);
 
     return true;
 }
@@ -71,349 +225,1104 @@ bool AES::ecb_decrypt(const byte_t* dataIn, byte_t* dataOut, unsigned int dataSi
 /*****************************
  * CBC
  ****************************/
-bool AES::cbc_encrypt(const byte_t* dataIn, byte_t* dataOut, unsigned int dataSize)
+// Each block depends on the previous one, no batching possible
+void cbcEncrypt(const Engine* engine, const word_t* ksch, qword_t& nonce,
+    const byte_t* dataIn, byte_t* dataOut, size_t dataSize)
 {
-    const word_t* ksch = this->keySchedule.keys;
-    qword_t state;
-    qword_t nonce;
-
-    qwordCopy(this->iv, nonce);
+    StatsScope stats(STAGE::CBC, dataSize, dataSize / AES::BLOCKSIZE);
 
-    unsigned int offsetData = 0;
-    unsigned int i = 0;
-    const unsigned int nBlocks = dataSize / 16;
-    while (i < nBlocks)
+    size_t offsetData = 0;
+    const size_t nBlocks = dataSize / 16;
+    for (size_t i = 0; i < nBlocks; ++i)
     {
-        // Init the state (AES input)
-        memcpy(QWTOBUF(state), dataIn + offsetData, AES::BLOCKSIZE);
-
-        qwordXor(state, nonce);
+        bufferXor(dataIn + offsetData, QWTOCBUF(nonce), QWTOBUF(nonce), AES::BLOCKSIZE);
 
-        // Cipher state
-        cipherBlock(QWTOBUF(nonce), ksch, this->Nr);
+        engine->cipherBlock(QWTOBUF(nonce), ksch);
 
         memcpy(dataOut + offsetData, QWTOCBUF(nonce), AES::BLOCKSIZE);
 
-        ++i;
         offsetData += AES::BLOCKSIZE;
     }
-
-    return true;
 }
 
-bool AES::cbc_decrypt(const byte_t* dataIn, byte_t* dataOut, unsigned int dataSize)
+/*
+    P[i] = D(C[i]) ^ C[i-1] only depends on the ciphertext, so blocks are deciphered by batch
+    The batch is xored before being written, dataIn and dataOut can be the same buffer
+*/
+static void cbcDecrypt(const Engine* engine, const word_t* ksch, qword_t& nonce,
+    const byte_t* dataIn, byte_t* dataOut, size_t dataSize)
 {
-    const word_t* ksch = this->keySchedule.keys;
-    qword_t state;
-    qword_t nonce;
+    StatsScope stats(STAGE::CBC, dataSize, dataSize / AES::BLOCKSIZE);
+    byte_t batch[ENGINE_BATCH_BLOCKS * AES::BLOCKSIZE];
 
-    qwordCopy(this->iv, nonce);
-
-    unsigned int offsetData = 0;
-    unsigned int i = 0;
-    const unsigned int nBlocks = dataSize / 16;
-    while (i < nBlocks)
+    size_t offsetData = 0;
+    size_t nBlocks = dataSize / 16;
+    while (nBlocks > 0)
     {
-        // Init the state (AES input)
-        memcpy(QWTOBUF(state), dataIn + offsetData, AES::BLOCKSIZE);
+        unsigned int n = nBlocks < ENGINE_BATCH_BLOCKS ?
+            (unsigned int)nBlocks : ENGINE_BATCH_BLOCKS;
+        unsigned int size = n * AES::BLOCKSIZE;
+        const byte_t* cipherText = dataIn + offsetData;
 
-        // Cipher state
-        decipherBlock(QWTOBUF(state), ksch, this->Nr);
+        memcpy(batch, cipherText, size);
+        engine->decipherBlocks(batch, n, ksch);
 
-        qwordXor(nonce, state);
+        bufferXor(batch, QWTOCBUF(nonce), batch, AES::BLOCKSIZE);
+        bufferXor(batch + AES::BLOCKSIZE, cipherText, batch + AES::BLOCKSIZE,
+            size - AES::BLOCKSIZE);
+        qwordCopy(cipherText + size - AES::BLOCKSIZE, nonce);
 
-        memcpy(dataOut + offsetData, QWTOCBUF(state), AES::BLOCKSIZE);
+        memcpy(dataOut + offsetData, batch, size);
 
-        memcpy(QWTOBUF(nonce), dataIn + offsetData, AES::BLOCKSIZE);
+        nBlocks -= n;
+        offsetData += size;
+    }
+}
 
-        ++i;
-        offsetData += AES::BLOCKSIZE;
+void cbcDecryptChunks(ThreadPool* pool, const Engine* engine, const word_t* ksch,
+    qword_t& nonce, const byte_t* dataIn, byte_t* dataOut, size_t dataSize)
+{
+    if (dataSize < AES::BLOCKSIZE)
+        return;
+    unsigned int nChunks = getChunkCount(pool, dataSize);
+    if (nChunks == 1) {
+        cbcDecrypt(engine, ksch, nonce, dataIn, dataOut, dataSize);
+        return;
     }
 
+    // Each chunk starts from the last ciphertext block of the previous one
+    // They are all read before any chunk is written, for in place buffers
+    std::vector<qword_t> nonces(nChunks + 1);
+    qwordCopy(nonce, nonces[0]);
+    for (unsigned int i = 1; i < nChunks; ++i)
+        qwordCopy(dataIn + (size_t)i * THREAD_CHUNK_SIZE - AES::BLOCKSIZE, nonces[i]);
+    qwordCopy(dataIn + dataSize - AES::BLOCKSIZE, nonces[nChunks]);
+
+    runChunks(pool, dataSize, [&](unsigned int index, size_t offset, size_t size) {
+        qword_t chunkNonce;
+        qwordCopy(nonces[index], chunkNonce);
+        cbcDecrypt(engine, ksch, chunkNonce, dataIn + offset, dataOut + offset, size);
+    });
+
+    qwordCopy(nonces[nChunks], nonce);
+}
+
+bool AES::cbc_encrypt(const byte_t* dataIn, byte_t* dataOut, size_t dataSize)
+{
+    qword_t nonce;
+
+    qwordCopy(this->iv, nonce);
+    cbcEncrypt(this->engine, this->keySchedule.encKeys, nonce, dataIn, dataOut,
+        dataSize);
+
+    return true;
+}
+
+bool AES::cbc_decrypt(const byte_t* dataIn, byte_t* dataOut, size_t dataSize)
+{
+    qword_t nonce;
+
+    qwordCopy(this->iv, nonce);
+    cbcDecryptChunks(this->threadPool, this->engine, this->keySchedule.decKeys, nonce,
+        dataIn, dataOut, dataSize);
+
     return true;
 }
 
 /*****************************
  * CTR
  ****************************/
-bool AES::ctr_encrypt(const byte_t* dataIn, byte_t* dataOut, unsigned int dataSize)
+// Each chunk starts its counter at counter + offset / 16, counter is left on the next unused value
+void ctrCryptChunks(ThreadPool* pool, const Engine* engine, const word_t* ksch,
+    qword_t& counter, int incBytes, const byte_t* dataIn, byte_t* dataOut, size_t dataSize)
+{
+    runChunks(pool, dataSize, [&](unsigned int, size_t offset, size_t size) {
+        StatsScope stats(STAGE::CTR, size, AES::getBlockRoundedSize(size) / AES::BLOCKSIZE);
+        qword_t chunkCounter;
+        qwordCopy(counter, chunkCounter);
+        ctrAdd(chunkCounter, incBytes, offset / AES::BLOCKSIZE);
+        ctrCrypt(engine, ksch, chunkCounter, incBytes, dataIn + offset, dataOut + offset,
+            size);
+    });
+    ctrAdd(counter, incBytes, AES::getBlockRoundedSize(dataSize) / AES::BLOCKSIZE);
+}
+
+bool AES::ctr_encrypt(const byte_t* dataIn, byte_t* dataOut, size_t dataSize)
+{
+    qword_t counter;
+
+    qwordCopy(this->iv, counter);
+    ctrCryptChunks(this->threadPool, this->engine, this->keySchedule.encKeys, counter, 16,
+        dataIn, dataOut, dataSize);
+
+    return true;
+}
+
+bool AES::ctr_decrypt(const byte_t* dataIn, byte_t* dataOut, size_t dataSize)
 {
-    const word_t* ksch = this->keySchedule.keys;
-    qword_t state;
     qword_t counter;
 
     qwordCopy(this->iv, counter);
+    ctrCryptChunks(this->threadPool, this->engine, this->keySchedule.encKeys, counter, 16,
+        dataIn, dataOut, dataSize);
+
+    return true;
+}
+
+void inc32(qword_t& J)
+{
+    qwordInc(J, 4);
+}
+
+void gctr(const Engine* engine, const word_t* ksch, const qword_t& icb,
+    const byte_t* dataIn, byte_t* dataOut, size_t dataSize)
+{
+    // dataIn = X
+    // dataOut = Y
+    qword_t CB; // counter block
+    qwordCopy(icb, CB);
+    ctrCrypt(engine, ksch, CB, 4, dataIn, dataOut, dataSize);
+}
+
+/*****************************
+ * GCM
+ ****************************/
+static const unsigned int GCM_CHUNK_BLOCKS = 64; // 1KB, stays in L1 between gctr and ghash
+
+/**
+ * Stitched gctr + ghash, single pass over the data
+ * Each chunk is ciphered then hashed while still hot in cache
+ * On decrypt the ciphertext is hashed before being overwritten, so in place buffers are fine
+ * The last partial block is hashed from a zero padded copy, buffers are never written past dataSize
+**/
+static void gcmCryptHash(const Engine* engine, const word_t* ksch,
+    const GhashEngine* ghashEngine, const GhashKey& hashKey, qword_t& counter, qword_t& Y,
+    const byte_t* dataIn, byte_t* dataOut, size_t dataSize, bool decrypt)
+{
+    const unsigned int chunkSize = GCM_CHUNK_BLOCKS * AES::BLOCKSIZE;
+
+    // gctr and ghash alternate on each chunk, their time is summed here and recorded once
+    const bool timed = statsEnabled();
+    uint64_t gctrTicks = 0;
+    uint64_t ghashTicks = 0;
+    uint64_t t0 = timed ? statsTicks() : 0;
+    uint64_t t1 = t0;
+
+    size_t offsetData = 0;
+    size_t fullSize = dataSize - dataSize % AES::BLOCKSIZE;
+    while (offsetData < fullSize)
+    {
+        size_t size = fullSize - offsetData < chunkSize ? fullSize - offsetData : chunkSize;
+        const byte_t* cipherText = decrypt ? dataIn + offsetData : dataOut + offsetData;
 
-    unsigned int offsetData = 0;
-    unsigned int i = 0;
-    unsigned int nBlocks = dataSize / 16;
-    unsigned int lastBlock = dataSize % 16;
-    unsigned int blockSize = AES::BLOCKSIZE;
-    if (lastBlock != 0) {
-        nBlocks++;
-        if (nBlocks == 1) {
-            blockSize = lastBlock;
+        if (decrypt) {
+            ghashEngine->update(hashKey, Y, cipherText, size / AES::BLOCKSIZE);
+            if (timed)
+                t1 = statsTicks();
         }
+        ctrCrypt(engine, ksch, counter, 4, dataIn + offsetData, dataOut + offsetData, size);
+        if (timed) {
+            uint64_t t2 = statsTicks();
+            ghashTicks += t1 - t0;
+            gctrTicks += t2 - t1;
+            t0 = t1 = t2;
+        }
+        if (!decrypt) {
+            ghashEngine->update(hashKey, Y, cipherText, size / AES::BLOCKSIZE);
+            if (timed) {
+                t1 = statsTicks();
+                ghashTicks += t1 - t0;
+                t0 = t1;
+            }
+        }
+
+        offsetData += size;
     }
-    while (i < nBlocks)
+
+    size_t remaining = dataSize - fullSize;
+    if (remaining > 0)
     {
-        // Init the state (AES input)
-        qwordCopy(counter, state);
+        qword_t last = QWORD_STATIC_ZERO;
+        if (decrypt)
+            memcpy(QWTOBUF(last), dataIn + fullSize, remaining);
+        ctrCrypt(engine, ksch, counter, 4, dataIn + fullSize, dataOut + fullSize, remaining);
+        if (timed) {
+            t1 = statsTicks();
+            gctrTicks += t1 - t0;
+            t0 = t1;
+        }
+        if (!decrypt)
+            memcpy(QWTOBUF(last), dataOut + fullSize, remaining);
+        ghashEngine->update(hashKey, Y, QWTOCBUF(last), 1);
+        if (timed)
+            ghashTicks += statsTicks() - t0;
+    }
 
-        // Update counter
-        incCounter(counter);
+    if (timed) {
+        uint64_t nBlocks = AES::getBlockRoundedSize(dataSize) / AES::BLOCKSIZE;
+        recordStats(STAGE::GCTR, dataSize, nBlocks, gctrTicks);
+        recordStats(STAGE::GHASH, dataSize, nBlocks, ghashTicks);
+    }
+}
 
-        // Cipher state
-        cipherBlock(QWTOBUF(state), ksch, this->Nr);
+/*
+    Hashes of the THREAD_CHUNK_SIZE chunks of dataSize bytes, each one computed from 0,
+    are merged in order with Y = Y.H^n ^ chunk, n is the number of blocks of the chunk
+*/
+static void mergeChunkHashes(const GhashKey& hashKey, const std::vector<qword_t>& partials,
+    size_t dataSize, qword_t& Y)
+{
+    const unsigned int nChunks = (unsigned int)partials.size();
+    qword_t Hn;
+    ghashPower(hashKey, THREAD_CHUNK_SIZE / AES::BLOCKSIZE, Hn);
+    for (unsigned int i = 0; i < nChunks; ++i)
+    {
+        if (i == nChunks - 1) { // Last chunk can be shorter
+            size_t lastSize = dataSize - (size_t)i * THREAD_CHUNK_SIZE;
+            ghashPower(hashKey, (unsigned int)(AES::getBlockRoundedSize(lastSize) / AES::BLOCKSIZE),
+                Hn);
+        }
+        gmul(Hn, Y);
+        qwordXor(partials[i], Y);
+    }
+}
 
-        qword_t plainBlock;
-        memcpy(QWTOBUF(plainBlock), dataIn + offsetData, blockSize);
-        qwordXor(plainBlock, state);
+/*
+    Each chunk hashes its own ciphertext from 0, merged in order by mergeChunkHashes
+    Counter is left on the next unused value
+*/
+void gcmCryptHashChunks(ThreadPool* pool, const Engine* engine, const word_t* ksch,
+    const GhashEngine* ghashEngine, const GhashKey& hashKey, qword_t& counter, qword_t& Y,
+    const byte_t* dataIn, byte_t* dataOut, size_t dataSize, bool decrypt)
+{
+    unsigned int nChunks = getChunkCount(pool, dataSize);
+    if (nChunks == 1) {
+        gcmCryptHash(engine, ksch, ghashEngine, hashKey, counter, Y, dataIn, dataOut,
+            dataSize, decrypt);
+        return;
+    }
 
-        memcpy(dataOut + offsetData, QWTOCBUF(state), blockSize);
+    std::vector<qword_t> partials(nChunks); // Zero initialized
+    runChunks(pool, dataSize, [&](unsigned int index, size_t offset, size_t size) {
+        qword_t chunkCounter;
+        qwordCopy(counter, chunkCounter);
+        ctrAdd(chunkCounter, 4, offset / AES::BLOCKSIZE);
+        gcmCryptHash(engine, ksch, ghashEngine, hashKey, chunkCounter, partials[index],
+            dataIn + offset, dataOut + offset, size, decrypt);
+    });
+    ctrAdd(counter, 4, AES::getBlockRoundedSize(dataSize) / AES::BLOCKSIZE);
+    mergeChunkHashes(hashKey, partials, dataSize, Y);
+}
 
-        ++i;
-        if (i == nBlocks - 1 && lastBlock != 0)
-            blockSize = lastBlock;
-        offsetData += AES::BLOCKSIZE;
+// Y = GHASH of data zero padded to a multiple of 128 bits, from Y
+void ghashPadded(const GhashEngine* ghashEngine, const GhashKey& hashKey, qword_t& Y,
+    const byte_t* data, size_t dataSize)
+{
+    size_t fullSize = dataSize - dataSize % AES::BLOCKSIZE;
+    ghashEngine->update(hashKey, Y, data, fullSize / AES::BLOCKSIZE);
+    if (fullSize != dataSize) {
+        qword_t last = QWORD_STATIC_ZERO;
+        memcpy(QWTOBUF(last), data + fullSize, dataSize - fullSize);
+        ghashEngine->update(hashKey, Y, QWTOCBUF(last), 1);
     }
+}
 
-    return true;
+// J0 from the iv, 96 bits iv are used as is, others go through GHASH
+void gcmJ0(const GhashEngine* ghashEngine, const GhashKey& hashKey, const byte_t* iv,
+    unsigned int ivSize, qword_t& J0)
+{
+    StatsScope stats(STAGE::GCM_J0, ivSize,
+        ivSize == 12 ? 0 : AES::getBlockRoundedSize(ivSize) / AES::BLOCKSIZE + 1);
+    qwordZero(J0);
+    if (ivSize == 12) {
+        memcpy(QWTOBUF(J0), iv, ivSize);
+        J0.b[15] |= 0x01;
+    }
+    else {
+        qword_t rightPart = QWORD_STATIC_ZERO;
+        storeU64Be((uint64_t)ivSize * 8, QWTOBUF(rightPart) + 8);
+        ghashPadded(ghashEngine, hashKey, J0, iv, ivSize);
+        ghashEngine->update(hashKey, J0, QWTOCBUF(rightPart), 1);
+    }
 }
 
-bool AES::ctr_decrypt(const byte_t* dataIn, byte_t* dataOut, unsigned int dataSize)
+// Last GHASH block, aad size || cipher size, 64 bits each, IN BITS !
+void gcmHashSizes(const GhashEngine* ghashEngine, const GhashKey& hashKey, qword_t& Y,
+    uint64_t aadSize, uint64_t dataSize)
 {
-    const word_t* ksch = this->keySchedule.keys;
-    qword_t state;
-    qword_t counter;
+    qword_t Ssizes = QWORD_STATIC_ZERO;
+    storeU64Be(aadSize * 8, QWTOBUF(Ssizes));
+    storeU64Be(dataSize * 8, QWTOBUF(Ssizes) + 8);
+    ghashEngine->update(hashKey, Y, QWTOCBUF(Ssizes), 1);
+}
 
-    qwordCopy(this->iv, counter);
+void AES::gcmPreCounter(qword_t& J0)
+{
+    gcmJ0(this->ghashEngine, *this->ghashKey, this->iv, this->ivSize, J0);
+}
+
+// T = GCTR(Key, J0, S), S = GHASH(aad || C || sizes) already hashed up to C in Y
+void AES::gcmTag(const qword_t& J0, qword_t& Y, uint64_t dataSize, qword_t& T)
+{
+    StatsScope stats(STAGE::GCM_TAG, AES::BLOCKSIZE, 1);
+    gcmHashSizes(this->ghashEngine, *this->ghashKey, Y, this->aadSize, dataSize);
+
+    qwordZero(T);
+    gctr(this->engine, this->keySchedule.encKeys, J0, QWTOCBUF(Y), QWTOBUF(T),
+        AES::BLOCKSIZE);
+}
+
+bool AES::gcm_crypt(const byte_t* dataIn, byte_t* dataOut, size_t dataSize, bool decrypt)
+{
+    const word_t* ksch = this->keySchedule.encKeys;
+
+    // Read the tag
+    qword_t TAG;
+    if (decrypt) {
+        if (dataSize < AES::BLOCKSIZE)
+            return false;
+        dataSize -= 16;
+        memcpy(QWTOBUF(TAG), dataIn + dataSize, 16);
+    }
+    if (dataSize > GCM_MAX_DATA_SIZE)
+        return false;
+
+    // H and the GHASH tables are cached by initialize, see prepareGhash
+    const GhashKey& hashKey = *this->ghashKey;
+
+    // block J = iv avec concat...
+    qword_t J0;
+    this->gcmPreCounter(J0);
+
+    // block S = GHASH(H, aad || C || sizes), aad is already hashed by setAad
+    qword_t Sout;
+    qwordCopy(this->aadHash, Sout);
 
-    unsigned int offsetData = 0;
-    unsigned int i = 0;
-    unsigned int nBlocks = dataSize / 16;
-    unsigned int lastBlock = dataSize % 16;
-    unsigned int blockSize = AES::BLOCKSIZE;
-    if (lastBlock != 0) {
-        nBlocks++;
-        if (nBlocks == 1) {
-            blockSize = lastBlock;
+    // block C = GCTR(Key, inc32(J), Plain) = cipher ici, hashed on the fly
+    qword_t J;
+    qwordCopy(J0, J);
+    inc32(J);
+    gcmCryptHashChunks(this->threadPool, this->engine, ksch, this->ghashEngine, hashKey,
+        J, Sout, dataIn, dataOut, dataSize, decrypt);
+
+    // block size t = MSB(GCTR(Key, J, S)) = auth tag
+    qword_t T;
+    this->gcmTag(J0, Sout, dataSize, T);
+
+    // return (C, T), the plain text of a wrong tag is wiped, not released
+    TRACE_INFO("=> Authentification tag: ", bytesToHexString(QWTOCBUF(T), 16));
+    if (decrypt) {
+        if (!bufferEqual(QWTOCBUF(TAG), QWTOCBUF(T), AES::BLOCKSIZE)) {
+            TRACE_ERROR("Bad authentification tag !");
+            TRACE_ERROR("Tag expected : ", bytesToHexString(QWTOCBUF(TAG), 16));
+            if (dataSize > 0)
+                memset(dataOut, 0, dataSize);
+            return false;
         }
     }
-    while (i < nBlocks)
-    {
-        // Init the state (AES input)
-        qwordCopy(counter, state);
+    else {
+        memcpy(dataOut + dataSize, QWTOCBUF(T), 16); // Write tag at the end
+    }
+
+    return true;
+}
+
+bool AES::gcm_encrypt(const byte_t* dataIn, byte_t* dataOut, size_t dataSize)
+{
+    return gcm_crypt(dataIn, dataOut, dataSize, false);
+}
+
+bool AES::gcm_decrypt(const byte_t* dataIn, byte_t* dataOut, size_t dataSize)
+{
+    return gcm_crypt(dataIn, dataOut, dataSize, true);
+}
+
+/*****************************
+ * XTS
+ ****************************/
+// Written out so the compiler turns them into a single load or store on little endian CPUs
+static inline uint64_t loadU64Le(const byte_t* b)
+{
+    return (uint64_t)b[0] | ((uint64_t)b[1] << 8) | ((uint64_t)b[2] << 16)
+        | ((uint64_t)b[3] << 24) | ((uint64_t)b[4] << 32) | ((uint64_t)b[5] << 40)
+        | ((uint64_t)b[6] << 48) | ((uint64_t)b[7] << 56);
+}
+
+static inline void storeU64Le(uint64_t v, byte_t* b)
+{
+    b[0] = (byte_t)v;
+    b[1] = (byte_t)(v >> 8);
+    b[2] = (byte_t)(v >> 16);
+    b[3] = (byte_t)(v >> 24);
+    b[4] = (byte_t)(v >> 32);
+    b[5] = (byte_t)(v >> 40);
+    b[6] = (byte_t)(v >> 48);
+    b[7] = (byte_t)(v >> 56);
+}
 
-        // Update counter
-        incCounter(counter);
+/*
+    T = T.alpha in GF(2^128), the tweak is a little endian 128 bits integer (IEEE 1619 5.2)
+    Shifted left by one bit, x^128 = x^7 + x^2 + x + 1 folds the carry back in the low byte
+*/
+static inline void xtsDouble(uint64_t& lo, uint64_t& hi)
+{
+    uint64_t carry = hi >> 63;
+    hi = (hi << 1) | (lo >> 63);
+    lo = (lo << 1) ^ (((uint64_t)0 - carry) & 0x87);
+}
 
-        // Cipher state
-        cipherBlock(QWTOBUF(state), ksch, this->Nr);
+/**
+ * One data unit, T is its tweak already ciphered with the tweak key
+ * Full blocks go to the engine XTS primitive, or by batch: the tweaks of the batch are
+ * written once and xored before and after the engine call. A partial last block steals
+ * the end of the previous ciphertext block (IEEE 1619 5.3.2), dataSize is at least 16 bytes
+ * Everything is read before being written, dataIn and dataOut can be the same buffer
+**/
+static void xtsCrypt(const Engine* engine, const word_t* ksch, const qword_t& T,
+    const byte_t* dataIn, byte_t* dataOut, size_t dataSize, bool decrypt)
+{
+    const xtsBlocksFunc_t xtsBlocks = decrypt ?
+        engine->xtsDecipherBlocks : engine->xtsCipherBlocks;
+    const blocksFunc_t blocksFunc = decrypt ? engine->decipherBlocks : engine->cipherBlocks;
+    const blockFunc_t blockFunc = decrypt ? engine->decipherBlock : engine->cipherBlock;
+    byte_t tweaks[ENGINE_BATCH_BLOCKS * AES::BLOCKSIZE];
+    byte_t batch[ENGINE_BATCH_BLOCKS * AES::BLOCKSIZE];
+
+    const size_t lastSize = dataSize % AES::BLOCKSIZE;
+    size_t nBlocks = dataSize / AES::BLOCKSIZE - (lastSize > 0 ? 1 : 0);
+    size_t offsetData = 0;
+    qword_t tweak;
+    qwordCopy(T, tweak);
+    if (xtsBlocks != nullptr) {
+        xtsBlocks(tweak, dataIn, dataOut, nBlocks, ksch);
+        offsetData = nBlocks * AES::BLOCKSIZE;
+        nBlocks = 0;
+    }
 
-        qword_t cBlock;
-        memcpy(QWTOBUF(cBlock), dataIn + offsetData, blockSize);
-        qwordXor(cBlock, state);
+    uint64_t lo = loadU64Le(QWTOCBUF(tweak));
+    uint64_t hi = loadU64Le(QWTOCBUF(tweak) + 8);
+    while (nBlocks > 0)
+    {
+        unsigned int n = nBlocks < ENGINE_BATCH_BLOCKS ?
+            (unsigned int)nBlocks : ENGINE_BATCH_BLOCKS;
+        unsigned int size = n * AES::BLOCKSIZE;
+        for (unsigned int i = 0; i < n; ++i) {
+            storeU64Le(lo, tweaks + 16 * i);
+            storeU64Le(hi, tweaks + 16 * i + 8);
+            xtsDouble(lo, hi);
+        }
 
-        memcpy(dataOut + offsetData, QWTOCBUF(state), blockSize);
+        bufferXor(dataIn + offsetData, tweaks, batch, size);
+        blocksFunc(batch, n, ksch);
+        bufferXor(batch, tweaks, dataOut + offsetData, size);
 
-        ++i;
-        if (i == nBlocks - 1 && lastBlock != 0)
-            blockSize = lastBlock;
-        offsetData += AES::BLOCKSIZE;
+        nBlocks -= n;
+        offsetData += size;
     }
+    if (lastSize == 0)
+        return;
+
+    // Tweaks of the last full block (m - 1) and of the partial one (m)
+    // Deciphering uses them in reverse order, the stolen bytes come from block m - 1
+    byte_t first[AES::BLOCKSIZE];
+    byte_t second[AES::BLOCKSIZE];
+    storeU64Le(lo, first);
+    storeU64Le(hi, first + 8);
+    xtsDouble(lo, hi);
+    storeU64Le(lo, second);
+    storeU64Le(hi, second + 8);
+    const byte_t* tweakFull = decrypt ? second : first;
+    const byte_t* tweakLast = decrypt ? first : second;
+
+    byte_t block[AES::BLOCKSIZE];
+    byte_t last[AES::BLOCKSIZE];
+    bufferXor(dataIn + offsetData, tweakFull, block, AES::BLOCKSIZE);
+    blockFunc(block, ksch);
+    bufferXor(block, tweakFull, block, AES::BLOCKSIZE);
+    memcpy(last, dataIn + offsetData + AES::BLOCKSIZE, lastSize);
+    memcpy(last + lastSize, block + lastSize, AES::BLOCKSIZE - lastSize);
+    memcpy(dataOut + offsetData + AES::BLOCKSIZE, block, lastSize);
+
+    bufferXor(last, tweakLast, last, AES::BLOCKSIZE);
+    blockFunc(last, ksch);
+    bufferXor(last, tweakLast, dataOut + offsetData, AES::BLOCKSIZE);
+}
+
+bool AES::xts_encrypt(const byte_t* dataIn, byte_t* dataOut, size_t dataSize)
+{
+    if (dataSize < AES::BLOCKSIZE)
+        return false;
+    StatsScope stats(STAGE::XTS, dataSize, AES::getBlockRoundedSize(dataSize) / AES::BLOCKSIZE);
+    qword_t T;
+
+    qwordCopy(this->iv, T);
+    this->engine->cipherBlock(QWTOBUF(T), this->tweakSchedule.encKeys);
+    xtsCrypt(this->engine, this->keySchedule.encKeys, T, dataIn, dataOut, dataSize, false);
 
     return true;
 }
 
-// R = 0x10000111
-// https://nvlpubs.nist.gov/nistpubs/legacy/sp/nistspecialpublication800-38d.pdf
-void gmul(const qword_t& x, qword_t& y)
+bool AES::xts_decrypt(const byte_t* dataIn, byte_t* dataOut, size_t dataSize)
 {
-#define BITON(x, b) ((x) & (0x01 << (b)))
+    if (dataSize < AES::BLOCKSIZE)
+        return false;
+    StatsScope stats(STAGE::XTS, dataSize, AES::getBlockRoundedSize(dataSize) / AES::BLOCKSIZE);
+    qword_t T;
 
-    int carry;
-    qword_t v;
-    qword_t r = QWORD_STATIC_ZERO;
+    qwordCopy(this->iv, T);
+    this->engine->cipherBlock(QWTOBUF(T), this->tweakSchedule.encKeys);
+    xtsCrypt(this->engine, this->keySchedule.decKeys, T, dataIn, dataOut, dataSize, true);
 
-    r.b[0] = 0b11100001; // x128 + x7 + x2 + x + 1
-    qwordCopy(y, v);
-    qwordZero(y);
+    return true;
+}
 
-    for (int byte = 0; byte < 16; ++byte) {
-        byte_t xi = x.b[byte];
-        for (int bit = 7; bit >= 0; --bit) {
-            if (BITON(xi, bit)) {
-                qwordXor(v, y);
+/*
+    Chunks of whole sectors, about THREAD_CHUNK_SIZE bytes each
+    The tweaks of ENGINE_BATCH_BLOCKS sectors are ciphered in a single engine call
+*/
+bool AES::xtsSectors(const byte_t* dataIn, byte_t* dataOut, size_t sectorSize,
+    const uint64_t* sectors, size_t count, bool decrypt)
+{
+    if (!this->hasInit || this->mode != MODE::XTS || sectorSize < AES::BLOCKSIZE)
+        return false;
+    if (count == 0)
+        return true;
+    if (dataIn == nullptr || dataOut == nullptr || sectors == nullptr)
+        return false;
+
+    const Engine* engine = this->engine;
+    const word_t* ksch = decrypt ? this->keySchedule.decKeys : this->keySchedule.encKeys;
+    const word_t* tweakKsch = this->tweakSchedule.encKeys;
+    size_t chunkSectors = THREAD_CHUNK_SIZE / sectorSize;
+    if (chunkSectors == 0)
+        chunkSectors = 1;
+    const size_t nChunks = (count - 1) / chunkSectors + 1;
+
+    auto chunkFunc = [&](size_t index) {
+        size_t first = index * chunkSectors;
+        size_t n = count - first < chunkSectors ? count - first : chunkSectors;
+        StatsScope stats(STAGE::XTS, n * sectorSize,
+            n * (AES::getBlockRoundedSize(sectorSize) / AES::BLOCKSIZE));
+        qword_t T[ENGINE_BATCH_BLOCKS];
+
+        for (size_t i = 0; i < n; i += ENGINE_BATCH_BLOCKS)
+        {
+            unsigned int nTweaks = n - i < ENGINE_BATCH_BLOCKS ?
+                (unsigned int)(n - i) : ENGINE_BATCH_BLOCKS;
+            for (unsigned int j = 0; j < nTweaks; ++j) {
+                storeU64Le(sectors[first + i + j], QWTOBUF(T[j]));
+                storeU64Le(0, QWTOBUF(T[j]) + 8);
             }
-            carry = BITON(v.b[15], 0);
-            qwordShiftRight(v);
-            if (carry) {
-                qwordXor(r, v);
+            engine->cipherBlocks(QWTOBUF(T[0]), nTweaks, tweakKsch);
+
+            for (unsigned int j = 0; j < nTweaks; ++j) {
+                size_t offset = (first + i + j) * sectorSize;
+                xtsCrypt(engine, ksch, T[j], dataIn + offset, dataOut + offset, sectorSize,
+                    decrypt);
             }
         }
+    };
+
+    if (this->threadPool == nullptr || nChunks == 1) {
+        for (size_t i = 0; i < nChunks; ++i)
+            chunkFunc(i);
+    }
+    else {
+        this->threadPool->run((unsigned int)nChunks, [&](unsigned int index) {
+            chunkFunc(index);
+        });
     }
+    return true;
 }
 
-void ghash(const qword_t& H, const byte_t* aad, unsigned int aadSize, const qword_t& Ssizes,
-    const byte_t* dataOut, unsigned int dataSize, qword_t& Sout)
+bool AES::cipherSectors(const byte_t* pDataIn, byte_t* pDataOut, size_t pSectorSize,
+    const uint64_t* pSectors, size_t pCount)
 {
-    qword_t Y = QWORD_STATIC_ZERO;
-    qword_t tmp;
+    return this->xtsSectors(pDataIn, pDataOut, pSectorSize, pSectors, pCount, false);
+}
 
-    // X1.. = aad
-    for (unsigned int i = 0; i < aadSize; i += AES::BLOCKSIZE)
-    {
-        qwordCopy(aad + i, tmp);
-        qwordXor(tmp, Y);
-        gmul(H, Y);
-    }
+bool AES::decipherSectors(const byte_t* pDataIn, byte_t* pDataOut, size_t pSectorSize,
+    const uint64_t* pSectors, size_t pCount)
+{
+    return this->xtsSectors(pDataIn, pDataOut, pSectorSize, pSectors, pCount, true);
+}
 
-    // Xi.. = C
-    for (unsigned int i = 0; i < dataSize; i += AES::BLOCKSIZE)
-    {
-        qwordCopy(dataOut + i, tmp);
-        qwordXor(tmp, Y);
-        gmul(H, Y);
+/*****************************
+ * OCB
+ ****************************/
+// S.x in GF(2^128), big endian this time (RFC 7253 2): shifted left, the top bit folds in 0x87
+static void ocbDouble(const qword_t& in, qword_t& out)
+{
+    uint64_t hi = loadU64Be(QWTOCBUF(in));
+    uint64_t lo = loadU64Be(QWTOCBUF(in) + 8);
+    uint64_t carry = hi >> 63;
+    hi = (hi << 1) | (lo >> 63);
+    lo = (lo << 1) ^ (((uint64_t)0 - carry) & 0x87);
+    storeU64Be(hi, QWTOBUF(out));
+    storeU64Be(lo, QWTOBUF(out) + 8);
+}
+
+void ocbInitKey(const Engine* engine, const word_t* ksch, OcbKey& key)
+{
+    qwordZero(key.Lstar);
+    engine->cipherBlock(QWTOBUF(key.Lstar), ksch);
+    ocbDouble(key.Lstar, key.Ldollar);
+    ocbDouble(key.Ldollar, key.L[0]);
+    for (int i = 1; i < OCB_L_COUNT; ++i)
+        ocbDouble(key.L[i - 1], key.L[i]);
+}
+
+/*
+    Offset_0 from the nonce, 128 bits tag (RFC 7253 4.2)
+    Nonce = 0^7 || 0^(120 - bitlen(N)) || 1 || N, its last 6 bits pick the shift of Stretch
+*/
+void ocbOffset0(const Engine* engine, const word_t* ksch, const byte_t* nonce,
+    unsigned int nonceSize, qword_t& offset)
+{
+    qword_t Ktop = QWORD_STATIC_ZERO;
+    memcpy(QWTOBUF(Ktop) + AES::BLOCKSIZE - nonceSize, nonce, nonceSize);
+    Ktop.b[AES::BLOCKSIZE - 1 - nonceSize] |= 0x01;
+    unsigned int bottom = Ktop.b[15] & 0x3F;
+    Ktop.b[15] &= 0xC0;
+    engine->cipherBlock(QWTOBUF(Ktop), ksch);
+
+    // Stretch = Ktop || (Ktop[1..64] ^ Ktop[9..72]), Offset_0 = Stretch[1 + bottom..128 + bottom]
+    byte_t stretch[AES::BLOCKSIZE + 8];
+    memcpy(stretch, QWTOCBUF(Ktop), AES::BLOCKSIZE);
+    for (int i = 0; i < 8; ++i)
+        stretch[AES::BLOCKSIZE + i] = Ktop.b[i] ^ Ktop.b[i + 1];
+    unsigned int byteShift = bottom / 8;
+    unsigned int bitShift = bottom % 8;
+    for (unsigned int i = 0; i < AES::BLOCKSIZE; ++i) {
+        unsigned int b = (unsigned int)stretch[i + byteShift] << bitShift;
+        if (bitShift != 0)
+            b |= stretch[i + byteShift + 1] >> (8 - bitShift);
+        offset.b[i] = (byte_t)b;
     }
+}
 
-    // Xm = sizes
-    qwordXor(Ssizes, Y);
-    gmul(H, Y);
+// Offsets of ENGINE_BATCH_BLOCKS blocks at most from block number blockIndex + 1
+static inline void ocbOffsets(const OcbKey& key, qword_t& offset, uint64_t blockIndex,
+    byte_t* offsets, unsigned int nBlocks)
+{
+    for (unsigned int i = 0; i < nBlocks; ++i) {
+        qwordXor(key.L[ocbNtz(blockIndex + 1 + i)], offset);
+        qwordCopy(offset, offsets + 16 * i);
+    }
+}
 
-    qwordCopy(Y, Sout);
+/*
+    Offset_i = Offset_0 ^ the L_j of the bits j set in i ^ (i >> 1) (gray code of i),
+    so the offset of any block is found without going through the previous ones
+*/
+static void ocbSkip(const OcbKey& key, uint64_t from, uint64_t to, qword_t& offset)
+{
+    uint64_t bits = (from ^ (from >> 1)) ^ (to ^ (to >> 1));
+    for (int i = 0; bits != 0; ++i, bits >>= 1) {
+        if (bits & 1)
+            qwordXor(key.L[i], offset);
+    }
 }
 
-void inc32(qword_t& J)
+/*
+    HASH(K, A), same offsets as the message from Offset_0 = 0, Sum ^= E(A_i ^ Offset_i)
+    A partial last block gets 10* padding and L_*
+*/
+void ocbHash(const Engine* engine, const word_t* ksch, const OcbKey& key, const byte_t* aad,
+    size_t aadSize, qword_t& sum)
 {
-    qwordInc(J, 4);
+    StatsScope stats(STAGE::OCB, aadSize, AES::getBlockRoundedSize(aadSize) / AES::BLOCKSIZE);
+    byte_t batch[ENGINE_BATCH_BLOCKS * AES::BLOCKSIZE];
+    byte_t offsets[ENGINE_BATCH_BLOCKS * AES::BLOCKSIZE];
+    qword_t offset = QWORD_STATIC_ZERO;
+
+    qwordZero(sum);
+    size_t nBlocks = aadSize / AES::BLOCKSIZE;
+    uint64_t blockIndex = 0;
+    while (nBlocks > 0)
+    {
+        unsigned int n = nBlocks < ENGINE_BATCH_BLOCKS ?
+            (unsigned int)nBlocks : ENGINE_BATCH_BLOCKS;
+        ocbOffsets(key, offset, blockIndex, offsets, n);
+        bufferXor(aad + blockIndex * AES::BLOCKSIZE, offsets, batch, n * AES::BLOCKSIZE);
+        engine->cipherBlocks(batch, n, ksch);
+        for (unsigned int i = 0; i < n; ++i)
+            bufferXor(QWTOCBUF(sum), batch + 16 * i, QWTOBUF(sum), AES::BLOCKSIZE);
+
+        nBlocks -= n;
+        blockIndex += n;
+    }
+
+    size_t lastSize = aadSize % AES::BLOCKSIZE;
+    if (lastSize > 0) {
+        qword_t last = QWORD_STATIC_ZERO;
+        memcpy(QWTOBUF(last), aad + blockIndex * AES::BLOCKSIZE, lastSize);
+        last.b[lastSize] = 0x80;
+        qwordXor(key.Lstar, offset);
+        qwordXor(offset, last);
+        engine->cipherBlock(QWTOBUF(last), ksch);
+        qwordXor(last, sum);
+    }
 }
 
-void gctr(const word_t* ksch, int Nr, const qword_t& icb,
-    const byte_t* dataIn, byte_t* dataOut, unsigned int dataSize)
+/**
+ * nBlocks full blocks, C_i = Offset_i ^ E(P_i ^ Offset_i) and Checksum ^= P_i
+ * The engine primitive keeps the offsets in registers, otherwise the offsets of a batch
+ * are written once and xored before and after the engine call like XTS
+ * Everything is read before being written, dataIn and dataOut can be the same buffer
+**/
+static void ocbCrypt(const Engine* engine, const word_t* ksch, const OcbKey& key,
+    qword_t& offset, qword_t& checksum, uint64_t blockIndex, const byte_t* dataIn,
+    byte_t* dataOut, size_t nBlocks, bool decrypt)
 {
-    // dataIn = X
-    // dataOut = Y
-    unsigned int i = 0;
-    unsigned int offsetData = 0;
-    unsigned int nBlocks = dataSize / 16;
-    unsigned int lastBlock = dataSize % 16;
-    unsigned int blockSize = AES::BLOCKSIZE;
-    if (lastBlock != 0) {
-        nBlocks++;
-        if (nBlocks == 1) {
-            blockSize = lastBlock;
-        }
+    const ocbBlocksFunc_t ocbBlocks = decrypt ?
+        engine->ocbDecipherBlocks : engine->ocbCipherBlocks;
+    if (ocbBlocks != nullptr) {
+        ocbBlocks(offset, checksum, blockIndex, key.L, dataIn, dataOut, nBlocks, ksch);
+        return;
     }
 
-    qword_t CB; // counter block
-    qword_t cipherCB;
-    qword_t plainBlock; // cipher block out
-    qwordCopy(icb, CB);
-    while (i < nBlocks)
+    const blocksFunc_t blocksFunc = decrypt ? engine->decipherBlocks : engine->cipherBlocks;
+    byte_t offsets[ENGINE_BATCH_BLOCKS * AES::BLOCKSIZE];
+    byte_t batch[ENGINE_BATCH_BLOCKS * AES::BLOCKSIZE];
+    size_t offsetData = 0;
+    while (nBlocks > 0)
     {
-        qwordCopy(CB, cipherCB);
-        cipherBlock(QWTOBUF(cipherCB), ksch, Nr);
+        unsigned int n = nBlocks < ENGINE_BATCH_BLOCKS ?
+            (unsigned int)nBlocks : ENGINE_BATCH_BLOCKS;
+        unsigned int size = n * AES::BLOCKSIZE;
+        const byte_t* plain = decrypt ? dataOut + offsetData : dataIn + offsetData;
+        ocbOffsets(key, offset, blockIndex, offsets, n);
+
+        bufferXor(dataIn + offsetData, offsets, batch, size);
+        if (!decrypt) {
+            for (unsigned int i = 0; i < n; ++i)
+                bufferXor(QWTOCBUF(checksum), plain + 16 * i, QWTOBUF(checksum), 16);
+        }
+        blocksFunc(batch, n, ksch);
+        bufferXor(batch, offsets, dataOut + offsetData, size);
+        if (decrypt) {
+            for (unsigned int i = 0; i < n; ++i)
+                bufferXor(QWTOCBUF(checksum), plain + 16 * i, QWTOBUF(checksum), 16);
+        }
 
-        memcpy(QWTOBUF(plainBlock), dataIn + offsetData, blockSize);
-        qwordXor(plainBlock, cipherCB);
+        nBlocks -= n;
+        blockIndex += n;
+        offsetData += size;
+    }
+}
 
-        memcpy(dataOut + offsetData, QWTOBUF(cipherCB), blockSize);
+/*
+    Each chunk starts from its own offset, found with ocbSkip, and sums its own checksum
+    from 0, the checksums are xored together at the end
+*/
+void ocbCryptChunks(ThreadPool* pool, const Engine* engine, const word_t* ksch,
+    const OcbKey& key, qword_t& offset, qword_t& checksum, uint64_t blockIndex,
+    const byte_t* dataIn, byte_t* dataOut, size_t dataSize, bool decrypt)
+{
+    unsigned int nChunks = getChunkCount(pool, dataSize);
+    if (nChunks == 1) {
+        StatsScope stats(STAGE::OCB, dataSize, dataSize / AES::BLOCKSIZE);
+        ocbCrypt(engine, ksch, key, offset, checksum, blockIndex, dataIn, dataOut,
+            dataSize / AES::BLOCKSIZE, decrypt);
+        return;
+    }
 
-        inc32(CB);
-        ++i;
-        if (i == nBlocks - 1 && lastBlock != 0)
-            blockSize = lastBlock;
-        offsetData += AES::BLOCKSIZE;
+    std::vector<qword_t> partials(nChunks); // Zero initialized
+    runChunks(pool, dataSize, [&](unsigned int index, size_t offsetData, size_t size) {
+        StatsScope stats(STAGE::OCB, size, size / AES::BLOCKSIZE);
+        uint64_t first = blockIndex + offsetData / AES::BLOCKSIZE;
+        qword_t chunkOffset;
+        qwordCopy(offset, chunkOffset);
+        ocbSkip(key, blockIndex, first, chunkOffset);
+        ocbCrypt(engine, ksch, key, chunkOffset, partials[index], first, dataIn + offsetData,
+            dataOut + offsetData, size / AES::BLOCKSIZE, decrypt);
+    });
+
+    ocbSkip(key, blockIndex, blockIndex + dataSize / AES::BLOCKSIZE, offset);
+    for (unsigned int i = 0; i < nChunks; ++i)
+        qwordXor(partials[i], checksum);
+}
+
+/*
+    lastSize bytes left after the full blocks are xored with Pad = E(Offset_*), the checksum
+    takes them with 10* padding. T = E(Checksum ^ Offset ^ L_$) ^ HASH(K, A)
+    ksch are the encryption keys, offset and checksum are used up
+*/
+void ocbTag(const Engine* engine, const word_t* ksch, const OcbKey& key, qword_t& offset,
+    qword_t& checksum, const qword_t& aadHash, const byte_t* dataIn, byte_t* dataOut,
+    unsigned int lastSize, bool decrypt, qword_t& T)
+{
+    StatsScope stats(STAGE::OCB, lastSize, lastSize > 0 ? 2 : 1);
+
+    if (lastSize > 0) {
+        qword_t pad;
+        qword_t last = QWORD_STATIC_ZERO;
+        qwordXor(key.Lstar, offset);
+        qwordCopy(offset, pad);
+        engine->cipherBlock(QWTOBUF(pad), ksch);
+        if (!decrypt)
+            memcpy(QWTOBUF(last), dataIn, lastSize);
+        bufferXor(dataIn, QWTOCBUF(pad), dataOut, lastSize);
+        if (decrypt)
+            memcpy(QWTOBUF(last), dataOut, lastSize);
+        last.b[lastSize] = 0x80;
+        qwordXor(last, checksum);
     }
+
+    qwordCopy(checksum, T);
+    qwordXor(offset, T);
+    qwordXor(key.Ldollar, T);
+    engine->cipherBlock(QWTOBUF(T), ksch);
+    qwordXor(aadHash, T);
 }
 
-/*****************************
- * GCM
- ****************************/
-bool AES::gcm_crypt(const byte_t* dataIn, byte_t* dataOut, unsigned int dataSize, bool decrypt)
+bool AES::ocb_crypt(const byte_t* dataIn, byte_t* dataOut, size_t dataSize, bool decrypt)
 {
-    const word_t* ksch = this->keySchedule.keys;
+    const word_t* encKeys = this->keySchedule.encKeys;
 
     // Read the tag
     qword_t TAG;
-    byte_t* selectCryptBuffer;
     if (decrypt) {
-        dataSize -= 16;
-        memcpy(QWTOBUF(TAG), dataIn + dataSize, 16);
-        selectCryptBuffer = (byte_t*)dataIn;
-    }
-    else {
-        selectCryptBuffer = (byte_t*)dataOut;
+        if (dataSize < AES::BLOCKSIZE)
+            return false;
+        dataSize -= AES::BLOCKSIZE;
+        memcpy(QWTOBUF(TAG), dataIn + dataSize, AES::BLOCKSIZE);
     }
+    if (this->ivSize == 0) // The nonce is not optional
+        return false;
 
-    // block H = qword_t de 0
-    qword_t H = QWORD_STATIC_ZERO;
-    cipherBlock(QWTOBUF(H), ksch, this->Nr);
+    // The L table is cached by initialize and HASH(K, A) by setAad
+    const OcbKey& key = *this->ocbKey;
+    qword_t offset;
+    qword_t checksum = QWORD_STATIC_ZERO;
+    ocbOffset0(this->engine, encKeys, this->iv, this->ivSize, offset);
 
-    // block J = iv avec concat...
-    qword_t J = QWORD_STATIC_ZERO;
-    if (this->ivSize == 12) {
-        memcpy(QWTOBUF(J), this->iv, this->ivSize);
-        J.b[15] |= 0x01;
+    size_t fullSize = dataSize - dataSize % AES::BLOCKSIZE;
+    ocbCryptChunks(this->threadPool, this->engine,
+        decrypt ? this->keySchedule.decKeys : encKeys, key, offset, checksum, 0, dataIn,
+        dataOut, fullSize, decrypt);
+
+    qword_t T;
+    ocbTag(this->engine, encKeys, key, offset, checksum, this->aadHash, dataIn + fullSize,
+        dataOut + fullSize, (unsigned int)(dataSize - fullSize), decrypt, T);
+
+    // The plain text of a wrong tag is wiped, not released
+    TRACE_INFO("=> Authentification tag: ", bytesToHexString(QWTOCBUF(T), 16));
+    if (decrypt) {
+        if (!bufferEqual(QWTOCBUF(TAG), QWTOCBUF(T), AES::BLOCKSIZE)) {
+            TRACE_ERROR("Bad authentification tag !");
+            TRACE_ERROR("Tag expected : ", bytesToHexString(QWTOCBUF(TAG), 16));
+            if (dataSize > 0)
+                memset(dataOut, 0, dataSize);
+            return false;
+        }
     }
     else {
-        qword_t rightPart = QWORD_STATIC_ZERO;
-        copyUIntToBuf(this->ivSize * 8, QWTOBUF(rightPart) + 12);
-        ghash(H, nullptr, 0, rightPart, this->iv, getBlockRoundedSize(this->ivSize), J);
+        memcpy(dataOut + dataSize, QWTOCBUF(T), AES::BLOCKSIZE); // Write tag at the end
     }
-    qword_t J0;
-    qwordCopy(J, J0);
 
-    // block C = GCTR(Key, inc32(J), Plain) = cipher ici
-    inc32(J);
-    gctr(ksch, this->Nr, J, dataIn, dataOut, dataSize);
+    return true;
+}
 
-    qword_t Sout = QWORD_STATIC_ZERO;
-    qword_t Ssizes = QWORD_STATIC_ZERO;
-    // 0^32 || aad size || 0^32 || cipher size, IN BITS !
-    copyUIntToBuf(this->aadSize * 8, QWTOBUF(Ssizes) + 4);
-    copyUIntToBuf(dataSize * 8, QWTOBUF(Ssizes) + 12);
+bool AES::ocb_encrypt(const byte_t* dataIn, byte_t* dataOut, size_t dataSize)
+{
+    return ocb_crypt(dataIn, dataOut, dataSize, false);
+}
 
-    // Puts 0 at the end of cipher text for ghash
-    if (dataSize % AES::BLOCKSIZE != 0)
+bool AES::ocb_decrypt(const byte_t* dataIn, byte_t* dataOut, size_t dataSize)
+{
+    return ocb_crypt(dataIn, dataOut, dataSize, true);
+}
+
+/*****************************
+ * GCM-SIV
+ ****************************/
+/*
+    RFC 8452 4: block i = E(K, LE32(i) || nonce), the first 8 bytes of blocks 0 and 1 are the
+    POLYVAL key, the ones of blocks 2 to 3 (AES-128) or 5 (AES-256) the encryption key
+    The encryption key is new for every nonce, it is expanded by the engine (same Nr as the
+    key of the nonce) so the constant time engines keep its bytes out of the S-box table
+*/
+void sivDeriveKeys(const Engine* engine, const GhashEngine* ghashEngine, const word_t* ksch,
+    int Nk, const byte_t* nonce, SivKeys& keys)
+{
+    const unsigned int nBlocks = Nk == 8 ? 6 : 4;
+    byte_t blocks[6 * AES::BLOCKSIZE];
+    byte_t derived[6 * 8];
     {
-        int extraZeros = AES::BLOCKSIZE - (dataSize % AES::BLOCKSIZE);
-        memset(selectCryptBuffer + dataSize, 0, extraZeros);
+        StatsScope stats(STAGE::KEY_EXPANSION, nBlocks * 8, nBlocks + Nk + 7);
+        for (unsigned int i = 0; i < nBlocks; ++i) {
+            storeU32Le(i, blocks + 16 * i);
+            memcpy(blocks + 16 * i + 4, nonce, 12);
+        }
+        engine->cipherBlocks(blocks, nBlocks, ksch);
+        for (unsigned int i = 0; i < nBlocks; ++i)
+            memcpy(derived + 8 * i, blocks + 16 * i, 8);
+
+        engine->expandKey(derived + 16, keys.keys);
+        engine->prepareKeys(keys.keys, keys.encKeys, keys.decKeys);
     }
 
-    // block S = GHASH(H, block concat/padding)
-    ghash(H, this->aad, this->getBlockRoundedSize(this->aadSize),
-        Ssizes, selectCryptBuffer, getBlockRoundedSize(dataSize), Sout);
+    StatsScope stats(STAGE::GHASH_KEY, AES::BLOCKSIZE, 0);
+    qword_t H;
+    polyvalKey(derived, H);
+    ghashEngine->init(keys.hashKey, H);
+}
 
-    // block size t = MSB(GCTR(Key, J, S)) = auth tag
-    qword_t T = QWORD_STATIC_ZERO;
-    gctr(ksch, this->Nr, J0, QWTOCBUF(Sout), QWTOBUF(T), AES::BLOCKSIZE);
+// Y = POLYVAL of data zero padded to a multiple of 128 bits, from Y
+static void polyvalPadded(const GhashEngine* ghashEngine, const GhashKey& hashKey, qword_t& Y,
+    const byte_t* data, size_t dataSize)
+{
+    StatsScope stats(STAGE::GHASH, dataSize, AES::getBlockRoundedSize(dataSize) / AES::BLOCKSIZE);
+    size_t fullSize = dataSize - dataSize % AES::BLOCKSIZE;
+    ghashEngine->polyval(hashKey, Y, data, fullSize / AES::BLOCKSIZE);
+    if (fullSize != dataSize) {
+        qword_t last = QWORD_STATIC_ZERO;
+        memcpy(QWTOBUF(last), data + fullSize, dataSize - fullSize);
+        ghashEngine->polyval(hashKey, Y, QWTOCBUF(last), 1);
+    }
+}
+
+void sivHashChunks(ThreadPool* pool, const GhashEngine* ghashEngine, const GhashKey& hashKey,
+    qword_t& Y, const byte_t* data, size_t dataSize)
+{
+    unsigned int nChunks = getChunkCount(pool, dataSize);
+    if (nChunks == 1) {
+        polyvalPadded(ghashEngine, hashKey, Y, data, dataSize);
+        return;
+    }
+
+    std::vector<qword_t> partials(nChunks); // Zero initialized
+    runChunks(pool, dataSize, [&](unsigned int index, size_t offset, size_t size) {
+        polyvalPadded(ghashEngine, hashKey, partials[index], data + offset, size);
+    });
+    mergeChunkHashes(hashKey, partials, dataSize, Y);
+}
+
+// T = E(K_enc, S ^ nonce) with the last bit cleared, S = POLYVAL(aad || data || lengths)
+void sivTag(const Engine* engine, const GhashEngine* ghashEngine, const SivKeys& keys,
+    qword_t& Y, const byte_t* nonce, uint64_t aadSize, uint64_t dataSize, qword_t& T)
+{
+    StatsScope stats(STAGE::GCM_TAG, AES::BLOCKSIZE, 2);
+    qword_t lengths = QWORD_STATIC_ZERO;
+    storeU64Le(aadSize * 8, QWTOBUF(lengths));
+    storeU64Le(dataSize * 8, QWTOBUF(lengths) + 8);
+    ghashEngine->polyval(keys.hashKey, Y, QWTOCBUF(lengths), 1);
+
+    for (int i = 0; i < AES::BLOCKSIZE; ++i)
+        T.b[i] = Y.b[AES::BLOCKSIZE - 1 - i];
+    for (int i = 0; i < 12; ++i)
+        T.b[i] ^= nonce[i];
+    T.b[15] &= 0x7f;
+    engine->cipherBlock(QWTOBUF(T), keys.encKeys);
+}
 
-    // return (C, T)
+void sivCounter(const byte_t* tag, qword_t& counter)
+{
+    qwordCopy(tag, counter);
+    counter.b[15] |= 0x80;
+}
+
+/*
+    Two passes: on encrypt the tag is the counter of CTR so the plaintext is hashed first,
+    on decrypt the counter is the received tag and the plaintext is hashed once deciphered
+*/
+bool AES::siv_crypt(const byte_t* dataIn, byte_t* dataOut, size_t dataSize, bool decrypt)
+{
+    // Read the tag
+    qword_t TAG;
+    if (decrypt) {
+        if (dataSize < AES::BLOCKSIZE)
+            return false;
+        dataSize -= AES::BLOCKSIZE;
+        memcpy(QWTOBUF(TAG), dataIn + dataSize, AES::BLOCKSIZE);
+    }
+    if (this->ivSize == 0 || dataSize > SIV_MAX_DATA_SIZE)
+        return false;
+
+    // Message keys are derived by setIv, the aad is hashed by setAad
+    const SivKeys& keys = *this->sivKeys;
+    qword_t Y;
+    qword_t counter;
+    qwordCopy(this->aadHash, Y);
+
+    if (decrypt) {
+        sivCounter(QWTOCBUF(TAG), counter);
+        ctrCryptChunks(this->threadPool, this->engine, keys.encKeys, counter, SIV_INC_BYTES,
+            dataIn, dataOut, dataSize);
+        sivHashChunks(this->threadPool, this->ghashEngine, keys.hashKey, Y, dataOut, dataSize);
+    }
+    else {
+        sivHashChunks(this->threadPool, this->ghashEngine, keys.hashKey, Y, dataIn, dataSize);
+    }
+
+    qword_t T;
+    sivTag(this->engine, this->ghashEngine, keys, Y, this->iv, this->aadSize, dataSize, T);
+
+    // The plain text of a wrong tag is wiped, not released (RFC 8452 5)
     TRACE_INFO("=> Authentification tag: ", bytesToHexString(QWTOCBUF(T), 16));
     if (decrypt) {
-        if (memcmp(QWTOCBUF(TAG), QWTOCBUF(T), 16) != 0) {
+        if (!bufferEqual(QWTOCBUF(TAG), QWTOCBUF(T), AES::BLOCKSIZE)) {
             TRACE_ERROR("Bad authentification tag !");
             TRACE_ERROR("Tag expected : ", bytesToHexString(QWTOCBUF(TAG), 16));
+            if (dataSize > 0)
+                memset(dataOut, 0, dataSize);
             return false;
         }
     }
     else {
-        memcpy(dataOut + dataSize, QWTOCBUF(T), 16); // Write tag at the end
+        sivCounter(QWTOCBUF(T), counter);
+        ctrCryptChunks(this->threadPool, this->engine, keys.encKeys, counter, SIV_INC_BYTES,
+            dataIn, dataOut, dataSize);
+        memcpy(dataOut + dataSize, QWTOCBUF(T), AES::BLOCKSIZE); // Write tag at the end
     }
 
     return true;
 }
 
-bool AES::gcm_encrypt(const byte_t* dataIn, byte_t* dataOut, unsigned int dataSize)
+bool AES::siv_encrypt(const byte_t* dataIn, byte_t* dataOut, size_t dataSize)
 {
-    return gcm_crypt(dataIn, dataOut, dataSize, false);
+    return siv_crypt(dataIn, dataOut, dataSize, false);
 }
 
-bool AES::gcm_decrypt(const byte_t* dataIn, byte_t* dataOut, unsigned int dataSize)
+bool AES::siv_decrypt(const byte_t* dataIn, byte_t* dataOut, size_t dataSize)
 {
-    return gcm_crypt(dataIn, dataOut, dataSize, true);
+    return siv_crypt(dataIn, dataOut, dataSize, true);
+}
+
+/*****************************
+ * Mode table
+ ****************************/
+// nullptr for an unknown mode
+const AES::ModeKernels* AES::getModeKernels(MODE pMode)
+{
+    static const ModeKernels ECB_KERNELS = { &AES::ecb_encrypt, &AES::ecb_decrypt };
+    static const ModeKernels CBC_KERNELS = { &AES::cbc_encrypt, &AES::cbc_decrypt };
+    static const ModeKernels CTR_KERNELS = { &AES::ctr_encrypt, &AES::ctr_decrypt };
+    static const ModeKernels GCM_KERNELS = { &AES::gcm_encrypt, &AES::gcm_decrypt };
+    static const ModeKernels XTS_KERNELS = { &AES::xts_encrypt, &AES::xts_decrypt };
+    static const ModeKernels OCB_KERNELS = { &AES::ocb_encrypt, &AES::ocb_decrypt };
+    static const ModeKernels SIV_KERNELS = { &AES::siv_encrypt, &AES::siv_decrypt };
+
+    switch (pMode)
+    {
+    case MODE::ECB:
+        return &ECB_KERNELS;
+    case MODE::CBC:
+        return &CBC_KERNELS;
+    case MODE::CTR:
+        return &CTR_KERNELS;
+    case MODE::GCM:
+        return &GCM_KERNELS;
+    case MODE::XTS:
+        return &XTS_KERNELS;
+    case MODE::OCB:
+        return &OCB_KERNELS;
+    case MODE::GCM_SIV:
+        return &SIV_KERNELS;
+    }
+    return nullptr;
 }
 
 } // namespace AES
@@ -0,0 +1,110 @@
+#ifndef LIBAES_AES_MODE_HPP
+#define LIBAES_AES_MODE_HPP
+
+#include <cstddef>
+
+#include <libaes/types.hpp>
+#include <libaes/aes_engine.hpp>
+#include <libaes/aes_ghash.hpp>
+
+namespace AES
+{
+
+class ThreadPool;
+
+// Data is split in chunks of this size between threads, multiple of ENGINE_BATCH_BLOCKS blocks
+static const unsigned int THREAD_CHUNK_SIZE = 1 << 20;
+
+// GCM counter is 32 bits, a message can't be longer than 2^32 - 2 blocks (SP 800-38D 5.2.1.1)
+static const uint64_t GCM_MAX_DATA_SIZE = (((uint64_t)1 << 32) - 2) * 16;
+
+// GCM-SIV counter, 32 bits little endian in the first 4 bytes, see ctrAdd
+static const int SIV_INC_BYTES = -4;
+// Plaintext and aad of GCM-SIV, the counter wraps without repeating a block (RFC 8452 6)
+static const uint64_t SIV_MAX_DATA_SIZE = (uint64_t)1 << 36;
+
+/**
+ * Mode kernels shared by the one shot and the streaming API, aes_mode.cpp
+ * They run on the thread pool when there is one (nullptr = single thread)
+ * Chaining values and counters are left ready for the next call
+ * dataSize is a multiple of 16 bytes, except for CTR and GCM
+**/
+void ctrAdd(qword_t& counter, int incBytes, uint64_t n);
+void ecbCryptChunks(ThreadPool* pool, blocksFunc_t blocksFunc, const word_t* ksch,
+    const byte_t* dataIn, byte_t* dataOut, size_t dataSize);
+void cbcEncrypt(const Engine* engine, const word_t* ksch, qword_t& nonce,
+    const byte_t* dataIn, byte_t* dataOut, size_t dataSize);
+void cbcDecryptChunks(ThreadPool* pool, const Engine* engine, const word_t* ksch,
+    qword_t& nonce, const byte_t* dataIn, byte_t* dataOut, size_t dataSize);
+void ctrCryptChunks(ThreadPool* pool, const Engine* engine, const word_t* ksch,
+    qword_t& counter, int incBytes, const byte_t* dataIn, byte_t* dataOut, size_t dataSize);
+void gcmCryptHashChunks(ThreadPool* pool, const Engine* engine, const word_t* ksch,
+    const GhashEngine* ghashEngine, const GhashKey& hashKey, qword_t& counter, qword_t& Y,
+    const byte_t* dataIn, byte_t* dataOut, size_t dataSize, bool decrypt);
+
+/**
+ * GCM pieces that only depend on the hash key, shared with the multi-buffer calls
+ * ghashPadded hashes data zero padded to a multiple of 16 bytes, the iv doesn't need padding
+**/
+void ghashPadded(const GhashEngine* ghashEngine, const GhashKey& hashKey, qword_t& Y,
+    const byte_t* data, size_t dataSize);
+void gcmJ0(const GhashEngine* ghashEngine, const GhashKey& hashKey, const byte_t* iv,
+    unsigned int ivSize, qword_t& J0);
+void gcmHashSizes(const GhashEngine* ghashEngine, const GhashKey& hashKey, qword_t& Y,
+    uint64_t aadSize, uint64_t dataSize);
+
+/**
+ * OCB (RFC 7253) pieces, shared with the stream and multi-buffer calls
+ * L_* = E(0^128), L_$ = double(L_*), L[0] = double(L_$), L[i] = double(L[i - 1])
+ * Block i xors L[ntz(i)] in the offset, 64 entries cover every 64 bits block number
+ * ocbCryptChunks does the full blocks from block number blockIndex + 1, offset and checksum
+ * are left on the last one for ocbTag, which does the partial last block and the tag
+**/
+static const int OCB_L_COUNT = 64;
+
+struct OcbKey
+{
+    qword_t Lstar;
+    qword_t Ldollar;
+    qword_t L[OCB_L_COUNT];
+};
+
+void ocbInitKey(const Engine* engine, const word_t* ksch, OcbKey& key);
+void ocbOffset0(const Engine* engine, const word_t* ksch, const byte_t* nonce,
+    unsigned int nonceSize, qword_t& offset);
+void ocbHash(const Engine* engine, const word_t* ksch, const OcbKey& key, const byte_t* aad,
+    size_t aadSize, qword_t& sum);
+void ocbCryptChunks(ThreadPool* pool, const Engine* engine, const word_t* ksch,
+    const OcbKey& key, qword_t& offset, qword_t& checksum, uint64_t blockIndex,
+    const byte_t* dataIn, byte_t* dataOut, size_t dataSize, bool decrypt);
+void ocbTag(const Engine* engine, const word_t* ksch, const OcbKey& key, qword_t& offset,
+    qword_t& checksum, const qword_t& aadHash, const byte_t* dataIn, byte_t* dataOut,
+    unsigned int lastSize, bool decrypt, qword_t& T);
+
+/**
+ * GCM-SIV (RFC 8452) pieces, shared with the multi-buffer calls
+ * Each nonce has its own POLYVAL key and message encryption key, sivDeriveKeys builds them
+ * from the key generating key ksch (Nk = 4 or 8)
+ * Y accumulators are POLYVAL values in GHASH order, see GhashEngine, they start at 0
+ * sivHashChunks hashes data zero padded to a multiple of 16 bytes, chunks are merged like GCM
+ * sivTag adds the lengths block to Y, the counter of CTR is the tag with its last bit set
+**/
+struct SivKeys
+{
+    alignas(16) word_t keys[4 * 15]; // AES-256 schedule
+    alignas(16) word_t encKeys[4 * 15];
+    alignas(16) word_t decKeys[4 * 15]; // Built by prepareKeys, not used
+    GhashKey hashKey;
+};
+
+void sivDeriveKeys(const Engine* engine, const GhashEngine* ghashEngine, const word_t* ksch,
+    int Nk, const byte_t* nonce, SivKeys& keys);
+void sivHashChunks(ThreadPool* pool, const GhashEngine* ghashEngine, const GhashKey& hashKey,
+    qword_t& Y, const byte_t* data, size_t dataSize);
+void sivTag(const Engine* engine, const GhashEngine* ghashEngine, const SivKeys& keys,
+    qword_t& Y, const byte_t* nonce, uint64_t aadSize, uint64_t dataSize, qword_t& T);
+void sivCounter(const byte_t* tag, qword_t& counter);
+
+} // namespace AES
+
+#endif
@@ -0,0 +1,267 @@
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <libaes/libaes.hpp>
+#include <libaes/aes_stats.hpp>
+
+namespace AES
+{
+
+std::atomic<bool> statsActive(false);
+
+/*****************************
+ * Per thread counters
+ ****************************/
+struct StageCounters
+{
+    std::atomic<uint64_t> calls;
+    std::atomic<uint64_t> bytes;
+    std::atomic<uint64_t> blocks;
+    std::atomic<uint64_t> ticks;       // Library stages, see statsTicks
+    std::atomic<uint64_t> nanoseconds; // Stages given to addStats
+};
+
+// Only written by its thread, read and reset by the others
+struct ThreadStats
+{
+    StageCounters stages[STAGE_COUNT];
+};
+
+/*
+    Every live thread that recorded something, and the sum of the ended ones
+    Allocated once and never freed: threads can end after the static destructors
+*/
+struct StatsRegistry
+{
+    std::mutex mutex;
+    std::vector<ThreadStats*> threads;
+    ThreadStats retired;
+    unsigned int retiredThreads;
+    uint64_t startTicks; // Reference point to convert ticks into nanoseconds
+    std::chrono::steady_clock::time_point startTime;
+};
+
+static StatsRegistry& getRegistry()
+{
+    static StatsRegistry* registry = new StatsRegistry(); // Zero initialized
+    return *registry;
+}
+
+static void addCounter(std::atomic<uint64_t>& counter, uint64_t value)
+{
+    counter.fetch_add(value, std::memory_order_relaxed);
+}
+
+static uint64_t readCounter(const std::atomic<uint64_t>& counter)
+{
+    return counter.load(std::memory_order_relaxed);
+}
+
+static bool hasCalls(const ThreadStats& stats)
+{
+    for (const StageCounters& stage : stats.stages) {
+        if (readCounter(stage.calls) != 0)
+            return true;
+    }
+    return false;
+}
+
+static void clearStats(ThreadStats& stats)
+{
+    for (StageCounters& stage : stats.stages) {
+        stage.calls.store(0, std::memory_order_relaxed);
+        stage.bytes.store(0, std::memory_order_relaxed);
+        stage.blocks.store(0, std::memory_order_relaxed);
+        stage.ticks.store(0, std::memory_order_relaxed);
+        stage.nanoseconds.store(0, std::memory_order_relaxed);
+    }
+}
+
+static void mergeStats(const ThreadStats& from, ThreadStats& to)
+{
+    for (int i = 0; i < STAGE_COUNT; ++i) {
+        addCounter(to.stages[i].calls, readCounter(from.stages[i].calls));
+        addCounter(to.stages[i].bytes, readCounter(from.stages[i].bytes));
+        addCounter(to.stages[i].blocks, readCounter(from.stages[i].blocks));
+        addCounter(to.stages[i].ticks, readCounter(from.stages[i].ticks));
+        addCounter(to.stages[i].nanoseconds, readCounter(from.stages[i].nanoseconds));
+    }
+}
+
+// Registered on the first record of the thread, merged into retired when the thread ends
+struct ThreadSlot
+{
+    ThreadStats* stats;
+
+    ~ThreadSlot()
+    {
+        if (this->stats == nullptr)
+            return;
+        StatsRegistry& registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        if (hasCalls(*this->stats))
+            ++registry.retiredThreads;
+        mergeStats(*this->stats, registry.retired);
+        for (size_t i = 0; i < registry.threads.size(); ++i) {
+            if (registry.threads[i] == this->stats) {
+                registry.threads.erase(registry.threads.begin() + i);
+                break;
+            }
+        }
+        delete this->stats;
+    }
+};
+
+static thread_local ThreadSlot threadSlot = { nullptr };
+
+static ThreadStats& getThreadStats()
+{
+    if (threadSlot.stats == nullptr) {
+        ThreadStats* stats = new ThreadStats(); // Zero initialized
+        StatsRegistry& registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.threads.push_back(stats);
+        threadSlot.stats = stats;
+    }
+    return *threadSlot.stats;
+}
+
+void recordStats(STAGE stage, uint64_t bytes, uint64_t blocks, uint64_t ticks)
+{
+    StageCounters& counters = getThreadStats().stages[(int)stage];
+    addCounter(counters.calls, 1);
+    addCounter(counters.bytes, bytes);
+    addCounter(counters.blocks, blocks);
+    addCounter(counters.ticks, ticks);
+}
+
+/*****************************
+ * API
+ ****************************/
+void AES::enableStats(bool pEnable)
+{
+    StatsRegistry& registry = getRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    if (pEnable && !statsEnabled()) {
+        registry.startTicks = statsTicks();
+        registry.startTime = std::chrono::steady_clock::now();
+    }
+    statsActive.store(pEnable, std::memory_order_relaxed);
+}
+
+bool AES::isStatsEnabled()
+{
+    return statsEnabled();
+}
+
+void AES::resetStats()
+{
+    StatsRegistry& registry = getRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (ThreadStats* stats : registry.threads)
+        clearStats(*stats);
+    clearStats(registry.retired);
+    registry.retiredThreads = 0;
+}
+
+// Ignored while statistics are off, like the library stages
+void AES::addStats(STAGE pStage, uint64_t pBytes, uint64_t pNanoseconds)
+{
+    if (!statsEnabled())
+        return;
+    StageCounters& counters = getThreadStats().stages[(int)pStage];
+    addCounter(counters.calls, 1);
+    addCounter(counters.bytes, pBytes);
+    addCounter(counters.blocks, (pBytes + BLOCKSIZE - 1) / BLOCKSIZE);
+    addCounter(counters.nanoseconds, pNanoseconds);
+}
+
+/*
+    Ticks are nanoseconds already without a time stamp counter
+    Otherwise its frequency is measured against steady_clock since enableStats
+*/
+void AES::getStats(Stats& pStats)
+{
+    StatsRegistry& registry = getRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    ThreadStats total = {};
+    mergeStats(registry.retired, total);
+    pStats.threads = registry.retiredThreads;
+    for (const ThreadStats* stats : registry.threads) {
+        if (hasCalls(*stats))
+            ++pStats.threads;
+        mergeStats(*stats, total);
+    }
+
+    double nsPerTick = 1.0;
+#if defined(LIBAES_X86)
+    uint64_t elapsedTicks = statsTicks() - registry.startTicks;
+    double elapsedNs = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - registry.startTime).count();
+    nsPerTick = elapsedTicks > 0 ? elapsedNs / (double)elapsedTicks : 0.0;
+#endif
+
+    for (int i = 0; i < STAGE_COUNT; ++i) {
+        const StageCounters& counters = total.stages[i];
+        StageStats& stage = pStats.stages[i];
+        uint64_t ticks = readCounter(counters.ticks);
+        stage.calls = readCounter(counters.calls);
+        stage.bytes = readCounter(counters.bytes);
+        stage.blocks = readCounter(counters.blocks);
+        stage.nanoseconds = readCounter(counters.nanoseconds) + (uint64_t)(ticks * nsPerTick);
+#if defined(LIBAES_X86)
+        stage.cycles = ticks;
+#else
+        stage.cycles = 0;
+#endif
+    }
+}
+
+/*
+    One line per stage that was called, then crypto time against READ/WRITE time
+    Times are summed over threads, the stages of a multi-threaded call add up
+*/
+std::string AES::getStatsReport()
+{
+    Stats stats;
+    AES::getStats(stats);
+
+    char line[160];
+    std::string report;
+    snprintf(line, sizeof(line), "%-14s %10s %14s %12s %12s %10s %10s\n", "Stage", "Calls",
+        "Bytes", "Blocks", "Time (ms)", "MB/s", "Cycles/B");
+    report += line;
+
+    double cryptoMs = 0;
+    double ioMs = 0;
+    for (int i = 0; i < STAGE_COUNT; ++i)
+    {
+        const StageStats& stage = stats.stages[i];
+        if (stage.calls == 0)
+            continue;
+
+        double ms = (double)stage.nanoseconds / 1e6;
+        double mbs = stage.nanoseconds > 0 ? (double)stage.bytes * 1e3 / (double)stage.nanoseconds : 0;
+        double cyclesPerByte = stage.bytes > 0 ? (double)stage.cycles / (double)stage.bytes : 0;
+        snprintf(line, sizeof(line), "%-14s %10llu %14llu %12llu %12.3f %10.1f %10.2f\n",
+            AES::getStageFromEnum((STAGE)i).c_str(), (unsigned long long)stage.calls,
+            (unsigned long long)stage.bytes, (unsigned long long)stage.blocks, ms, mbs,
+            cyclesPerByte);
+        report += line;
+
+        if ((STAGE)i == STAGE::READ || (STAGE)i == STAGE::WRITE)
+            ioMs += ms;
+        else
+            cryptoMs += ms;
+    }
+
+    snprintf(line, sizeof(line), "Crypto: %.3f ms, I/O: %.3f ms, threads: %u", cryptoMs, ioMs,
+        stats.threads);
+    report += line;
+    return report;
+}
+
+} // namespace AES
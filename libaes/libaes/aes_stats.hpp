@@ -0,0 +1,77 @@
+#ifndef LIBAES_AES_STATS_HPP
+#define LIBAES_AES_STATS_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include <libaes/libaes.hpp>
+#include <libaes/cpu_features.hpp>
+
+#if defined(LIBAES_X86)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+namespace AES
+{
+
+// Set by AES::enableStats, read relaxed on the hot path
+extern std::atomic<bool> statsActive;
+
+inline bool statsEnabled()
+{
+    return statsActive.load(std::memory_order_relaxed);
+}
+
+// Time stamp counter on x86, steady_clock nanoseconds elsewhere, getStats converts them
+inline uint64_t statsTicks()
+{
+#if defined(LIBAES_X86)
+    return __rdtsc();
+#else
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// Adds to the counters of the calling thread, aes_stats.cpp
+void recordStats(STAGE stage, uint64_t bytes, uint64_t blocks, uint64_t ticks);
+
+/**
+ * Times its own lifetime as one call of stage
+ * Stages that interleave (gctr and ghash in GCM) use statsTicks and recordStats directly
+**/
+class StatsScope
+{
+public:
+    StatsScope(STAGE pStage, uint64_t pBytes, uint64_t pBlocks)
+        : stage(pStage), bytes(pBytes), blocks(pBlocks), active(statsEnabled()), start(0)
+    {
+        if (this->active)
+            this->start = statsTicks();
+    }
+
+    ~StatsScope()
+    {
+        if (this->active)
+            recordStats(this->stage, this->bytes, this->blocks, statsTicks() - this->start);
+    }
+
+    StatsScope(const StatsScope& other) = delete;
+    StatsScope& operator=(const StatsScope& other) = delete;
+
+private:
+    STAGE stage;
+    uint64_t bytes;
+    uint64_t blocks;
+    bool active;
+    uint64_t start;
+};
+
+} // namespace AES
+
+#endif
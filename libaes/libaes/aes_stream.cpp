@@ -0,0 +1,330 @@
+#include <cstring>
+
+#include <libaes/libaes.hpp>
+#include <libaes/types_helper.hpp>
+#include <libaes/aes_engine.hpp>
+#include <libaes/aes_ghash.hpp>
+#include <libaes/aes_mode.hpp>
+
+#include <utility/logs.hpp>
+
+namespace AES
+{
+
+/*
+    Starts a new message with the current key, iv and aad
+    Can be called again at any time to drop the current message
+*/
+bool AES::init(bool pEncrypt)
+{
+    if (!this->hasInit)
+        return false;
+    if (this->mode == MODE::XTS) // Stealing needs the end of the data unit
+        return false;
+    if (this->mode == MODE::GCM_SIV) // The counter is the tag of the whole message
+        return false;
+    if (this->mode != MODE::ECB && this->ivSize == 0)
+        return false;
+
+    StreamState& st = this->stream;
+    st.encrypt = pEncrypt;
+    st.keystreamOffset = AES::BLOCKSIZE;
+    st.pendingSize = 0;
+    st.tagSize = 0;
+    st.heldSize = 0;
+    st.dataSize = 0;
+
+    if (this->mode == MODE::CBC) {
+        qwordCopy(this->iv, st.chain);
+    }
+    else if (this->mode == MODE::CTR) {
+        qwordCopy(this->iv, st.counter);
+    }
+    else if (this->mode == MODE::GCM) {
+        this->gcmPreCounter(st.J0);
+        qwordCopy(st.J0, st.counter);
+        ctrAdd(st.counter, 4, 1);
+        qwordCopy(this->aadHash, st.Y); // aad is hashed by setAad
+    }
+    else if (this->mode == MODE::OCB) {
+        ocbOffset0(this->engine, this->keySchedule.encKeys, this->iv, this->ivSize, st.offset);
+        qwordZero(st.checksum);
+    }
+    else {
+        qwordZero(st.Y);
+    }
+
+    st.started = true;
+    return true;
+}
+
+bool AES::update(const byte_t* dataIn, size_t dataSize, byte_t* dataOut, size_t& outSize)
+{
+    StreamState& st = this->stream;
+
+    outSize = 0;
+    if (!st.started)
+        return false;
+    if (dataSize == 0)
+        return true;
+    if (dataIn == nullptr || dataOut == nullptr)
+        return false;
+    // GCM messages are limited in size, on decipher the last 16 bytes are the tag
+    if (this->mode == MODE::GCM && st.dataSize + st.tagSize + dataSize
+        > GCM_MAX_DATA_SIZE + (st.encrypt ? 0 : AES::BLOCKSIZE))
+        return false;
+
+    if (AES::hasTag(this->mode) && !st.encrypt)
+    {
+        // The last 16 bytes may be the tag, they are kept out of the mode until more data comes
+        if (dataSize >= AES::BLOCKSIZE) {
+            size_t heldOut;
+            size_t dataOutSize;
+            this->streamCrypt(st.tag, st.tagSize, dataOut, heldOut);
+            this->streamCrypt(dataIn, dataSize - AES::BLOCKSIZE, dataOut + heldOut, dataOutSize);
+            memcpy(st.tag, dataIn + dataSize - AES::BLOCKSIZE, AES::BLOCKSIZE);
+            st.tagSize = AES::BLOCKSIZE;
+            outSize = heldOut + dataOutSize;
+        }
+        else {
+            byte_t joined[2 * AES::BLOCKSIZE];
+            unsigned int total = st.tagSize + (unsigned int)dataSize;
+            unsigned int extra = total > AES::BLOCKSIZE ? total - AES::BLOCKSIZE : 0;
+            memcpy(joined, st.tag, st.tagSize);
+            memcpy(joined + st.tagSize, dataIn, dataSize);
+            this->streamCrypt(joined, extra, dataOut, outSize);
+            memcpy(st.tag, joined + extra, total - extra);
+            st.tagSize = total - extra;
+        }
+    }
+    else
+    {
+        this->streamCrypt(dataIn, dataSize, dataOut, outSize);
+    }
+
+    if (!st.encrypt && this->padding != PADDING::NONE)
+        this->streamHold(dataOut, outSize);
+
+    return true;
+}
+
+bool AES::final(byte_t* dataOut, size_t& outSize)
+{
+    StreamState& st = this->stream;
+
+    outSize = 0;
+    if (!st.started || dataOut == nullptr)
+        return false;
+    st.started = false;
+
+    // Same padding as cipher, computed on the whole message
+    if (st.encrypt) {
+        byte_t padding[2 * AES::BLOCKSIZE];
+        unsigned int paddingSize = AES::getPaddingSize(st.dataSize, this->padding);
+        memset(padding, paddingSize, paddingSize);
+        this->streamCrypt(padding, paddingSize, dataOut, outSize);
+    }
+
+    // ECB and CBC need full blocks
+    if ((this->mode == MODE::ECB || this->mode == MODE::CBC) && st.pendingSize != 0)
+        return false;
+
+    if (AES::hasTag(this->mode))
+    {
+        if (!st.encrypt && st.tagSize != AES::BLOCKSIZE)
+            return false;
+
+        qword_t T;
+        if (this->mode == MODE::GCM) {
+            if (st.dataSize > GCM_MAX_DATA_SIZE) // Padding can go past the limit
+                return false;
+            if (st.pendingSize > 0) {
+                qword_t last = QWORD_STATIC_ZERO;
+                memcpy(QWTOBUF(last), st.pending, st.pendingSize);
+                this->ghashEngine->update(*this->ghashKey, st.Y, QWTOCBUF(last), 1);
+            }
+            this->gcmTag(st.J0, st.Y, st.dataSize, T);
+        }
+        else {
+            // OCB partial last block, a padded message is only made of full blocks
+            if (!st.encrypt && this->padding != PADDING::NONE && st.pendingSize != 0)
+                return false;
+            ocbTag(this->engine, this->keySchedule.encKeys, *this->ocbKey, st.offset,
+                st.checksum, this->aadHash, st.pending, dataOut + outSize, st.pendingSize,
+                !st.encrypt, T);
+            outSize += st.pendingSize;
+        }
+
+        TRACE_INFO("=> Authentification tag: ", bytesToHexString(QWTOCBUF(T), 16));
+        if (st.encrypt) {
+            memcpy(dataOut + outSize, QWTOCBUF(T), AES::BLOCKSIZE);
+            outSize += AES::BLOCKSIZE;
+        }
+        else if (!bufferEqual(st.tag, QWTOCBUF(T), AES::BLOCKSIZE)) {
+            TRACE_ERROR("Bad authentification tag !");
+            TRACE_ERROR("Tag expected : ", bytesToHexString(st.tag, 16));
+            return false;
+        }
+    }
+
+    // Release the held plain text without its padding
+    if (!st.encrypt && this->padding != PADDING::NONE && st.heldSize > 0) {
+        unsigned int paddingSize = st.held[st.heldSize - 1];
+        if (paddingSize == 0 || paddingSize > st.heldSize)
+            return false;
+        outSize = st.heldSize - paddingSize;
+        memcpy(dataOut, st.held, outSize);
+    }
+
+    return true;
+}
+
+/*
+    Mode layer, without padding nor tag
+    ECB/CBC/OCB keep a partial block for the next call, CTR/GCM keep the rest of the keystream
+    block. GCM also keeps the partial ciphertext block until it can be hashed
+    OCB ciphers its partial last block in final, where it is known to be the last one
+*/
+void AES::streamCrypt(const byte_t* dataIn, size_t dataSize, byte_t* dataOut, size_t& outSize)
+{
+    StreamState& st = this->stream;
+    const word_t* encKeys = this->keySchedule.encKeys;
+
+    outSize = 0;
+    if (dataSize == 0)
+        return;
+    st.dataSize += dataSize;
+
+    if (this->mode == MODE::ECB || this->mode == MODE::CBC || this->mode == MODE::OCB)
+    {
+        // OCB block numbers follow the blocks already given to the mode
+        uint64_t blockIndex = (st.dataSize - dataSize - st.pendingSize) / AES::BLOCKSIZE;
+        auto cryptBlocks = [&](const byte_t* in, byte_t* out, size_t size) {
+            if (this->mode == MODE::OCB) {
+                ocbCryptChunks(this->threadPool, this->engine,
+                    st.encrypt ? encKeys : this->keySchedule.decKeys, *this->ocbKey, st.offset,
+                    st.checksum, blockIndex, in, out, size, !st.encrypt);
+                blockIndex += size / AES::BLOCKSIZE;
+            }
+            else if (this->mode == MODE::ECB) {
+                ecbCryptChunks(this->threadPool,
+                    st.encrypt ? this->engine->cipherBlocks : this->engine->decipherBlocks,
+                    st.encrypt ? encKeys : this->keySchedule.decKeys, in, out, size);
+            }
+            else if (st.encrypt) {
+                cbcEncrypt(this->engine, encKeys, st.chain, in, out, size);
+            }
+            else {
+                cbcDecryptChunks(this->threadPool, this->engine, this->keySchedule.decKeys,
+                    st.chain, in, out, size);
+            }
+        };
+
+        size_t offsetData = 0;
+        if (st.pendingSize > 0) {
+            unsigned int n = AES::BLOCKSIZE - st.pendingSize;
+            if (n > dataSize)
+                n = (unsigned int)dataSize;
+            memcpy(st.pending + st.pendingSize, dataIn, n);
+            st.pendingSize += n;
+            offsetData = n;
+            if (st.pendingSize < AES::BLOCKSIZE)
+                return;
+            cryptBlocks(st.pending, dataOut, AES::BLOCKSIZE);
+            outSize = AES::BLOCKSIZE;
+        }
+
+        size_t fullSize = (dataSize - offsetData) / AES::BLOCKSIZE * AES::BLOCKSIZE;
+        cryptBlocks(dataIn + offsetData, dataOut + outSize, fullSize);
+        outSize += fullSize;
+        offsetData += fullSize;
+
+        st.pendingSize = (unsigned int)(dataSize - offsetData);
+        memcpy(st.pending, dataIn + offsetData, st.pendingSize);
+        return;
+    }
+
+    const bool gcm = this->mode == MODE::GCM;
+    const int incBytes = gcm ? 4 : 16;
+    size_t offsetData = 0;
+
+    // Rest of the current keystream block
+    while (st.keystreamOffset < AES::BLOCKSIZE && offsetData < dataSize) {
+        byte_t c = dataIn[offsetData] ^ st.keystream.b[st.keystreamOffset++];
+        if (gcm)
+            st.pending[st.pendingSize++] = st.encrypt ? c : dataIn[offsetData];
+        dataOut[offsetData++] = c;
+    }
+    if (gcm && st.pendingSize == AES::BLOCKSIZE) {
+        this->ghashEngine->update(*this->ghashKey, st.Y, st.pending, 1);
+        st.pendingSize = 0;
+    }
+
+    // Whole blocks
+    size_t fullSize = (dataSize - offsetData) / AES::BLOCKSIZE * AES::BLOCKSIZE;
+    if (gcm) {
+        gcmCryptHashChunks(this->threadPool, this->engine, encKeys, this->ghashEngine,
+            *this->ghashKey, st.counter, st.Y, dataIn + offsetData, dataOut + offsetData,
+            fullSize, !st.encrypt);
+    }
+    else {
+        ctrCryptChunks(this->threadPool, this->engine, encKeys, st.counter, incBytes,
+            dataIn + offsetData, dataOut + offsetData, fullSize);
+    }
+    offsetData += fullSize;
+
+    // Start a new keystream block for the rest
+    unsigned int remaining = (unsigned int)(dataSize - offsetData); // Less than a block
+    if (remaining > 0) {
+        qwordCopy(st.counter, st.keystream);
+        this->engine->cipherBlock(QWTOBUF(st.keystream), encKeys);
+        ctrAdd(st.counter, incBytes, 1);
+        bufferXor(dataIn + offsetData, QWTOCBUF(st.keystream), dataOut + offsetData, remaining);
+        if (gcm) {
+            memcpy(st.pending, st.encrypt ? dataOut + offsetData : dataIn + offsetData, remaining);
+            st.pendingSize = remaining;
+        }
+        st.keystreamOffset = remaining;
+    }
+
+    outSize = dataSize;
+}
+
+/*
+    Decipher with padding: the padding is only known at the end,
+    so the last 2 blocks given by the mode are kept until the next call or final
+*/
+void AES::streamHold(byte_t* dataOut, size_t& outSize)
+{
+    StreamState& st = this->stream;
+    const unsigned int holdSize = sizeof(st.held);
+
+    size_t total = st.heldSize + outSize;
+    if (total <= holdSize) {
+        memcpy(st.held + st.heldSize, dataOut, outSize);
+        st.heldSize = (unsigned int)total;
+        outSize = 0;
+        return;
+    }
+
+    // Output is held || dataOut minus its last holdSize bytes
+    byte_t newHeld[sizeof(st.held)];
+    size_t emitSize = total - holdSize;
+    if (outSize >= holdSize) {
+        memcpy(newHeld, dataOut + outSize - holdSize, holdSize);
+        memmove(dataOut + st.heldSize, dataOut, outSize - holdSize);
+        memcpy(dataOut, st.held, st.heldSize);
+    }
+    else {
+        size_t keep = st.heldSize - emitSize;
+        memcpy(newHeld, st.held + emitSize, keep);
+        memcpy(newHeld + keep, dataOut, outSize);
+        memcpy(dataOut, st.held, emitSize);
+    }
+
+    memcpy(st.held, newHeld, holdSize);
+    st.heldSize = holdSize;
+    outSize = emitSize;
+}
+
+} // namespace AES
@@ -0,0 +1,91 @@
+#include <cstdlib>
+
+#include <libaes/cpu_features.hpp>
+
+#if defined(LIBAES_X86)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace AES
+{
+
+#if defined(LIBAES_X86)
+static void cpuid(int leaf, int subLeaf, unsigned int regs[4])
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuidex(info, leaf, subLeaf);
+    for (int i = 0; i < 4; ++i)
+        regs[i] = (unsigned int)info[i];
+#else
+    __cpuid_count(leaf, subLeaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// Register states enabled by the OS, XCR0
+static unsigned long long xgetbv0()
+{
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    unsigned int eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((unsigned long long)edx << 32) | eax;
+#endif
+}
+#endif
+
+static CpuFeatures detectCpuFeatures()
+{
+    CpuFeatures features = {};
+
+#if defined(LIBAES_X86)
+    unsigned int regs[4]; // eax, ebx, ecx, edx
+
+    cpuid(0, 0, regs);
+    if (regs[0] < 1)
+        return features;
+
+    cpuid(1, 0, regs);
+    features.sse2 = (regs[3] & (1u << 26)) != 0;
+    features.ssse3 = (regs[2] & (1u << 9)) != 0;
+    features.sse41 = (regs[2] & (1u << 19)) != 0;
+    features.aesni = (regs[2] & (1u << 25)) != 0;
+    features.pclmul = (regs[2] & (1u << 1)) != 0;
+
+    // The CPU may have AVX while the OS doesn't save the registers on context switches
+    bool osxsave = (regs[2] & (1u << 27)) != 0;
+    bool avx = (regs[2] & (1u << 28)) != 0;
+    unsigned long long xcr0 = osxsave ? xgetbv0() : 0;
+    bool osYmm = avx && (xcr0 & 0x06) == 0x06;   // xmm, ymm
+    bool osZmm = osYmm && (xcr0 & 0xE0) == 0xE0; // opmask, zmm 0-15, zmm 16-31
+
+    cpuid(0, 0, regs);
+    if (regs[0] < 7)
+        return features;
+    cpuid(7, 0, regs);
+    features.avx2 = osYmm && (regs[1] & (1u << 5)) != 0;
+    features.avx512 = osZmm && (regs[1] & (1u << 16)) != 0 // F
+        && (regs[1] & (1u << 30)) != 0 && (regs[1] & (1u << 31)) != 0; // BW, VL
+    features.vaes = osYmm && (regs[2] & (1u << 9)) != 0;
+    features.vpclmul = osYmm && (regs[2] & (1u << 10)) != 0;
+
+    const char* noAvx512 = std::getenv("LIBAES_NO_AVX512");
+    if (noAvx512 != nullptr && noAvx512[0] != '\0' && noAvx512[0] != '0')
+        features.avx512 = false;
+#endif
+
+    return features;
+}
+
+const CpuFeatures& getCpuFeatures()
+{
+    static const CpuFeatures features = detectCpuFeatures();
+    return features;
+}
+
+} // namespace AES
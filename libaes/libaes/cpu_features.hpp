@@ -0,0 +1,41 @@
+#ifndef LIBAES_CPU_FEATURES_HPP
+#define LIBAES_CPU_FEATURES_HPP
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define LIBAES_X86 1
+#endif
+
+// Enable an instruction set for one function only, so the rest of the library
+// can still run on CPUs without it. MSVC does not need it for intrinsics
+#if defined(_MSC_VER) && !defined(__clang__)
+#define LIBAES_TARGET(isa)
+#else
+#define LIBAES_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+namespace AES
+{
+
+struct CpuFeatures
+{
+    bool sse2;
+    bool ssse3;
+    bool sse41;
+    bool aesni;
+    bool pclmul;
+    bool avx2;    // And the OS saves the ymm registers
+    bool avx512;  // F, BW and VL, and the OS saves the zmm registers
+    bool vaes;
+    bool vpclmul; // VPCLMULQDQ
+};
+
+/**
+ * Read once with CPUID and XGETBV, then cached for the whole process
+ * Everything is false on non x86 CPUs
+ * LIBAES_NO_AVX512=1 in the environment hides AVX-512, the wide engines then use 256 bits vectors
+**/
+const CpuFeatures& getCpuFeatures();
+
+} // namespace AES
+
+#endif
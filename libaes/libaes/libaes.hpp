@@ -1,6 +1,7 @@
 #ifndef LIBAES_LIBAES_HPP
 #define LIBAES_LIBAES_HPP
 
+#include <cstddef>
 #include <string>
 #include <libaes/types.hpp>
 
@@ -18,7 +19,35 @@ enum class MODE {
     ECB,
     CBC,
     CTR,
-    GCM
+    GCM,
+    XTS, // IEEE 1619, 128 or 256 bits keys given twice as long: data key then tweak key
+    OCB, // RFC 7253 OCB3, 1 to 15 bytes nonce in the iv, 16 bytes tag like GCM
+    GCM_SIV // RFC 8452, 128 or 256 bits keys, 12 bytes nonce in the iv, 16 bytes tag,
+            // nonce misuse resistant, the aad is set after the iv
+};
+
+// Implementation of the block cipher, AUTO picks VAES or AESNI when the CPU supports them and
+// REFERENCE otherwise, TTABLE and BITSLICE are only used when asked for
+// AESNI, VAES and BITSLICE are constant time, key expansion included, REFERENCE and TTABLE
+// use lookup tables
+// VAES is AESNI with CTR and GCM counter blocks ciphered 2 or 4 at a time (AVX2, AVX-512)
+enum class ENGINE {
+    AUTO,
+    REFERENCE,
+    TTABLE,
+    BITSLICE,
+    AESNI,
+    VAES
+};
+
+// Implementation of GHASH for GCM and POLYVAL for GCM-SIV, AUTO picks the fastest one
+// VPCLMUL multiplies 2 or 4 blocks per instruction (AVX2, AVX-512)
+enum class GHASH {
+    AUTO,
+    REFERENCE,
+    TABLE,
+    CLMUL,
+    VPCLMUL
 };
 
 enum class KEY_SIZE {
@@ -27,9 +56,72 @@ enum class KEY_SIZE {
     S256 = 256
 };
 
+// Stages timed by the statistics, READ and WRITE are given by the application with addStats
+enum class STAGE {
+    KEY_EXPANSION,
+    GHASH_KEY,  // H = CIPH(0^128) and the GHASH engine tables, POLYVAL key of a GCM-SIV nonce
+    GCM_J0,
+    ECB,
+    CBC,
+    CTR,
+    GCTR,
+    GHASH,      // aad and ciphertext, POLYVAL of the aad and plaintext in GCM-SIV
+    GCM_TAG,
+    XTS,        // Sectors and data units, tweaks included
+    OCB,        // Blocks and checksum, aad hash, last partial block and tag
+    READ,
+    WRITE
+};
+
+static const int STAGE_COUNT = 13;
+
+struct StageStats
+{
+    uint64_t calls;
+    uint64_t bytes;
+    uint64_t blocks;      // 16 bytes blocks ciphered or hashed, round keys for KEY_EXPANSION
+    uint64_t nanoseconds; // Summed over threads, can be more than the elapsed time
+    uint64_t cycles;      // Time stamp counter, 0 on non x86 CPUs and for READ/WRITE
+};
+
+struct Stats
+{
+    StageStats stages[STAGE_COUNT];
+    unsigned int threads; // Threads that recorded a stage since the last reset
+};
+
+struct Engine;
+struct GhashEngine;
+struct GhashKey;
+struct OcbKey;
+struct SivKeys;
+struct BatchMessage;
+class ThreadPool;
+class AES;
 
 /**
- * All size are expressed in bytes
+ * One message of a multi-buffer call, see AES::cipherBatch
+ * key is an initialized AES that gives the key schedule, mode, padding and engines, it is only
+ * read so any number of jobs can share it, its own iv, aad and stream state are not used
+ * cipherBatch writes dataSize + padding bytes in dataOut and the tag for GCM, OCB and GCM-SIV
+ * decipherBatch writes dataSize bytes and checks the tag, padding is left like decipher
+**/
+struct BatchJob
+{
+    const AES* key;
+    const byte_t* iv;     // Not used in ECB
+    unsigned int ivSize;
+    const byte_t* aad;    // GCM, OCB and GCM-SIV, can be nullptr when aadSize is 0
+    unsigned int aadSize;
+    const byte_t* dataIn; // Never written, can be the same buffer as dataOut
+    byte_t* dataOut;
+    size_t dataSize;
+    byte_t tag[16];       // Modes with a tag, written by cipherBatch, checked by decipherBatch
+    bool status;          // Set by the call, false for an invalid job or a wrong tag
+};
+
+/**
+ * All size are expressed in bytes, data sizes are size_t and stream totals 64 bits
  * All functions must be called AFTER initialization
  *
 **/
@@ -37,32 +129,91 @@ class AES
 {
 public:
     static const int BLOCKSIZE = 16; // 16 bytes = 128 bits, AES specification
+    static const int STREAM_FINAL_SIZE = 3 * BLOCKSIZE; // Max bytes written by final
+    static const int MAX_KEY_SIZE = 32; // AES-256
+    static const int MAX_IV_SIZE = 256; // GCM iv, rounded to a multiple of BLOCKSIZE
+    static const int SIV_NONCE_SIZE = 12; // GCM-SIV nonce, the only size of RFC 8452
+    static const unsigned int MAX_BATCH_LANES = 16; // CBC messages ciphered together
+    static const unsigned int DEFAULT_BATCH_LANES = 8;
 
     AES()
     {
         this->verbose = false;
         this->hasInit = false;
-        this->key = nullptr;
+        this->ivSize = 0;
+        this->aadSize = 0;
+        this->engineId = ENGINE::AUTO;
+        this->engine = nullptr;
+        this->modeKernels = nullptr;
+        this->ghashId = GHASH::AUTO;
+        this->ghashEngine = nullptr;
+        this->ghashKey = nullptr;
+        this->ocbKey = nullptr;
+        this->sivKeys = nullptr;
+        this->threads = 1;
+        this->threadPool = nullptr;
+        this->stream.started = false;
     }
 
-    ~AES()
-    {
-        delete[] key;
-        delete[] iv;
-        delete[] aad;
-    }
+    ~AES();
 
     // No need to be copied or moved
     AES(const AES& other) = delete;
     AES(const AES&& other) = delete;
     AES& operator=(const AES&& other) = delete;
 
+    /**
+     * Can be called again to change the key, key, iv and schedules are stored in the object
+     * so re-keying and setting a new iv or aad never allocate
+     * iv and aad must be set again after a new key
+    **/
     bool initialize(KEY_SIZE pKeySize, MODE pMode, bool pPadding, const byte_t* pKey);
-    bool cipher(byte_t* dataIn, byte_t* dataOut, unsigned int dataSize);
-    bool decipher(const byte_t* dataIn, byte_t* dataOut, unsigned int dataSize);
+    bool cipher(byte_t* dataIn, byte_t* dataOut, size_t dataSize);
+    bool decipher(const byte_t* dataIn, byte_t* dataOut, size_t dataSize);
+
+    /**
+     * Streaming, gives the same output as cipher/decipher with the message in several pieces
+     * init after initialize/setIv/setAad, then update as many times as needed, then final
+     * update writes up to dataSize + BLOCKSIZE bytes, final up to STREAM_FINAL_SIZE bytes
+     * outSize is set to the number of bytes written, dataIn and dataOut must not overlap
+     * In GCM and OCB the tag is checked by final, but update already released the plain text
+     * of the previous pieces: when final fails the caller must discard everything written,
+     * as cliaes does by removing the output file
+     * GCM-SIV needs the whole message to compute its counter, init fails like XTS
+    **/
+    bool init(bool pEncrypt);
+    bool update(const byte_t* dataIn, size_t dataSize, byte_t* dataOut, size_t& outSize);
+    bool final(byte_t* dataOut, size_t& outSize);
+
+    /**
+     * Multi-buffer, many independent messages in one call, on the calling thread
+     * CBC encryption is serial within a message, so pLanes messages are ciphered together,
+     * one block of each at a time under its own key. The other modes are already parallel
+     * within a message and run one message after the other, without touching the AES objects
+     * pLanes is in [1;MAX_BATCH_LANES], true if every job succeeded
+    **/
+    static bool cipherBatch(BatchJob* pJobs, size_t pCount,
+        unsigned int pLanes = DEFAULT_BATCH_LANES);
+    static bool decipherBatch(BatchJob* pJobs, size_t pCount,
+        unsigned int pLanes = DEFAULT_BATCH_LANES);
+
+    /**
+     * XTS, pCount sectors of pSectorSize bytes each, one after the other in the buffers
+     * Sector i is ciphered as the data unit number pSectors[i], its tweak in little endian
+     * Sectors are independent, they are split between the threads by whole sectors
+     * pSectorSize is at least BLOCKSIZE, ciphertext stealing handles the other sizes
+     * cipher/decipher do a single data unit, the tweak is the iv, the stream API isn't supported
+    **/
+    bool cipherSectors(const byte_t* pDataIn, byte_t* pDataOut, size_t pSectorSize,
+        const uint64_t* pSectors, size_t pCount);
+    bool decipherSectors(const byte_t* pDataIn, byte_t* pDataOut, size_t pSectorSize,
+        const uint64_t* pSectors, size_t pCount);
 
     bool setIv(const byte_t* pIv, int pIvSize);
     bool setAad(const byte_t* pAad, int pAadSize);
+    bool setEngine(ENGINE pEngine);
+    bool setGhash(GHASH pGhash);
+    bool setThreads(unsigned int pThreads);
 
     void setVerbose(bool activate)
     {
@@ -75,39 +226,83 @@ public:
     static int getKeySizeFromEnum(KEY_SIZE value);
     static std::string getModeFromEnum(MODE value);
     static std::string getPaddingFromEnum(PADDING value);
+    static std::string getEngineFromEnum(ENGINE value);
+    static bool isEngineSupported(ENGINE value);
+    static std::string getGhashFromEnum(GHASH value);
+    static bool isGhashSupported(GHASH value);
     static bool isGcmIvSizeValid(unsigned int pIvSize);
-    static unsigned int getPaddingSize(unsigned int pDataSize, PADDING pPadding);
-    static unsigned int getRevPaddingSize(const byte_t* pDataIn, unsigned int pDataSize,
+    static bool isOcbIvSizeValid(unsigned int pIvSize);
+    static unsigned int getPaddingSize(uint64_t pDataSize, PADDING pPadding);
+    static unsigned int getRevPaddingSize(const byte_t* pDataIn, size_t pDataSize,
         PADDING pPadding, MODE pMode);
-    static unsigned int getBlockRoundedSize(unsigned int pDataSize);
-    static unsigned int getPlainInBufferSize(unsigned int pDataSize, PADDING pPadding, MODE pMode);
-    static unsigned int getCipherOutBufferSize(unsigned int pDataSize, PADDING pPadding,
-        MODE pMode);
-    static unsigned int getCipherInBufferSize(unsigned int pDataSize, PADDING pPadding, MODE pMode);
-    static unsigned int getPlainOutBufferSize(unsigned int pDataSize, PADDING pPadding, MODE pMode);
+    static size_t getBlockRoundedSize(size_t pDataSize);
+    static size_t getPlainInBufferSize(size_t pDataSize, PADDING pPadding, MODE pMode);
+    static size_t getCipherOutBufferSize(size_t pDataSize, PADDING pPadding, MODE pMode);
+    static size_t getCipherInBufferSize(size_t pDataSize, PADDING pPadding, MODE pMode);
+    static size_t getPlainOutBufferSize(size_t pDataSize, PADDING pPadding, MODE pMode);
+
+    /**
+     * Statistics of the whole process, off by default
+     * Each thread counts in its own counters, getStats adds them up when called
+     * While off a stage only costs a load and a branch, nothing is recorded
+    **/
+    static void enableStats(bool pEnable);
+    static bool isStatsEnabled();
+    static void resetStats();
+    static void getStats(Stats& pStats);
+    static void addStats(STAGE pStage, uint64_t pBytes, uint64_t pNanoseconds);
+    static std::string getStatsReport();
+    static std::string getStageFromEnum(STAGE value);
 
 private:
+    static const int MAX_SCHEDULE_SIZE = 60; // Words, Nb * (Nr + 1) for AES-256
+
+    // One shot cipher/decipher of a mode, bound by initialize
+    typedef bool (AES::*modeFunc_t)(const byte_t* dataIn, byte_t* dataOut, size_t dataSize);
+    struct ModeKernels
+    {
+        modeFunc_t encrypt;
+        modeFunc_t decrypt;
+    };
+
+    // Sized for AES-256, a new key is expanded over the previous one
+    // encKeys and decKeys have an engine specific layout, see Engine::prepareKeys
     struct KeySchedule
     {
-        KeySchedule() : keys(nullptr), len(0) {}
-        ~KeySchedule()
-        {
-            if (keys != nullptr)
-            {
-                delete[] keys;
-                keys = nullptr;
-                len = 0;
-            }
-        }
-        word_t* keys;
+        alignas(16) word_t keys[MAX_SCHEDULE_SIZE];
+        alignas(16) word_t encKeys[MAX_SCHEDULE_SIZE];
+        alignas(16) word_t decKeys[MAX_SCHEDULE_SIZE];
         int len;
     };
 
+    // State carried between update calls
+    struct StreamState
+    {
+        bool started;
+        bool encrypt;
+        qword_t chain;      // CBC chaining value
+        qword_t counter;    // CTR/GCM next counter block
+        qword_t keystream;  // CTR/GCM keystream of the current block
+        unsigned int keystreamOffset; // First unused keystream byte, 16 = none
+        qword_t J0;         // GCM pre-counter block, for the tag
+        qword_t Y;          // GCM GHASH accumulator
+        qword_t offset;     // OCB offset of the last full block
+        qword_t checksum;   // OCB xor of the plaintext blocks
+        byte_t pending[BLOCKSIZE]; // ECB/CBC/OCB partial block, GCM partial ciphertext block
+        unsigned int pendingSize;
+        byte_t tag[BLOCKSIZE]; // GCM/OCB decipher, the last 16 bytes seen may be the tag
+        unsigned int tagSize;
+        byte_t held[2 * BLOCKSIZE]; // Decipher with padding, the last bytes may be padding
+        unsigned int heldSize;
+        uint64_t dataSize; // Bytes given to the mode, without padding and tag
+    };
+
     const int Nb = 4;   // 4 bytes = 32bits, AES specification
     int Nr;
     int Nk;
 
     KeySchedule keySchedule;
+    KeySchedule tweakSchedule; // XTS tweak key, only encKeys is used
 
     bool verbose; // Activate trace
     bool hasInit; // Is state ready to cipher/decipher
@@ -117,22 +312,55 @@ private:
     unsigned int aadSize;
     PADDING padding;
     MODE mode;
-    byte_t* key;
-    byte_t* iv;
-    byte_t* aad;
-
-    void applyPadding(byte_t* data, unsigned int& dataSize);
-
-    bool ecb_encrypt(const byte_t* dataIn, byte_t* dataOut, unsigned int dataSize);
-    bool cbc_encrypt(const byte_t* dataIn, byte_t* dataOut, unsigned int dataSize);
-    bool ctr_encrypt(const byte_t* dataIn, byte_t* dataOut, unsigned int dataSize);
-    bool gcm_encrypt(const byte_t* dataIn, byte_t* dataOut, unsigned int dataSize);
-    bool gcm_crypt(const byte_t* dataIn, byte_t* dataOut, unsigned int dataSize, bool decrypt);
-
-    bool ecb_decrypt(const byte_t* dataIn, byte_t* dataOut, unsigned int dataSize);
-    bool cbc_decrypt(const byte_t* dataIn, byte_t* dataOut, unsigned int dataSize);
-    bool ctr_decrypt(const byte_t* dataIn, byte_t* dataOut, unsigned int dataSize);
-    bool gcm_decrypt(const byte_t* dataIn, byte_t* dataOut, unsigned int dataSize);
+    const ModeKernels* modeKernels;
+    ENGINE engineId;
+    const Engine* engine;
+    GHASH ghashId;
+    const GhashEngine* ghashEngine;
+    GhashKey* ghashKey; // H and engine tables, computed once per key for GCM
+    OcbKey* ocbKey;     // L_*, L_$ and L_i, computed once per key for OCB
+    SivKeys* sivKeys;   // Message keys of the current GCM-SIV nonce, derived by setIv
+    unsigned int threads;
+    ThreadPool* threadPool; // nullptr when single threaded
+    byte_t key[2 * MAX_KEY_SIZE]; // XTS keeps both keys
+    alignas(16) byte_t iv[MAX_IV_SIZE]; // Zero padded to a multiple of BLOCKSIZE in GCM
+    qword_t aadHash; // GCM: GHASH of the zero padded aad, messages start hashing from it
+                     // OCB: HASH(K, aad), xored in every tag
+                     // GCM-SIV: POLYVAL of the zero padded aad under the key of the nonce
+    StreamState stream;
+
+    static const ModeKernels* getModeKernels(MODE pMode);
+    void applyPadding(byte_t* data, size_t& dataSize);
+    void prepareGhash();
+    void gcmPreCounter(qword_t& J0);
+    void gcmTag(const qword_t& J0, qword_t& Y, uint64_t dataSize, qword_t& T);
+    void prepareSiv();
+    static bool hasTag(MODE pMode);
+    void streamCrypt(const byte_t* dataIn, size_t dataSize, byte_t* dataOut, size_t& outSize);
+    void streamHold(byte_t* dataOut, size_t& outSize);
+    static bool getBatchMessage(BatchJob& job, bool encrypt, BatchMessage& message);
+    static bool runBatch(BatchJob* jobs, size_t count, unsigned int lanes, bool encrypt);
+    bool xtsSectors(const byte_t* dataIn, byte_t* dataOut, size_t sectorSize,
+        const uint64_t* sectors, size_t count, bool decrypt);
+
+    bool ecb_encrypt(const byte_t* dataIn, byte_t* dataOut, size_t dataSize);
+    bool cbc_encrypt(const byte_t* dataIn, byte_t* dataOut, size_t dataSize);
+    bool ctr_encrypt(const byte_t* dataIn, byte_t* dataOut, size_t dataSize);
+    bool gcm_encrypt(const byte_t* dataIn, byte_t* dataOut, size_t dataSize);
+    bool gcm_crypt(const byte_t* dataIn, byte_t* dataOut, size_t dataSize, bool decrypt);
+    bool xts_encrypt(const byte_t* dataIn, byte_t* dataOut, size_t dataSize);
+    bool ocb_encrypt(const byte_t* dataIn, byte_t* dataOut, size_t dataSize);
+    bool ocb_crypt(const byte_t* dataIn, byte_t* dataOut, size_t dataSize, bool decrypt);
+    bool siv_encrypt(const byte_t* dataIn, byte_t* dataOut, size_t dataSize);
+    bool siv_crypt(const byte_t* dataIn, byte_t* dataOut, size_t dataSize, bool decrypt);
+
+    bool ecb_decrypt(const byte_t* dataIn, byte_t* dataOut, size_t dataSize);
+    bool cbc_decrypt(const byte_t* dataIn, byte_t* dataOut, size_t dataSize);
+    bool ctr_decrypt(const byte_t* dataIn, byte_t* dataOut, size_t dataSize);
+    bool gcm_decrypt(const byte_t* dataIn, byte_t* dataOut, size_t dataSize);
+    bool xts_decrypt(const byte_t* dataIn, byte_t* dataOut, size_t dataSize);
+    bool ocb_decrypt(const byte_t* dataIn, byte_t* dataOut, size_t dataSize);
+    bool siv_decrypt(const byte_t* dataIn, byte_t* dataOut, size_t dataSize);
 };
 
 } // namespace AES
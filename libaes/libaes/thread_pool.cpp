@@ -0,0 +1,74 @@
+#include <libaes/thread_pool.hpp>
+
+namespace AES
+{
+
+ThreadPool::ThreadPool(unsigned int pThreads)
+    : task(nullptr), nTasks(0), nextTask(0), pendingTasks(0), generation(0), stop(false)
+{
+    for (unsigned int i = 1; i < pThreads; ++i)
+        this->workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stop = true;
+    }
+    this->wakeUp.notify_all();
+    for (std::thread& worker : this->workers)
+        worker.join();
+}
+
+void ThreadPool::run(unsigned int pTasks, const taskFunc_t& pTask)
+{
+    if (pTasks == 0)
+        return;
+
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->task = &pTask;
+    this->nTasks = pTasks;
+    this->nextTask = 0;
+    this->pendingTasks = pTasks;
+    ++this->generation;
+    this->wakeUp.notify_all();
+
+    this->runTasks(lock);
+    this->allDone.wait(lock, [this] { return this->pendingTasks == 0; });
+    this->task = nullptr;
+}
+
+// Called with the lock held, it is released while a task runs
+void ThreadPool::runTasks(std::unique_lock<std::mutex>& lock)
+{
+    while (this->nextTask < this->nTasks)
+    {
+        unsigned int index = this->nextTask++;
+        const taskFunc_t& current = *this->task;
+
+        lock.unlock();
+        current(index);
+        lock.lock();
+
+        if (--this->pendingTasks == 0)
+            this->allDone.notify_all();
+    }
+}
+
+void ThreadPool::workerLoop()
+{
+    unsigned int seen = 0;
+
+    std::unique_lock<std::mutex> lock(this->mutex);
+    while (true)
+    {
+        this->wakeUp.wait(lock, [this, seen] { return this->stop || this->generation != seen; });
+        if (this->stop)
+            return;
+        seen = this->generation;
+        this->runTasks(lock);
+    }
+}
+
+} // namespace AES
@@ -0,0 +1,55 @@
+#ifndef LIBAES_THREAD_POOL_HPP
+#define LIBAES_THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace AES
+{
+
+typedef std::function<void(unsigned int index)> taskFunc_t;
+
+/**
+ * Fixed set of workers, created once and reused by every call
+ * run() hands out the indexes 0..nTasks-1, the calling thread works too
+ * and the call returns when every task is done
+**/
+class ThreadPool
+{
+public:
+    explicit ThreadPool(unsigned int pThreads); // Total threads, caller included
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool& other) = delete;
+    ThreadPool& operator=(const ThreadPool& other) = delete;
+
+    unsigned int getThreads() const
+    {
+        return (unsigned int)workers.size() + 1;
+    }
+
+    void run(unsigned int pTasks, const taskFunc_t& pTask);
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    std::condition_variable allDone;
+
+    const taskFunc_t* task;
+    unsigned int nTasks;
+    unsigned int nextTask;
+    unsigned int pendingTasks;
+    unsigned int generation; // Bumped by run() so workers know there is a new batch
+    bool stop;
+
+    void workerLoop();
+    void runTasks(std::unique_lock<std::mutex>& lock);
+};
+
+} // namespace AES
+
+#endif
@@ -1,8 +1,14 @@
+#include <cstdio>
 #include <cstring>
 #include <string>
 
 #include <libaes/types.hpp>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TYPES_HELPER_SSE2
+#endif
+
 int bitInByte(int bits)
 {
     return bits / 8 + (bits % 8 == 0 ? 0 : 1);
@@ -99,6 +105,53 @@ void qwordInc(qword_t& q1, int nBytes)
     } while (nBytes);
 }
 
+// out = in1 ^ in2, buffers may be the same
+void bufferXor(const byte_t* in1, const byte_t* in2, byte_t* out, size_t size)
+{
+    size_t i = 0;
+
+#if defined(TYPES_HELPER_SSE2)
+    for (; i + 64 <= size; i += 64) {
+        __m128i a0 = _mm_loadu_si128((const __m128i*)(in1 + i));
+        __m128i a1 = _mm_loadu_si128((const __m128i*)(in1 + i + 16));
+        __m128i a2 = _mm_loadu_si128((const __m128i*)(in1 + i + 32));
+        __m128i a3 = _mm_loadu_si128((const __m128i*)(in1 + i + 48));
+        a0 = _mm_xor_si128(a0, _mm_loadu_si128((const __m128i*)(in2 + i)));
+        a1 = _mm_xor_si128(a1, _mm_loadu_si128((const __m128i*)(in2 + i + 16)));
+        a2 = _mm_xor_si128(a2, _mm_loadu_si128((const __m128i*)(in2 + i + 32)));
+        a3 = _mm_xor_si128(a3, _mm_loadu_si128((const __m128i*)(in2 + i + 48)));
+        _mm_storeu_si128((__m128i*)(out + i), a0);
+        _mm_storeu_si128((__m128i*)(out + i + 16), a1);
+        _mm_storeu_si128((__m128i*)(out + i + 32), a2);
+        _mm_storeu_si128((__m128i*)(out + i + 48), a3);
+    }
+    for (; i + 16 <= size; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(in1 + i));
+        a = _mm_xor_si128(a, _mm_loadu_si128((const __m128i*)(in2 + i)));
+        _mm_storeu_si128((__m128i*)(out + i), a);
+    }
+#else
+    for (; i + 8 <= size; i += 8) {
+        uint64_t a, b;
+        memcpy(&a, in1 + i, 8);
+        memcpy(&b, in2 + i, 8);
+        a ^= b;
+        memcpy(out + i, &a, 8);
+    }
+#endif
+
+    for (; i < size; ++i)
+        out[i] = in1[i] ^ in2[i];
+}
+
+// Constant time, for the tags: every byte is read, the result only depends on all of them
+bool bufferEqual(const byte_t* in1, const byte_t* in2, size_t size)
+{
+    volatile byte_t diff = 0;
+    for (size_t i = 0; i < size; ++i)
+        diff = diff | (byte_t)(in1[i] ^ in2[i]);
+    return diff == 0;
+}
 
 std::string bytesToHexString(const byte_t* bytes, int byteSize)
 {
@@ -107,7 +160,7 @@ std::string bytesToHexString(const byte_t* bytes, int byteSize)
     for (int i = 0; i < byteSize; ++i)
     {
         char buff[3];
-        sprintf_s(buff, 3, "%02X", bytes[i]);
+        snprintf(buff, sizeof(buff), "%02X", bytes[i]);
         buffer += std::string(buff);
     }
 
@@ -117,6 +170,6 @@ std::string bytesToHexString(const byte_t* bytes, int byteSize)
 std::string wordToHexString(word_t word)
 {
     char buff[9];
-    sprintf_s(buff, 9, "%08X", word);
+    snprintf(buff, sizeof(buff), "%08X", word);
     return std::string(buff);
 }
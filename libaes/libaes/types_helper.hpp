@@ -1,6 +1,7 @@
 #ifndef LIBAES_TYPES_HELPER_HPP
 #define LIBAES_TYPES_HELPER_HPP
 
+#include <cstddef>
 #include <string>
 
 #include <libaes/types.hpp>
@@ -25,4 +26,7 @@ void qwordShiftRight(qword_t& q1);
 void qwordShiftLeft(qword_t& q1);
 void qwordInc(qword_t& q1, int nBytes);
 
+void bufferXor(const byte_t* in1, const byte_t* in2, byte_t* out, size_t size);
+bool bufferEqual(const byte_t* in1, const byte_t* in2, size_t size);
+
 #endif
@@ -0,0 +1,268 @@
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <libaes/libaes.hpp>
+
+#include "testUtils.hpp"
+
+/**
+ * cipherBatch/decipherBatch against the one shot API, message by message
+ * Messages mix three keys of different sizes and lengths around the block size,
+ * the lane counts cover a single lane, a partial fill and the maximum
+ * GCM-SIV has no 192 bits keys, its third key is a second 256 bits one
+**/
+
+static const AES::KEY_SIZE BATCH_KEY_SIZES[] = { AES::KEY_SIZE::S128, AES::KEY_SIZE::S256,
+    AES::KEY_SIZE::S192 };
+static const size_t BATCH_MESSAGES = 37;
+
+struct BatchMessages
+{
+    std::vector<std::unique_ptr<AES::AES>> keys;
+    std::vector<Vector> vectors; // One per message, expected is the one shot output
+    std::vector<Bytes> out;
+    std::vector<AES::BatchJob> jobs;
+};
+
+static Bytes randomBytes(std::mt19937& rng, size_t n)
+{
+    Bytes out(n);
+    for (byte_t& b : out)
+        b = (byte_t)rng();
+    return out;
+}
+
+static Bytes oneShotCipher(const Backend& backend, const Vector& v)
+{
+    AES::AES aes;
+    Bytes in(v.plain);
+    in.resize(v.plain.size() + 2 * AES::AES::BLOCKSIZE); // Padding, never empty
+    Bytes out(in.size() + AES::AES::BLOCKSIZE);
+    EXPECT_TRUE(setup(aes, backend, v) && aes.cipher(in.data(), out.data(), v.plain.size()));
+    out.resize(AES::AES::getCipherOutBufferSize(v.plain.size(),
+        v.padding ? AES::PADDING::PKCS7 : AES::PADDING::NONE, v.mode));
+    return out;
+}
+
+// Jobs are ready for cipherBatch, out is sized for the padding
+static void makeMessages(const Backend& backend, AES::MODE mode, uint32_t seed,
+    BatchMessages& messages)
+{
+    std::mt19937 rng(seed);
+    const bool gcm = mode == AES::MODE::GCM;
+    const bool ocb = mode == AES::MODE::OCB;
+    const bool siv = mode == AES::MODE::GCM_SIV;
+    const bool padding = mode == AES::MODE::ECB || mode == AES::MODE::CBC;
+
+    std::vector<Vector> keyVectors;
+    for (AES::KEY_SIZE keySize : BATCH_KEY_SIZES)
+    {
+        if (siv && keySize == AES::KEY_SIZE::S192)
+            keySize = AES::KEY_SIZE::S256;
+        Vector v;
+        v.keySize = keySize;
+        v.mode = mode;
+        v.padding = padding;
+        v.key = randomBytes(rng, (size_t)keySize / 8);
+        std::unique_ptr<AES::AES> aes(new AES::AES());
+        ASSERT_TRUE(aes->setEngine(backend.engine) && aes->setGhash(backend.ghash)
+            && aes->initialize(keySize, mode, padding, v.key.data()));
+        messages.keys.push_back(std::move(aes));
+        keyVectors.push_back(v);
+    }
+
+    for (size_t i = 0; i < BATCH_MESSAGES; ++i)
+    {
+        size_t k = rng() % messages.keys.size();
+        Vector v = keyVectors[k];
+        if (siv)
+            v.iv = randomBytes(rng, AES::AES::SIV_NONCE_SIZE);
+        else if (ocb)
+            v.iv = randomBytes(rng, rng() % 4 == 0 ? 1 + rng() % 15 : 12);
+        else
+            v.iv = randomBytes(rng, gcm && rng() % 4 == 0 ? 1 + rng() % 60 : 16 - (gcm ? 4 : 0));
+        v.aad = gcm || ocb || siv ? randomBytes(rng, rng() % 40) : Bytes();
+        v.plain = randomBytes(rng, i == 0 ? 0 : rng() % (i % 5 == 0 ? 3000 : 100));
+        v.expected = oneShotCipher(backend, v);
+        messages.vectors.push_back(v);
+        messages.out.push_back(Bytes(v.expected.size() + 1, 0xEE));
+
+        AES::BatchJob job = {};
+        job.key = messages.keys[k].get();
+        job.ivSize = (unsigned int)v.iv.size();
+        job.aadSize = (unsigned int)v.aad.size();
+        job.dataSize = v.plain.size();
+        messages.jobs.push_back(job);
+    }
+
+    // Pointers are taken once every vector has its final address
+    for (size_t i = 0; i < BATCH_MESSAGES; ++i)
+    {
+        messages.jobs[i].iv = messages.vectors[i].iv.data();
+        messages.jobs[i].aad = messages.vectors[i].aad.empty() ?
+            nullptr : messages.vectors[i].aad.data();
+        messages.jobs[i].dataIn = messages.vectors[i].plain.data();
+        messages.jobs[i].dataOut = messages.out[i].data();
+    }
+}
+
+class BatchTest : public BackendTest
+{
+protected:
+    void roundTrip(AES::MODE mode, unsigned int lanes)
+    {
+        SCOPED_TRACE(AES::AES::getModeFromEnum(mode) + ", lanes " + std::to_string(lanes));
+        const bool tagged = mode == AES::MODE::GCM || mode == AES::MODE::OCB
+            || mode == AES::MODE::GCM_SIV;
+        const size_t tagSize = tagged ? AES::AES::BLOCKSIZE : 0;
+        BatchMessages messages;
+        makeMessages(this->backend, mode, 0xBA7C + lanes, messages);
+        ASSERT_FALSE(HasFatalFailure());
+
+        ASSERT_TRUE(AES::AES::cipherBatch(messages.jobs.data(), messages.jobs.size(), lanes));
+        for (size_t i = 0; i < messages.jobs.size(); ++i)
+        {
+            const Bytes& expected = messages.vectors[i].expected;
+            const size_t size = expected.size() - tagSize;
+            EXPECT_TRUE(messages.jobs[i].status);
+            EXPECT_EQ(Bytes(expected.begin(), expected.begin() + size),
+                Bytes(messages.out[i].begin(), messages.out[i].begin() + size))
+                << "message " << i;
+            EXPECT_EQ(0xEE, messages.out[i][size]) << "written past the end, message " << i;
+            EXPECT_EQ(Bytes(expected.begin() + size, expected.end()),
+                Bytes(messages.jobs[i].tag, messages.jobs[i].tag + tagSize)) << "message " << i;
+        }
+
+        // Deciphered in place, padding is left in the output like decipher does
+        for (size_t i = 0; i < messages.jobs.size(); ++i) {
+            messages.jobs[i].dataIn = messages.out[i].data();
+            messages.jobs[i].dataSize = messages.vectors[i].expected.size() - tagSize;
+        }
+        ASSERT_TRUE(AES::AES::decipherBatch(messages.jobs.data(), messages.jobs.size(), lanes));
+        for (size_t i = 0; i < messages.jobs.size(); ++i)
+        {
+            const Bytes& plain = messages.vectors[i].plain;
+            EXPECT_TRUE(messages.jobs[i].status);
+            EXPECT_EQ(plain,
+                Bytes(messages.out[i].begin(), messages.out[i].begin() + plain.size()))
+                << "message " << i;
+        }
+    }
+};
+
+TEST_P(BatchTest, MatchesOneShot)
+{
+    for (AES::MODE mode : { AES::MODE::ECB, AES::MODE::CBC, AES::MODE::CTR, AES::MODE::GCM,
+        AES::MODE::OCB, AES::MODE::GCM_SIV }) {
+        for (unsigned int lanes : { 1u, 5u, AES::AES::MAX_BATCH_LANES })
+            roundTrip(mode, lanes);
+    }
+}
+
+// A wrong tag only fails its own message, its plain text is wiped
+TEST_P(BatchTest, WrongTag)
+{
+    for (AES::MODE mode : { AES::MODE::GCM, AES::MODE::OCB, AES::MODE::GCM_SIV }) {
+        SCOPED_TRACE(AES::AES::getModeFromEnum(mode));
+        BatchMessages messages;
+        makeMessages(this->backend, mode, 0x7A6, messages);
+        ASSERT_FALSE(HasFatalFailure());
+        ASSERT_TRUE(AES::AES::cipherBatch(messages.jobs.data(), messages.jobs.size()));
+
+        for (size_t i = 0; i < messages.jobs.size(); ++i) {
+            messages.jobs[i].dataIn = messages.out[i].data();
+            messages.jobs[i].dataSize = messages.vectors[i].plain.size();
+        }
+        messages.jobs[3].tag[5] ^= 0x10;
+        EXPECT_FALSE(AES::AES::decipherBatch(messages.jobs.data(), messages.jobs.size()));
+        for (size_t i = 0; i < messages.jobs.size(); ++i)
+            EXPECT_EQ(i != 3, messages.jobs[i].status) << "message " << i;
+        const size_t size = messages.vectors[3].plain.size();
+        ASSERT_GT(size, 0u);
+        EXPECT_EQ(Bytes(size, 0), Bytes(messages.out[3].begin(), messages.out[3].begin() + size));
+        EXPECT_EQ(messages.vectors[4].plain, Bytes(messages.out[4].begin(),
+            messages.out[4].begin() + messages.vectors[4].plain.size()));
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(Engines, BatchTest, ::testing::Combine(
+    ::testing::ValuesIn(TEST_ENGINES),
+    ::testing::Values(AES::GHASH::AUTO),
+    ::testing::Values(1u)), backendName);
+
+// Keys on different engines share a CBC step, each engine ciphers its own lanes
+TEST(Batch, MixedEngines)
+{
+    const AES::ENGINE engines[] = { AES::ENGINE::TTABLE, AES::ENGINE::AUTO,
+        AES::ENGINE::BITSLICE };
+    Vector v;
+    v.keySize = AES::KEY_SIZE::S128;
+    v.mode = AES::MODE::CBC;
+    v.padding = true;
+    v.key = Bytes(16, 0x42);
+    v.iv = Bytes(16, 0x24);
+    v.plain = Bytes(100, 0x5A);
+    const Bytes expected = oneShotCipher({ AES::ENGINE::REFERENCE, AES::GHASH::AUTO, 1 }, v);
+
+    AES::AES keys[3];
+    std::vector<Bytes> out(6, Bytes(expected.size()));
+    std::vector<AES::BatchJob> jobs;
+    for (size_t i = 0; i < out.size(); ++i)
+    {
+        AES::AES& aes = keys[i % 3];
+        if (i < 3) {
+            ASSERT_TRUE(aes.setEngine(engines[i]));
+            ASSERT_TRUE(aes.initialize(v.keySize, v.mode, v.padding, v.key.data()));
+        }
+        AES::BatchJob job = {};
+        job.key = &aes;
+        job.iv = v.iv.data();
+        job.ivSize = (unsigned int)v.iv.size();
+        job.dataIn = v.plain.data();
+        job.dataOut = out[i].data();
+        job.dataSize = v.plain.size();
+        jobs.push_back(job);
+    }
+
+    ASSERT_TRUE(AES::AES::cipherBatch(jobs.data(), jobs.size()));
+    for (size_t i = 0; i < out.size(); ++i)
+        EXPECT_EQ(expected, out[i]) << "message " << i;
+}
+
+TEST(Batch, InvalidJobs)
+{
+    const Bytes key(16, 0x42);
+    const Bytes data(32, 0x5A);
+    Bytes out(64);
+    AES::AES aes;
+    AES::AES notInitialized;
+    ASSERT_TRUE(aes.initialize(AES::KEY_SIZE::S128, AES::MODE::CBC, false, key.data()));
+
+    AES::BatchJob jobs[4] = {};
+    for (AES::BatchJob& job : jobs) {
+        job.key = &aes;
+        job.iv = key.data();
+        job.ivSize = 16;
+        job.dataIn = data.data();
+        job.dataOut = out.data();
+        job.dataSize = data.size();
+    }
+    jobs[1].key = &notInitialized;
+    jobs[2].ivSize = 12;
+    jobs[3].key = nullptr;
+
+    EXPECT_FALSE(AES::AES::cipherBatch(jobs, 4));
+    EXPECT_TRUE(jobs[0].status);
+    EXPECT_FALSE(jobs[1].status);
+    EXPECT_FALSE(jobs[2].status);
+    EXPECT_FALSE(jobs[3].status);
+
+    EXPECT_FALSE(AES::AES::cipherBatch(jobs, 1, 0));
+    EXPECT_FALSE(AES::AES::cipherBatch(jobs, 1, AES::AES::MAX_BATCH_LANES + 1));
+    EXPECT_FALSE(jobs[0].status);
+    EXPECT_TRUE(AES::AES::cipherBatch(nullptr, 0));
+}
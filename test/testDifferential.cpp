@@ -0,0 +1,282 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <libaes/libaes.hpp>
+
+#include "testUtils.hpp"
+
+/**
+ * Random key/iv/aad/length combinations through every engine, ghash engine and mode
+ * The portable path, REFERENCE engine and REFERENCE ghash on 1 thread, gives the expected
+ * ciphertext, each backend must match it with cipher, update/final in random pieces,
+ * then decipher both ways and reject a flipped bit in GCM, OCB and GCM-SIV
+ * XTS and GCM-SIV have no streaming
+ *
+ * LIBAES_DIFF_ITERATIONS sets the number of cases per backend (default 200), nightly runs
+ * use millions. LIBAES_DIFF_SEED replays a run, failures print the seed and the case
+**/
+
+static uint64_t getEnvNumber(const char* name, uint64_t defaultValue)
+{
+    const char* value = std::getenv(name);
+    if (value == nullptr || *value == '\0')
+        return defaultValue;
+    return std::strtoull(value, nullptr, 0);
+}
+
+class RandomCase
+{
+public:
+    explicit RandomCase(uint64_t seed) : rng(seed) {}
+
+    size_t below(size_t n)
+    {
+        return n == 0 ? 0 : (size_t)(this->rng() % n);
+    }
+
+    Bytes bytes(size_t n)
+    {
+        Bytes out(n);
+        for (byte_t& b : out)
+            b = (byte_t)this->rng();
+        return out;
+    }
+
+    /*
+        Lengths are picked around the edges of the code: empty, partial and exact blocks,
+        8 block batches, and now and then past THREAD_CHUNK_SIZE (1 MB) so threads split it
+    */
+    size_t length()
+    {
+        switch (this->below(10))
+        {
+        case 0:
+        case 1:
+        case 2:
+            return this->below(48);
+        case 3:
+        case 4:
+        case 5:
+            return this->below(600);
+        case 6:
+        case 7:
+            return AES::AES::BLOCKSIZE * (1 + this->below(64)) - 1 + this->below(3);
+        case 8:
+            return this->below(20000);
+        default:
+            if (this->below(32) == 0)
+                return (1 << 20) + this->below(3 << 20);
+            return this->below(70000);
+        }
+    }
+
+    Vector next()
+    {
+        static const AES::MODE MODES[] = { AES::MODE::ECB, AES::MODE::CBC, AES::MODE::CTR,
+            AES::MODE::GCM, AES::MODE::XTS, AES::MODE::OCB, AES::MODE::GCM_SIV };
+        static const AES::KEY_SIZE KEY_SIZES[] = { AES::KEY_SIZE::S128, AES::KEY_SIZE::S192,
+            AES::KEY_SIZE::S256 };
+
+        Vector v;
+        v.mode = MODES[this->below(7)];
+        v.keySize = KEY_SIZES[this->below(3)];
+        v.padding = this->below(2) == 0;
+        v.key = this->bytes(AES::AES::getKeySizeFromEnum(v.keySize) / 8);
+
+        size_t size = this->length();
+        if (!v.padding && (v.mode == AES::MODE::ECB || v.mode == AES::MODE::CBC))
+            size -= size % AES::AES::BLOCKSIZE;
+        if (v.mode == AES::MODE::XTS) {
+            // 128 or 256 bits, data key then tweak key, a data unit is at least one block
+            if (v.keySize == AES::KEY_SIZE::S192)
+                v.keySize = AES::KEY_SIZE::S256;
+            v.padding = false;
+            v.key = this->bytes(AES::AES::getKeySizeFromEnum(v.keySize) / 4);
+            size = std::max(size, (size_t)AES::AES::BLOCKSIZE + this->below(20));
+        }
+        if (v.mode == AES::MODE::GCM_SIV && v.keySize == AES::KEY_SIZE::S192) {
+            v.keySize = AES::KEY_SIZE::S256;
+            v.key = this->bytes(32);
+        }
+        v.plain = this->bytes(size);
+
+        if (v.mode == AES::MODE::GCM) {
+            // 12 bytes is the fast path, any other size goes through GHASH
+            v.iv = this->bytes(this->below(2) == 0 ? 12 : 1 + this->below(80));
+            v.aad = this->bytes(this->below(4) == 0 ? this->below(1000) : this->below(40));
+        }
+        else if (v.mode == AES::MODE::OCB) {
+            // 12 bytes is the usual nonce, its last 6 bits pick the shift of Offset_0
+            v.iv = this->bytes(this->below(2) == 0 ? 12 : 1 + this->below(15));
+            v.aad = this->bytes(this->below(4) == 0 ? this->below(1000) : this->below(40));
+        }
+        else if (v.mode == AES::MODE::GCM_SIV) {
+            v.iv = this->bytes(AES::AES::SIV_NONCE_SIZE);
+            v.aad = this->bytes(this->below(4) == 0 ? this->below(1000) : this->below(40));
+        }
+        else {
+            v.iv = this->bytes(AES::AES::BLOCKSIZE);
+            // CTR counter about to wrap, the carry goes through several bytes
+            if (v.mode == AES::MODE::CTR && this->below(3) == 0) {
+                size_t n = 1 + this->below(AES::AES::BLOCKSIZE);
+                for (size_t i = AES::AES::BLOCKSIZE - n; i < AES::AES::BLOCKSIZE; ++i)
+                    v.iv[i] = 0xFF;
+            }
+        }
+        return v;
+    }
+
+    std::mt19937_64 rng;
+};
+
+static const Backend REFERENCE_BACKEND = { AES::ENGINE::REFERENCE, AES::GHASH::REFERENCE, 1 };
+
+// One shot cipher, in place or not, output is the ciphertext then the tag if the mode has one
+static bool oneShotCipher(const Backend& backend, const Vector& v, bool inPlace, Bytes& out)
+{
+    AES::PADDING padding = v.padding ? AES::PADDING::PKCS7 : AES::PADDING::NONE;
+    size_t cipherSize = AES::AES::getCipherOutBufferSize(v.plain.size(), padding, v.mode);
+
+    Bytes in(v.plain);
+    in.resize(std::max(AES::AES::getPlainInBufferSize(v.plain.size(), padding, v.mode),
+        cipherSize) + AES::AES::BLOCKSIZE);
+    out.assign(cipherSize + AES::AES::BLOCKSIZE, 0);
+
+    AES::AES aes;
+    if (!setup(aes, backend, v))
+        return false;
+    if (!aes.cipher(in.data(), inPlace ? in.data() : out.data(), v.plain.size()))
+        return false;
+    if (inPlace)
+        out.assign(in.begin(), in.begin() + cipherSize);
+    out.resize(cipherSize);
+    return true;
+}
+
+static bool oneShotDecipher(const Backend& backend, const Vector& v, const Bytes& cipher,
+    Bytes& plain)
+{
+    AES::PADDING padding = v.padding ? AES::PADDING::PKCS7 : AES::PADDING::NONE;
+    size_t plainSize = AES::AES::getPlainOutBufferSize(cipher.size(), padding, v.mode);
+
+    Bytes in(cipher);
+    in.resize(cipher.size() + AES::AES::BLOCKSIZE);
+    plain.assign(plainSize + AES::AES::BLOCKSIZE, 0);
+
+    AES::AES aes;
+    if (!setup(aes, backend, v) || !aes.decipher(in.data(), plain.data(), cipher.size()))
+        return false;
+    plain.resize(plainSize - AES::AES::getRevPaddingSize(plain.data(), cipher.size(),
+        padding, v.mode));
+    return true;
+}
+
+static Bytes stream(const Backend& backend, const Vector& v, bool encrypt, const Bytes& data,
+    RandomCase& random, bool& ok)
+{
+    auto nextPiece = [&random](size_t remaining) {
+        return random.below(4) == 0 ? random.below(remaining + 1) : random.below(100);
+    };
+
+    AES::AES aes;
+    ok = setup(aes, backend, v) && aes.init(encrypt);
+    if (!ok)
+        return Bytes();
+    return streamPieces(aes, data, nextPiece, ok);
+}
+
+/*
+    CTR rebuilt from ECB with the counter incremented here, the reference path shares
+    qwordInc and the partial block logic with the other engines so it can't catch them
+*/
+static Bytes ctrFromEcb(const Vector& v)
+{
+    size_t nBlocks = AES::AES::getBlockRoundedSize(v.plain.size()) / AES::AES::BLOCKSIZE;
+    Vector ecb = v;
+    ecb.mode = AES::MODE::ECB;
+    ecb.padding = false;
+    ecb.plain.clear();
+
+    Bytes counter(v.iv);
+    for (size_t i = 0; i < nBlocks; ++i) {
+        ecb.plain.insert(ecb.plain.end(), counter.begin(), counter.end());
+        for (int j = AES::AES::BLOCKSIZE - 1; j >= 0 && ++counter[j] == 0; --j)
+            ;
+    }
+
+    Bytes keystream;
+    if (!oneShotCipher(REFERENCE_BACKEND, ecb, false, keystream))
+        return Bytes();
+    Bytes out(v.plain);
+    for (size_t i = 0; i < out.size(); ++i)
+        out[i] ^= keystream[i];
+    return out;
+}
+
+class DifferentialTest : public BackendTest {};
+
+TEST_P(DifferentialTest, AgainstReference)
+{
+    uint64_t iterations = getEnvNumber("LIBAES_DIFF_ITERATIONS", 200);
+    uint64_t seed = getEnvNumber("LIBAES_DIFF_SEED", 0x5EED);
+    RandomCase random(seed ^ ((uint64_t)this->backend.engine << 40)
+        ^ ((uint64_t)this->backend.ghash << 48) ^ ((uint64_t)this->backend.threads << 56));
+
+    for (uint64_t i = 0; i < iterations && !HasFailure(); ++i)
+    {
+        Vector v = random.next();
+        SCOPED_TRACE("seed " + std::to_string(seed) + ", case " + std::to_string(i) + ", "
+            + AES::AES::getModeFromEnum(v.mode) + "-"
+            + std::to_string(AES::AES::getKeySizeFromEnum(v.keySize))
+            + (v.padding ? " pkcs7" : "") + ", " + std::to_string(v.plain.size()) + " bytes, iv "
+            + std::to_string(v.iv.size()) + ", aad " + std::to_string(v.aad.size()));
+
+        ASSERT_TRUE(oneShotCipher(REFERENCE_BACKEND, v, false, v.expected));
+        if (v.mode == AES::MODE::CTR && !v.padding) {
+            ASSERT_EQ(ctrFromEcb(v), v.expected) << "reference ctr";
+        }
+
+        Bytes out;
+        bool ok;
+        ASSERT_TRUE(oneShotCipher(this->backend, v, random.below(4) == 0, out));
+        EXPECT_EQ(v.expected, out) << "cipher";
+
+        ASSERT_TRUE(oneShotDecipher(this->backend, v, v.expected, out));
+        EXPECT_EQ(v.plain, out) << "decipher";
+
+        const bool streamed = v.mode != AES::MODE::XTS && v.mode != AES::MODE::GCM_SIV;
+        if (streamed) {
+            out = stream(this->backend, v, true, v.plain, random, ok);
+            EXPECT_TRUE(ok);
+            EXPECT_EQ(v.expected, out) << "stream cipher";
+
+            out = stream(this->backend, v, false, v.expected, random, ok);
+            EXPECT_TRUE(ok);
+            EXPECT_EQ(v.plain, out) << "stream decipher";
+        }
+
+        if (v.mode == AES::MODE::GCM || v.mode == AES::MODE::OCB
+            || v.mode == AES::MODE::GCM_SIV)
+        {
+            Bytes tampered(v.expected);
+            tampered[random.below(tampered.size())] ^= (byte_t)(1 << random.below(8));
+            EXPECT_FALSE(oneShotDecipher(this->backend, v, tampered, out)) << "tag";
+            if (streamed) {
+                stream(this->backend, v, false, tampered, random, ok);
+                EXPECT_FALSE(ok) << "stream tag";
+            }
+        }
+    }
+}
+
+// 4 threads split the messages larger than THREAD_CHUNK_SIZE
+INSTANTIATE_TEST_SUITE_P(Engines, DifferentialTest, ::testing::Combine(
+    ::testing::ValuesIn(TEST_ENGINES),
+    ::testing::ValuesIn(TEST_GHASHES),
+    ::testing::Values(1u, 4u)), backendName);
@@ -0,0 +1,80 @@
+#include <cstdint>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include <libaes/libaes.hpp>
+
+#include "testUtils.hpp"
+
+/**
+ * RFC 8452 appendix C.1 message with a random key, then the calls GCM-SIV refuses
+ * The message keys come from the nonce: the aad is set after it and a repeated nonce
+ * only reveals that the same message was sent again
+**/
+
+class GcmSivTest : public BackendTest
+{
+};
+
+TEST_P(GcmSivTest, RfcHelloWorld)
+{
+    Vector v;
+    v.keySize = AES::KEY_SIZE::S128;
+    v.mode = AES::MODE::GCM_SIV;
+    v.padding = false;
+    v.key = { 0xEE, 0x8E, 0x1E, 0xD9, 0xFF, 0x25, 0x40, 0xAE, 0x8F, 0x2B, 0xA9, 0xF5, 0x0B,
+        0xC2, 0xF2, 0x7C };
+    v.iv = { 0x75, 0x2A, 0xBA, 0xD3, 0xE0, 0xAF, 0xB5, 0xF4, 0x34, 0xDC, 0x43, 0x10 };
+    AES::AES aes;
+    ASSERT_TRUE(setup(aes, this->backend, v));
+
+    const std::string plain = "Hello world";
+    const std::string aad = "example";
+    const Bytes expected = { 0x5D, 0x34, 0x9E, 0xAD, 0x17, 0x5E, 0xF6, 0xB1, 0xDE, 0xF6, 0xFD,
+        0x4F, 0xBC, 0xDE, 0xB7, 0xE4, 0x79, 0x3F, 0x4A, 0x1D, 0x7E, 0x4F, 0xAA, 0x70, 0x10, 0x0A,
+        0xF1 };
+    Bytes out = encryptWith(aes, v.iv, Bytes(aad.begin(), aad.end()),
+        Bytes(plain.begin(), plain.end()));
+    EXPECT_EQ(expected, out);
+
+    // Same nonce, same message: same output, the key of the nonce is derived again
+    EXPECT_EQ(out, encryptWith(aes, v.iv, Bytes(aad.begin(), aad.end()),
+        Bytes(plain.begin(), plain.end())));
+
+    Bytes back(out.size());
+    ASSERT_TRUE(aes.decipher(out.data(), back.data(), out.size()));
+    back.resize(plain.size());
+    EXPECT_EQ(Bytes(plain.begin(), plain.end()), back);
+}
+
+INSTANTIATE_TEST_SUITE_P(Engines, GcmSivTest, ::testing::Combine(
+    ::testing::ValuesIn(TEST_ENGINES),
+    ::testing::ValuesIn(TEST_GHASHES),
+    ::testing::Values(1u)), backendName);
+
+TEST(GcmSiv, InvalidCalls)
+{
+    const Bytes key(32, 0x42);
+    Bytes data(64, 0x5A);
+    Bytes out(64);
+
+    AES::AES aes;
+    EXPECT_FALSE(aes.initialize(AES::KEY_SIZE::S192, AES::MODE::GCM_SIV, false, key.data()));
+    ASSERT_TRUE(aes.initialize(AES::KEY_SIZE::S256, AES::MODE::GCM_SIV, false, key.data()));
+    EXPECT_FALSE(aes.cipher(data.data(), out.data(), 16)); // No nonce yet
+    EXPECT_FALSE(aes.setAad(data.data(), 3)); // Needs the key of the nonce
+    EXPECT_FALSE(aes.init(true)); // Two passes, no stream
+    EXPECT_FALSE(aes.setIv(data.data(), 16));
+    EXPECT_FALSE(aes.setIv(data.data(), 11));
+    ASSERT_TRUE(aes.setIv(data.data(), AES::AES::SIV_NONCE_SIZE));
+
+    // A new nonce drops the aad
+    ASSERT_TRUE(aes.setAad(data.data(), 3));
+    ASSERT_TRUE(aes.cipher(data.data(), out.data(), 20));
+    ASSERT_TRUE(aes.setIv(data.data(), AES::AES::SIV_NONCE_SIZE));
+    Bytes plain(20);
+    EXPECT_FALSE(aes.decipher(out.data(), plain.data(), 36));
+    ASSERT_TRUE(aes.setAad(data.data(), 3));
+    EXPECT_TRUE(aes.decipher(out.data(), plain.data(), 36));
+}
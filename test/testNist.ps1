@@ -19,7 +19,8 @@ function Invoke-Test {
     param (
         [string]$FileIn,
         [string]$KeySize,
-        [string]$Mode
+        [string]$Mode,
+        [string]$Engine
     )
 
     $key = $keys[$KeySize]
@@ -32,8 +33,8 @@ function Invoke-Test {
     $fileEncrypted = "$testPath\$FileIn.$KeySize.$Mode"
     $fileDecrypted = "$testPath\$FileIn"
 
-    Invoke-Cliaes -KeySize $KeySize -Mode $Mode -Key $key -Iv $nonce -FileIn $basePlain -FileOut $fileEncrypted -Decrypt $false -NoPadding $true | Out-Null
-    Invoke-Cliaes -KeySize $KeySize -Mode $Mode -Key $key -Iv $nonce -FileIn $fileEncrypted -FileOut $fileDecrypted -Decrypt $true -NoPadding $true | Out-Null
+    Invoke-Cliaes -KeySize $KeySize -Mode $Mode -Key $key -Iv $nonce -Engine $Engine -FileIn $basePlain -FileOut $fileEncrypted -Decrypt $false -NoPadding $true | Out-Null
+    Invoke-Cliaes -KeySize $KeySize -Mode $Mode -Key $key -Iv $nonce -Engine $Engine -FileIn $fileEncrypted -FileOut $fileDecrypted -Decrypt $true -NoPadding $true | Out-Null
 
     # Test decrypted file
     $diffPlain = Compare-Object (Get-Content $basePlain) (Get-Content $fileDecrypted)
@@ -56,12 +57,14 @@ Write-Host "Running nist tests suite..."
 # Create temporary dir to store generated files
 New-Item -Force -ItemType "directory" -Path $testPath | Out-Null
 
-# Execute all test combination
-foreach ($keySize in $keySizes) {
-    foreach ($mode in $modes) {
-        $ret = Invoke-Test -FileIn $plainPath -KeySize $keySize -Mode $mode
-        if (!$ret) {
-            Write-Host "Error : $file / $keySize-$mode"
+# Execute all test combination, every engine must give the same output
+foreach ($engine in $engines) {
+    foreach ($keySize in $keySizes) {
+        foreach ($mode in $modes) {
+            $ret = Invoke-Test -FileIn $plainPath -KeySize $keySize -Mode $mode -Engine $engine
+            if (!$ret) {
+                Write-Host "Error : $file / $keySize-$mode / $engine"
+            }
         }
     }
 }
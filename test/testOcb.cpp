@@ -0,0 +1,101 @@
+#include <cstdint>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include <libaes/libaes.hpp>
+
+#include "testUtils.hpp"
+
+/**
+ * RFC 7253 appendix A iterated test: 384 messages of 0 to 127 bytes under one key,
+ * the tag of their concatenation given as aad must be the one of the RFC
+ * The key is kept, each message only sets its own nonce and aad
+**/
+
+// num2str(n, 96)
+static Bytes ocbNonce(uint32_t n)
+{
+    Bytes nonce(12, 0);
+    for (int i = 0; i < 4; ++i)
+        nonce[11 - i] = (byte_t)(n >> (8 * i));
+    return nonce;
+}
+
+class OcbTest : public BackendTest
+{
+protected:
+    void checkIterated(AES::KEY_SIZE keySize, const Bytes& expected)
+    {
+        SCOPED_TRACE(std::to_string((int)keySize) + " bits");
+        Bytes key((size_t)keySize / 8, 0);
+        key.back() = 128; // TAGLEN
+
+        Vector v;
+        v.keySize = keySize;
+        v.mode = AES::MODE::OCB;
+        v.padding = false;
+        v.key = key;
+        v.iv = ocbNonce(0);
+        AES::AES aes;
+        ASSERT_TRUE(setup(aes, this->backend, v));
+
+        Bytes C;
+        for (uint32_t i = 0; i < 128; ++i) {
+            Bytes S(i, 0);
+            Bytes out = encryptWith(aes, ocbNonce(3 * i + 1), S, S);
+            C.insert(C.end(), out.begin(), out.end());
+            out = encryptWith(aes, ocbNonce(3 * i + 2), Bytes(), S);
+            C.insert(C.end(), out.begin(), out.end());
+            out = encryptWith(aes, ocbNonce(3 * i + 3), S, Bytes());
+            C.insert(C.end(), out.begin(), out.end());
+        }
+        EXPECT_EQ(expected, encryptWith(aes, ocbNonce(385), C, Bytes()));
+    }
+};
+
+TEST_P(OcbTest, RfcIteratedTags)
+{
+    checkIterated(AES::KEY_SIZE::S128, { 0x67, 0xE9, 0x44, 0xD2, 0x32, 0x56, 0xC5, 0xE0,
+        0xB6, 0xC6, 0x1F, 0xA2, 0x2F, 0xDF, 0x1E, 0xA2 });
+    checkIterated(AES::KEY_SIZE::S192, { 0xF6, 0x73, 0xF2, 0xC3, 0xE7, 0x17, 0x4A, 0xAE,
+        0x7B, 0xAE, 0x98, 0x6C, 0xA9, 0xF2, 0x9E, 0x17 });
+    checkIterated(AES::KEY_SIZE::S256, { 0xD9, 0x0E, 0xB8, 0xE9, 0xC9, 0x77, 0xC8, 0x8B,
+        0x79, 0xDD, 0x79, 0x3D, 0x7F, 0xFA, 0x16, 0x1C });
+}
+
+INSTANTIATE_TEST_SUITE_P(Engines, OcbTest, ::testing::Combine(
+    ::testing::ValuesIn(TEST_ENGINES),
+    ::testing::Values(AES::GHASH::AUTO),
+    ::testing::Values(1u)), backendName);
+
+TEST(Ocb, InvalidCalls)
+{
+    const Bytes key(16, 0x42);
+    Bytes data(64, 0x5A);
+    Bytes out(64);
+
+    AES::AES aes;
+    ASSERT_TRUE(aes.initialize(AES::KEY_SIZE::S128, AES::MODE::OCB, false, key.data()));
+    EXPECT_FALSE(aes.cipher(data.data(), out.data(), 16)); // No nonce yet
+    EXPECT_FALSE(aes.init(true));
+    EXPECT_FALSE(aes.setIv(data.data(), 0));
+    EXPECT_FALSE(aes.setIv(data.data(), 16));
+    ASSERT_TRUE(aes.setIv(data.data(), 15));
+    ASSERT_TRUE(aes.setIv(data.data(), 1));
+
+    // Tag alone, then a message shorter than the tag
+    ASSERT_TRUE(aes.cipher(data.data(), out.data(), 0));
+    EXPECT_TRUE(aes.decipher(out.data(), data.data(), 16));
+    EXPECT_FALSE(aes.decipher(out.data(), data.data(), 15));
+
+    // The aad is part of the tag, the plain text of a wrong tag is wiped
+    ASSERT_TRUE(aes.cipher(data.data(), out.data(), 20));
+    ASSERT_TRUE(aes.setAad(data.data(), 3));
+    Bytes plain(20, 0xEE);
+    EXPECT_FALSE(aes.decipher(out.data(), plain.data(), 36));
+    EXPECT_EQ(Bytes(20, 0), plain);
+    ASSERT_TRUE(aes.setAad(nullptr, 0));
+    EXPECT_TRUE(aes.decipher(out.data(), plain.data(), 36));
+    EXPECT_EQ(Bytes(20, 0x5A), plain);
+}
@@ -0,0 +1,115 @@
+#include <cstdint>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <libaes/libaes.hpp>
+
+#include "testUtils.hpp"
+
+/**
+ * Statistics are shared by the whole process, each test starts from zero and turns them off
+ * Bytes and calls are exact, times are only checked to be counted
+**/
+
+class StatsTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        AES::AES::enableStats(true);
+        AES::AES::resetStats();
+    }
+
+    void TearDown() override
+    {
+        AES::AES::enableStats(false);
+        AES::AES::resetStats();
+    }
+
+    static AES::StageStats get(const AES::Stats& stats, AES::STAGE stage)
+    {
+        return stats.stages[(int)stage];
+    }
+};
+
+static Vector gcmVector(size_t size, size_t aadSize)
+{
+    Vector v;
+    v.keySize = AES::KEY_SIZE::S128;
+    v.mode = AES::MODE::GCM;
+    v.padding = false;
+    v.key = Bytes(16, 0x42);
+    v.iv = Bytes(12, 0x24);
+    v.aad = Bytes(aadSize, 0x11);
+    v.plain = Bytes(size, 0x5A);
+    return v;
+}
+
+static bool gcmCipher(const Vector& v, unsigned int threads)
+{
+    Backend backend = { AES::ENGINE::AUTO, AES::GHASH::AUTO, threads };
+    Bytes in(v.plain);
+    in.resize(v.plain.size() + AES::AES::BLOCKSIZE);
+    Bytes out(v.plain.size() + 2 * AES::AES::BLOCKSIZE);
+
+    AES::AES aes;
+    return setup(aes, backend, v) && aes.cipher(in.data(), out.data(), v.plain.size());
+}
+
+// Every GCM stage is counted once per message, gctr and ghash on the whole message
+TEST_F(StatsTest, GcmStages)
+{
+    const size_t size = (3 << 20) + 100; // Split between threads
+    ASSERT_TRUE(gcmCipher(gcmVector(size, 20), 4));
+
+    AES::Stats stats;
+    AES::AES::getStats(stats);
+    EXPECT_EQ(1u, get(stats, AES::STAGE::KEY_EXPANSION).calls);
+    EXPECT_EQ(11u, get(stats, AES::STAGE::KEY_EXPANSION).blocks);
+    EXPECT_EQ(1u, get(stats, AES::STAGE::GHASH_KEY).calls);
+    EXPECT_EQ(1u, get(stats, AES::STAGE::GCM_J0).calls);
+    EXPECT_EQ(1u, get(stats, AES::STAGE::GCM_TAG).calls);
+    EXPECT_EQ(size, get(stats, AES::STAGE::GCTR).bytes);
+    EXPECT_EQ((size + 15) / 16, get(stats, AES::STAGE::GCTR).blocks);
+    EXPECT_EQ(size + 20, get(stats, AES::STAGE::GHASH).bytes); // aad then ciphertext
+    EXPECT_EQ(0u, get(stats, AES::STAGE::CTR).calls);
+    EXPECT_GT(get(stats, AES::STAGE::GCTR).nanoseconds, 0u);
+    EXPECT_GT(get(stats, AES::STAGE::GHASH).nanoseconds, 0u);
+    EXPECT_GE(stats.threads, 1u);
+}
+
+TEST_F(StatsTest, DisabledRecordsNothing)
+{
+    AES::AES::enableStats(false);
+    ASSERT_FALSE(AES::AES::isStatsEnabled());
+    ASSERT_TRUE(gcmCipher(gcmVector(5000, 0), 1));
+    AES::AES::addStats(AES::STAGE::READ, 100, 1000);
+
+    AES::Stats stats;
+    AES::AES::getStats(stats);
+    for (const AES::StageStats& stage : stats.stages)
+        EXPECT_EQ(0u, stage.calls);
+    EXPECT_EQ(0u, stats.threads);
+}
+
+TEST_F(StatsTest, ApplicationStagesAndReset)
+{
+    AES::AES::addStats(AES::STAGE::READ, 100, 1000);
+    AES::AES::addStats(AES::STAGE::READ, 50, 500);
+    AES::AES::addStats(AES::STAGE::WRITE, 150, 2000);
+
+    AES::Stats stats;
+    AES::AES::getStats(stats);
+    EXPECT_EQ(2u, get(stats, AES::STAGE::READ).calls);
+    EXPECT_EQ(150u, get(stats, AES::STAGE::READ).bytes);
+    EXPECT_EQ(11u, get(stats, AES::STAGE::READ).blocks); // 7 + 4, rounded up per call
+    EXPECT_EQ(1500u, get(stats, AES::STAGE::READ).nanoseconds);
+    EXPECT_EQ(0u, get(stats, AES::STAGE::READ).cycles);
+    EXPECT_EQ(2000u, get(stats, AES::STAGE::WRITE).nanoseconds);
+    EXPECT_NE(std::string::npos, AES::AES::getStatsReport().find("Read"));
+
+    AES::AES::resetStats();
+    AES::AES::getStats(stats);
+    EXPECT_EQ(0u, get(stats, AES::STAGE::READ).calls);
+}
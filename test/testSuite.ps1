@@ -9,7 +9,8 @@ function Invoke-Test {
     param (
         [string]$FileIn,
         [string]$KeySize,
-        [string]$Mode
+        [string]$Mode,
+        [string]$Threads
     )
 
     $key = $defaultKeys[$KeySize]
@@ -19,8 +20,8 @@ function Invoke-Test {
     $fileEncrypted = "$testPath\$FileIn.$KeySize.$Mode"
     $fileDecrypted = "$testPath\$FileIn"
 
-    Invoke-Cliaes -KeySize $KeySize -Mode $Mode -Key $key -Iv $iv -FileIn $basePlain -FileOut $fileEncrypted -Decrypt $false -NoPadding $false | Out-Null
-    Invoke-Cliaes -KeySize $KeySize -Mode $Mode -Key $key -Iv $iv -FileIn $fileEncrypted -FileOut $fileDecrypted -Decrypt $true -NoPadding $false | Out-Null
+    Invoke-Cliaes -KeySize $KeySize -Mode $Mode -Key $key -Iv $iv -Threads $Threads -FileIn $basePlain -FileOut $fileEncrypted -Decrypt $false -NoPadding $false | Out-Null
+    Invoke-Cliaes -KeySize $KeySize -Mode $Mode -Key $key -Iv $iv -Threads $Threads -FileIn $fileEncrypted -FileOut $fileDecrypted -Decrypt $true -NoPadding $false | Out-Null
 
     # Test decrypted file
     $diffPlain = Compare-Object (Get-Content $basePlain) (Get-Content $fileDecrypted)
@@ -43,13 +44,15 @@ Write-Host "Running tests suite..."
 # Create temporary dir to store generated files
 New-Item -Force -ItemType "directory" -Path $testPath | Out-Null
 
-# Execute all test combination
-foreach ($file in $defaultFiles) {
-    foreach ($keySize in $keySizes) {
-        foreach ($mode in $modes) {
-            $ret = Invoke-Test -FileIn $file -KeySize $keySize -Mode $mode
-            if (!$ret) {
-                Write-Host "Error : $file / $keySize-$mode"
+# Execute all test combination, output must not depend on the number of threads
+foreach ($threads in $threadCounts) {
+    foreach ($file in $defaultFiles) {
+        foreach ($keySize in $keySizes) {
+            foreach ($mode in $modes) {
+                $ret = Invoke-Test -FileIn $file -KeySize $keySize -Mode $mode -Threads $threads
+                if (!$ret) {
+                    Write-Host "Error : $file / $keySize-$mode / $threads threads"
+                }
             }
         }
     }
@@ -0,0 +1,122 @@
+#ifndef TEST_TEST_UTILS_HPP
+#define TEST_TEST_UTILS_HPP
+
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <libaes/libaes.hpp>
+
+typedef std::vector<byte_t> Bytes;
+
+struct Vector
+{
+    AES::KEY_SIZE keySize;
+    AES::MODE mode;
+    bool padding;
+    Bytes key;
+    Bytes iv;
+    Bytes aad;
+    Bytes plain;
+    Bytes expected; // Ciphertext, followed by the tag in GCM
+};
+
+struct Backend
+{
+    AES::ENGINE engine;
+    AES::GHASH ghash;
+    unsigned int threads;
+};
+
+inline bool setup(AES::AES& aes, const Backend& backend, const Vector& v)
+{
+    return aes.setEngine(backend.engine)
+        && aes.setGhash(backend.ghash)
+        && aes.setThreads(backend.threads)
+        && aes.initialize(v.keySize, v.mode, v.padding, v.key.data())
+        && aes.setIv(v.iv.data(), (int)v.iv.size())
+        && aes.setAad(v.aad.empty() ? nullptr : v.aad.data(), (int)v.aad.size());
+}
+
+// One message of an AEAD mode under the nonce and aad, gives the ciphertext then the tag
+inline Bytes encryptWith(AES::AES& aes, const Bytes& nonce, const Bytes& aad, const Bytes& plain)
+{
+    Bytes in(plain);
+    in.resize(plain.size() + AES::AES::BLOCKSIZE);
+    Bytes out(plain.size() + AES::AES::BLOCKSIZE);
+    EXPECT_TRUE(aes.setIv(nonce.data(), (int)nonce.size()));
+    EXPECT_TRUE(aes.setAad(aad.empty() ? nullptr : aad.data(), (int)aad.size()));
+    EXPECT_TRUE(aes.cipher(in.data(), out.data(), plain.size()));
+    return out;
+}
+
+/*
+    Gives data to update in pieces of nextPiece(remaining) bytes then calls final
+    ok is false as soon as update or final fails, the output is then incomplete
+*/
+inline Bytes streamPieces(AES::AES& aes, const Bytes& data,
+    const std::function<size_t(size_t remaining)>& nextPiece, bool& ok)
+{
+    Bytes out(data.size() + AES::AES::BLOCKSIZE + AES::AES::STREAM_FINAL_SIZE);
+    size_t total = 0;
+    size_t outSize;
+
+    ok = true;
+    for (size_t offset = 0; offset < data.size() && ok; )
+    {
+        size_t size = std::min(nextPiece(data.size() - offset), data.size() - offset);
+        ok = aes.update(data.data() + offset, size, out.data() + total, outSize);
+        total += outSize;
+        offset += size;
+    }
+    ok = ok && aes.final(out.data() + total, outSize);
+    out.resize(total + (ok ? outSize : 0));
+    return out;
+}
+
+/*****************************
+ * Tests run once per backend
+ ****************************/
+
+typedef std::tuple<AES::ENGINE, AES::GHASH, unsigned int> BackendParam;
+
+static const AES::ENGINE TEST_ENGINES[] = { AES::ENGINE::REFERENCE, AES::ENGINE::TTABLE,
+    AES::ENGINE::BITSLICE, AES::ENGINE::AESNI, AES::ENGINE::VAES };
+static const AES::GHASH TEST_GHASHES[] = { AES::GHASH::REFERENCE, AES::GHASH::TABLE,
+    AES::GHASH::CLMUL, AES::GHASH::VPCLMUL };
+
+// Skipped when the CPU doesn't support the engine or the ghash engine
+class BackendTest : public ::testing::TestWithParam<BackendParam>
+{
+protected:
+    void SetUp() override
+    {
+        this->backend.engine = std::get<0>(GetParam());
+        this->backend.ghash = std::get<1>(GetParam());
+        this->backend.threads = std::get<2>(GetParam());
+        if (!AES::AES::isEngineSupported(this->backend.engine))
+            GTEST_SKIP() << "engine not supported by this CPU";
+        if (!AES::AES::isGhashSupported(this->backend.ghash))
+            GTEST_SKIP() << "ghash engine not supported by this CPU";
+    }
+
+    Backend backend;
+};
+
+// Test names only allow letters, digits and underscores, getEngineFromEnum can't be used
+inline std::string backendName(const ::testing::TestParamInfo<BackendParam>& info)
+{
+    static const char* ENGINE_NAMES[] = { "auto", "ref", "ttable", "bitslice", "aesni",
+        "vaes" };
+    static const char* GHASH_NAMES[] = { "auto", "ref", "table", "clmul", "vpclmul" };
+
+    return std::string(ENGINE_NAMES[(int)std::get<0>(info.param)]) + "_"
+        + GHASH_NAMES[(int)std::get<1>(info.param)] + "_"
+        + std::to_string(std::get<2>(info.param)) + "T";
+}
+
+#endif
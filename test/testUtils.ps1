@@ -4,6 +4,9 @@ $cliExePath = "..\bin\cliaes\cliaes.exe"
 
 $modes = "ctr", "ecb", "cbc"
 $keySizes = "128", "192", "256"
+$engines = "ref", "ttable", "bitslice", "aesni"
+$ghashEngines = "ref", "table", "clmul"
+$threadCounts = "1", "4"
 
 $defaultKeys = @{
     "128" = "000102030405060708090a0b0c0d0e0f"
@@ -24,6 +27,9 @@ function Invoke-Cliaes {
         [string]$Key,
         [string]$Aad = "",
         [string]$Tag = "",
+        [string]$Engine = "",
+        [string]$Ghash = "",
+        [string]$Threads = "",
         [boolean]$Decrypt,
         [boolean]$NoPadding
     )
@@ -41,6 +47,15 @@ function Invoke-Cliaes {
     if ($Tag) {
         $params += "-t $Tag"
     }
+    if ($Engine) {
+        $params += "--engine $Engine"
+    }
+    if ($Ghash) {
+        $params += "--ghash $Ghash"
+    }
+    if ($Threads) {
+        $params += "--threads $Threads"
+    }
 
     $process = Start-Process -PassThru -FilePath $cliExePath -ArgumentList $params
     $process.WaitForExit()
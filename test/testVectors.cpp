@@ -0,0 +1,402 @@
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <libaes/libaes.hpp>
+
+#include "testUtils.hpp"
+
+/**
+ * The files of res/ fed straight into the library, for every engine, ghash engine and
+ * thread count the CPU supports
+ * Each vector goes through cipher/decipher, then through init/update/final in small pieces
+**/
+
+#ifndef CRYPTOMANIA_RES_DIR
+#error CRYPTOMANIA_RES_DIR must be the path of the res directory
+#endif
+
+static Bytes readRes(const std::string& name)
+{
+    std::string path = std::string(CRYPTOMANIA_RES_DIR) + "/" + name;
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    if (!file.is_open()) {
+        ADD_FAILURE() << "Can't open " << path;
+        return Bytes();
+    }
+    return Bytes(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static Bytes fromHex(const std::string& hex)
+{
+    Bytes bytes;
+    for (size_t i = 0; i + 1 < hex.size(); i += 2)
+        bytes.push_back((byte_t)std::stoi(hex.substr(i, 2), nullptr, 16));
+    return bytes;
+}
+
+// Buffers get a spare block, so data() is never nullptr even for an empty message
+static void checkOneShot(const Backend& backend, const Vector& v)
+{
+    AES::PADDING padding = v.padding ? AES::PADDING::PKCS7 : AES::PADDING::NONE;
+    size_t cipherSize = AES::AES::getCipherOutBufferSize(v.plain.size(), padding, v.mode);
+
+    Bytes in(v.plain);
+    in.resize(AES::AES::getPlainInBufferSize(v.plain.size(), padding, v.mode)
+        + AES::AES::BLOCKSIZE);
+    Bytes out(cipherSize + AES::AES::BLOCKSIZE);
+    {
+        AES::AES aes;
+        ASSERT_TRUE(setup(aes, backend, v));
+        ASSERT_TRUE(aes.cipher(in.data(), out.data(), v.plain.size()));
+    }
+    out.resize(cipherSize);
+    EXPECT_EQ(v.expected, out) << "cipher";
+
+    out.resize(cipherSize + AES::AES::BLOCKSIZE);
+    Bytes plain(AES::AES::getPlainOutBufferSize(cipherSize, padding, v.mode)
+        + AES::AES::BLOCKSIZE);
+    {
+        AES::AES aes;
+        ASSERT_TRUE(setup(aes, backend, v));
+        ASSERT_TRUE(aes.decipher(out.data(), plain.data(), cipherSize));
+    }
+    plain.resize(AES::AES::getPlainOutBufferSize(cipherSize, padding, v.mode)
+        - AES::AES::getRevPaddingSize(plain.data(), cipherSize, padding, v.mode));
+    EXPECT_EQ(v.plain, plain) << "decipher";
+
+    if (v.mode == AES::MODE::GCM || v.mode == AES::MODE::OCB || v.mode == AES::MODE::GCM_SIV)
+    {
+        out[cipherSize - 1] ^= 1;
+        AES::AES aes;
+        ASSERT_TRUE(setup(aes, backend, v));
+        EXPECT_FALSE(aes.decipher(out.data(), plain.data(), cipherSize)) << "tag";
+    }
+}
+
+// Same result when the message is given in pieces of pieceSize bytes
+static void checkStream(const Backend& backend, const Vector& v, size_t pieceSize)
+{
+    auto nextPiece = [pieceSize](size_t) { return pieceSize; };
+    bool ok;
+    AES::AES enc;
+    ASSERT_TRUE(setup(enc, backend, v));
+    ASSERT_TRUE(enc.init(true));
+    EXPECT_EQ(v.expected, streamPieces(enc, v.plain, nextPiece, ok)) << "stream cipher";
+    EXPECT_TRUE(ok);
+
+    AES::AES dec;
+    ASSERT_TRUE(setup(dec, backend, v));
+    ASSERT_TRUE(dec.init(false));
+    EXPECT_EQ(v.plain, streamPieces(dec, v.expected, nextPiece, ok)) << "stream decipher";
+    EXPECT_TRUE(ok);
+}
+
+static void checkVector(const Backend& backend, const Vector& v)
+{
+    checkOneShot(backend, v);
+    if (v.mode == AES::MODE::XTS || v.mode == AES::MODE::GCM_SIV) // No streaming
+        return;
+    checkStream(backend, v, 1);
+    checkStream(backend, v, 17);
+}
+
+/*****************************
+ * Vector sets of res/
+ ****************************/
+
+static const char* KEY_SIZE_NAMES[] = { "128", "192", "256" };
+static const AES::KEY_SIZE KEY_SIZES[] = { AES::KEY_SIZE::S128, AES::KEY_SIZE::S192,
+    AES::KEY_SIZE::S256 };
+static const char* MODE_NAMES[] = { "ecb", "cbc", "ctr" };
+static const AES::MODE MODES[] = { AES::MODE::ECB, AES::MODE::CBC, AES::MODE::CTR };
+
+// res/testCases, pkcs7 padding, same keys and iv as test/testUtils.ps1
+static std::vector<Vector> loadTestCases()
+{
+    static const char* KEYS[] = {
+        "000102030405060708090a0b0c0d0e0f",
+        "000102030405060708090a0b0c0d0e0f08090a0b0c0d0e0f",
+        "000102030405060708090a0b0c0d0e0f000102030405060708090a0b0c0d0e0f"
+    };
+    static const char* FILES[] = { "lt1block", "eq1block", "gt1block", "3block" };
+
+    std::vector<Vector> vectors;
+    for (const char* file : FILES) {
+        for (int k = 0; k < 3; ++k) {
+            for (int m = 0; m < 3; ++m) {
+                std::string name = std::string("testCases/") + file;
+                Vector v;
+                v.keySize = KEY_SIZES[k];
+                v.mode = MODES[m];
+                v.padding = true;
+                v.key = fromHex(KEYS[k]);
+                v.iv = fromHex("000102030405060708090a0b0c0d0e0f");
+                v.plain = readRes(name);
+                v.expected = readRes(name + "." + KEY_SIZE_NAMES[k] + "." + MODE_NAMES[m]);
+                vectors.push_back(v);
+            }
+        }
+    }
+    return vectors;
+}
+
+// res/nistTestCases, NIST SP 800-38A F.1, F.2 and F.5 without padding
+static std::vector<Vector> loadNistTestCases()
+{
+    static const char* KEYS[] = {
+        "2b7e151628aed2a6abf7158809cf4f3c",
+        "8e73b0f7da0e6452c810f32b809079e562f8ead2522c6b7b",
+        "603deb1015ca71be2b73aef0857d77811f352c073b6108d72d9810a30914dff4"
+    };
+
+    std::vector<Vector> vectors;
+    for (int k = 0; k < 3; ++k) {
+        for (int m = 0; m < 3; ++m) {
+            Vector v;
+            v.keySize = KEY_SIZES[k];
+            v.mode = MODES[m];
+            v.padding = false;
+            v.key = fromHex(KEYS[k]);
+            v.iv = fromHex(MODES[m] == AES::MODE::CTR ? "f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff"
+                : "000102030405060708090a0b0c0d0e0f");
+            v.plain = readRes("nistTestCases/msg");
+            v.expected = readRes(std::string("nistTestCases/msg.") + KEY_SIZE_NAMES[k]
+                + "." + MODE_NAMES[m]);
+            vectors.push_back(v);
+        }
+    }
+    return vectors;
+}
+
+// res/nistGcmTestCases, test cases 1 to 6 of the GCM specification, ciphertext then tag
+static std::vector<Vector> loadNistGcmTestCases()
+{
+    static const char* KEY = "feffe9928665731c6d6a8f9467308308";
+    static const char* AAD = "feedfacedeadbeeffeedfacedeadbeefabaddad2";
+    static const struct {
+        const char* file;
+        const char* key;
+        const char* iv;
+        const char* aad;
+    } CASES[] = {
+        { "msgEmpty", "00000000000000000000000000000000", "000000000000000000000000", "" },
+        { "msgZeros", "00000000000000000000000000000000", "000000000000000000000000", "" },
+        { "msg64", KEY, "cafebabefacedbaddecaf888", "" },
+        { "msg60", KEY, "cafebabefacedbaddecaf888", AAD },
+        { "msg60iv12", KEY, "cafebabefacedbad", AAD },
+        { "msg60iv120", KEY, "9313225df88406e555909c5aff5269aa6a7a9538534f7da1e4c303d2a318a728"
+            "c3c0c95156809539fcf0e2429a6b525416aedbf5a0de6a57a637b39b", AAD }
+    };
+
+    std::vector<Vector> vectors;
+    for (const auto& c : CASES) {
+        std::string name = std::string("nistGcmTestCases/") + c.file;
+        Vector v;
+        v.keySize = AES::KEY_SIZE::S128;
+        v.mode = AES::MODE::GCM;
+        v.padding = false;
+        v.key = fromHex(c.key);
+        v.iv = fromHex(c.iv);
+        v.aad = fromHex(c.aad);
+        v.plain = readRes(name);
+        v.expected = readRes(name + ".128");
+        vectors.push_back(v);
+    }
+    return vectors;
+}
+
+// res/xtsTestCases, IEEE 1619 vectors, the iv is the data unit number in little endian
+static std::vector<Vector> loadXtsTestCases()
+{
+    static const char* KEY_4 = "2718281828459045235360287471352631415926535897932384626433832795";
+    static const char* KEY_15 = "fffefdfcfbfaf9f8f7f6f5f4f3f2f1f0bfbebdbcbbbab9b8b7b6b5b4b3b2b1b0";
+    static const struct {
+        const char* file;
+        AES::KEY_SIZE keySize;
+        const char* key;
+        const char* iv;
+    } CASES[] = {
+        { "vec1", AES::KEY_SIZE::S128,
+            "0000000000000000000000000000000000000000000000000000000000000000",
+            "00000000000000000000000000000000" },
+        { "vec2", AES::KEY_SIZE::S128,
+            "1111111111111111111111111111111122222222222222222222222222222222",
+            "33333333330000000000000000000000" },
+        { "vec4", AES::KEY_SIZE::S128, KEY_4, "00000000000000000000000000000000" },
+        { "vec10", AES::KEY_SIZE::S256,
+            "27182818284590452353602874713526624977572470936999595749669676273141592653589793238462"
+            "643383279502884197169399375105820974944592", "ff000000000000000000000000000000" },
+        { "vec15", AES::KEY_SIZE::S128, KEY_15, "9a785634120000000000000000000000" },
+        { "vec17", AES::KEY_SIZE::S128, KEY_15, "9a785634120000000000000000000000" },
+        { "vec18", AES::KEY_SIZE::S128, KEY_15, "9a785634120000000000000000000000" }
+    };
+
+    std::vector<Vector> vectors;
+    for (const auto& c : CASES) {
+        std::string name = std::string("xtsTestCases/") + c.file;
+        Vector v;
+        v.keySize = c.keySize;
+        v.mode = AES::MODE::XTS;
+        v.padding = false;
+        v.key = fromHex(c.key);
+        v.iv = fromHex(c.iv);
+        v.plain = readRes(name);
+        v.expected = readRes(name + "." + std::to_string((int)c.keySize));
+        vectors.push_back(v);
+    }
+    return vectors;
+}
+
+// res/ocbTestCases, RFC 7253 sample results, AES-128, ciphertext then tag
+// Vector i has nonce BBAA99887766554433221100 + i, its aad is the plaintext or the same bytes
+static std::vector<Vector> loadOcbTestCases()
+{
+    static const char* NONCE = "bbaa998877665544332211";
+    static const char* S = "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f"
+        "2021222324252627";
+
+    std::vector<Vector> vectors;
+    for (int i = 0; i < 16; ++i) {
+        static const char* HEX = "0123456789abcdef";
+        std::string number = std::string(1, HEX[i / 16]) + HEX[i % 16];
+        std::string name = "ocbTestCases/vec" + number;
+        // Vector 0 is empty, then each length has aad and plaintext, aad only, plaintext only
+        size_t length = i == 0 ? 0 : 8 * ((i - 1) / 3 + 1);
+        bool hasAad = i != 0 && (i - 1) % 3 != 2;
+        Vector v;
+        v.keySize = AES::KEY_SIZE::S128;
+        v.mode = AES::MODE::OCB;
+        v.padding = false;
+        v.key = fromHex("000102030405060708090a0b0c0d0e0f");
+        v.iv = fromHex(NONCE + number);
+        v.aad = hasAad ? fromHex(std::string(S, 2 * length)) : Bytes();
+        v.plain = readRes(name);
+        v.expected = readRes(name + ".128");
+        vectors.push_back(v);
+    }
+    return vectors;
+}
+
+// res/gcmSivTestCases, RFC 8452 appendix C.1 and C.2, same plaintexts for both key sizes
+// The key is 01 followed by zeros, the aad of vector i is GCM_SIV_AADS[i]
+static std::vector<Vector> loadGcmSivTestCases()
+{
+    static const char* GCM_SIV_AADS[] = { "", "", "", "", "", "", "", "01", "01", "01", "01",
+        "01", "01", "010000000000000000000000", "010000000000000000000000000000000200",
+        "0100000000000000000000000000000002000000" };
+
+    std::vector<Vector> vectors;
+    for (AES::KEY_SIZE keySize : { AES::KEY_SIZE::S128, AES::KEY_SIZE::S256 }) {
+        for (int i = 0; i < 16; ++i) {
+            static const char* HEX = "0123456789abcdef";
+            std::string name = std::string("gcmSivTestCases/vec") + HEX[i / 16] + HEX[i % 16];
+            Vector v;
+            v.keySize = keySize;
+            v.mode = AES::MODE::GCM_SIV;
+            v.padding = false;
+            v.key = Bytes((size_t)keySize / 8, 0);
+            v.key[0] = 0x01;
+            v.iv = fromHex("030000000000000000000000");
+            v.aad = fromHex(GCM_SIV_AADS[i]);
+            v.plain = readRes(name);
+            v.expected = readRes(name + "." + std::to_string((int)keySize));
+            vectors.push_back(v);
+        }
+    }
+    return vectors;
+}
+
+/*****************************
+ * Tests, one instance per backend
+ ****************************/
+
+class VectorTest : public BackendTest
+{
+protected:
+    void checkAll(const std::vector<Vector>& vectors)
+    {
+        ASSERT_FALSE(vectors.empty());
+        for (size_t i = 0; i < vectors.size(); ++i) {
+            SCOPED_TRACE("vector " + std::to_string(i) + ", "
+                + AES::AES::getModeFromEnum(vectors[i].mode) + "-"
+                + std::to_string(AES::AES::getKeySizeFromEnum(vectors[i].keySize)));
+            checkVector(this->backend, vectors[i]);
+        }
+    }
+};
+
+// The ghash engine only matters for GCM and GCM-SIV, the other modes run with AUTO
+class CipherVectorTest : public VectorTest {};
+class GcmVectorTest : public VectorTest {};
+
+TEST_P(CipherVectorTest, TestCases)
+{
+    this->checkAll(loadTestCases());
+}
+
+TEST_P(CipherVectorTest, NistTestCases)
+{
+    this->checkAll(loadNistTestCases());
+}
+
+TEST_P(CipherVectorTest, XtsTestCases)
+{
+    this->checkAll(loadXtsTestCases());
+}
+
+TEST_P(CipherVectorTest, OcbTestCases)
+{
+    this->checkAll(loadOcbTestCases());
+}
+
+TEST_P(GcmVectorTest, NistGcmTestCases)
+{
+    this->checkAll(loadNistGcmTestCases());
+}
+
+TEST_P(GcmVectorTest, GcmSivTestCases)
+{
+    this->checkAll(loadGcmSivTestCases());
+}
+
+// Output must not depend on the number of threads
+INSTANTIATE_TEST_SUITE_P(Engines, CipherVectorTest, ::testing::Combine(
+    ::testing::ValuesIn(TEST_ENGINES),
+    ::testing::Values(AES::GHASH::AUTO),
+    ::testing::Values(1u, 4u)), backendName);
+
+INSTANTIATE_TEST_SUITE_P(Engines, GcmVectorTest, ::testing::Combine(
+    ::testing::ValuesIn(TEST_ENGINES),
+    ::testing::ValuesIn(TEST_GHASHES),
+    ::testing::Values(1u, 4u)), backendName);
+
+TEST(Gcm, InvalidCalls)
+{
+    const Bytes key(16, 0x42);
+    Bytes data(64, 0x5A);
+    Bytes out(64);
+
+    AES::AES aes;
+    ASSERT_TRUE(aes.initialize(AES::KEY_SIZE::S128, AES::MODE::GCM, false, key.data()));
+    EXPECT_FALSE(aes.setIv(data.data(), 0));
+    ASSERT_TRUE(aes.setIv(data.data(), 12));
+
+    // Tag alone, then a message shorter than the tag
+    ASSERT_TRUE(aes.cipher(data.data(), out.data(), 0));
+    EXPECT_TRUE(aes.decipher(out.data(), data.data(), 16));
+    EXPECT_FALSE(aes.decipher(out.data(), data.data(), 15));
+
+    // The aad is part of the tag, the plain text of a wrong tag is wiped
+    ASSERT_TRUE(aes.cipher(data.data(), out.data(), 20));
+    ASSERT_TRUE(aes.setAad(data.data(), 3));
+    Bytes plain(20, 0xEE);
+    EXPECT_FALSE(aes.decipher(out.data(), plain.data(), 36));
+    EXPECT_EQ(Bytes(20, 0), plain);
+    ASSERT_TRUE(aes.setAad(nullptr, 0));
+    EXPECT_TRUE(aes.decipher(out.data(), plain.data(), 36));
+    EXPECT_EQ(Bytes(20, 0x5A), plain);
+}
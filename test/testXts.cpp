@@ -0,0 +1,138 @@
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <libaes/libaes.hpp>
+
+#include "testUtils.hpp"
+
+/**
+ * cipherSectors/decipherSectors against cipher/decipher, one data unit at a time
+ * Sector numbers are random 64 bits values, the iv of a data unit is its number in little endian
+ * Enough sectors are given for the 4 threads instances to split them
+**/
+
+static Bytes randomBytes(std::mt19937_64& rng, size_t n)
+{
+    Bytes out(n);
+    for (byte_t& b : out)
+        b = (byte_t)rng();
+    return out;
+}
+
+static Vector xtsVector(AES::KEY_SIZE keySize, std::mt19937_64& rng)
+{
+    Vector v;
+    v.keySize = keySize;
+    v.mode = AES::MODE::XTS;
+    v.padding = false;
+    v.key = randomBytes(rng, 2 * (size_t)keySize / 8);
+    return v;
+}
+
+static Bytes sectorIv(uint64_t sector)
+{
+    Bytes iv(AES::AES::BLOCKSIZE, 0);
+    for (int i = 0; i < 8; ++i)
+        iv[i] = (byte_t)(sector >> (8 * i));
+    return iv;
+}
+
+class XtsTest : public BackendTest
+{
+protected:
+    void checkSectors(AES::KEY_SIZE keySize, size_t sectorSize, size_t count)
+    {
+        SCOPED_TRACE(std::to_string((int)keySize) + " bits, " + std::to_string(count)
+            + " sectors of " + std::to_string(sectorSize));
+        std::mt19937_64 rng(sectorSize ^ count);
+        Vector v = xtsVector(keySize, rng);
+        v.iv = Bytes(AES::AES::BLOCKSIZE, 0);
+        const Bytes plain = randomBytes(rng, sectorSize * count);
+        std::vector<uint64_t> sectors(count);
+        for (uint64_t& sector : sectors)
+            sector = rng();
+
+        AES::AES aes;
+        ASSERT_TRUE(setup(aes, this->backend, v));
+        Bytes cipher(plain.size());
+        ASSERT_TRUE(aes.cipherSectors(plain.data(), cipher.data(), sectorSize, sectors.data(),
+            count));
+
+        // One data unit at a time on the reference engine
+        Vector ref = v;
+        AES::AES one;
+        ASSERT_TRUE(setup(one, { AES::ENGINE::REFERENCE, AES::GHASH::AUTO, 1 }, ref));
+        Bytes in(plain);
+        Bytes expected(plain.size());
+        for (size_t i = 0; i < count; ++i) {
+            Bytes iv = sectorIv(sectors[i]);
+            ASSERT_TRUE(one.setIv(iv.data(), (int)iv.size()));
+            ASSERT_TRUE(one.cipher(in.data() + i * sectorSize, expected.data() + i * sectorSize,
+                sectorSize));
+        }
+        EXPECT_EQ(expected, cipher);
+
+        // In place
+        ASSERT_TRUE(aes.decipherSectors(cipher.data(), cipher.data(), sectorSize,
+            sectors.data(), count));
+        EXPECT_EQ(plain, cipher);
+    }
+};
+
+TEST_P(XtsTest, SectorsMatchDataUnits)
+{
+    for (AES::KEY_SIZE keySize : { AES::KEY_SIZE::S128, AES::KEY_SIZE::S256 }) {
+        checkSectors(keySize, 512, 2100);
+        checkSectors(keySize, 4096, 260);
+        checkSectors(keySize, 16384, 65);
+        checkSectors(keySize, 520, 37); // Ciphertext stealing in every sector
+        checkSectors(keySize, 16, 9);
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(Engines, XtsTest, ::testing::Combine(
+    ::testing::ValuesIn(TEST_ENGINES),
+    ::testing::Values(AES::GHASH::AUTO),
+    ::testing::Values(1u, 4u)), backendName);
+
+TEST(Xts, InvalidCalls)
+{
+    std::mt19937_64 rng(0x775);
+    Vector v = xtsVector(AES::KEY_SIZE::S128, rng);
+    Bytes data(64, 0x5A);
+    Bytes out(64);
+    const uint64_t sectors[2] = { 0, 1 };
+
+    AES::AES aes;
+    EXPECT_FALSE(aes.cipherSectors(data.data(), out.data(), 32, sectors, 2)); // Not initialized
+    EXPECT_FALSE(aes.initialize(AES::KEY_SIZE::S192, AES::MODE::XTS, false, v.key.data()));
+    ASSERT_TRUE(aes.initialize(AES::KEY_SIZE::S128, AES::MODE::XTS, true, v.key.data()));
+    EXPECT_FALSE(aes.cipherSectors(data.data(), out.data(), 15, sectors, 2));
+    EXPECT_FALSE(aes.cipherSectors(data.data(), out.data(), 32, nullptr, 2));
+    EXPECT_TRUE(aes.cipherSectors(nullptr, nullptr, 32, nullptr, 0));
+
+    // Padding is ignored, the output keeps the data size
+    Bytes iv = sectorIv(7);
+    ASSERT_TRUE(aes.setIv(iv.data(), (int)iv.size()));
+    out.assign(64, 0xEE);
+    EXPECT_TRUE(aes.cipher(data.data(), out.data(), 33));
+    EXPECT_EQ(0xEE, out[33]);
+    EXPECT_FALSE(aes.cipher(data.data(), out.data(), 15));
+    EXPECT_FALSE(aes.init(true));
+
+    AES::BatchJob job = {};
+    job.key = &aes;
+    job.iv = iv.data();
+    job.ivSize = (unsigned int)iv.size();
+    job.dataIn = data.data();
+    job.dataOut = out.data();
+    job.dataSize = 32;
+    EXPECT_FALSE(AES::AES::cipherBatch(&job, 1));
+
+    AES::AES cbc;
+    ASSERT_TRUE(cbc.initialize(AES::KEY_SIZE::S128, AES::MODE::CBC, false, v.key.data()));
+    EXPECT_FALSE(cbc.cipherSectors(data.data(), out.data(), 32, sectors, 2));
+}